@@ -193,11 +193,15 @@ typedef uint8_t byte;
 #define degrees(rad) ((rad)*RAD_TO_DEG)
 #define sq(x) ((x)*(x))
 
+#ifdef ENERGIA_CRITICAL_TRACE
+#define interrupts() criticalTraceInterrupts()
+#define noInterrupts() criticalTraceNoInterrupts()
+#else
 #define interrupts() ROM_IntMasterEnable()
 #define noInterrupts() ROM_IntMasterDisable()
+#endif
 
-//#define clockCyclesPerMicrosecond() ( F_CPU / 1000000L )
-#define clockCyclesPerMicrosecond() ( 80000000L / 1000000L )
+#define clockCyclesPerMicrosecond() ( cpuFrequency() / 1000000L )
 #define clockCyclesToMicroseconds(a) ( (a) / clockCyclesPerMicrosecond() )
 #define microsecondsToClockCycles(a) ( (a) * clockCyclesPerMicrosecond() )
 
@@ -239,6 +243,13 @@ void suspend(void);
 extern volatile boolean stay_asleep;
 #define wakeup() { stay_asleep = false; }
 
+// Bit n is set when UART n receives data, serialEventRun() clears it
+extern volatile uint8_t serialEventPending;
+// Sleep until an interrupt is pending unless a serial event is waiting
+void waitForEvent(void);
+// When true, main() calls waitForEvent() after each loop()
+extern boolean loopIdle;
+
 void attachInterrupt(uint8_t, void (*)(void), int mode);
 void detachInterrupt(uint8_t);
 
@@ -299,8 +310,19 @@ extern const uint32_t digital_pin_to_analog_in[];
 void delayMicroseconds(unsigned int us);
 unsigned long micros();
 unsigned long millis();
+void clockInit();
 void timerInit();
 void registerSysTickCb(void (*userFunc)(uint32_t));
+// Thread context callbacks, run after each loop() and while delay() waits
+void registerLoopCb(void (*userFunc)(void));
+void loopCbRun(void);
+
+// Phases passed to the registerCpuFrequencyCb() callbacks
+#define CPU_FREQ_PRE    0   // about to switch, interrupts enabled
+#define CPU_FREQ_POST   1   // switched, interrupts disabled
+uint32_t cpuFrequency(void);
+uint32_t setCpuFrequency(uint32_t hz);
+void registerCpuFrequencyCb(void (*userFunc)(uint32_t hz, uint8_t phase));
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -329,6 +351,13 @@ long map(long, long, long, long, long);
 
 #endif
 
+#include "WRandom.h"
+#include "boot.h"
+#include "priority.h"
+#include "heap.h"
+#include "stack.h"
+#include "mpu_guard.h"
+#include "crash.h"
 #include "pins_energia.h"
 
 #endif
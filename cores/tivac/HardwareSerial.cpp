@@ -38,6 +38,7 @@
 #include <string.h>
 #include <inttypes.h>
 #include "wiring_private.h"
+#include "fast_map.h"
 #include "inc/hw_memmap.h"
 #include "inc/hw_types.h"
 #include "inc/hw_ints.h"
@@ -55,6 +56,9 @@
 #define TX_BUFFER_EMPTY    (txReadIndex == txWriteIndex)
 #define TX_BUFFER_FULL     (((txWriteIndex + 1) % txBufferSize) == txReadIndex)
 
+// Highest priority that may call write(), see primeTransmit()
+#define TX_PRIORITY        INT_PRIORITY_GPIO
+
 #define RX_BUFFER_EMPTY    (rxReadIndex == rxWriteIndex)
 #define RX_BUFFER_FULL     (((rxWriteIndex + 1) % rxBufferSize) == rxReadIndex)
 
@@ -154,43 +158,13 @@ static const unsigned long g_ulUARTPins[8] =
 #endif
 };
 
-// Constructors ////////////////////////////////////////////////////////////////
-HardwareSerial::HardwareSerial(void)
-{
-    txWriteIndex = 0;
-    txReadIndex = 0;
-    rxWriteIndex = 0;
-    rxReadIndex = 0;
-    uartModule = 0;
-
-    txBuffer = (unsigned char *) 0xFFFFFFFF;
-    rxBuffer = (unsigned char *) 0xFFFFFFFF;
-    txBufferSize = SERIAL_BUFFER_SIZE;
-    rxBufferSize = SERIAL_BUFFER_SIZE;
-}
-
-HardwareSerial::HardwareSerial(unsigned long module) 
-{
-    txWriteIndex = 0;
-    txReadIndex = 0;
-    rxWriteIndex = 0;
-    rxReadIndex = 0;
-    uartModule = module;
-
-    txBuffer = (unsigned char *) 0xFFFFFFFF;
-    rxBuffer = (unsigned char *) 0xFFFFFFFF;
-    txBufferSize = SERIAL_BUFFER_SIZE;
-    rxBufferSize = SERIAL_BUFFER_SIZE;
-}
 // Private Methods //////////////////////////////////////////////////////////////
 void
 HardwareSerial::flushAll(void)
 {
-    // wait for transmission of outgoing data
-    while(!TX_BUFFER_EMPTY)
-    {
-    }
-    while (ROM_UARTBusy(UART_BASE)) ;
+    // wait for transmission of outgoing data; flush() feeds the FIFO
+    // itself, so this also works with the UART interrupt masked
+    flush();
     txReadIndex = 0;
     txWriteIndex = 0;
 
@@ -201,7 +175,7 @@ HardwareSerial::flushAll(void)
     rxWriteIndex = 0;
 }
 
-void
+RAMFUNC void
 HardwareSerial::primeTransmit(unsigned long ulBase)
 {
     //
@@ -210,28 +184,24 @@ HardwareSerial::primeTransmit(unsigned long ulBase)
     if(!TX_BUFFER_EMPTY)
     {
         //
-        // Disable the UART interrupt. If we don't do this there is a race
-        // condition which can cause the read index to be corrupted.
+        // write() may be called from attachInterrupt() and SysTick
+        // callbacks, which preempt the UART interrupt. Mask all of them
+        // while the ring indexes are updated.
         //
-        ROM_IntDisable(g_ulUARTInt[uartModule]);
+        uint32_t saved = criticalEnter(TX_PRIORITY);
         //
         // Yes - take some characters out of the transmit buffer and feed
-        // them to the UART transmit FIFO.
+        // them to the UART transmit FIFO. The TX interrupt refills it as
+        // it drains.
         //
-        while(!TX_BUFFER_EMPTY)
-        {
-            while(ROM_UARTSpaceAvail(ulBase) && !TX_BUFFER_EMPTY){
-                ROM_UARTCharPutNonBlocking(ulBase,
-                                       txBuffer[txReadIndex]);
+        while(FAST_UARTSpaceAvail(ulBase) && !TX_BUFFER_EMPTY){
+            FAST_UARTCharPutNonBlocking(ulBase,
+                                    txBuffer[txReadIndex]);
 
-                txReadIndex = (txReadIndex + 1) % txBufferSize;
-            }
+            txReadIndex = (txReadIndex + 1) % txBufferSize;
         }
 
-        //
-        // Reenable the UART interrupt.
-        //
-        ROM_IntEnable(g_ulUARTInt[uartModule]);
+        criticalExit(saved);
     }
 }
 
@@ -252,7 +222,7 @@ HardwareSerial::begin(unsigned long baud)
 
     ROM_GPIOPinTypeUART(g_ulUARTPort[uartModule], g_ulUARTPins[uartModule]);
 
-    ROM_UARTConfigSetExpClk(UART_BASE, F_CPU, baudRate,
+    ROM_UARTConfigSetExpClk(UART_BASE, cpuFrequency(), baudRate,
                             (UART_CONFIG_PAR_NONE | UART_CONFIG_STOP_ONE |
                              UART_CONFIG_WLEN_8));
     //
@@ -267,18 +237,22 @@ HardwareSerial::begin(unsigned long baud)
     // Allocate TX & RX buffers
     // Make sure buffers are ready before interrupts are enabled
     // so the handlers do not fail because of unitialized pointers
-    //
-    if (txBuffer != (unsigned char *)0xFFFFFFFF)  // Catch attempts to re-init this Serial instance by freeing old buffer first
-        free(txBuffer);
-    if (rxBuffer != (unsigned char *)0xFFFFFFFF)  // Catch attempts to re-init this Serial instance by freeing old buffer first
-        free(rxBuffer);
-    txBuffer = (unsigned char *) malloc(txBufferSize);
-    rxBuffer = (unsigned char *) malloc(rxBufferSize);
+    // Buffers handed in with setBuffers() are owned by the caller
+    //
+    if (!userBuffers) {
+        if (txBuffer)  // Catch attempts to re-init this Serial instance by freeing old buffer first
+            free(txBuffer);
+        if (rxBuffer)  // Catch attempts to re-init this Serial instance by freeing old buffer first
+            free(rxBuffer);
+        txBuffer = (unsigned char *) malloc(txBufferSize);
+        rxBuffer = (unsigned char *) malloc(rxBufferSize);
+    }
     
     //
     // Enable interrupts
     //
     ROM_UARTIntEnable(UART_BASE, UART_INT_RX | UART_INT_RT);
+    ROM_IntPrioritySet(g_ulUARTInt[uartModule], INT_PRIORITY_UART);
     ROM_IntEnable(g_ulUARTInt[uartModule]);
 
     //
@@ -287,18 +261,80 @@ HardwareSerial::begin(unsigned long baud)
     ROM_UARTEnable(UART_BASE);
 
 
+    registerCpuFrequencyCb(cpuFrequencyChanged);
+
     SysCtlDelay(100);
 }
 
+//
+// Keep the baud rate across setCpuFrequency(). Pending output is sent at
+// the old rate first, then the divisors are reloaded for the new clock
+// with the line settings left as they are.
+//
+void
+HardwareSerial::retime(uint32_t hz, uint8_t phase)
+{
+    if (phase == CPU_FREQ_PRE) {
+        flush();
+        return;
+    }
+    ROM_UARTConfigSetExpClk(UART_BASE, hz, baudRate,
+                            HWREG(UART_BASE + UART_O_LCRH) &
+                            (UART_CONFIG_WLEN_MASK | UART_CONFIG_STOP_MASK |
+                             UART_CONFIG_PAR_MASK));
+}
+
+void
+HardwareSerial::cpuFrequencyChanged(uint32_t hz, uint8_t phase)
+{
+    HardwareSerial *const ports[] = {
+        &Serial, &Serial1, &Serial2, &Serial3,
+        &Serial4, &Serial5, &Serial6, &Serial7
+    };
+    unsigned i;
+
+    for (i = 0; i < sizeof(ports) / sizeof(ports[0]); i++) {
+        if (ports[i]->baudRate)
+            ports[i]->retime(hz, phase);
+    }
+}
+
 void
 HardwareSerial::setBufferSize(unsigned long txsize, unsigned long rxsize)
 {
+    if (userBuffers) {
+        // Forget the caller's buffers, begin() allocates new ones
+        txBuffer = NULL;
+        rxBuffer = NULL;
+        userBuffers = false;
+    }
     if (txsize > 0)
         txBufferSize = txsize;
     if (rxsize > 0)
         rxBufferSize = rxsize;
 }
 
+//
+// Use caller supplied buffers (static arrays or BlockPool blocks) instead
+// of allocating them from the heap in begin(). Call before begin().
+//
+void
+HardwareSerial::setBuffers(unsigned char *tx, unsigned long txsize,
+                           unsigned char *rx, unsigned long rxsize)
+{
+    if (!userBuffers) {
+        if (txBuffer)
+            free(txBuffer);
+        if (rxBuffer)
+            free(rxBuffer);
+    }
+    txBuffer = tx;
+    txBufferSize = txsize;
+    rxBuffer = rx;
+    rxBufferSize = rxsize;
+    userBuffers = true;
+}
+
 void
 HardwareSerial::setModule(unsigned long module)
 {
@@ -333,21 +369,20 @@ HardwareSerial::operator bool()
 
 void HardwareSerial::end()
 {
-    unsigned long ulInt = ROM_IntMasterDisable();
+    // Drain before taking the lock, so the UART interrupt keeps feeding
+    // the FIFO meanwhile
+    flush();
 
-	flushAll();
-
-    //
-    // If interrupts were enabled when we turned them off, turn them
-    // back on again.
-    //
-    if(!ulInt)
-    {
-        ROM_IntMasterEnable();
-    }
+    uint32_t saved = criticalEnter(TX_PRIORITY);
 
     ROM_IntDisable(g_ulUARTInt[uartModule]);
-    ROM_UARTIntDisable(UART_BASE, UART_INT_RX | UART_INT_RT);
+    ROM_UARTIntDisable(UART_BASE, UART_INT_RX | UART_INT_RT | UART_INT_TX);
+    txReadIndex = 0;
+    txWriteIndex = 0;
+    rxReadIndex = 0;
+    rxWriteIndex = 0;
+
+    criticalExit(saved);
 }
 
 int HardwareSerial::available(void)
@@ -356,6 +391,15 @@ int HardwareSerial::available(void)
 		(rxWriteIndex - rxReadIndex) : rxBufferSize - (rxReadIndex - rxWriteIndex));
 }
 
+int HardwareSerial::availableForWrite(void)
+{
+    //
+    // One slot is always kept free to tell a full buffer from an empty one.
+    //
+    return((txReadIndex > txWriteIndex) ?
+		(txReadIndex - txWriteIndex - 1) : txBufferSize - (txWriteIndex - txReadIndex) - 1);
+}
+
 int HardwareSerial::peek(void)
 {
     unsigned char cChar = 0;
@@ -398,7 +442,8 @@ int HardwareSerial::read(void)
 
 void HardwareSerial::flush()
 {
-    while(!TX_BUFFER_EMPTY);
+    while(!TX_BUFFER_EMPTY)
+        primeTransmit(UART_BASE);
     while (ROM_UARTBusy(UART_BASE)) ;
 }
 
@@ -429,22 +474,26 @@ size_t HardwareSerial::write(uint8_t c)
     }
 */
     //
-    // Send the character to the UART output.
+    // Send the character to the UART output. While the buffer is full keep
+    // feeding the FIFO from here, the UART interrupt can't do it when we
+    // were called with it masked.
     //
-    while (TX_BUFFER_FULL);
+    uint32_t saved = criticalEnter(TX_PRIORITY);
+    while (TX_BUFFER_FULL) {
+        criticalExit(saved);
+        primeTransmit(UART_BASE);
+        saved = criticalEnter(TX_PRIORITY);
+    }
     txBuffer[txWriteIndex] = c;
     txWriteIndex = (txWriteIndex + 1) % txBufferSize;
     numTransmit ++;
 
     //
-    // If we have anything in the buffer, make sure that the UART is set
-    // up to transmit it.
+    // Make sure that the UART is set up to transmit it.
     //
-    if(!TX_BUFFER_EMPTY)
-    {
-	    primeTransmit(UART_BASE);
-        ROM_UARTIntEnable(UART_BASE, UART_INT_TX);
-    }
+    primeTransmit(UART_BASE);
+    FAST_UARTIntEnable(UART_BASE, UART_INT_TX);
+    criticalExit(saved);
 
     //
     // Return the number of characters written.
@@ -452,18 +501,19 @@ size_t HardwareSerial::write(uint8_t c)
     return(numTransmit);
 }
 
-void HardwareSerial::UARTIntHandler(void){
+RAMFUNC void HardwareSerial::UARTIntHandler(void){
     unsigned long ulInts;
     long lChar;
     // Get and clear the current interrupt source(s)
     //
-    ulInts = ROM_UARTIntStatus(UART_BASE, true);
-    ROM_UARTIntClear(UART_BASE, ulInts);
+    ulInts = FAST_UARTIntStatus(UART_BASE, true);
+    FAST_UARTIntClear(UART_BASE, ulInts);
 
     // Are we being interrupted because the TX FIFO has space available?
     //
     if(ulInts & UART_INT_TX)
     {
+        uint32_t saved = criticalEnter(TX_PRIORITY);
         //
         // Move as many bytes as we can into the transmit FIFO.
         //
@@ -471,21 +521,23 @@ void HardwareSerial::UARTIntHandler(void){
 
         //
         // If the output buffer is empty, turn off the transmit interrupt.
+        // A write() from a higher priority handler can't get in between.
         //
         if(TX_BUFFER_EMPTY)
         {
-            ROM_UARTIntDisable(UART_BASE, UART_INT_TX);
+            FAST_UARTIntDisable(UART_BASE, UART_INT_TX);
         }
+        criticalExit(saved);
     }
     if(ulInts & (UART_INT_RX | UART_INT_RT))
     {
-        while(ROM_UARTCharsAvail(UART_BASE))
+        while(FAST_UARTCharsAvail(UART_BASE))
             {
 
             //
             // Read a character
             //
-            lChar = ROM_UARTCharGetNonBlocking(UART_BASE);
+            lChar = FAST_UARTCharGetNonBlocking(UART_BASE);
             //
             // If there is space in the receive buffer, put the character
             // there, otherwise throw it away.
@@ -502,86 +554,114 @@ void HardwareSerial::UARTIntHandler(void){
             // gets transmitted.
             //
         }
+        serialEventPending |= 1 << uartModule;
+        uint32_t saved = criticalEnter(TX_PRIORITY);
         primeTransmit(UART_BASE);
-        ROM_UARTIntEnable(UART_BASE, UART_INT_TX);
+        FAST_UARTIntEnable(UART_BASE, UART_INT_TX);
+        criticalExit(saved);
     }
 }
 
-void
+RAMFUNC void
 UARTIntHandler(void)
 {
     Serial.UARTIntHandler();
 }
 
-void
+RAMFUNC void
 UARTIntHandler1(void)
 {
     Serial1.UARTIntHandler();
 }
 
-void
+RAMFUNC void
 UARTIntHandler2(void)
 {
     Serial2.UARTIntHandler();
 }
 
-void
+RAMFUNC void
 UARTIntHandler3(void)
 {
     Serial3.UARTIntHandler();
 }
 
-void
+RAMFUNC void
 UARTIntHandler4(void)
 {
     Serial4.UARTIntHandler();
 }
 
-void
+RAMFUNC void
 UARTIntHandler5(void)
 {
     Serial5.UARTIntHandler();
 }
 
-void
+RAMFUNC void
 UARTIntHandler6(void)
 {
     Serial6.UARTIntHandler();
 }
 
-void
+RAMFUNC void
 UARTIntHandler7(void)
 {
     Serial7.UARTIntHandler();
 }
 
+//
+// serialEventN() is only called when the sketch defines it
+//
 void serialEvent() __attribute__((weak));
-void serialEvent() {}
 void serialEvent1() __attribute__((weak));
-void serialEvent1() {}
 void serialEvent2() __attribute__((weak));
-void serialEvent2() {}
 void serialEvent3() __attribute__((weak));
-void serialEvent3() {}
 void serialEvent4() __attribute__((weak));
-void serialEvent4() {}
 void serialEvent5() __attribute__((weak));
-void serialEvent5() {}
 void serialEvent6() __attribute__((weak));
-void serialEvent6() {}
 void serialEvent7() __attribute__((weak));
-void serialEvent7() {}
+
+volatile uint8_t serialEventPending;
 
 void serialEventRun(void)
 {
-    if (Serial.available()) serialEvent();
-    if (Serial1.available()) serialEvent1();
-    if (Serial2.available()) serialEvent2();
-    if (Serial3.available()) serialEvent3();
-    if (Serial4.available()) serialEvent4();
-    if (Serial5.available()) serialEvent5();
-    if (Serial6.available()) serialEvent6();
-    if (Serial7.available()) serialEvent7();
+    static void (* const events[8])(void) = {
+        serialEvent, serialEvent1, serialEvent2, serialEvent3,
+        serialEvent4, serialEvent5, serialEvent6, serialEvent7
+    };
+    static HardwareSerial * const ports[8] = {
+        &Serial, &Serial1, &Serial2, &Serial3,
+        &Serial4, &Serial5, &Serial6, &Serial7
+    };
+    uint32_t saved;
+    uint8_t pending, again = 0;
+    int i;
+
+    if (!serialEventPending)
+        return;
+
+    saved = criticalEnter(INT_PRIORITY_UART);
+    pending = serialEventPending;
+    serialEventPending = 0;
+    criticalExit(saved);
+
+    for (i = 0; pending; i++, pending >>= 1) {
+        if (!(pending & 1) || !events[i])
+            continue;
+        events[i]();
+        //
+        // Like Arduino, keep calling serialEvent while unread data is left
+        //
+        if (ports[i]->available())
+            again |= 1 << i;
+    }
+
+    if (again) {
+        saved = criticalEnter(INT_PRIORITY_UART);
+        serialEventPending |= again;
+        criticalExit(saved);
+    }
 }
 
 HardwareSerial Serial;
@@ -35,6 +35,7 @@
 
 #include <inttypes.h>
 #include "Stream.h"
+#include "boot.h"
 
 #define SERIAL_BUFFER_SIZE     256
 
@@ -55,22 +56,35 @@ class HardwareSerial : public Stream
 		volatile unsigned long rxReadIndex;
 		unsigned long uartModule;
 		unsigned long baudRate;
+		bool userBuffers;
 		void flushAll(void);
-		void primeTransmit(unsigned long ulBase);
+		RAMFUNC void primeTransmit(unsigned long ulBase);
+		void retime(uint32_t hz, uint8_t phase);
+		static void cpuFrequencyChanged(uint32_t hz, uint8_t phase);
 
 	public:
-		HardwareSerial(void);
-		HardwareSerial(unsigned long);
+		//
+		// constexpr so the Serial objects are laid out by the linker in
+		// .data and need no constructor call at boot
+		//
+		constexpr HardwareSerial(unsigned long module = 0) :
+			txBuffer(NULL), txBufferSize(SERIAL_BUFFER_SIZE),
+			txWriteIndex(0), txReadIndex(0),
+			rxBuffer(NULL), rxBufferSize(SERIAL_BUFFER_SIZE),
+			rxWriteIndex(0), rxReadIndex(0),
+			uartModule(module), baudRate(0), userBuffers(false) {}
 		void begin(unsigned long);
 		void setBufferSize(unsigned long, unsigned long);
+		void setBuffers(unsigned char *, unsigned long, unsigned char *, unsigned long);
 		void setModule(unsigned long);
 		void setPins(unsigned long);
 		void end(void);
 		virtual int available(void);
+		virtual int availableForWrite(void);
 		virtual int peek(void);
 		virtual int read(void);
 		virtual void flush(void);
-		void UARTIntHandler(void);
+		RAMFUNC void UARTIntHandler(void);
 		virtual size_t write(uint8_t c);
 		operator bool();
 		using Print::write; // pull in write(str) and write(buf, size) from Print
@@ -86,14 +100,14 @@ extern HardwareSerial Serial5;
 extern HardwareSerial Serial6;
 extern HardwareSerial Serial7;
 
-extern "C" void UARTIntHandler(void);
-extern "C" void UARTIntHandler1(void);
-extern "C" void UARTIntHandler2(void);
-extern "C" void UARTIntHandler3(void);
-extern "C" void UARTIntHandler4(void);
-extern "C" void UARTIntHandler5(void);
-extern "C" void UARTIntHandler6(void);
-extern "C" void UARTIntHandler7(void);
+extern "C" RAMFUNC void UARTIntHandler(void);
+extern "C" RAMFUNC void UARTIntHandler1(void);
+extern "C" RAMFUNC void UARTIntHandler2(void);
+extern "C" RAMFUNC void UARTIntHandler3(void);
+extern "C" RAMFUNC void UARTIntHandler4(void);
+extern "C" RAMFUNC void UARTIntHandler5(void);
+extern "C" RAMFUNC void UARTIntHandler6(void);
+extern "C" RAMFUNC void UARTIntHandler7(void);
 
 extern void serialEventRun(void) __attribute__((weak));
 #endif
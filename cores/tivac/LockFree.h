@@ -0,0 +1,333 @@
+/*
+ ************************************************************************
+ *	LockFree.h
+ *
+ *	Arduino core files for ARM Cortex-M4F: Tiva-C and Stellaris
+ *		Copyright (c) 2016 Energia. All right reserved.
+ *
+ *	Queues and event primitives for passing work from interrupt handlers
+ *	to loop() without masking interrupts.
+ *
+ *	  SPSCQueue<Sample, 16> samples;    // one producer, one consumer
+ *	  MPSCQueue<Event, 32> events;      // any number of producers
+ *	  EventFlags flags;                 // 32 event bits
+ *	  Semaphore ready;                  // counting semaphore
+ *
+ *	SPSCQueue needs no read-modify-write at all: the producer only writes
+ *	tail and the consumer only writes head. MPSCQueue, EventFlags and
+ *	Semaphore update shared words with LDREX/STREX through the GCC
+ *	__atomic builtins; an interrupt between the two cancels the STREX and
+ *	the update is retried, so an ISR of any priority may use them while
+ *	loop() or a lower priority ISR is half way through.
+ *
+ *	Memory ordering: a producer writes the element and then publishes it
+ *	with a release store of the index (or slot sequence); the consumer
+ *	reads that index with an acquire load before touching the element,
+ *	and releases the slot back the same way. On Cortex-M4 this costs a
+ *	DMB, which also keeps the compiler from moving element accesses
+ *	across the index update. EventFlags and Semaphore operations are
+ *	sequentially consistent. Capacities must be powers of two; indices
+ *	run freely and wrap at 2^32.
+ *
+ *	The blocking waits sleep with WFI between checks, masking interrupts
+ *	across the check so a post that lands just before the WFI still wakes
+ *	it. Only an interrupt can make them succeed, so do not wait in loop()
+ *	for something only loop() posts. Built for the host, the waits yield
+ *	the thread instead, which lets the same code be exercised there.
+ *
+ ***********************************************************************
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef LockFree_h
+#define LockFree_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef ENERGIA
+#include "Energia.h"
+#else
+#include <sched.h>
+#include <time.h>
+#endif
+
+namespace lockfree {
+
+#ifdef ENERGIA
+static inline uint32_t now(void) { return millis(); }
+#else
+static inline uint32_t now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+#endif
+
+//
+// Sleep until done() holds or timeoutMs passed, 0xFFFFFFFF waits forever.
+// Returns the last result of done().
+//
+template<typename Done>
+static bool waitUntil(Done done, uint32_t timeoutMs)
+{
+	uint32_t start = now();
+
+	for (;;) {
+		if (done())
+			return true;
+		if (timeoutMs != 0xFFFFFFFF && now() - start >= timeoutMs)
+			return false;
+#ifdef ENERGIA
+		uint32_t primask;
+		bool ok;
+		__asm volatile ("mrs %0, primask\n"
+				"cpsid i" : "=r" (primask) :: "memory");
+		ok = done();
+		if (!ok)
+			__asm volatile ("wfi\n"
+					"nop" ::: "memory");
+		__asm volatile ("msr primask, %0" :: "r" (primask) : "memory");
+		if (ok)
+			return true;
+#else
+		sched_yield();
+#endif
+	}
+}
+
+} // namespace lockfree
+
+//
+// Single producer, single consumer. The producer and the consumer may each
+// be loop() or an ISR, but there must be only one of each.
+//
+template<typename T, size_t N>
+class SPSCQueue
+{
+	static_assert(N >= 2 && !(N & (N - 1)), "SPSCQueue size must be a power of two");
+
+	private:
+		T items[N];
+		uint32_t head;      // next to pop, written by the consumer only
+		uint32_t tail;      // next to push, written by the producer only
+
+	public:
+		SPSCQueue(void) : head(0), tail(0) {}
+
+		// Producer side, false when full
+		bool push(const T &item) {
+			uint32_t t = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+			if (t - __atomic_load_n(&head, __ATOMIC_ACQUIRE) == N)
+				return false;
+			items[t & (N - 1)] = item;
+			__atomic_store_n(&tail, t + 1, __ATOMIC_RELEASE);
+			return true;
+		}
+
+		// Consumer side, false when empty
+		bool pop(T &item) {
+			uint32_t h = __atomic_load_n(&head, __ATOMIC_RELAXED);
+			if (h == __atomic_load_n(&tail, __ATOMIC_ACQUIRE))
+				return false;
+			item = items[h & (N - 1)];
+			__atomic_store_n(&head, h + 1, __ATOMIC_RELEASE);
+			return true;
+		}
+
+		// Consumer side, the oldest element without removing it or NULL
+		T *peek(void) {
+			uint32_t h = __atomic_load_n(&head, __ATOMIC_RELAXED);
+			if (h == __atomic_load_n(&tail, __ATOMIC_ACQUIRE))
+				return NULL;
+			return &items[h & (N - 1)];
+		}
+
+		bool pop(T &item, uint32_t timeoutMs) {
+			return lockfree::waitUntil([&]() { return pop(item); }, timeoutMs);
+		}
+
+		size_t available(void) const {
+			return __atomic_load_n(&tail, __ATOMIC_ACQUIRE) - __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+		}
+		bool empty(void) const { return available() == 0; }
+		size_t capacity(void) const { return N; }
+};
+
+//
+// Multiple producers, single consumer, after D. Vyukov's bounded queue.
+// Each slot carries a sequence number: pos when free for the push that
+// claims index pos, pos + 1 once that push has published it. Producers
+// claim an index by advancing tail with compare-and-swap. A producer that
+// is interrupted between claiming and publishing holds back the consumer
+// at that slot until it resumes; elements are never reordered.
+//
+template<typename T, size_t N>
+class MPSCQueue
+{
+	static_assert(N >= 2 && !(N & (N - 1)), "MPSCQueue size must be a power of two");
+
+	private:
+		struct Slot {
+			uint32_t seq;
+			T item;
+		};
+		Slot slots[N];
+		uint32_t head;      // consumer only
+		uint32_t tail;      // shared by the producers
+
+	public:
+		MPSCQueue(void) : head(0), tail(0) {
+			for (size_t i = 0; i < N; i++)
+				slots[i].seq = i;
+		}
+
+		// Any producer, false when full
+		bool push(const T &item) {
+			uint32_t pos = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+			Slot *s;
+
+			for (;;) {
+				s = &slots[pos & (N - 1)];
+				int32_t diff = (int32_t)(__atomic_load_n(&s->seq, __ATOMIC_ACQUIRE) - pos);
+				if (diff == 0) {
+					// Free for pos; on failure pos is reloaded from tail
+					if (__atomic_compare_exchange_n(&tail, &pos, pos + 1, true,
+							__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+						break;
+				} else if (diff < 0) {
+					return false;
+				} else {
+					pos = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+				}
+			}
+			s->item = item;
+			__atomic_store_n(&s->seq, pos + 1, __ATOMIC_RELEASE);
+			return true;
+		}
+
+		// Consumer only, false when empty or the oldest push is unfinished
+		bool pop(T &item) {
+			Slot *s = &slots[head & (N - 1)];
+			if (__atomic_load_n(&s->seq, __ATOMIC_ACQUIRE) != head + 1)
+				return false;
+			item = s->item;
+			__atomic_store_n(&s->seq, head + N, __ATOMIC_RELEASE);
+			head++;
+			return true;
+		}
+
+		bool pop(T &item, uint32_t timeoutMs) {
+			return lockfree::waitUntil([&]() { return pop(item); }, timeoutMs);
+		}
+
+		// Claimed slots, including pushes still being written
+		size_t available(void) const {
+			return __atomic_load_n(&tail, __ATOMIC_ACQUIRE) - head;
+		}
+		bool empty(void) const { return available() == 0; }
+		size_t capacity(void) const { return N; }
+};
+
+//
+// 32 event bits. Any context may set or clear them; waiting belongs in
+// loop() or one task, since waitAny()/waitAll() consume the bits they
+// return.
+//
+class EventFlags
+{
+	private:
+		uint32_t bits;
+
+		uint32_t takeAny(uint32_t mask) {
+			uint32_t got = __atomic_fetch_and(&bits, ~mask, __ATOMIC_SEQ_CST) & mask;
+			return got;
+		}
+
+		uint32_t takeAll(uint32_t mask) {
+			uint32_t cur = __atomic_load_n(&bits, __ATOMIC_SEQ_CST);
+			while ((cur & mask) == mask) {
+				if (__atomic_compare_exchange_n(&bits, &cur, cur & ~mask, true,
+						__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+					return mask;
+			}
+			return 0;
+		}
+
+	public:
+		EventFlags(void) : bits(0) {}
+
+		void set(uint32_t mask) { __atomic_fetch_or(&bits, mask, __ATOMIC_SEQ_CST); }
+		void clear(uint32_t mask) { __atomic_fetch_and(&bits, ~mask, __ATOMIC_SEQ_CST); }
+		uint32_t get(void) const { return __atomic_load_n(&bits, __ATOMIC_SEQ_CST); }
+
+		// Bits of mask that were set, now cleared; 0 on timeout
+		uint32_t waitAny(uint32_t mask, uint32_t timeoutMs = 0xFFFFFFFF) {
+			uint32_t got = 0;
+			lockfree::waitUntil([&]() { return (got = takeAny(mask)) != 0; }, timeoutMs);
+			return got;
+		}
+
+		// mask once every bit of it was set, now cleared; 0 on timeout
+		uint32_t waitAll(uint32_t mask, uint32_t timeoutMs = 0xFFFFFFFF) {
+			uint32_t got = 0;
+			lockfree::waitUntil([&]() { return (got = takeAll(mask)) != 0; }, timeoutMs);
+			return got;
+		}
+};
+
+//
+// Counting semaphore. give() is safe from any context, take() with a
+// timeout belongs in loop().
+//
+class Semaphore
+{
+	private:
+		int32_t count;
+		int32_t limit;
+
+	public:
+		Semaphore(int32_t initial = 0, int32_t max = 0x7FFFFFFF) : count(initial), limit(max) {}
+
+		// false when the count is already at its maximum
+		bool give(void) {
+			int32_t cur = __atomic_load_n(&count, __ATOMIC_SEQ_CST);
+			while (cur < limit) {
+				if (__atomic_compare_exchange_n(&count, &cur, cur + 1, true,
+						__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+					return true;
+			}
+			return false;
+		}
+
+		bool tryTake(void) {
+			int32_t cur = __atomic_load_n(&count, __ATOMIC_SEQ_CST);
+			while (cur > 0) {
+				if (__atomic_compare_exchange_n(&count, &cur, cur - 1, true,
+						__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+					return true;
+			}
+			return false;
+		}
+
+		bool take(uint32_t timeoutMs = 0xFFFFFFFF) {
+			return lockfree::waitUntil([&]() { return tryTake(); }, timeoutMs);
+		}
+
+		int32_t value(void) const { return __atomic_load_n(&count, __ATOMIC_SEQ_CST); }
+};
+
+#endif
@@ -0,0 +1,139 @@
+/*
+ ************************************************************************
+ *	ObjectPool.h
+ *
+ *	Arduino core files for ARM Cortex-M4F: Tiva-C and Stellaris
+ *		Copyright (c) 2016 Energia. All right reserved.
+ *
+ *	Fixed size pools carved out of static storage. Allocation and release
+ *	are constant time, never fragment, and are safe from interrupt handlers.
+ *
+ *	  BlockPool<256, 4> serialBuffers;     // raw byte buffers
+ *	  Serial.setBuffers((uint8_t *)serialBuffers.alloc(), 256,
+ *	                   (uint8_t *)serialBuffers.alloc(), 256);
+ *
+ *	  ObjectPool<EthernetClient, 4> clients;
+ *	  EthernetClient *c = clients.create(server.available());
+ *	  ...
+ *	  clients.destroy(c);
+ *
+ ***********************************************************************
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef ObjectPool_h
+#define ObjectPool_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <new>
+
+template<size_t Size, size_t Count>
+class BlockPool
+{
+	private:
+		union Block {
+			Block *next;
+			uint8_t data[Size];
+			uint64_t align;
+		};
+
+		Block blocks[Count];
+		Block *freeList;
+		size_t used;
+		size_t highWater;
+
+		static inline uint32_t lock(void) {
+			uint32_t primask;
+			__asm volatile ("mrs %0, primask\n"
+					"cpsid i" : "=r" (primask) :: "memory");
+			return primask;
+		}
+		static inline void unlock(uint32_t primask) {
+			__asm volatile ("msr primask, %0" :: "r" (primask) : "memory");
+		}
+
+	public:
+		BlockPool(void) {
+			for (size_t i = 0; i < Count - 1; i++)
+				blocks[i].next = &blocks[i + 1];
+			blocks[Count - 1].next = NULL;
+			freeList = &blocks[0];
+			used = 0;
+			highWater = 0;
+		}
+
+		// NULL when the pool is exhausted
+		void *alloc(void) {
+			uint32_t primask = lock();
+			Block *b = freeList;
+			if (b) {
+				freeList = b->next;
+				if (++used > highWater)
+					highWater = used;
+			}
+			unlock(primask);
+			return b;
+		}
+
+		void release(void *p) {
+			if (!p)
+				return;
+			uint32_t primask = lock();
+			Block *b = (Block *)p;
+			b->next = freeList;
+			freeList = b;
+			used--;
+			unlock(primask);
+		}
+
+		bool owns(const void *p) const {
+			return p >= (const void *)&blocks[0] && p < (const void *)&blocks[Count];
+		}
+
+		size_t blockSize(void) const { return Size; }
+		size_t capacity(void) const { return Count; }
+		size_t available(void) const { return Count - used; }
+		size_t maxUsed(void) const { return highWater; }
+};
+
+template<typename T, size_t Count>
+class ObjectPool
+{
+	private:
+		BlockPool<sizeof(T), Count> pool;
+
+	public:
+		// Construct a T in the pool, NULL when the pool is exhausted
+		template<typename... Args>
+		T *create(const Args&... args) {
+			void *p = pool.alloc();
+			return p ? new (p) T(args...) : NULL;
+		}
+
+		void destroy(T *obj) {
+			if (!obj)
+				return;
+			obj->~T();
+			pool.release(obj);
+		}
+
+		bool owns(const T *obj) const { return pool.owns(obj); }
+		size_t capacity(void) const { return Count; }
+		size_t available(void) const { return pool.available(); }
+		size_t maxUsed(void) const { return pool.maxUsed(); }
+};
+
+#endif
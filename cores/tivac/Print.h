@@ -43,7 +43,7 @@ class Print
   protected:
     void setWriteError(int err = 1) { write_error = err; }
   public:
-    Print() : write_error(0) {}
+    constexpr Print() : write_error(0) {}
   
     int getWriteError() { return write_error; }
     void clearWriteError() { setWriteError(0); }
@@ -60,7 +60,7 @@ class Stream : public Print
     virtual int read() = 0;
     virtual int peek() = 0;
 
-    Stream() {_timeout=1000;}
+    constexpr Stream() : _timeout(1000), _startMillis(0) {}
 
 // parsing methods
 
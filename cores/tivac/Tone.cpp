@@ -71,6 +71,16 @@ ToneIntHandler(void)
 
 }
 
+//
+// The tone pitch follows a clock change through PWMWrite(), the duration
+// timer is reloaded here
+//
+static void toneCpuFrequencyChanged(uint32_t hz, uint8_t phase)
+{
+    if (phase == CPU_FREQ_POST && tone_state)
+        ROM_TimerLoadSet(TIMER4_BASE, TIMER_A, hz/1000);
+}
+
 /**
  *** tone() -- Output a tone (50% Dutycycle PWM signal) on a pin
  ***  pin: This pin is selected as output
@@ -96,7 +106,9 @@ void tone(uint8_t _pin, unsigned int frequency, unsigned long duration)
         ROM_SysCtlPeripheralEnable(SYSCTL_PERIPH_TIMER4);
         ROM_IntMasterEnable();
         ROM_TimerConfigure(TIMER4_BASE, TIMER_CFG_PERIODIC);
-        ROM_TimerLoadSet(TIMER4_BASE, TIMER_A, F_CPU/1000);
+        ROM_TimerLoadSet(TIMER4_BASE, TIMER_A, cpuFrequency()/1000);
+        registerCpuFrequencyCb(toneCpuFrequencyChanged);
+        ROM_IntPrioritySet(INT_TIMER4A, INT_PRIORITY_TONE);
         ROM_IntEnable(INT_TIMER4A);
         ROM_TimerIntEnable(TIMER4_BASE, TIMER_TIMA_TIMEOUT);
         ROM_TimerEnable(TIMER4_BASE, TIMER_A);
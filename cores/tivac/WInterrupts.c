@@ -38,6 +38,7 @@
 #include "inc/hw_types.h"
 #include "inc/hw_nvic.h"
 #include "inc/hw_ints.h"
+#include "inc/hw_gpio.h"
 #include "driverlib/gpio.h"
 #include "wiring_private.h"
 #include "driverlib/rom.h"
@@ -63,12 +64,16 @@ static void (*cbFuncsS[8])(void);
 static void (*cbFuncsT[8])(void);
 #endif
 
-void GPIOXIntHandler(uint32_t base, void (**funcs)(void))
+//
+// Runs from RAM. The status is read and cleared directly instead of through
+// GPIOIntStatus()/GPIOIntClear(), which live in flash.
+//
+RAMFUNC void GPIOXIntHandler(uint32_t base, void (**funcs)(void))
 {
 	uint32_t i;
-	uint32_t isr = GPIOIntStatus(base, true);
+	uint32_t isr = HWREG(base + GPIO_O_MIS);
 
-	GPIOIntClear(base, isr);
+	HWREG(base + GPIO_O_ICR) = isr;
 
 	for (i=0; i<8; i++, isr>>=1) {
 		if ((isr & 0x1) == 0)
@@ -78,100 +83,106 @@ void GPIOXIntHandler(uint32_t base, void (**funcs)(void))
 	}
 }
 
-void GPIOAIntHandler(void)
+RAMFUNC void GPIOAIntHandler(void)
 {
 	GPIOXIntHandler(GPIO_PORTA_BASE, cbFuncsA);
 }
 
-void GPIOBIntHandler(void)
+RAMFUNC void GPIOBIntHandler(void)
 {
 	GPIOXIntHandler(GPIO_PORTB_BASE, cbFuncsB);
 }
 
-void GPIOCIntHandler(void)
+RAMFUNC void GPIOCIntHandler(void)
 {
 	GPIOXIntHandler(GPIO_PORTC_BASE, cbFuncsC);
 }
 
-void GPIODIntHandler(void)
+RAMFUNC void GPIODIntHandler(void)
 {
 	GPIOXIntHandler(GPIO_PORTD_BASE, cbFuncsD);
 }
 
-void GPIOEIntHandler(void)
+RAMFUNC void GPIOEIntHandler(void)
 {
 	GPIOXIntHandler(GPIO_PORTE_BASE, cbFuncsE);
 }
 
-void GPIOFIntHandler(void)
+RAMFUNC void GPIOFIntHandler(void)
 {
 	GPIOXIntHandler(GPIO_PORTF_BASE, cbFuncsF);
 }
 
-void GPIOGIntHandler(void)
+RAMFUNC void GPIOGIntHandler(void)
 {
 	GPIOXIntHandler(GPIO_PORTG_BASE, cbFuncsG);
 }
 
-void GPIOHIntHandler(void)
+RAMFUNC void GPIOHIntHandler(void)
 {
 	GPIOXIntHandler(GPIO_PORTH_BASE, cbFuncsH);
 }
 
-void GPIOJIntHandler(void)
+RAMFUNC void GPIOJIntHandler(void)
 {
 	GPIOXIntHandler(GPIO_PORTJ_BASE, cbFuncsJ);
 }
 
-void GPIOKIntHandler(void)
+RAMFUNC void GPIOKIntHandler(void)
 {
 	GPIOXIntHandler(GPIO_PORTK_BASE, cbFuncsK);
 }
 
-void GPIOLIntHandler(void)
+RAMFUNC void GPIOLIntHandler(void)
 {
 	GPIOXIntHandler(GPIO_PORTL_BASE, cbFuncsL);
 }
 
-void GPIOMIntHandler(void)
+RAMFUNC void GPIOMIntHandler(void)
 {
 	GPIOXIntHandler(GPIO_PORTM_BASE, cbFuncsM);
 }
-void GPIONIntHandler(void)
+RAMFUNC void GPIONIntHandler(void)
 {
 	GPIOXIntHandler(GPIO_PORTN_BASE, cbFuncsN);
 }
 
-void GPIOPIntHandler(void)
+RAMFUNC void GPIOPIntHandler(void)
 {
 	GPIOXIntHandler(GPIO_PORTP_BASE, cbFuncsP);
 }
 
-void GPIOQIntHandler(void)
+RAMFUNC void GPIOQIntHandler(void)
 {
 	GPIOXIntHandler(GPIO_PORTQ_BASE, cbFuncsQ);
 }
 
 #ifdef TARGET_IS_SNOWFLAKE_RA0
-void GPIORIntHandler(void)
+RAMFUNC void GPIORIntHandler(void)
 {
 	GPIOXIntHandler(GPIO_PORTR_BASE, cbFuncsR);
 }
 
-void GPIOSIntHandler(void)
+RAMFUNC void GPIOSIntHandler(void)
 {
 	GPIOXIntHandler(GPIO_PORTS_BASE, cbFuncsS);
 }
 
-void GPIOTIntHandler(void)
+RAMFUNC void GPIOTIntHandler(void)
 {
 	GPIOXIntHandler(GPIO_PORTT_BASE, cbFuncsT);
 }
 #endif
 
+static void enableGPIOInt(uint32_t interrupt)
+{
+	ROM_IntPrioritySet(interrupt, INT_PRIORITY_GPIO);
+	ROM_IntEnable(interrupt);
+}
+
 void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), int mode)
 {
-	uint32_t lm4fMode, i;
+	uint32_t lm4fMode, i, saved;
 
 	uint8_t bit = digitalPinToBitMask(interruptNum);
 	uint8_t port = digitalPinToPort(interruptNum);
@@ -194,7 +205,7 @@ void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), int mode)
 		return;
 	}
 
-	ROM_IntMasterDisable();
+	saved = criticalEnter(INT_PRIORITY_GPIO);
 	GPIOIntClear(portBase, bit);
 	ROM_GPIOIntTypeSet(portBase, bit, lm4fMode);
 	GPIOIntEnable(portBase, bit);
@@ -207,94 +218,94 @@ void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), int mode)
 	switch(portBase) {
 	case GPIO_PORTA_BASE:
 		cbFuncsA[i] = userFunc;
-		ROM_IntEnable(INT_GPIOA);
+		enableGPIOInt(INT_GPIOA);
 		break;
 	case GPIO_PORTB_BASE:
 		cbFuncsB[i] = userFunc;
-		ROM_IntEnable(INT_GPIOB);
+		enableGPIOInt(INT_GPIOB);
 		break;
 	case GPIO_PORTC_BASE:
 		cbFuncsC[i] = userFunc;
-		ROM_IntEnable(INT_GPIOC);
+		enableGPIOInt(INT_GPIOC);
 		break;
 	case GPIO_PORTD_BASE:
 		cbFuncsD[i] = userFunc;
-		ROM_IntEnable(INT_GPIOD);
+		enableGPIOInt(INT_GPIOD);
 		break;
 	case GPIO_PORTE_BASE:
 		cbFuncsE[i] = userFunc;
-		ROM_IntEnable(INT_GPIOE);
+		enableGPIOInt(INT_GPIOE);
 		break;
 	case GPIO_PORTF_BASE:
 		cbFuncsF[i] = userFunc;
-		ROM_IntEnable(INT_GPIOF);
+		enableGPIOInt(INT_GPIOF);
 		break;
 	case GPIO_PORTG_BASE:
 		cbFuncsG[i] = userFunc;
-		ROM_IntEnable(INT_GPIOG);
+		enableGPIOInt(INT_GPIOG);
 		break;
 	case GPIO_PORTH_BASE:
 		cbFuncsH[i] = userFunc;
-		ROM_IntEnable(INT_GPIOH);
+		enableGPIOInt(INT_GPIOH);
 		break;
 	case GPIO_PORTJ_BASE:
 		cbFuncsJ[i] = userFunc;
-		ROM_IntEnable(INT_GPIOJ);
+		enableGPIOInt(INT_GPIOJ);
 		break;
 	case GPIO_PORTK_BASE:
 		cbFuncsK[i] = userFunc;
-		ROM_IntEnable(INT_GPIOK);
+		enableGPIOInt(INT_GPIOK);
 		break;
 	case GPIO_PORTL_BASE:
 		cbFuncsL[i] = userFunc;
-		ROM_IntEnable(INT_GPIOL);
+		enableGPIOInt(INT_GPIOL);
 		break;
 	case GPIO_PORTM_BASE:
 		cbFuncsM[i] = userFunc;
-		ROM_IntEnable(INT_GPIOM);
+		enableGPIOInt(INT_GPIOM);
 		break;
 	case GPIO_PORTN_BASE:
 		cbFuncsN[i] = userFunc;
-		ROM_IntEnable(INT_GPION);
+		enableGPIOInt(INT_GPION);
 		break;
 	case GPIO_PORTP_BASE:
 		cbFuncsP[i] = userFunc;
-		ROM_IntEnable(INT_GPIOP0);
-		ROM_IntEnable(INT_GPIOP1);
-		ROM_IntEnable(INT_GPIOP2);
-		ROM_IntEnable(INT_GPIOP3);
-		ROM_IntEnable(INT_GPIOP4);
-		ROM_IntEnable(INT_GPIOP5);
-		ROM_IntEnable(INT_GPIOP6);
-		ROM_IntEnable(INT_GPIOP7);
+		enableGPIOInt(INT_GPIOP0);
+		enableGPIOInt(INT_GPIOP1);
+		enableGPIOInt(INT_GPIOP2);
+		enableGPIOInt(INT_GPIOP3);
+		enableGPIOInt(INT_GPIOP4);
+		enableGPIOInt(INT_GPIOP5);
+		enableGPIOInt(INT_GPIOP6);
+		enableGPIOInt(INT_GPIOP7);
 		break;
 	case GPIO_PORTQ_BASE:
 		cbFuncsQ[i] = userFunc;
-		ROM_IntEnable(INT_GPIOQ0);
-		ROM_IntEnable(INT_GPIOQ1);
-		ROM_IntEnable(INT_GPIOQ2);
-		ROM_IntEnable(INT_GPIOQ3);
-		ROM_IntEnable(INT_GPIOQ4);
-		ROM_IntEnable(INT_GPIOQ5);
-		ROM_IntEnable(INT_GPIOQ6);
-		ROM_IntEnable(INT_GPIOQ7);
+		enableGPIOInt(INT_GPIOQ0);
+		enableGPIOInt(INT_GPIOQ1);
+		enableGPIOInt(INT_GPIOQ2);
+		enableGPIOInt(INT_GPIOQ3);
+		enableGPIOInt(INT_GPIOQ4);
+		enableGPIOInt(INT_GPIOQ5);
+		enableGPIOInt(INT_GPIOQ6);
+		enableGPIOInt(INT_GPIOQ7);
 		break;
 #ifdef TARGET_IS_SNOWFLAKE_RA0
 	case GPIO_PORTR_BASE:
 		cbFuncsR[i] = userFunc;
-		ROM_IntEnable(INT_GPIOR);
+		enableGPIOInt(INT_GPIOR);
 		break;
 	case GPIO_PORTS_BASE:
 		cbFuncsS[i] = userFunc;
-		ROM_IntEnable(INT_GPIOS);
+		enableGPIOInt(INT_GPIOS);
 		break;
 	case GPIO_PORTT_BASE:
 		cbFuncsT[i] = userFunc;
-		ROM_IntEnable(INT_GPIOT);
+		enableGPIOInt(INT_GPIOT);
 		break;
 #endif
 	}
-	ROM_IntMasterEnable();
+	criticalExit(saved);
 }
 
 void detachInterrupt(uint8_t interruptNum)
@@ -32,6 +32,7 @@ extern "C" {
 extern long random(void);
 extern void srandom(unsigned __seed);
 }
+#include "WRandom.h"
 
 void randomSeed(unsigned int seed)
 {
@@ -42,10 +43,10 @@ void randomSeed(unsigned int seed)
 
 long random(long howbig)
 {
-    if (howbig == 0) {
+    if (howbig <= 0) {
         return (0);
     }
-    return (random() % howbig);
+    return (randomRange(howbig));
 }
 
 long random(long howsmall, long howbig)
@@ -53,8 +54,8 @@ long random(long howsmall, long howbig)
     if (howsmall >= howbig) {
         return (howsmall);
     }
-    long diff = howbig - howsmall;
-    return (random(diff) + howsmall);
+    uint32_t diff = (uint32_t)howbig - (uint32_t)howsmall;
+    return (randomRange(diff) + howsmall);
 }
 
 
@@ -0,0 +1,88 @@
+/*
+ ************************************************************************
+ *	WRandom.h
+ *
+ *	Arduino core files for ARM Cortex-M4F: Tiva-C and Stellaris
+ *		Copyright (c) 2016 Energia. All right reserved.
+ *
+ *	random(), random(range) and randomBytes() draw from a xoshiro128**
+ *	generator. RandomState/RandomGenerator give independent generators
+ *	with their own seed, e.g. for reproducible simulations next to a
+ *	freshly seeded global one. Ranges use Lemire's multiply-shift method
+ *	with rejection, so every value is equally likely.
+ *
+ *	randomSeedEntropy() seeds the global generator from ADC noise on the
+ *	temperature sensor and clock jitter, entropyRandom() returns raw
+ *	collected bits. Neither is suitable for cryptographic keys.
+ *
+ ***********************************************************************
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef WRandom_h
+#define WRandom_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+typedef struct {
+	uint32_t s[4];
+} RandomState;
+
+void randomStateSeed(RandomState *state, uint64_t seed);
+uint32_t randomStateNext(RandomState *state);
+// Uniform in [0, range), 0 for a range of 0
+uint32_t randomStateRange(RandomState *state, uint32_t range);
+void randomStateBytes(RandomState *state, void *buf, size_t n);
+
+// Global generator behind random()
+void randomSeed64(uint64_t seed);
+uint32_t randomRange(uint32_t range);
+void randomBytes(void *buf, size_t n);
+
+// Implemented in entropy.c
+uint32_t entropyRandom(void);
+void randomSeedEntropy(void);
+
+#ifdef __cplusplus
+} // extern "C"
+
+class RandomGenerator {
+public:
+	RandomGenerator(uint64_t seed = 1) { randomStateSeed(&state, seed); }
+
+	void seed(uint64_t seed) { randomStateSeed(&state, seed); }
+	uint32_t next(void) { return randomStateNext(&state); }
+	long random(long howbig) { return howbig > 0 ? (long)randomStateRange(&state, howbig) : 0; }
+	long random(long howsmall, long howbig)
+	{
+		if (howsmall >= howbig)
+			return howsmall;
+		return howsmall + (long)randomStateRange(&state, (uint32_t)howbig - (uint32_t)howsmall);
+	}
+	void bytes(void *buf, size_t n) { randomStateBytes(&state, buf, n); }
+	// Uniform in [0, 1)
+	float uniform(void) { return (next() >> 8) * (1.0f / 16777216.0f); }
+
+private:
+	RandomState state;
+};
+#endif
+
+#endif
@@ -23,6 +23,20 @@
 #include "itoa.h"
 #include "avr/dtostrf.h"
 
+#if STRING_POOL_BLOCKS > 0
+#include "ObjectPool.h"
+
+static BlockPool<STRING_POOL_BLOCK_SIZE, STRING_POOL_BLOCKS> stringPool;
+
+static inline void freeBuffer(char *buffer)
+{
+	if (stringPool.owns(buffer)) stringPool.release(buffer);
+	else free(buffer);
+}
+#else
+#define freeBuffer free
+#endif
+
 /*********************************************/
 /*  Constructors                             */
 /*********************************************/
@@ -123,7 +137,7 @@ String::String(double value, unsigned char decimalPlaces)
 
 String::~String()
 {
-	free(buffer);
+	if (buffer != sso) freeBuffer(buffer);
 }
 
 /*********************************************/
@@ -139,7 +153,7 @@ inline void String::init(void)
 
 void String::invalidate(void)
 {
-	if (buffer) free(buffer);
+	if (buffer && buffer != sso) freeBuffer(buffer);
 	buffer = NULL;
 	capacity = len = 0;
 }
@@ -156,7 +170,40 @@ unsigned char String::reserve(unsigned int size)
 
 unsigned char String::changeBuffer(unsigned int maxStrLen)
 {
-	char *newbuffer = (char *)realloc(buffer, maxStrLen + 1);
+	char *newbuffer;
+
+	if (maxStrLen <= STRING_SSO_SIZE && (!buffer || buffer == sso)) {
+		buffer = sso;
+		capacity = STRING_SSO_SIZE;
+		return 1;
+	}
+#if STRING_POOL_BLOCKS > 0
+	if (maxStrLen < STRING_POOL_BLOCK_SIZE && (!buffer || buffer == sso)) {
+		newbuffer = (char *)stringPool.alloc();
+		if (newbuffer) {
+			if (buffer) memcpy(newbuffer, sso, len + 1);
+			buffer = newbuffer;
+			capacity = STRING_POOL_BLOCK_SIZE - 1;
+			return 1;
+		}
+		// pool exhausted, fall back to the heap
+	}
+	if (stringPool.owns(buffer)) {
+		// outgrew the pool block
+		newbuffer = (char *)malloc(maxStrLen + 1);
+		if (newbuffer) {
+			memcpy(newbuffer, buffer, len + 1);
+			stringPool.release(buffer);
+		}
+	} else
+#endif
+	if (buffer == sso) {
+		// moving out of the inline storage
+		newbuffer = (char *)malloc(maxStrLen + 1);
+		if (newbuffer) memcpy(newbuffer, sso, len + 1);
+	} else {
+		newbuffer = (char *)realloc(buffer, maxStrLen + 1);
+	}
 	if (newbuffer) {
 		buffer = newbuffer;
 		capacity = maxStrLen;
@@ -165,6 +212,16 @@ unsigned char String::changeBuffer(unsigned int maxStrLen)
 	return 0;
 }
 
+// Like reserve(), but grows the capacity by half when it has to grow at
+// all so that appending one piece at a time does not realloc every time.
+unsigned char String::grow(unsigned int size)
+{
+	if (buffer && capacity >= size) return 1;
+	unsigned int newCapacity = capacity + (capacity >> 1);
+	if (buffer && newCapacity > size && reserve(newCapacity)) return 1;
+	return reserve(size);
+}
+
 /*********************************************/
 /*  Copy and Move                            */
 /*********************************************/
@@ -200,10 +257,20 @@ void String::move(String &rhs)
 			len = rhs.len;
 			rhs.len = 0;
 			return;
-		} else {
-			free(buffer);
+		} else if (buffer != sso) {
+			freeBuffer(buffer);
 		}
 	}
+	if (rhs.buffer == rhs.sso) {
+		// inline storage can't be stolen, copy it
+		memcpy(sso, rhs.sso, rhs.len + 1);
+		buffer = sso;
+		capacity = STRING_SSO_SIZE;
+		len = rhs.len;
+		rhs.len = 0;
+		rhs.sso[0] = 0;
+		return;
+	}
 	buffer = rhs.buffer;
 	capacity = rhs.capacity;
 	len = rhs.len;
@@ -267,12 +334,34 @@ unsigned char String::concat(const char *cstr, unsigned int length)
 	unsigned int newlen = len + length;
 	if (!cstr) return 0;
 	if (length == 0) return 1;
-	if (!reserve(newlen)) return 0;
+	if (!grow(newlen)) return 0;
 	strcpy(buffer + len, cstr);
 	len = newlen;
 	return 1;
 }
 
+unsigned char String::concat(StringPiece *pieces, unsigned int count)
+{
+	unsigned int i, newlen = len;
+	const char *old = buffer;
+
+	for (i = 0; i < count; i++) newlen += pieces[i].len;
+	if (!reserve(newlen)) return 0;
+
+	// pieces taken from this string itself have to follow a moved buffer
+	for (i = 0; old && buffer != old && i < count; i++) {
+		if (pieces[i].ptr >= old && pieces[i].ptr <= old + len)
+			pieces[i].ptr = buffer + (pieces[i].ptr - old);
+	}
+	for (i = 0; i < count; i++) {
+		if (!pieces[i].len) continue;
+		memcpy(buffer + len, pieces[i].ptr, pieces[i].len);
+		len += pieces[i].len;
+	}
+	buffer[len] = 0;
+	return 1;
+}
+
 unsigned char String::concat(const char *cstr)
 {
 	if (!cstr) return 0;
@@ -342,91 +431,75 @@ unsigned char String::concat(const __FlashStringHelper * str)
 	int length = strlen_P((const char *) str);
 	if (length == 0) return 1;
 	unsigned int newlen = len + length;
-	if (!reserve(newlen)) return 0;
+	if (!grow(newlen)) return 0;
 	strcpy_P(buffer + len, (const char *) str);
 	len = newlen;
 	return 1;
 }
 
 /*********************************************/
-/*  Concatenate                              */
+/*  Append pieces                            */
 /*********************************************/
 
-StringSumHelper & operator + (const StringSumHelper &lhs, const String &rhs)
+StringPiece::StringPiece(const __FlashStringHelper *pstr)
 {
-	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
-	if (!a.concat(rhs.buffer, rhs.len)) a.invalidate();
-	return a;
+	ptr = (const char *)pstr;
+	len = pstr ? strlen_P(ptr) : 0;
 }
 
-StringSumHelper & operator + (const StringSumHelper &lhs, const char *cstr)
+StringPiece::StringPiece(char c)
 {
-	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
-	if (!cstr || !a.concat(cstr, strlen(cstr))) a.invalidate();
-	return a;
-}
-
-StringSumHelper & operator + (const StringSumHelper &lhs, char c)
-{
-	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
-	if (!a.concat(c)) a.invalidate();
-	return a;
-}
-
-StringSumHelper & operator + (const StringSumHelper &lhs, unsigned char num)
-{
-	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
-	if (!a.concat(num)) a.invalidate();
-	return a;
+	buf[0] = c;
+	buf[1] = 0;
+	ptr = buf;
+	len = 1;
 }
 
-StringSumHelper & operator + (const StringSumHelper &lhs, int num)
+StringPiece::StringPiece(unsigned char num)
 {
-	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
-	if (!a.concat(num)) a.invalidate();
-	return a;
+	utoa(num, buf, 10);
+	ptr = buf;
+	len = strlen(buf);
 }
 
-StringSumHelper & operator + (const StringSumHelper &lhs, unsigned int num)
+StringPiece::StringPiece(int num)
 {
-	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
-	if (!a.concat(num)) a.invalidate();
-	return a;
+	itoa(num, buf, 10);
+	ptr = buf;
+	len = strlen(buf);
 }
 
-StringSumHelper & operator + (const StringSumHelper &lhs, long num)
+StringPiece::StringPiece(unsigned int num)
 {
-	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
-	if (!a.concat(num)) a.invalidate();
-	return a;
+	utoa(num, buf, 10);
+	ptr = buf;
+	len = strlen(buf);
 }
 
-StringSumHelper & operator + (const StringSumHelper &lhs, unsigned long num)
+StringPiece::StringPiece(long num)
 {
-	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
-	if (!a.concat(num)) a.invalidate();
-	return a;
+	ltoa(num, buf, 10);
+	ptr = buf;
+	len = strlen(buf);
 }
 
-StringSumHelper & operator + (const StringSumHelper &lhs, float num)
+StringPiece::StringPiece(unsigned long num)
 {
-	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
-	if (!a.concat(num)) a.invalidate();
-	return a;
+	ultoa(num, buf, 10);
+	ptr = buf;
+	len = strlen(buf);
 }
 
-StringSumHelper & operator + (const StringSumHelper &lhs, double num)
+StringPiece::StringPiece(float num)
 {
-	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
-	if (!a.concat(num)) a.invalidate();
-	return a;
+	ptr = dtostrf(num, 4, 2, buf);
+	len = strlen(ptr);
 }
 
-StringSumHelper & operator + (const StringSumHelper &lhs, const __FlashStringHelper *rhs)
+StringPiece::StringPiece(double num)
 {
-	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
-	if (!a.concat(rhs))	a.invalidate();
-	return a;
+	ptr = dtostrf(num, 4, 2, buf);
+	len = strlen(ptr);
 }
 
 /*********************************************/
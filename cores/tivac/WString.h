@@ -37,10 +37,33 @@
 class __FlashStringHelper;
 #define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(PSTR(string_literal)))
 
+// Strings up to this many characters are stored inside the String object
+// itself and never touch the heap.
+#ifndef STRING_SSO_SIZE
+#define STRING_SSO_SIZE 11
+#endif
+
+// With STRING_POOL_BLOCKS > 0 (Tools > Heap > TLSF + String pool) longer
+// strings that still fit a STRING_POOL_BLOCK_SIZE block, terminator
+// included, are taken from a fixed size BlockPool instead of malloc. Larger
+// strings and strings created while the pool is exhausted use malloc.
+#ifndef STRING_POOL_BLOCKS
+#define STRING_POOL_BLOCKS 0
+#endif
+#ifndef STRING_POOL_BLOCK_SIZE
+#define STRING_POOL_BLOCK_SIZE 32
+#endif
+
 // An inherited class for holding the result of a concatenation.  These
 // result objects are assumed to be writable by subsequent concatenations.
 class StringSumHelper;
 
+// One argument of String::append() or of a + chain, converted to characters.
+class StringPiece;
+
+// A pending "a + b + c" chain, see below.
+template<typename Left> class StringSum;
+
 // The string class
 class String
 {
@@ -63,6 +86,7 @@ public:
 	String(String &&rval);
 	String(StringSumHelper &&rval);
 	#endif
+	template<typename Left> String(const StringSum<Left> &sum);
 	explicit String(char c);
 	explicit String(unsigned char, unsigned char base=10);
 	explicit String(int, unsigned char base=10);
@@ -122,17 +146,14 @@ public:
 	String & operator += (double num)		{concat(num); return (*this);}
 	String & operator += (const __FlashStringHelper *str){concat(str); return (*this);}
 
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, const String &rhs);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, const char *cstr);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, char c);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, unsigned char num);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, int num);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, unsigned int num);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, long num);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, unsigned long num);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, float num);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, double num);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, const __FlashStringHelper *rhs);
+	// appends all arguments with a single allocation, e.g.
+	//     s.append("temp=", t, " C, humidity=", h, '%');
+	// instead of s = s + "temp=" + t + ..., which grows the buffer once
+	// per piece.  returns true on success, false on failure (in which case
+	// the string is left unchanged).
+	template<typename... Args>
+	unsigned char append(const Args&... args);
+	unsigned char append(void) { return 1; }
 
 	// comparison (only works w/ Strings and "strings")
 	operator StringIfHelperType() const { return buffer ? &String::StringIfHelper : 0; }
@@ -193,14 +214,17 @@ public:
 	double toDouble(void) const;
 
 protected:
-	char *buffer;	        // the actual char array
+	char *buffer;	        // the actual char array, sso or on the heap
 	unsigned int capacity;  // the array length minus one (for the '\0')
 	unsigned int len;       // the String length (not counting the '\0')
+	char sso[STRING_SSO_SIZE + 1];  // inline storage for short strings
 protected:
 	void init(void);
 	void invalidate(void);
 	unsigned char changeBuffer(unsigned int maxStrLen);
+	unsigned char grow(unsigned int size);
 	unsigned char concat(const char *cstr, unsigned int length);
+	unsigned char concat(StringPiece *pieces, unsigned int count);
 
 	// copy and move
 	String & copy(const char *cstr, unsigned int length);
@@ -225,5 +249,116 @@ public:
 	StringSumHelper(double num) : String(num) {}
 };
 
+class StringPiece
+{
+public:
+	StringPiece(const String &s) : ptr(s.c_str()), len(s.length()) {}
+	StringPiece(const char *cstr) : ptr(cstr), len(cstr ? strlen(cstr) : 0) {}
+	StringPiece(const __FlashStringHelper *pstr);
+	StringPiece(char c);
+	StringPiece(unsigned char num);
+	StringPiece(int num);
+	StringPiece(unsigned int num);
+	StringPiece(long num);
+	StringPiece(unsigned long num);
+	StringPiece(float num);
+	StringPiece(double num);
+	template<typename Left>
+	StringPiece(const StringSum<Left> &sum) : ptr(sum.c_str()), len(sum.length()) {}
+	StringPiece(const StringPiece &p) : ptr(p.ptr), len(p.len) {
+		if (p.ptr == p.buf) ptr = (const char *)memcpy(buf, p.buf, len + 1);
+	}
+
+	// a NULL string or an invalid String makes a + chain invalid
+	bool valid(void) const { return ptr != NULL; }
+	void write(char *dst) const { if (len) memcpy(dst, ptr, len); }
+
+	const char *ptr;
+	unsigned int len;
+private:
+	char buf[33];  // conversion buffer for numbers
+};
+
+// "a + b + c" builds a StringSum: each + only records its right hand side
+// and adds up the length. The String is allocated once, with the total
+// length, when the chain is converted to a String, e.g. by assignment or
+// when it is passed to a function taking a String. A chain refers to the
+// temporaries of its statement, so it cannot be copied or kept in a
+// variable ("auto s = a + b;" does not compile; use String).
+// The first piece of a chain is held by value, the chain to the left of a
+// later + by reference.
+template<typename T> struct StringSumOperand { typedef const T &type; };
+template<> struct StringSumOperand<StringPiece> { typedef const StringPiece type; };
+
+template<typename Left>
+class StringSum
+{
+public:
+	StringSum(const Left &l, const StringPiece &r) : left(l), right(r), len(l.len + r.len) {}
+	StringSum(const StringSum &) = delete;
+	StringSum & operator = (const StringSum &) = delete;
+
+	bool valid(void) const { return left.valid() && right.valid(); }
+	void write(char *dst) const { left.write(dst); right.write(dst + left.len); }
+
+	// the most common String calls work on a chain directly
+	unsigned int length(void) const { return len; }
+	const char *c_str(void) const { return str().c_str(); }
+	unsigned char operator == (const String &rhs) const { return str().equals(rhs); }
+	unsigned char operator == (const char *cstr) const { return str().equals(cstr); }
+	unsigned char operator != (const String &rhs) const { return !str().equals(rhs); }
+	unsigned char operator != (const char *cstr) const { return !str().equals(cstr); }
+
+	typename StringSumOperand<Left>::type left;
+	const StringPiece right;
+	const unsigned int len;
+
+private:
+	mutable String result;  // filled by c_str() and the comparisons
+
+	const String &str(void) const {
+		if (result.length() != len) result = String(*this);
+		return result;
+	}
+};
+
+template<typename Left>
+String::String(const StringSum<Left> &sum)
+{
+	init();
+	if (!sum.valid() || !reserve(sum.len)) {
+		invalidate();
+		return;
+	}
+	sum.write(buffer);
+	len = sum.len;
+	buffer[len] = 0;
+}
+
+template<typename T>
+inline StringSum<StringPiece> operator + (const String &lhs, const T &rhs)
+{
+	return {StringPiece(lhs), StringPiece(rhs)};
+}
+
+// "text" + s, 'c' + s, 42 + s
+inline StringSum<StringPiece> operator + (const StringPiece &lhs, const String &rhs)
+{
+	return {lhs, StringPiece(rhs)};
+}
+
+template<typename Left, typename T>
+inline StringSum<StringSum<Left> > operator + (const StringSum<Left> &lhs, const T &rhs)
+{
+	return {lhs, StringPiece(rhs)};
+}
+
+template<typename... Args>
+unsigned char String::append(const Args&... args)
+{
+	StringPiece pieces[] = { StringPiece(args)... };
+	return concat(pieces, sizeof...(Args));
+}
+
 #endif  // __cplusplus
 #endif  // String_class_h
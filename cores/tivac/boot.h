@@ -0,0 +1,86 @@
+/*
+ ************************************************************************
+ *	boot.h
+ *
+ *	Arduino core files for ARM Cortex-M4F: Tiva-C and Stellaris
+ *		Copyright (c) 2016 Energia. All right reserved.
+ *
+ *	Boot time measurement. ResetISR starts the DWT cycle counter and
+ *	stamps the end of each start-up phase, bootMicros() converts the
+ *	stamps to time since reset.
+ *
+ *	Variables marked NOINIT go to the .noinit section, which ResetISR
+ *	neither copies nor clears. Use it for large buffers that are
+ *	written before they are read, and for data that has to survive a
+ *	warm reset. Functions marked RAMFUNC execute from SRAM.
+ *
+ ***********************************************************************
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef boot_h
+#define boot_h
+
+#include <stdint.h>
+#include "inc/hw_types.h"
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#define NOINIT  __attribute__((section(".noinit")))
+
+// Functions marked RAMFUNC are linked into .data and copied to SRAM with it.
+// They run without flash wait states or prefetch misses, for interrupt
+// handlers with tight latency. Calls into them from flash use long calls.
+#define RAMFUNC __attribute__((section(".ramfunc"), long_call, noinline))
+
+// Copy the vector table to SRAM and point VTOR at it, so fetching an
+// interrupt vector does not wait for flash either.
+void vectorTableToRam(void);
+
+// Start-up phases in the order they run
+#define BOOT_CLOCK      0   // system clock switched to the PLL
+#define BOOT_DATA       1   // .data copied from flash
+#define BOOT_BSS        2   // .bss cleared
+#define BOOT_PAINT      3   // free RAM painted for stackHighWater()
+#define BOOT_INIT       4   // _init(): EEPROM, SysTick, GPIO clocks
+#define BOOT_CTORS      5   // global constructors
+#define BOOT_SETUP      6   // setup() returned
+#define BOOT_PHASES     7
+
+#define BOOT_DEMCR          0xE000EDFC  // Debug Exception and Monitor Control
+#define BOOT_DEMCR_TRCENA   0x01000000
+#define BOOT_DWT_CTRL       0xE0001000
+#define BOOT_DWT_CYCCNTENA  0x00000001
+#define BOOT_DWT_CYCCNT     0xE0001004
+
+extern uint32_t bootStamps[BOOT_PHASES];
+
+static inline void bootStamp(unsigned phase)
+{
+	bootStamps[phase] = HWREG(BOOT_DWT_CYCCNT);
+}
+
+// CPU cycles spent in a phase
+uint32_t bootCycles(unsigned phase);
+// Microseconds from reset to the end of a phase
+uint32_t bootMicros(unsigned phase);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -0,0 +1,258 @@
+/*
+ ************************************************************************
+ *	crash.cpp
+ *
+ *	Arduino core files for ARM Cortex-M4F: Tiva-C and Stellaris
+ *		Copyright (c) 2016 Energia. All right reserved.
+ *
+ ***********************************************************************
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "Energia.h"
+#include "crash.h"
+#include "driverlib/rom_map.h"
+#include "driverlib/eeprom.h"
+
+#define CRASH_MAGIC             0xC7A5DEAD
+#define CRASH_SCAN_WORDS        256     // stack words searched for return addresses
+
+extern unsigned long _text;
+extern unsigned long _etext;
+extern unsigned _estack;
+
+static CrashRecord record NOINIT;
+static int storeMode;
+
+extern "C" {
+
+// The handler may run because the main stack overflowed, so it has its own
+uint32_t crashStack[CRASH_STACK_SIZE / 4] __attribute__((used));
+
+static uint32_t checksum(const CrashRecord *r)
+{
+	const uint32_t *p = (const uint32_t *)r;
+	uint32_t sum = 0;
+	unsigned i;
+
+	for (i = 0; i < offsetof(CrashRecord, checksum) / 4; i++)
+		sum = ((sum << 5) | (sum >> 27)) ^ p[i];
+	return sum;
+}
+
+static int valid(const CrashRecord *r)
+{
+	return r->magic == CRASH_MAGIC && r->checksum == checksum(r);
+}
+
+static uint32_t eepromAddress(void)
+{
+	return (MAP_EEPROMSizeGet() - sizeof(CrashRecord)) & ~3;
+}
+
+static inline int isCode(uint32_t addr)
+{
+	// Return addresses have the thumb bit set
+	return (addr & 1) && addr > (uint32_t)&_text && addr < (uint32_t)&_etext;
+}
+
+static inline int inRam(uint32_t *p, unsigned words)
+{
+	return (uint32_t)p >= 0x20000000 && !((uint32_t)p & 3) &&
+		p + words <= (uint32_t *)&_estack;
+}
+
+void crashCapture(uint32_t *frame, uint32_t excReturn) __attribute__((used, noreturn));
+void crashCapture(uint32_t *frame, uint32_t excReturn)
+{
+	CrashRecord *r = &record;
+	uint32_t count = valid(r) ? r->count + 1 : 1;
+	uint32_t ipsr;
+	unsigned i, n;
+
+	__asm volatile ("mrs %0, ipsr" : "=r" (ipsr));
+
+	memset(r, 0, sizeof(*r));
+	r->magic = CRASH_MAGIC;
+	r->count = count;
+	r->exception = ipsr & 0x1FF;
+	r->excReturn = excReturn;
+	r->cfsr = HWREG(NVIC_FAULT_STAT);
+	r->hfsr = HWREG(NVIC_HFAULT_STAT);
+	r->mmfar = HWREG(NVIC_MM_ADDR);
+	r->bfar = HWREG(NVIC_FAULT_ADDR);
+
+	//
+	// A fault during exception entry leaves no usable frame
+	//
+	if (!(r->cfsr & (NVIC_FAULT_STAT_MSTKE | NVIC_FAULT_STAT_BSTKE)) && inRam(frame, 8)) {
+		r->r0 = frame[0];
+		r->r1 = frame[1];
+		r->r2 = frame[2];
+		r->r3 = frame[3];
+		r->r12 = frame[4];
+		r->lr = frame[5];
+		r->pc = frame[6];
+		r->xpsr = frame[7];
+		r->activeIrq = r->xpsr & 0x1FF;
+
+		// Extended frame when the FPU was in use, plus alignment padding
+		n = (excReturn & 0x10) ? 8 : 26;
+		if (r->xpsr & (1 << 9))
+			n++;
+		r->sp = (uint32_t)(frame + n);
+
+		//
+		// No frame pointers with -Os, so collect the words on the stack
+		// that look like return addresses. Older frames may be stale but
+		// this is usually enough to see how the code got there.
+		//
+		uint32_t *sp = frame + n;
+		for (i = 0, n = 0; i < CRASH_SCAN_WORDS && n < CRASH_BACKTRACE_DEPTH &&
+				inRam(sp + i, 1); i++) {
+			if (isCode(sp[i]))
+				r->backtrace[n++] = sp[i];
+		}
+	}
+	r->checksum = checksum(r);
+
+	if (storeMode == CRASH_STORE_EEPROM)
+		MAP_EEPROMProgram((uint32_t *)r, eepromAddress(), sizeof(*r));
+
+	if (HWREG(NVIC_DBG_CTRL) & NVIC_DBG_CTRL_C_DEBUGEN) {
+		__asm volatile ("bkpt #0");
+		while (1) {
+			; // debugger attached, keep the state for inspection
+		}
+	}
+
+	HWREG(NVIC_APINT) = NVIC_APINT_VECTKEY | NVIC_APINT_SYSRESETREQ;
+	while (1) {
+		; // wait for the reset
+	}
+}
+
+//
+// Entered from the fault, NMI and default interrupt vectors in
+// startup_gcc.c with the exception frame untouched. With the MPU guards in
+// use memory management faults come through mpu_guard.c first.
+//
+__attribute__((naked)) void CrashHandler(void)
+{
+	__asm volatile (
+		"    tst     lr, #4\n"
+		"    ite     eq\n"
+		"    mrseq   r0, msp\n"
+		"    mrsne   r0, psp\n"
+		"    mov     r1, lr\n"
+		"    ldr     r2, =crashStack + " CRASH_STR(CRASH_STACK_SIZE) "\n"
+		"    mov     sp, r2\n"
+		"    b       crashCapture\n"
+	);
+}
+
+void crashStore(int store)
+{
+	storeMode = store;
+}
+
+int crashAvailable(void)
+{
+	if (valid(&record))
+		return 1;
+
+	// RAM does not survive a power cycle, the EEPROM copy does
+	if (storeMode == CRASH_STORE_EEPROM) {
+		MAP_EEPROMRead((uint32_t *)&record, eepromAddress(), sizeof(record));
+		return valid(&record);
+	}
+	return 0;
+}
+
+const CrashRecord *crashRecord(void)
+{
+	return crashAvailable() ? &record : NULL;
+}
+
+void crashClear(void)
+{
+	memset(&record, 0, sizeof(record));
+	if (storeMode == CRASH_STORE_EEPROM)
+		MAP_EEPROMProgram((uint32_t *)&record, eepromAddress(), sizeof(record));
+}
+
+} // extern "C"
+
+static size_t printWord(Print &out, uint32_t value)
+{
+	char buf[11];
+	int i;
+
+	buf[0] = '0';
+	buf[1] = 'x';
+	for (i = 9; i >= 2; i--, value >>= 4)
+		buf[i] = "0123456789abcdef"[value & 0xF];
+	buf[10] = 0;
+
+	return out.print(buf);
+}
+
+static size_t printField(Print &out, const char *name, uint32_t value)
+{
+	return out.print(name) + out.print('=') + printWord(out, value) + out.print(' ');
+}
+
+//
+// One record in a line oriented format that extras/crash_symbolize.py reads
+//
+size_t crashPrint(Print &out)
+{
+	const CrashRecord *r = crashRecord();
+	size_t n = 0;
+	int i;
+
+	if (!r)
+		return 0;
+
+	n += out.print("CRASH count=");
+	n += out.print(r->count);
+	n += out.print(" exception=");
+	n += out.print(r->exception);
+	n += out.print(" irq=");
+	n += out.println(r->activeIrq);
+	n += printField(out, "cfsr", r->cfsr);
+	n += printField(out, "hfsr", r->hfsr);
+	n += printField(out, "mmfar", r->mmfar);
+	n += printField(out, "bfar", r->bfar);
+	n += out.println();
+	n += printField(out, "r0", r->r0);
+	n += printField(out, "r1", r->r1);
+	n += printField(out, "r2", r->r2);
+	n += printField(out, "r3", r->r3);
+	n += printField(out, "r12", r->r12);
+	n += out.println();
+	n += printField(out, "pc", r->pc);
+	n += printField(out, "lr", r->lr);
+	n += printField(out, "sp", r->sp);
+	n += printField(out, "xpsr", r->xpsr);
+	n += out.println();
+	n += out.print("bt");
+	for (i = 0; i < CRASH_BACKTRACE_DEPTH && r->backtrace[i]; i++) {
+		n += out.print(' ');
+		n += printWord(out, r->backtrace[i]);
+	}
+	n += out.println();
+	return n;
+}
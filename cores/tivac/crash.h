@@ -0,0 +1,82 @@
+/*
+ ************************************************************************
+ *	crash.h
+ *
+ *	Arduino core files for ARM Cortex-M4F: Tiva-C and Stellaris
+ *		Copyright (c) 2016 Energia. All right reserved.
+ *
+ *	Post-mortem crash records. Faults, NMI and unhandled interrupts save
+ *	the stacked registers, the fault status registers, the active
+ *	exception and a short backtrace into .noinit RAM (and optionally the
+ *	last block of the internal EEPROM) and reset the part at once. After
+ *	the reboot the record can be read back and printed; the printout is
+ *	symbolized on the host with extras/crash_symbolize.py.
+ *
+ *	With a debugger attached the handler stops at a breakpoint instead
+ *	of resetting.
+ *
+ ***********************************************************************
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef crash_h
+#define crash_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CRASH_BACKTRACE_DEPTH   8
+
+// Private stack of the fault handlers, room for the ROM EEPROM calls and a
+// fault callback (see mpu_guard.h)
+#define CRASH_STACK_SIZE        512
+
+// The naked handlers need the size as a string
+#define CRASH_STR_(x)           #x
+#define CRASH_STR(x)            CRASH_STR_(x)
+
+#define CRASH_STORE_RAM         0   // .noinit only, lost on power loss
+#define CRASH_STORE_EEPROM      1   // also kept in the last EEPROM block
+
+typedef struct {
+	uint32_t magic;
+	uint32_t count;         // crashes since the record was cleared
+	uint32_t exception;     // 2 NMI, 3 hard fault, 4-6 faults, 16+ IRQ
+	uint32_t activeIrq;     // exception number that was interrupted, 0 thread
+	uint32_t r0, r1, r2, r3, r12, lr, pc, xpsr;
+	uint32_t sp;            // stack pointer before the exception
+	uint32_t excReturn;
+	uint32_t cfsr, hfsr, mmfar, bfar;
+	uint32_t backtrace[CRASH_BACKTRACE_DEPTH];
+	uint32_t checksum;
+} CrashRecord;
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+void crashStore(int store);
+int crashAvailable(void);
+const CrashRecord *crashRecord(void);
+void crashClear(void);
+
+#ifdef __cplusplus
+} // extern "C"
+
+class Print;
+size_t crashPrint(Print &out);
+#endif
+
+#endif
@@ -0,0 +1,77 @@
+/*
+ ************************************************************************
+ *	dma.c
+ *
+ *	Arduino core files for ARM Cortex-M4F: Tiva-C and Stellaris
+ *		Copyright (c) 2016 Energia. All right reserved.
+ *
+ *	Shared uDMA control table, see dma.h.
+ *
+ ***********************************************************************
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "inc/hw_types.h"
+#include "inc/hw_memmap.h"
+#include "inc/hw_udma.h"
+#include "driverlib/rom.h"
+#include "driverlib/rom_map.h"
+#include "driverlib/sysctl.h"
+#include "driverlib/udma.h"
+#include "boot.h"
+#include "priority.h"
+#include "dma.h"
+
+// Primary and alternate structures for all 32 channels
+static tDMAControlTable dmaTable[64] __attribute__((aligned(1024))) NOINIT;
+static volatile bool dmaReady;
+
+void dmaBegin(void)
+{
+	uint32_t saved;
+
+	if (dmaReady)
+		return;
+
+	// The controller registers fault until its clock is on, so the flag
+	// rather than UDMA_CTLBASE tells whether the table is installed
+	saved = criticalEnter(INT_PRIORITY_CORE);
+	if (!dmaReady) {
+		MAP_SysCtlPeripheralEnable(SYSCTL_PERIPH_UDMA);
+		while (!MAP_SysCtlPeripheralReady(SYSCTL_PERIPH_UDMA))
+			;
+		MAP_uDMAEnable();
+		MAP_uDMAControlBaseSet(dmaTable);
+		dmaReady = true;
+	}
+	criticalExit(saved);
+}
+
+void dmaTaskSet(tDMAControlTable *task, uint32_t control, uint32_t mode,
+		volatile void *src, volatile void *dst, uint32_t n)
+{
+	// Increment fields are log2 of the byte step, 3 means none
+	uint32_t srcInc = (control & UDMA_CHCTL_SRCINC_M) >> 26;
+	uint32_t dstInc = (control & UDMA_CHCTL_DSTINC_M) >> 30;
+
+	task->pvSrcEndAddr = srcInc == 3 ? src : (volatile uint8_t *)src + ((n - 1) << srcInc);
+	task->pvDstEndAddr = dstInc == 3 ? dst : (volatile uint8_t *)dst + ((n - 1) << dstInc);
+	if (mode == UDMA_MODE_MEM_SCATTER_GATHER || mode == UDMA_MODE_PER_SCATTER_GATHER)
+		mode |= UDMA_MODE_ALT_SELECT;
+	task->ui32Control = control | mode | ((n - 1) << UDMA_CHCTL_XFERSIZE_S);
+	task->ui32Spare = 0;
+}
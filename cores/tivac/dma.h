@@ -0,0 +1,57 @@
+/*
+ ************************************************************************
+ *	dma.h
+ *
+ *	Arduino core files for ARM Cortex-M4F: Tiva-C and Stellaris
+ *		Copyright (c) 2016 Energia. All right reserved.
+ *
+ *	The uDMA controller has a single control table for all 32 channels,
+ *	so the core owns it and libraries share it. Call dmaBegin() before
+ *	programming a channel; it enables the controller on first use.
+ *
+ ***********************************************************************
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef dma_h
+#define dma_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "driverlib/udma.h"
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+// Longest transfer a single control structure can describe
+#define DMA_MAX_TRANSFER    1024
+
+void dmaBegin(void);
+
+//
+// Fill in a scatter-gather task or control structure for n items of the
+// given size, UDMA_SRC_INC_NONE/UDMA_DST_INC_NONE keep that address fixed.
+// control holds UDMA_SIZE_x, the increments and UDMA_ARB_x; mode is a
+// UDMA_MODE_x value.
+//
+void dmaTaskSet(tDMAControlTable *task, uint32_t control, uint32_t mode,
+		volatile void *src, volatile void *dst, uint32_t n);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
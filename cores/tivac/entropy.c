@@ -0,0 +1,92 @@
+/*
+ ************************************************************************
+ *	entropy.c
+ *
+ *	Arduino core files for ARM Cortex-M4F: Tiva-C and Stellaris
+ *		Copyright (c) 2016 Energia. All right reserved.
+ *
+ *	Seed material for the random number generator. Each conversion of
+ *	the internal temperature sensor contributes its noisy low bits and
+ *	the number of CPU cycles the conversion took, which jitters with the
+ *	ADC clock running off PIOSC rather than the PLL. The samples are
+ *	folded into a 32 bit pool with a multiply/rotate hash.
+ *
+ ***********************************************************************
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "inc/hw_types.h"
+#include "inc/hw_memmap.h"
+#include "inc/hw_nvic.h"
+#include "driverlib/adc.h"
+#include "driverlib/rom.h"
+#include "driverlib/sysctl.h"
+#include "boot.h"
+#include "WRandom.h"
+
+/* Conversions folded into each 32 bit result */
+#define ENTROPY_SAMPLES     32
+
+static uint32_t fmix32(uint32_t h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+static uint32_t mix(uint32_t pool, uint32_t sample)
+{
+    pool ^= sample * 0xcc9e2d51;
+    pool = (pool << 13) | (pool >> 19);
+    return pool * 5 + 0xe6546b64;
+}
+
+uint32_t entropyRandom(void)
+{
+    uint32_t pool = HWREG(NVIC_ST_CURRENT);
+    uint32_t start, value[1];
+    int i;
+
+    ROM_SysCtlPeripheralEnable(SYSCTL_PERIPH_ADC0);
+    ROM_ADCSequenceConfigure(ADC0_BASE, 3, ADC_TRIGGER_PROCESSOR, 0);
+    ROM_ADCSequenceStepConfigure(ADC0_BASE, 3, 0, ADC_CTL_TS | ADC_CTL_IE | ADC_CTL_END);
+    ROM_ADCSequenceEnable(ADC0_BASE, 3);
+
+    for (i = 0; i < ENTROPY_SAMPLES; i++) {
+        ROM_ADCIntClear(ADC0_BASE, 3);
+        start = HWREG(BOOT_DWT_CYCCNT);
+        ROM_ADCProcessorTrigger(ADC0_BASE, 3);
+        while(!ROM_ADCIntStatus(ADC0_BASE, 3, false)) {
+        }
+        ROM_ADCSequenceDataGet(ADC0_BASE, 3, (unsigned long*) value);
+        pool = mix(pool, (value[0] & 0xf) | ((HWREG(BOOT_DWT_CYCCNT) - start) << 4));
+    }
+    ROM_ADCIntClear(ADC0_BASE, 3);
+
+    return fmix32(pool ^ HWREG(NVIC_ST_CURRENT));
+}
+
+void randomSeedEntropy(void)
+{
+    uint64_t seed = entropyRandom();
+
+    seed = (seed << 32) | entropyRandom();
+    randomSeed64(seed);
+}
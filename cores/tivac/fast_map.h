@@ -0,0 +1,160 @@
+/*
+ ************************************************************************
+ *	fast_map.h
+ *
+ *	Arduino core files for ARM Cortex-M4F: Tiva-C and Stellaris
+ *		Copyright (c) 2016 Energia. All right reserved.
+ *
+ *	Inline register access for the driverlib calls on hot paths.
+ *	FAST_xxx() does the same as ROM_xxx()/MAP_xxx() but compiles to a
+ *	few loads and stores instead of a call through the ROM table, so
+ *	per-byte loops and interrupt handlers can use it. Only the simple
+ *	data path functions are here, set-up code keeps using MAP_/ROM_.
+ *
+ ***********************************************************************
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef fast_map_h
+#define fast_map_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "inc/hw_types.h"
+#include "inc/hw_nvic.h"
+#include "inc/hw_gpio.h"
+#include "inc/hw_uart.h"
+#include "inc/hw_ssi.h"
+
+#define FAST_INLINE static inline __attribute__((always_inline))
+
+//
+// NVIC, peripheral interrupts only (ui32Interrupt >= 16)
+//
+FAST_INLINE void FAST_IntEnable(uint32_t ui32Interrupt)
+{
+	HWREG(NVIC_EN0 + (((ui32Interrupt - 16) >> 5) << 2)) = 1 << ((ui32Interrupt - 16) & 31);
+}
+
+FAST_INLINE void FAST_IntDisable(uint32_t ui32Interrupt)
+{
+	HWREG(NVIC_DIS0 + (((ui32Interrupt - 16) >> 5) << 2)) = 1 << ((ui32Interrupt - 16) & 31);
+}
+
+//
+// GPIO
+//
+FAST_INLINE void FAST_GPIOPinWrite(uint32_t ui32Port, uint8_t ui8Pins, uint8_t ui8Val)
+{
+	HWREG(ui32Port + GPIO_O_DATA + (ui8Pins << 2)) = ui8Val;
+}
+
+FAST_INLINE int32_t FAST_GPIOPinRead(uint32_t ui32Port, uint8_t ui8Pins)
+{
+	return HWREG(ui32Port + GPIO_O_DATA + (ui8Pins << 2));
+}
+
+//
+// UART
+//
+FAST_INLINE bool FAST_UARTSpaceAvail(uint32_t ui32Base)
+{
+	return !(HWREG(ui32Base + UART_O_FR) & UART_FR_TXFF);
+}
+
+FAST_INLINE bool FAST_UARTCharsAvail(uint32_t ui32Base)
+{
+	return !(HWREG(ui32Base + UART_O_FR) & UART_FR_RXFE);
+}
+
+FAST_INLINE bool FAST_UARTBusy(uint32_t ui32Base)
+{
+	return HWREG(ui32Base + UART_O_FR) & UART_FR_BUSY;
+}
+
+FAST_INLINE bool FAST_UARTCharPutNonBlocking(uint32_t ui32Base, unsigned char ucData)
+{
+	if (HWREG(ui32Base + UART_O_FR) & UART_FR_TXFF)
+		return false;
+	HWREG(ui32Base + UART_O_DR) = ucData;
+	return true;
+}
+
+FAST_INLINE int32_t FAST_UARTCharGetNonBlocking(uint32_t ui32Base)
+{
+	if (HWREG(ui32Base + UART_O_FR) & UART_FR_RXFE)
+		return -1;
+	return HWREG(ui32Base + UART_O_DR);
+}
+
+FAST_INLINE uint32_t FAST_UARTIntStatus(uint32_t ui32Base, bool bMasked)
+{
+	return HWREG(ui32Base + (bMasked ? UART_O_MIS : UART_O_RIS));
+}
+
+FAST_INLINE void FAST_UARTIntClear(uint32_t ui32Base, uint32_t ui32IntFlags)
+{
+	HWREG(ui32Base + UART_O_ICR) = ui32IntFlags;
+}
+
+FAST_INLINE void FAST_UARTIntEnable(uint32_t ui32Base, uint32_t ui32IntFlags)
+{
+	HWREG(ui32Base + UART_O_IM) |= ui32IntFlags;
+}
+
+FAST_INLINE void FAST_UARTIntDisable(uint32_t ui32Base, uint32_t ui32IntFlags)
+{
+	HWREG(ui32Base + UART_O_IM) &= ~ui32IntFlags;
+}
+
+//
+// SSI
+//
+FAST_INLINE void FAST_SSIDataPut(uint32_t ui32Base, uint32_t ui32Data)
+{
+	while (!(HWREG(ui32Base + SSI_O_SR) & SSI_SR_TNF))
+		;
+	HWREG(ui32Base + SSI_O_DR) = ui32Data;
+}
+
+FAST_INLINE int32_t FAST_SSIDataPutNonBlocking(uint32_t ui32Base, uint32_t ui32Data)
+{
+	if (!(HWREG(ui32Base + SSI_O_SR) & SSI_SR_TNF))
+		return 0;
+	HWREG(ui32Base + SSI_O_DR) = ui32Data;
+	return 1;
+}
+
+FAST_INLINE void FAST_SSIDataGet(uint32_t ui32Base, uint32_t *pui32Data)
+{
+	while (!(HWREG(ui32Base + SSI_O_SR) & SSI_SR_RNE))
+		;
+	*pui32Data = HWREG(ui32Base + SSI_O_DR);
+}
+
+FAST_INLINE int32_t FAST_SSIDataGetNonBlocking(uint32_t ui32Base, uint32_t *pui32Data)
+{
+	if (!(HWREG(ui32Base + SSI_O_SR) & SSI_SR_RNE))
+		return 0;
+	*pui32Data = HWREG(ui32Base + SSI_O_DR);
+	return 1;
+}
+
+FAST_INLINE bool FAST_SSIBusy(uint32_t ui32Base)
+{
+	return HWREG(ui32Base + SSI_O_SR) & SSI_SR_BSY;
+}
+
+#endif
@@ -0,0 +1,515 @@
+/*
+ ************************************************************************
+ *	heap.c
+ *
+ *	Arduino core files for ARM Cortex-M4F: Tiva-C and Stellaris
+ *		Copyright (c) 2016 Energia. All right reserved.
+ *
+ *	TLSF (two level segregated fit) allocator after M. Masmano et al.,
+ *	"TLSF: a New Dynamic Memory Allocator for Real-Time Systems".
+ *	Free blocks are kept in size class lists indexed by two bitmaps so
+ *	malloc and free run in constant time, independent of fragmentation.
+ *
+ ***********************************************************************
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include "heap.h"
+
+extern char end asm ("end");    /* first ram address after bss and data */
+extern unsigned _estack;
+
+#ifdef ENERGIA_HEAP_TLSF
+
+#define ALIGN_SIZE_LOG2     3
+#define ALIGN_SIZE          (1 << ALIGN_SIZE_LOG2)   // malloc alignment
+
+#define SL_INDEX_COUNT_LOG2 3
+#define SL_INDEX_COUNT      (1 << SL_INDEX_COUNT_LOG2)
+#define FL_INDEX_MAX        18                       // blocks below 256 KB
+#define FL_INDEX_SHIFT      (SL_INDEX_COUNT_LOG2 + ALIGN_SIZE_LOG2)
+#define FL_INDEX_COUNT      (FL_INDEX_MAX - FL_INDEX_SHIFT + 1)
+#define SMALL_BLOCK_SIZE    (1 << FL_INDEX_SHIFT)
+
+#define BLOCK_FREE          0x1
+#define BLOCK_SIZE_MAX      ((1UL << FL_INDEX_MAX) - ALIGN_SIZE)
+
+typedef struct heap_block {
+	struct heap_block *prev_phys;   // physically preceding block
+	size_t size;                    // payload bytes | BLOCK_FREE
+	struct heap_block *next_free;   // free list links, only valid while free
+	struct heap_block *prev_free;
+} heap_block;
+
+#define BLOCK_HEADER_SIZE   offsetof(heap_block, next_free)
+#define BLOCK_SIZE_MIN      (sizeof(heap_block) - BLOCK_HEADER_SIZE)
+
+static uint32_t fl_bitmap;
+static uint32_t sl_bitmap[FL_INDEX_COUNT];
+static heap_block *blocks[FL_INDEX_COUNT][SL_INDEX_COUNT];
+
+static size_t heap_size;
+static size_t free_bytes;
+static size_t high_water;
+static uint32_t failed_allocs;
+static int initialized;
+
+//
+// The allocator is short and bounded, so making it interrupt safe with a
+// PRIMASK critical section costs little.
+//
+static inline uint32_t heap_lock(void)
+{
+	uint32_t primask;
+	__asm volatile ("mrs %0, primask\n"
+			"cpsid i" : "=r" (primask) :: "memory");
+	return primask;
+}
+
+static inline void heap_unlock(uint32_t primask)
+{
+	__asm volatile ("msr primask, %0" :: "r" (primask) : "memory");
+}
+
+static inline size_t block_size(const heap_block *block)
+{
+	return block->size & ~BLOCK_FREE;
+}
+
+static inline int block_is_free(const heap_block *block)
+{
+	return block->size & BLOCK_FREE;
+}
+
+static inline void *block_to_ptr(heap_block *block)
+{
+	return (char *)block + BLOCK_HEADER_SIZE;
+}
+
+static inline heap_block *block_from_ptr(void *ptr)
+{
+	return (heap_block *)((char *)ptr - BLOCK_HEADER_SIZE);
+}
+
+static inline heap_block *block_next(heap_block *block)
+{
+	return (heap_block *)((char *)block_to_ptr(block) + block_size(block));
+}
+
+static inline size_t align_up(size_t x)
+{
+	return (x + (ALIGN_SIZE - 1)) & ~(ALIGN_SIZE - 1);
+}
+
+static inline int fls_nonzero(uint32_t x)
+{
+	return 31 - __builtin_clz(x);
+}
+
+static inline int ffs_nonzero(uint32_t x)
+{
+	return __builtin_ctz(x);
+}
+
+static void mapping_insert(size_t size, int *fli, int *sli)
+{
+	if (size < SMALL_BLOCK_SIZE) {
+		*fli = 0;
+		*sli = size / (SMALL_BLOCK_SIZE / SL_INDEX_COUNT);
+	} else {
+		int fl = fls_nonzero(size);
+		*sli = (size >> (fl - SL_INDEX_COUNT_LOG2)) ^ SL_INDEX_COUNT;
+		*fli = fl - (FL_INDEX_SHIFT - 1);
+	}
+}
+
+//
+// Round up to the next list boundary so that any block in the list found
+// is big enough, no searching inside a list.
+//
+static void mapping_search(size_t size, int *fli, int *sli)
+{
+	if (size >= SMALL_BLOCK_SIZE)
+		size += (1 << (fls_nonzero(size) - SL_INDEX_COUNT_LOG2)) - 1;
+	mapping_insert(size, fli, sli);
+}
+
+static heap_block *search_suitable_block(int *fli, int *sli)
+{
+	int fl = *fli;
+	uint32_t sl_map = sl_bitmap[fl] & (~0UL << *sli);
+
+	if (!sl_map) {
+		uint32_t fl_map = fl_bitmap & (~0UL << (fl + 1));
+		if (!fl_map)
+			return NULL;
+		fl = ffs_nonzero(fl_map);
+		*fli = fl;
+		sl_map = sl_bitmap[fl];
+	}
+	*sli = ffs_nonzero(sl_map);
+	return blocks[fl][*sli];
+}
+
+static void remove_free_block(heap_block *block, int fl, int sl)
+{
+	heap_block *prev = block->prev_free;
+	heap_block *next = block->next_free;
+
+	if (next)
+		next->prev_free = prev;
+	if (prev)
+		prev->next_free = next;
+
+	if (blocks[fl][sl] == block) {
+		blocks[fl][sl] = next;
+		if (!next) {
+			sl_bitmap[fl] &= ~(1UL << sl);
+			if (!sl_bitmap[fl])
+				fl_bitmap &= ~(1UL << fl);
+		}
+	}
+	free_bytes -= block_size(block);
+}
+
+static void insert_free_block(heap_block *block)
+{
+	int fl, sl;
+
+	mapping_insert(block_size(block), &fl, &sl);
+	block->prev_free = NULL;
+	block->next_free = blocks[fl][sl];
+	if (block->next_free)
+		block->next_free->prev_free = block;
+	blocks[fl][sl] = block;
+	fl_bitmap |= 1UL << fl;
+	sl_bitmap[fl] |= 1UL << sl;
+	block->size |= BLOCK_FREE;
+	free_bytes += block_size(block);
+}
+
+static void remove_block(heap_block *block)
+{
+	int fl, sl;
+
+	mapping_insert(block_size(block), &fl, &sl);
+	remove_free_block(block, fl, sl);
+}
+
+//
+// Cut block down to size bytes and return the remainder to the free
+// lists, merged with a free neighbour if there is one.
+//
+static void trim_block(heap_block *block, size_t size)
+{
+	size_t remaining = block_size(block) - size;
+	heap_block *rest, *next;
+
+	if (remaining < BLOCK_HEADER_SIZE + BLOCK_SIZE_MIN)
+		return;
+
+	rest = (heap_block *)((char *)block_to_ptr(block) + size);
+	rest->size = remaining - BLOCK_HEADER_SIZE;
+	rest->prev_phys = block;
+	block->size = size | (block->size & BLOCK_FREE);
+
+	next = block_next(rest);
+	if (block_is_free(next)) {
+		remove_block(next);
+		rest->size += BLOCK_HEADER_SIZE + block_size(next);
+	}
+	block_next(rest)->prev_phys = rest;
+	insert_free_block(rest);
+}
+
+static void heap_init(void)
+{
+	uintptr_t start = ((uintptr_t)&end + ALIGN_SIZE - 1) & ~(ALIGN_SIZE - 1);
+	uintptr_t limit = ((uintptr_t)&_estack - HEAP_STACK_RESERVE) & ~(ALIGN_SIZE - 1);
+	heap_block *block = (heap_block *)start;
+	heap_block *sentinel;
+
+	initialized = 1;
+	if (limit <= start + 2 * BLOCK_HEADER_SIZE + BLOCK_SIZE_MIN)
+		return;
+
+	//
+	// One free block spanning the pool, followed by a zero sized used
+	// block so that block_next() never walks off the end.
+	//
+	heap_size = limit - start - 2 * BLOCK_HEADER_SIZE;
+	if (heap_size > BLOCK_SIZE_MAX)
+		heap_size = BLOCK_SIZE_MAX;
+	block->prev_phys = NULL;
+	block->size = heap_size;
+	sentinel = block_next(block);
+	sentinel->prev_phys = block;
+	sentinel->size = 0;
+	insert_free_block(block);
+}
+
+static inline void update_high_water(void)
+{
+	if (heap_size - free_bytes > high_water)
+		high_water = heap_size - free_bytes;
+}
+
+static void *heap_malloc(size_t size)
+{
+	heap_block *block;
+	int fl, sl;
+
+	if (!initialized)
+		heap_init();
+
+	if (size > BLOCK_SIZE_MAX)
+		goto fail;
+	size = size < BLOCK_SIZE_MIN ? BLOCK_SIZE_MIN : align_up(size);
+
+	mapping_search(size, &fl, &sl);
+	if (fl >= FL_INDEX_COUNT)
+		goto fail;
+	block = search_suitable_block(&fl, &sl);
+	if (!block)
+		goto fail;
+
+	remove_free_block(block, fl, sl);
+	block->size &= ~BLOCK_FREE;
+	trim_block(block, size);
+	update_high_water();
+	return block_to_ptr(block);
+
+fail:
+	failed_allocs++;
+	return NULL;
+}
+
+static void heap_free(void *ptr)
+{
+	heap_block *block, *prev, *next;
+
+	if (!ptr)
+		return;
+
+	block = block_from_ptr(ptr);
+	prev = block->prev_phys;
+	next = block_next(block);
+
+	if (prev && block_is_free(prev)) {
+		remove_block(prev);
+		prev->size += BLOCK_HEADER_SIZE + block_size(block);
+		block = prev;
+	}
+	if (block_is_free(next)) {
+		remove_block(next);
+		block->size += BLOCK_HEADER_SIZE + block_size(next);
+	}
+	block->size &= ~BLOCK_FREE;
+	block_next(block)->prev_phys = block;
+	insert_free_block(block);
+}
+
+static void *heap_realloc(void *ptr, size_t size)
+{
+	heap_block *block, *next;
+	size_t current;
+	void *p;
+
+	if (!ptr)
+		return heap_malloc(size);
+	if (size == 0) {
+		heap_free(ptr);
+		return NULL;
+	}
+	if (size > BLOCK_SIZE_MAX) {
+		failed_allocs++;
+		return NULL;
+	}
+
+	block = block_from_ptr(ptr);
+	next = block_next(block);
+	current = block_size(block);
+	size = size < BLOCK_SIZE_MIN ? BLOCK_SIZE_MIN : align_up(size);
+
+	if (size <= current) {
+		trim_block(block, size);
+		return ptr;
+	}
+
+	// grow in place into a free neighbour if it is big enough
+	if (block_is_free(next) &&
+	    current + BLOCK_HEADER_SIZE + block_size(next) >= size) {
+		remove_block(next);
+		block->size += BLOCK_HEADER_SIZE + block_size(next);
+		block_next(block)->prev_phys = block;
+		trim_block(block, size);
+		update_high_water();
+		return ptr;
+	}
+
+	p = heap_malloc(size);
+	if (p) {
+		memcpy(p, ptr, current);
+		heap_free(ptr);
+	}
+	return p;
+}
+
+void *malloc(size_t size)
+{
+	uint32_t primask = heap_lock();
+	void *p = heap_malloc(size);
+	heap_unlock(primask);
+	return p;
+}
+
+void free(void *ptr)
+{
+	uint32_t primask = heap_lock();
+	heap_free(ptr);
+	heap_unlock(primask);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	uint32_t primask = heap_lock();
+	void *p = heap_realloc(ptr, size);
+	heap_unlock(primask);
+	return p;
+}
+
+void *calloc(size_t n, size_t size)
+{
+	size_t total = n * size;
+	void *p;
+
+	if (size && total / size != n) {
+		failed_allocs++;
+		return NULL;
+	}
+	p = malloc(total);
+	if (p)
+		memset(p, 0, total);
+	return p;
+}
+
+//
+// Reentrant entry points used inside newlib (stdio, strdup, ...)
+//
+struct _reent;
+void *_malloc_r(struct _reent *r, size_t size) { return malloc(size); }
+void _free_r(struct _reent *r, void *ptr) { free(ptr); }
+void *_realloc_r(struct _reent *r, void *ptr, size_t size) { return realloc(ptr, size); }
+void *_calloc_r(struct _reent *r, size_t n, size_t size) { return calloc(n, size); }
+
+void heapStats(HeapStats *stats)
+{
+	uint32_t primask = heap_lock();
+	size_t largest = 0;
+
+	if (!initialized)
+		heap_init();
+
+	//
+	// The largest block is in the highest non-empty list, only that
+	// list needs to be scanned.
+	//
+	if (fl_bitmap) {
+		int fl = fls_nonzero(fl_bitmap);
+		heap_block *block = blocks[fl][fls_nonzero(sl_bitmap[fl])];
+		for (; block; block = block->next_free) {
+			if (block_size(block) > largest)
+				largest = block_size(block);
+		}
+	}
+
+	stats->size = heap_size;
+	stats->freeBytes = free_bytes;
+	stats->largestFreeBlock = largest;
+	stats->highWater = high_water;
+	stats->failedAllocs = failed_allocs;
+	heap_unlock(primask);
+}
+
+void *heapTop(void)
+{
+	return (void *)(((uintptr_t)&_estack - HEAP_STACK_RESERVE) & ~(ALIGN_SIZE - 1));
+}
+
+size_t heapHighWater(void)
+{
+	return high_water;
+}
+
+int heapSetLimit(void *limit)
+{
+	return !limit || (uintptr_t)limit >= (uintptr_t)heapTop();
+}
+
+#else
+
+extern uint32_t heap_sbrk_failures;    /* counted by _sbrk in startup_gcc.c */
+extern char *heap_sbrk_limit;
+extern char *_sbrk(int incr);
+
+void heapStats(HeapStats *stats)
+{
+	struct mallinfo info = mallinfo();
+	char *brk = (char *)_sbrk(0);
+	char *sp = (char *)__builtin_frame_address(0);
+	size_t gap = sp > brk ? sp - brk : 0;
+
+	//
+	// newlib never returns memory to the break, so the break is the
+	// high-water mark. The gap up to the stack can still be claimed.
+	//
+	stats->size = (char *)&_estack - &end;
+	stats->freeBytes = info.fordblks + gap;
+	stats->largestFreeBlock = gap;
+	stats->highWater = brk - &end;
+	stats->failedAllocs = heap_sbrk_failures;
+}
+
+void *heapTop(void)
+{
+	return _sbrk(0);
+}
+
+size_t heapHighWater(void)
+{
+	return (char *)_sbrk(0) - &end;
+}
+
+int heapSetLimit(void *limit)
+{
+	if (limit && (char *)_sbrk(0) > (char *)limit)
+		return 0;
+	heap_sbrk_limit = (char *)limit;
+	return 1;
+}
+
+#endif
+
+size_t heapFreeBytes(void)
+{
+	HeapStats stats;
+
+	heapStats(&stats);
+	return stats.freeBytes;
+}
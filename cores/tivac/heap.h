@@ -0,0 +1,70 @@
+/*
+ ************************************************************************
+ *	heap.h
+ *
+ *	Arduino core files for ARM Cortex-M4F: Tiva-C and Stellaris
+ *		Copyright (c) 2016 Energia. All right reserved.
+ *
+ *	Heap statistics. With ENERGIA_HEAP_TLSF defined (Tools > Heap menu)
+ *	malloc/free are replaced by a TLSF (two level segregated fit)
+ *	allocator with O(1) bounded allocation and free time. Otherwise
+ *	newlib malloc is used and the statistics are derived from mallinfo()
+ *	and the break pointer.
+ *
+ ***********************************************************************
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef heap_h
+#define heap_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+// Bytes between the end of the TLSF heap and the top of RAM left for the
+// main stack. The newlib heap instead grows until it meets the stack.
+#ifndef HEAP_STACK_RESERVE
+#define HEAP_STACK_RESERVE 0x800
+#endif
+
+typedef struct {
+	size_t size;              // bytes managed by the allocator
+	size_t freeBytes;         // bytes currently available
+	size_t largestFreeBlock;  // biggest single allocation that can succeed
+	size_t highWater;         // most bytes ever in use
+	uint32_t failedAllocs;    // allocations that returned NULL
+} HeapStats;
+
+void heapStats(HeapStats *stats);
+size_t heapFreeBytes(void);
+size_t heapHighWater(void);
+
+// First address above the heap, the main stack may grow down to here.
+void *heapTop(void);
+
+// Keep the heap below limit, NULL removes the limit. Returns 0 when the
+// heap already extends past it. The TLSF pool is fixed, so there this only
+// checks the pool end.
+int heapSetLimit(void *limit);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
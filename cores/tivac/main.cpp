@@ -79,9 +79,12 @@ void _init(void)
 int main(void)
 {
 	setup();
+	bootStamp(BOOT_SETUP);
 
 	for (;;) {
 		loop();
 		if (serialEventRun) serialEventRun();
+		loopCbRun();
+		if (loopIdle) waitForEvent();
 	}
 }
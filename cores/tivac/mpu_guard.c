@@ -0,0 +1,184 @@
+/*
+ ************************************************************************
+ *	mpu_guard.c
+ *
+ *	Arduino core files for ARM Cortex-M4F: Tiva-C and Stellaris
+ *		Copyright (c) 2016 Energia. All right reserved.
+ *
+ ***********************************************************************
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "Energia.h"
+#include "mpu_guard.h"
+#include "crash.h"
+#include "inc/hw_ints.h"
+#include "driverlib/rom_map.h"
+#include "driverlib/interrupt.h"
+#include "driverlib/mpu.h"
+
+#ifdef TARGET_IS_BLIZZARD_RB1
+#define FLASH_SIZE              0x40000
+#define FLASH_REGION_SIZE       MPU_RGN_SIZE_256K
+#else
+#define FLASH_SIZE              0x100000
+#define FLASH_REGION_SIZE       MPU_RGN_SIZE_1M
+#endif
+
+// Higher region numbers take precedence where regions overlap
+#define REGION_FLASH            0
+#define REGION_NULL             1
+#define REGION_STACK            2
+
+#if MPU_STACK_GUARD_SIZE >= HEAP_STACK_RESERVE
+#error "MPU_STACK_GUARD_SIZE leaves no room for the stack in HEAP_STACK_RESERVE"
+#endif
+
+// MPU_RGN_SIZE_xxx for a region of MPU_STACK_GUARD_SIZE bytes
+#define STACK_GUARD_REGION_SIZE ((__builtin_ctz(MPU_STACK_GUARD_SIZE) - 1) << 1)
+
+extern unsigned _estack;
+extern uint32_t crashStack[];
+extern void crashCapture(uint32_t *frame, uint32_t excReturn) __attribute__((noreturn));
+
+volatile MpuFault mpuLastFault;
+
+static MpuFaultCallback faultCallback;
+static uint32_t stackGuard;
+
+int mpuGuardBegin(uint32_t guards)
+{
+	uint32_t sp;
+
+	MAP_MPUDisable();
+	MAP_MPURegionDisable(REGION_FLASH);
+	MAP_MPURegionDisable(REGION_NULL);
+	MAP_MPURegionDisable(REGION_STACK);
+
+	if (guards & MPU_GUARD_STACK) {
+		stackGuard = ((uint32_t)&_estack - HEAP_STACK_RESERVE + MPU_STACK_GUARD_SIZE - 1)
+				& ~(MPU_STACK_GUARD_SIZE - 1);
+		__asm volatile ("mov %0, sp" : "=r" (sp));
+		if (sp < stackGuard + MPU_STACK_GUARD_SIZE || !heapSetLimit((void *)stackGuard)) {
+			stackGuard = 0;
+			return 0;
+		}
+		MAP_MPURegionSet(REGION_STACK, stackGuard,
+				STACK_GUARD_REGION_SIZE | MPU_RGN_PERM_NOEXEC |
+				MPU_RGN_PERM_PRV_NO_USR_NO | MPU_RGN_ENABLE);
+	}
+
+	//
+	// IntRegister() and the other driverlib *IntRegister() calls copy the
+	// table VTOR points at, so once it is in RAM nothing reads address 0
+	// and the region can be no-access.
+	//
+	if (guards & MPU_GUARD_NULL) {
+		vectorTableToRam();
+		MAP_MPURegionSet(REGION_NULL, 0,
+				MPU_RGN_SIZE_256B | MPU_RGN_PERM_NOEXEC |
+				MPU_RGN_PERM_PRV_NO_USR_NO | MPU_RGN_ENABLE);
+	}
+
+	if (guards & MPU_GUARD_FLASH) {
+		MAP_MPURegionSet(REGION_FLASH, 0,
+				FLASH_REGION_SIZE | MPU_RGN_PERM_EXEC |
+				MPU_RGN_PERM_PRV_RO_USR_RO | MPU_RGN_ENABLE);
+	}
+
+	//
+	// Everything outside the guards keeps the default memory map. Vector
+	// table fetches always use the default map as well.
+	//
+	MAP_IntEnable(FAULT_MPU);
+	MAP_MPUEnable(MPU_CONFIG_PRIV_DEFAULT);
+	return 1;
+}
+
+void mpuGuardEnd(void)
+{
+	MAP_MPUDisable();
+	MAP_IntDisable(FAULT_MPU);
+	stackGuard = 0;
+	heapSetLimit(NULL);
+}
+
+void mpuGuardOnFault(MpuFaultCallback callback)
+{
+	faultCallback = callback;
+}
+
+static void mpuFaultReport(uint32_t *frame, uint32_t excReturn) __attribute__((used, noreturn));
+static void mpuFaultReport(uint32_t *frame, uint32_t excReturn)
+{
+	uint32_t status = HWREG(NVIC_FAULT_STAT) & 0xFF;
+	uint32_t address = 0;
+	uint32_t guard = 0;
+	uint32_t pc = 0;
+
+	if (status & NVIC_FAULT_STAT_MMARV)
+		address = HWREG(NVIC_MM_ADDR);
+
+	//
+	// When exception entry itself hit the stack guard nothing was stacked
+	// and the frame pointer is meaningless.
+	//
+	if (status & (NVIC_FAULT_STAT_MSTKE | NVIC_FAULT_STAT_MUSTKE))
+		guard = MPU_GUARD_STACK;
+	else
+		pc = frame[6];
+
+	if (status & NVIC_FAULT_STAT_MMARV) {
+		if (stackGuard && address >= stackGuard &&
+		    address < stackGuard + MPU_STACK_GUARD_SIZE)
+			guard = MPU_GUARD_STACK;
+		else if (address < MPU_NULL_GUARD_SIZE)
+			guard = MPU_GUARD_NULL;
+		else if (address < FLASH_SIZE)
+			guard = MPU_GUARD_FLASH;
+	} else if ((status & NVIC_FAULT_STAT_IERR) && pc < MPU_NULL_GUARD_SIZE) {
+		guard = MPU_GUARD_NULL;       // call through a NULL function pointer
+	}
+
+	mpuLastFault.guard = guard;
+	mpuLastFault.address = address;
+	mpuLastFault.pc = pc;
+	mpuLastFault.status = status;
+
+	if (faultCallback)
+		faultCallback((const MpuFault *)&mpuLastFault);
+
+	// Record the fault like any other and reset, see crash.cpp
+	crashCapture(frame, excReturn);
+}
+
+//
+// Replaces the weak handler in startup_gcc.c, which goes straight to
+// CrashHandler. The faulting stack may be the one that overflowed, so the
+// report runs on the crash handler's stack.
+//
+__attribute__((naked)) void MPUFaultHandler(void)
+{
+	__asm volatile (
+		"    tst     lr, #4\n"
+		"    ite     eq\n"
+		"    mrseq   r0, msp\n"
+		"    mrsne   r0, psp\n"
+		"    mov     r1, lr\n"
+		"    ldr     r2, =crashStack + " CRASH_STR(CRASH_STACK_SIZE) "\n"
+		"    mov     sp, r2\n"
+		"    b       mpuFaultReport\n"
+	);
+}
@@ -0,0 +1,83 @@
+/*
+ ************************************************************************
+ *	mpu_guard.h
+ *
+ *	Arduino core files for ARM Cortex-M4F: Tiva-C and Stellaris
+ *		Copyright (c) 2016 Energia. All right reserved.
+ *
+ *	Memory protection unit guard regions. A no-access region between the
+ *	heap and the main stack turns a stack overflow into a fault instead
+ *	of silent heap corruption, a no-access region at address 0 catches
+ *	reads, writes and calls through NULL pointers, and flash can be made
+ *	read-only. The NULL guard moves the vector table to RAM first
+ *	(vectorTableToRam() in boot.h), since nothing may read it at 0 then.
+ *
+ *	With the stack guard the main stack gets a fixed size of
+ *	HEAP_STACK_RESERVE bytes (see heap.h), the guard takes its lowest
+ *	MPU_STACK_GUARD_SIZE bytes and the heap stays below the guard. The
+ *	guard is larger than an FPU exception frame (104 bytes) or a typical
+ *	function's locals, so an overflow lands in it rather than past it.
+ *
+ ***********************************************************************
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef mpu_guard_h
+#define mpu_guard_h
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#define MPU_GUARD_STACK         0x01
+#define MPU_GUARD_NULL          0x02
+#define MPU_GUARD_FLASH         0x04    // flash read-only
+#define MPU_GUARD_ALL           (MPU_GUARD_STACK | MPU_GUARD_NULL | MPU_GUARD_FLASH)
+
+// A power of two, at least 32
+#ifndef MPU_STACK_GUARD_SIZE
+#define MPU_STACK_GUARD_SIZE    256
+#endif
+#define MPU_NULL_GUARD_SIZE     256
+
+typedef struct {
+	uint32_t guard;         // MPU_GUARD_xxx that was hit, 0 if unknown
+	uint32_t address;       // faulting data address, 0 if not known
+	uint32_t pc;            // faulting instruction, 0 if the stack was lost
+	uint32_t status;        // memory management fault status (CFSR[7:0])
+} MpuFault;
+
+typedef void (*MpuFaultCallback)(const MpuFault *fault);
+
+// Returns 0 if the stack guard can not be placed because the heap or the
+// stack already extend past it; no guard is enabled then.
+int mpuGuardBegin(uint32_t guards);
+void mpuGuardEnd(void);
+
+// Called from the fault handler on a private stack with interrupts of
+// lower priority blocked. It must not return to the sketch; when it returns
+// the fault is recorded and the part reset like any other crash (crash.h).
+void mpuGuardOnFault(MpuFaultCallback callback);
+
+// The last fault, for inspection with a debugger
+extern volatile MpuFault mpuLastFault;
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
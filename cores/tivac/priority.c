@@ -0,0 +1,128 @@
+/*
+ ************************************************************************
+ *	priority.c
+ *
+ *	Arduino core files for ARM Cortex-M4F: Tiva-C and Stellaris
+ *		Copyright (c) 2016 Energia. All right reserved.
+ *
+ *	Longest interrupts-disabled window, see priority.h. Only the
+ *	outermost section of a nest is timed, so a window is charged once
+ *	to the code that opened it.
+ *
+ ***********************************************************************
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <stdint.h>
+#include <string.h>
+#include "inc/hw_types.h"
+#include "boot.h"
+#include "priority.h"
+
+#ifdef ENERGIA_CRITICAL_TRACE
+
+static CriticalStats worst;
+
+static struct {
+	uint32_t start;
+	const void *site;
+} openBasepri, openPrimask;
+
+static inline uint32_t primaskGet(void)
+{
+	uint32_t primask;
+	__asm volatile ("mrs %0, primask" : "=r" (primask));
+	return primask;
+}
+
+static void record(uint32_t start, const void *site, uint8_t level)
+{
+	uint32_t cycles = HWREG(BOOT_DWT_CYCCNT) - start;
+
+	// Runs masked, nothing can update worst underneath
+	if (cycles > worst.cycles) {
+		worst.cycles = cycles;
+		worst.site = site;
+		worst.level = level;
+	}
+}
+
+__attribute__((noinline)) uint32_t criticalTraceEnter(uint32_t level)
+{
+	uint32_t old = criticalRaise(level);
+
+	if (!old) {
+		openBasepri.start = HWREG(BOOT_DWT_CYCCNT);
+		openBasepri.site = __builtin_return_address(0);
+	}
+	return old;
+}
+
+void criticalTraceExit(uint32_t old)
+{
+	uint32_t level;
+
+	if (!old) {
+		__asm volatile ("mrs %0, basepri" : "=r" (level));
+		record(openBasepri.start, openBasepri.site, level);
+	}
+	criticalRestore(old);
+}
+
+__attribute__((noinline)) uint32_t criticalTraceNoInterrupts(void)
+{
+	uint32_t was = primaskGet();
+
+	__asm volatile ("cpsid i" ::: "memory");
+	if (!was) {
+		openPrimask.start = HWREG(BOOT_DWT_CYCCNT);
+		openPrimask.site = __builtin_return_address(0);
+	}
+	return was;
+}
+
+void criticalTraceInterrupts(void)
+{
+	if (primaskGet())
+		record(openPrimask.start, openPrimask.site, 0);
+	__asm volatile ("cpsie i" ::: "memory");
+}
+
+void criticalStats(CriticalStats *stats)
+{
+	uint32_t old = criticalRaise(INT_PRIORITY_CORE);
+	*stats = worst;
+	criticalRestore(old);
+}
+
+void criticalStatsReset(void)
+{
+	uint32_t old = criticalRaise(INT_PRIORITY_CORE);
+	memset(&worst, 0, sizeof(worst));
+	criticalRestore(old);
+}
+
+#else
+
+void criticalStats(CriticalStats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+}
+
+void criticalStatsReset(void)
+{
+}
+
+#endif
@@ -0,0 +1,132 @@
+/*
+ ************************************************************************
+ *	priority.h
+ *
+ *	Arduino core files for ARM Cortex-M4F: Tiva-C and Stellaris
+ *		Copyright (c) 2016 Energia. All right reserved.
+ *
+ *	Interrupt priority map and BASEPRI critical sections. The NVIC on
+ *	these parts implements the top 3 bits of each priority byte, so there
+ *	are eight levels, 0x00 the most urgent. Every interrupt the core and
+ *	its libraries own is given a level below; levels 0x00 and 0x20 are
+ *	left to the sketch and are never masked by the core.
+ *
+ *	criticalEnter(level) masks interrupts at level and less urgent by
+ *	raising BASEPRI, so data shared with an ISR is protected without
+ *	holding off anything more urgent. Pass the level of the most urgent
+ *	ISR that touches the data:
+ *
+ *	    uint32_t saved = criticalEnter(INT_PRIORITY_UART);
+ *	    ...
+ *	    criticalExit(saved);
+ *
+ *	or in C++ { CRITICAL_SECTION(INT_PRIORITY_UART); ... }. Sections nest.
+ *
+ *	Building with ENERGIA_CRITICAL_TRACE defined records the longest
+ *	window, BASEPRI or noInterrupts(), with the caller address that
+ *	opened it, in DWT cycles. Look the address up with addr2line.
+ *
+ ***********************************************************************
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef priority_h
+#define priority_h
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#define INT_PRIORITY_CRITICAL   0x00    // sketch only, never masked by the core
+#define INT_PRIORITY_HIGH       0x20    // sketch only, never masked by the core
+#define INT_PRIORITY_SERVO      0x40    // pulse edges, jitter shows as servo twitch
+#define INT_PRIORITY_GPIO       0x60    // attachInterrupt()
+#define INT_PRIORITY_SYSTICK    0x80    // millis(), SysTick callbacks
+#define INT_PRIORITY_UART       0xA0
+#define INT_PRIORITY_SSI        0xA0
+#define INT_PRIORITY_I2C        0xA0
+#define INT_PRIORITY_TONE       0xA0
+#define INT_PRIORITY_ETHERNET   0xC0    // lwIP, also runs the lwIP timers
+#define INT_PRIORITY_LOWEST     0xE0
+
+// Masks every interrupt owned by the core and its libraries
+#define INT_PRIORITY_CORE       INT_PRIORITY_SERVO
+
+typedef struct {
+	uint32_t cycles;        // longest window seen
+	const void *site;       // return address inside the function that opened it
+	uint8_t level;          // BASEPRI level, 0 for noInterrupts()
+} CriticalStats;
+
+//
+// Raise BASEPRI to level unless it already masks more. The write is
+// bracketed by PRIMASK to work around Cortex-M4 r0p1 erratum 837070,
+// where an interrupt could still be taken just after raising BASEPRI.
+//
+static inline __attribute__((always_inline)) uint32_t criticalRaise(uint32_t level)
+{
+	uint32_t old, primask;
+	__asm volatile ("mrs %0, basepri\n"
+			"mrs %1, primask\n"
+			"cpsid i\n"
+			"msr basepri_max, %2\n"
+			"msr primask, %1" : "=&r" (old), "=&r" (primask) : "r" (level) : "memory");
+	return old;
+}
+
+static inline __attribute__((always_inline)) void criticalRestore(uint32_t old)
+{
+	__asm volatile ("msr basepri, %0" :: "r" (old) : "memory");
+}
+
+#ifdef ENERGIA_CRITICAL_TRACE
+uint32_t criticalTraceEnter(uint32_t level);
+void criticalTraceExit(uint32_t old);
+uint32_t criticalTraceNoInterrupts(void);
+void criticalTraceInterrupts(void);
+
+#define criticalEnter(level)    criticalTraceEnter(level)
+#define criticalExit(old)       criticalTraceExit(old)
+#else
+#define criticalEnter(level)    criticalRaise(level)
+#define criticalExit(old)       criticalRestore(old)
+#endif
+
+// Longest window so far, all zero when ENERGIA_CRITICAL_TRACE is not set
+void criticalStats(CriticalStats *stats);
+void criticalStatsReset(void);
+
+#ifdef __cplusplus
+} // extern "C"
+
+class CriticalSection {
+public:
+	explicit CriticalSection(uint32_t level = INT_PRIORITY_CORE) : saved(criticalEnter(level)) {}
+	~CriticalSection() { criticalExit(saved); }
+
+private:
+	CriticalSection(const CriticalSection &);
+	CriticalSection &operator=(const CriticalSection &);
+	uint32_t saved;
+};
+
+#define CRITICAL_CONCAT2(a, b)  a##b
+#define CRITICAL_CONCAT(a, b)   CRITICAL_CONCAT2(a, b)
+#define CRITICAL_SECTION(level) CriticalSection CRITICAL_CONCAT(criticalSection, __LINE__)(level)
+#endif
+
+#endif
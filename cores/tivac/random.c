@@ -73,15 +73,114 @@ long random_r(unsigned long *ctx)
     return (do_random(ctx));
 }
 
-static unsigned long next = 1;
+/*
+ * xoshiro128** by David Blackman and Sebastiano Vigna, public domain.
+ * Seeds are expanded to the 128 bit state with splitmix64.
+ */
+#include <stdint.h>
+#include <string.h>
+#include "WRandom.h"
+
+static inline uint32_t rotl(uint32_t x, int k)
+{
+    return (x << k) | (x >> (32 - k));
+}
+
+static inline uint64_t splitmix64(uint64_t *x)
+{
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+void randomStateSeed(RandomState *state, uint64_t seed)
+{
+    uint64_t a = splitmix64(&seed);
+    uint64_t b = splitmix64(&seed);
+
+    state->s[0] = (uint32_t)a;
+    state->s[1] = (uint32_t)(a >> 32);
+    state->s[2] = (uint32_t)b;
+    state->s[3] = (uint32_t)(b >> 32);
+}
+
+uint32_t randomStateNext(RandomState *state)
+{
+    uint32_t *s = state->s;
+    uint32_t result = rotl(s[1] * 5, 7) * 9;
+    uint32_t t = s[1] << 9;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 11);
+
+    return result;
+}
+
+/*
+ * Lemire, "Fast random integer generation in an interval", 2019: the high
+ * word of a 32x32 multiply, redrawn in the rare case the low word shows
+ * the result would be biased.
+ */
+uint32_t randomStateRange(RandomState *state, uint32_t range)
+{
+    uint64_t m = (uint64_t)randomStateNext(state) * range;
+    uint32_t low = (uint32_t)m;
+
+    if (low < range) {
+        uint32_t threshold = -range % range;
+        while (low < threshold) {
+            m = (uint64_t)randomStateNext(state) * range;
+            low = (uint32_t)m;
+        }
+    }
+    return (uint32_t)(m >> 32);
+}
+
+void randomStateBytes(RandomState *state, void *buf, size_t n)
+{
+    uint8_t *p = (uint8_t *)buf;
+    uint32_t r;
+
+    for (; n >= 4; n -= 4, p += 4) {
+        r = randomStateNext(state);
+        memcpy(p, &r, 4);
+    }
+    if (n) {
+        r = randomStateNext(state);
+        memcpy(p, &r, n);
+    }
+}
+
+/* randomStateSeed(&global, 1), the sequence is the same on every boot */
+static RandomState global = {{ 0x89025cc1, 0x910a2dec, 0x658eec67, 0xbeeb8da1 }};
 
 long random(void)
 {
-    return (do_random(&next));
+    return (randomStateNext(&global) >> 1);
 }
 
 void srandom(unsigned seed)
 {
-    next = seed;
+    randomStateSeed(&global, seed);
+}
+
+void randomSeed64(uint64_t seed)
+{
+    randomStateSeed(&global, seed);
+}
+
+uint32_t randomRange(uint32_t range)
+{
+    return randomStateRange(&global, range);
+}
+
+void randomBytes(void *buf, size_t n)
+{
+    randomStateBytes(&global, buf, n);
 }
 
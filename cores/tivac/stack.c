@@ -0,0 +1,188 @@
+/*
+ ************************************************************************
+ *	stack.c
+ *
+ *	Arduino core files for ARM Cortex-M4F: Tiva-C and Stellaris
+ *		Copyright (c) 2016 Energia. All right reserved.
+ *
+ ***********************************************************************
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "Energia.h"
+#include "stack.h"
+
+extern char end asm ("end");    /* first ram address after bss and data */
+extern unsigned _estack;
+
+typedef struct {
+	const char *name;
+	uint32_t *base;
+	size_t size;
+	uint8_t reported;
+} StackInfo;
+
+static StackInfo stacks[STACK_MAX_REGISTERED];
+static uint8_t mainReported;
+
+static StackCheckCallback checkCallback;
+static size_t checkMargin;
+static uint32_t checkPeriod;
+static uint32_t checkElapsed;
+static uint8_t tickRegistered;
+
+static inline uint32_t *alignUp(void *p)
+{
+	return (uint32_t *)(((uintptr_t)p + 3) & ~3);
+}
+
+//
+// Called from ResetISR before any interrupt is enabled, so everything
+// below the current stack pointer is free.
+//
+void stackPaint(void)
+{
+	uint32_t *p = alignUp(&end);
+	uint32_t *sp;
+
+	__asm volatile ("mov %0, sp" : "=r" (sp));
+	while (p < sp)
+		*p++ = STACK_PAINT;
+}
+
+static void paint(uint32_t *from, uint32_t *to)
+{
+	while (from < to)
+		*from++ = STACK_PAINT;
+}
+
+// Bytes above the lowest overwritten word of [bottom, top)
+static size_t used(uint32_t *bottom, uint32_t *top)
+{
+	uint32_t *p = bottom;
+
+	while (p < top && *p == STACK_PAINT)
+		p++;
+	return (char *)top - (char *)p;
+}
+
+// True when a word in the lowest margin bytes of [bottom, top) was written
+static int touched(uint32_t *bottom, uint32_t *top, size_t margin)
+{
+	uint32_t *limit = bottom + margin / 4;
+
+	if (limit > top)
+		limit = top;
+	while (bottom < limit) {
+		if (*bottom++ != STACK_PAINT)
+			return 1;
+	}
+	return 0;
+}
+
+size_t stackHighWater(void)
+{
+	return used(alignUp(heapTop()), (uint32_t *)&_estack);
+}
+
+size_t stackSize(void)
+{
+	return (char *)&_estack - (char *)alignUp(heapTop());
+}
+
+int stackRegister(const char *name, void *base, size_t size)
+{
+	int i;
+
+	for (i = 0; i < STACK_MAX_REGISTERED; i++) {
+		if (!stacks[i].base) {
+			stacks[i].name = name;
+			stacks[i].size = size & ~3;
+			stacks[i].reported = 0;
+			paint(alignUp(base), alignUp(base) + stacks[i].size / 4);
+			stacks[i].base = alignUp(base);
+			return i;
+		}
+	}
+	return -1;
+}
+
+void stackUnregister(int id)
+{
+	if (id >= 0 && id < STACK_MAX_REGISTERED)
+		stacks[id].base = NULL;
+}
+
+size_t stackHighWaterOf(int id)
+{
+	StackInfo *s;
+
+	if (id < 0 || id >= STACK_MAX_REGISTERED || !stacks[id].base)
+		return 0;
+	s = &stacks[id];
+	return used(s->base, s->base + s->size / 4);
+}
+
+//
+// Only the lowest margin bytes of each stack are examined, which keeps the
+// time spent in the SysTick handler small and bounded.
+//
+static void stackCheckTick(uint32_t ms)
+{
+	uint32_t *bottom, *top;
+	int i;
+
+	if (!checkCallback)
+		return;
+	checkElapsed += ms;
+	if (checkElapsed < checkPeriod)
+		return;
+	checkElapsed = 0;
+
+	bottom = alignUp(heapTop());
+	top = (uint32_t *)&_estack;
+	if (!mainReported && touched(bottom, top, checkMargin)) {
+		mainReported = 1;
+		checkCallback("main", used(bottom, top), (char *)top - (char *)bottom);
+	}
+
+	for (i = 0; i < STACK_MAX_REGISTERED; i++) {
+		StackInfo *s = &stacks[i];
+		if (!s->base || s->reported)
+			continue;
+		if (touched(s->base, s->base + s->size / 4, checkMargin)) {
+			s->reported = 1;
+			checkCallback(s->name, stackHighWaterOf(i), s->size);
+		}
+	}
+}
+
+void stackCheckBegin(size_t margin, uint32_t periodMs, StackCheckCallback callback)
+{
+	checkMargin = margin;
+	checkPeriod = periodMs;
+	checkElapsed = 0;
+	checkCallback = callback;
+
+	if (!tickRegistered) {
+		registerSysTickCb(stackCheckTick);
+		tickRegistered = 1;
+	}
+}
+
+void stackCheckEnd(void)
+{
+	checkCallback = NULL;
+}
@@ -0,0 +1,73 @@
+/*
+ ************************************************************************
+ *	stack.h
+ *
+ *	Arduino core files for ARM Cortex-M4F: Tiva-C and Stellaris
+ *		Copyright (c) 2016 Energia. All right reserved.
+ *
+ *	Stack usage measurement. ResetISR fills the free RAM between the end
+ *	of bss and the initial stack pointer with STACK_PAINT; the deepest
+ *	overwritten word gives the most stack a program ever used. Additional
+ *	stacks (task or coroutine stacks) can be registered and are measured
+ *	the same way.
+ *
+ ***********************************************************************
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef stack_h
+#define stack_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#define STACK_PAINT     0xC5C5C5C5
+
+// Number of task stacks that can be registered besides the main stack
+#ifndef STACK_MAX_REGISTERED
+#define STACK_MAX_REGISTERED 4
+#endif
+
+// Called with the stack name, the most bytes it ever used and its size.
+typedef void (*StackCheckCallback)(const char *name, size_t used, size_t size);
+
+void stackPaint(void);                  // called from ResetISR
+
+// Most bytes ever used by the main stack
+size_t stackHighWater(void);
+// Bytes the main stack may currently grow to, up to the heap
+size_t stackSize(void);
+
+// Paint and track a task stack, base is its lowest address. Returns the
+// stack id or -1 when all slots are taken.
+int stackRegister(const char *name, void *base, size_t size);
+void stackUnregister(int id);
+size_t stackHighWaterOf(int id);
+
+// Check all stacks every periodMs from the SysTick handler and call
+// callback once for each stack whose unused part fell below margin bytes.
+// The callback runs in interrupt context.
+void stackCheckBegin(size_t margin, uint32_t periodMs, StackCheckCallback callback);
+void stackCheckEnd(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
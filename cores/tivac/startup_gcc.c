@@ -38,6 +38,11 @@
 #include "Energia.h"
 #include "inc/hw_types.h"
 #include "inc/hw_nvic.h"
+#ifdef ENERGIA_BOOT_UDMA
+#include "driverlib/rom_map.h"
+#include "driverlib/sysctl.h"
+#include "driverlib/udma.h"
+#endif
 #include <stdio.h>
 #include <stdarg.h>
 #include <sys/types.h>
@@ -51,6 +56,7 @@ void ResetISR(void);
 static void NmiSR(void);
 static void FaultISR(void);
 static void IntDefaultHandler(void);
+extern void CrashHandler(void);
 
 //*****************************************************************************
 //
@@ -93,7 +99,19 @@ __attribute__((weak)) void UARTIntHandler5(void) {}
 __attribute__((weak)) void UARTIntHandler6(void) {}
 __attribute__((weak)) void UARTIntHandler7(void) {}
 __attribute__((weak)) void ToneIntHandler(void) {}
-__attribute__((weak)) void I2CIntHandler(void) {}
+// Wire module n, see g_uli2cInt in Wire.cpp
+__attribute__((weak)) void I2CIntHandler0(void) {}
+__attribute__((weak)) void I2CIntHandler1(void) {}
+__attribute__((weak)) void I2CIntHandler2(void) {}
+__attribute__((weak)) void I2CIntHandler3(void) {}
+__attribute__((weak)) void SSIIntHandler(void) {}
+__attribute__((weak)) void SSIIntHandler1(void) {}
+__attribute__((weak)) void SSIIntHandler2(void) {}
+__attribute__((weak)) void SSIIntHandler3(void) {}
+__attribute__((weak, naked)) void MPUFaultHandler(void)  // see mpu_guard.c
+{
+    __asm volatile ("    b       CrashHandler\n");
+}
 //*****************************************************************************
 // System stack start determined by ldscript, normally highest ram address
 //*****************************************************************************
@@ -114,7 +132,7 @@ void (* const g_pfnVectors[])(void) =
     ResetISR,                               // The reset handler
     NmiSR,                                  // The NMI handler
     FaultISR,                               // The hard fault handler
-    IntDefaultHandler,                      // The MPU fault handler
+    MPUFaultHandler,                        // The MPU fault handler
     IntDefaultHandler,                      // The bus fault handler
     IntDefaultHandler,                      // The usage fault handler
     0,                                      // Reserved
@@ -133,8 +151,8 @@ void (* const g_pfnVectors[])(void) =
     GPIOEIntHandler,                        // GPIO Port E
     UARTIntHandler,                         // UART0 Rx and Tx
     UARTIntHandler1,                        // UART1 Rx and Tx
-    IntDefaultHandler,                      // SSI0 Rx and Tx
-    I2CIntHandler,                          // I2C0 Master and Slave
+    SSIIntHandler,                          // SSI0 Rx and Tx
+    I2CIntHandler0,                         // I2C0 Master and Slave
     IntDefaultHandler,                      // PWM Fault
     IntDefaultHandler,                      // PWM Generator 0
     IntDefaultHandler,                      // PWM Generator 1
@@ -160,10 +178,10 @@ void (* const g_pfnVectors[])(void) =
     GPIOGIntHandler,                        // GPIO Port G
     GPIOHIntHandler,                        // GPIO Port H
     UARTIntHandler2,                        // UART2 Rx and Tx
-    IntDefaultHandler,                      // SSI1 Rx and Tx
+    SSIIntHandler1,                         // SSI1 Rx and Tx
     IntDefaultHandler,                      // Timer 3 subtimer A
     IntDefaultHandler,                      // Timer 3 subtimer B
-    I2CIntHandler,                          // I2C1 Master and Slave
+    I2CIntHandler1,                         // I2C1 Master and Slave
     IntDefaultHandler,                      // Quadrature Encoder 1
     IntDefaultHandler,                      // CAN0
     IntDefaultHandler,                      // CAN1
@@ -183,8 +201,8 @@ void (* const g_pfnVectors[])(void) =
     GPIOJIntHandler,                        // GPIO Port J
     GPIOKIntHandler,                        // GPIO Port K
     GPIOLIntHandler,                        // GPIO Port L
-    IntDefaultHandler,                      // SSI2 Rx and Tx
-    IntDefaultHandler,                      // SSI3 Rx and Tx
+    SSIIntHandler2,                         // SSI2 Rx and Tx
+    SSIIntHandler3,                         // SSI3 Rx and Tx
     UARTIntHandler3,                        // UART3 Rx and Tx
     UARTIntHandler4,                        // UART4 Rx and Tx
     UARTIntHandler5,                        // UART5 Rx and Tx
@@ -194,8 +212,8 @@ void (* const g_pfnVectors[])(void) =
     0,                                      // Reserved
     0,                                      // Reserved
     0,                                      // Reserved
-    I2CIntHandler,                          // I2C2 Master and Slave
-    I2CIntHandler,                          // I2C3 Master and Slave
+    I2CIntHandler2,                         // I2C2 Master and Slave
+    I2CIntHandler3,                         // I2C3 Master and Slave
     ToneIntHandler,                         // Timer 4 subtimer A
     IntDefaultHandler,                      // Timer 4 subtimer B
     0,                                      // Reserved
@@ -274,7 +292,7 @@ void (* const g_pfnVectors[])(void) =
     ResetISR,                               // The reset handler
     NmiSR,                                  // The NMI handler
     FaultISR,                               // The hard fault handler
-    IntDefaultHandler,                      // The MPU fault handler
+    MPUFaultHandler,                        // The MPU fault handler
     IntDefaultHandler,                      // The bus fault handler
     IntDefaultHandler,                      // The usage fault handler
     0,                                      // Reserved
@@ -293,8 +311,8 @@ void (* const g_pfnVectors[])(void) =
     GPIOEIntHandler,                        // GPIO Port E
     UARTIntHandler,                         // UART0 Rx and Tx
     UARTIntHandler1,                        // UART1 Rx and Tx
-    IntDefaultHandler,                      // SSI0 Rx and Tx
-    IntDefaultHandler,                      // I2C0 Master and Slave
+    SSIIntHandler,                          // SSI0 Rx and Tx
+    I2CIntHandler0,                         // I2C0 Master and Slave
     IntDefaultHandler,                      // PWM Fault
     IntDefaultHandler,                      // PWM Generator 0
     IntDefaultHandler,                      // PWM Generator 1
@@ -320,7 +338,7 @@ void (* const g_pfnVectors[])(void) =
     GPIOGIntHandler,                        // GPIO Port G
     GPIOHIntHandler,                        // GPIO Port H
     UARTIntHandler2,                        // UART2 Rx and Tx
-    IntDefaultHandler,                      // SSI1 Rx and Tx
+    SSIIntHandler1,                         // SSI1 Rx and Tx
     IntDefaultHandler,                      // Timer 3 subtimer A
     IntDefaultHandler,                      // Timer 3 subtimer B
     IntDefaultHandler,                      // I2C1 Master and Slave
@@ -340,15 +358,15 @@ void (* const g_pfnVectors[])(void) =
     GPIOJIntHandler,                        // GPIO Port J
     GPIOKIntHandler,                        // GPIO Port K
     GPIOLIntHandler,                        // GPIO Port L
-    IntDefaultHandler,                      // SSI2 Rx and Tx
-    IntDefaultHandler,                      // SSI3 Rx and Tx
+    SSIIntHandler2,                         // SSI2 Rx and Tx
+    SSIIntHandler3,                         // SSI3 Rx and Tx
     UARTIntHandler3,                        // UART3 Rx and Tx
     UARTIntHandler4,                        // UART4 Rx and Tx
     UARTIntHandler5,                        // UART5 Rx and Tx
     UARTIntHandler6,                        // UART6 Rx and Tx
     UARTIntHandler7,                        // UART7 Rx and Tx
-    IntDefaultHandler,                      // I2C2 Master and Slave
-    IntDefaultHandler,                      // I2C3 Master and Slave
+    I2CIntHandler1,                         // I2C2 Master and Slave, Wire1
+    I2CIntHandler3,                         // I2C3 Master and Slave
     ToneIntHandler,                         // Timer 4 subtimer A
     IntDefaultHandler,                      // Timer 4 subtimer B
     IntDefaultHandler,                      // Timer 5 subtimer A
@@ -356,7 +374,7 @@ void (* const g_pfnVectors[])(void) =
     IntDefaultHandler,                      // FPU
     0,                                      // Reserved
     0,                                      // Reserved
-    IntDefaultHandler,                      // I2C4 Master and Slave
+    I2CIntHandler2,                         // I2C4 Master and Slave, Wire2
     IntDefaultHandler,                      // I2C5 Master and Slave
     GPIOMIntHandler,                        // GPIO Port M
     GPIONIntHandler,                        // GPIO Port N
@@ -419,6 +437,72 @@ extern void (*__init_array_end[])(void);
 extern void _init(void);
 
 
+uint32_t bootStamps[BOOT_PHASES] NOINIT;
+
+#ifdef ENERGIA_BOOT_UDMA
+//*****************************************************************************
+//
+// uDMA software channel transfers for the C runtime init. The control table
+// lives in .noinit since it is in use while .bss is being cleared.
+//
+//*****************************************************************************
+static uint8_t bootDMATable[1024] __attribute__((aligned(1024))) NOINIT;
+static const uint32_t bootZero = 0;
+
+static void bootDMAInit(void) {
+    MAP_SysCtlPeripheralEnable(SYSCTL_PERIPH_UDMA);
+    while (!MAP_SysCtlPeripheralReady(SYSCTL_PERIPH_UDMA)) ;
+    MAP_uDMAEnable();
+    MAP_uDMAControlBaseSet(bootDMATable);
+}
+
+static void bootDMA(void *dst, const void *src, uint32_t bytes, uint32_t srcInc) {
+    uint32_t words = bytes / 4;
+    uint32_t n;
+
+    while (words) {
+        n = words > 1024 ? 1024 : words;   // longest auto mode transfer
+        MAP_uDMAChannelControlSet(UDMA_CHANNEL_SW | UDMA_PRI_SELECT,
+                                  UDMA_SIZE_32 | srcInc | UDMA_DST_INC_32 |
+                                  UDMA_ARB_1024);
+        MAP_uDMAChannelTransferSet(UDMA_CHANNEL_SW | UDMA_PRI_SELECT,
+                                   UDMA_MODE_AUTO, (void *)src, dst, n);
+        MAP_uDMAChannelEnable(UDMA_CHANNEL_SW);
+        MAP_uDMAChannelRequest(UDMA_CHANNEL_SW);
+        while (MAP_uDMAChannelIsEnabled(UDMA_CHANNEL_SW)) ;
+
+        dst = (uint32_t *)dst + n;
+        if (srcInc != UDMA_SRC_INC_NONE)
+            src = (const uint32_t *)src + n;
+        words -= n;
+    }
+}
+
+static void bootDMADone(void) {
+    MAP_uDMADisable();
+    MAP_SysCtlPeripheralDisable(SYSCTL_PERIPH_UDMA);
+}
+#endif
+
+//*****************************************************************************
+//
+// Boot time accounting, the stamps are raw DWT cycle counts. Everything up
+// to BOOT_CLOCK ran on the 16MHz PIOSC, the rest at F_CPU.
+//
+//*****************************************************************************
+uint32_t bootCycles(unsigned phase) {
+    if (phase >= BOOT_PHASES)
+        return 0;
+    return phase ? bootStamps[phase] - bootStamps[phase - 1] : bootStamps[0];
+}
+
+uint32_t bootMicros(unsigned phase) {
+    if (phase >= BOOT_PHASES)
+        return 0;
+    return bootStamps[BOOT_CLOCK] / 16 +
+           (bootStamps[phase] - bootStamps[BOOT_CLOCK]) / (F_CPU / 1000000UL);
+}
+
 //*****************************************************************************
 //
 // This is the code that gets called when the processor first starts execution
@@ -430,31 +514,86 @@ extern void _init(void);
 //
 //*****************************************************************************
 void ResetISR(void) {
-    unsigned long *pulSrc, *pulDest;
     unsigned i, cnt;
 
     //
-    // Copy the data segment initializers from flash to SRAM.
+    // Start the DWT cycle counter for the boot stamps (see boot.h)
     //
-    pulSrc = &_etext;
-    for (pulDest = &_data; pulDest < &_edata;) {
-        *pulDest++ = *pulSrc++;
-    }
+    HWREG(BOOT_DEMCR) |= BOOT_DEMCR_TRCENA;
+    HWREG(BOOT_DWT_CYCCNT) = 0;
+    HWREG(BOOT_DWT_CTRL) |= BOOT_DWT_CYCCNTENA;
+
+    //
+    // Switch to the PLL before touching RAM, the copy and fill loops below
+    // then run at 80/120MHz instead of on the 16MHz PIOSC.
+    //
+    clockInit();
+    bootStamp(BOOT_CLOCK);
+
+#ifdef ENERGIA_BOOT_UDMA
+    bootDMAInit();
+    bootDMA(&_data, &_etext, (&_edata - &_data) * 4, UDMA_SRC_INC_32);
+    bootStamp(BOOT_DATA);
+    bootDMA(&_bss, &bootZero, (&_ebss - &_bss) * 4, UDMA_SRC_INC_NONE);
+    bootDMADone();
+#else
+    //
+    // Copy the data segment initializers from flash to SRAM, four words
+    // at a time.
+    //
+    __asm volatile (
+            "    ldr     r0, =_data\n"
+            "    ldr     r1, =_edata\n"
+            "    ldr     r2, =_etext\n"
+            "1:\n"
+            "    sub     r3, r1, r0\n"
+            "    cmp     r3, #16\n"
+            "    blt     2f\n"
+            "    ldmia   r2!, {r3, r4, r5, r6}\n"
+            "    stmia   r0!, {r3, r4, r5, r6}\n"
+            "    b       1b\n"
+            "2:\n"
+            "    cmp     r0, r1\n"
+            "    ittt    lt\n"
+            "    ldrlt   r3, [r2], #4\n"
+            "    strlt   r3, [r0], #4\n"
+            "    blt     2b\n"
+            ::: "r0", "r1", "r2", "r3", "r4", "r5", "r6", "memory"
+    );
+    bootStamp(BOOT_DATA);
 
     //
     // Zero fill the bss segment.
     //
-    __asm(  "    ldr     r0, =_bss\n"
+    __asm volatile (
+            "    ldr     r0, =_bss\n"
             "    ldr     r1, =_ebss\n"
             "    mov     r2, #0\n"
-            "    .thumb_func\n"
+            "    mov     r3, #0\n"
+            "    mov     r4, #0\n"
+            "    mov     r5, #0\n"
             "1:\n"
+            "    sub     r6, r1, r0\n"
+            "    cmp     r6, #16\n"
+            "    blt     2f\n"
+            "    stmia   r0!, {r2, r3, r4, r5}\n"
+            "    b       1b\n"
+            "2:\n"
             "    cmp     r0, r1\n"
-            "    it      lt\n"
+            "    itt     lt\n"
             "    strlt   r2, [r0], #4\n"
-            "    blt     1b"
+            "    blt     2b\n"
+            ::: "r0", "r1", "r2", "r3", "r4", "r5", "r6", "memory"
     );
+#endif
     (void)_bss; (void)_ebss; // get rid of unused warnings
+    bootStamp(BOOT_BSS);
+
+    //
+    // Fill the free RAM with a pattern for stackHighWater()
+    //
+    stackPaint();
+    bootStamp(BOOT_PAINT);
 
     //
     // Enable the floating-point unit before calling c++ ctors
@@ -472,10 +611,12 @@ void ResetISR(void) {
         __preinit_array_start[i]();
 
     _init();
+    bootStamp(BOOT_INIT);
 
     cnt = __init_array_end - __init_array_start;
     for (i = 0; i < cnt; i++)
         __init_array_start[i]();
+    bootStamp(BOOT_CTORS);
 
     //
     // call 'C' entry point, Energia never returns from main
@@ -485,50 +626,62 @@ void ResetISR(void) {
 
 //*****************************************************************************
 //
-// This is the code that gets called when the processor receives a NMI.  This
-// simply enters an infinite loop, preserving the system state for examination
-// by a debugger.
+// This is the code that gets called when the processor receives a NMI.  The
+// state is recorded in a crash record (see crash.cpp) and the part is reset,
+// or halted at a breakpoint when a debugger is attached.
 //
 //*****************************************************************************
-static void NmiSR(void) {
-    //
-    // Enter an infinite loop.
-    //
-    while (1) {
-        ; // trap NMI
-    }
+__attribute__((naked)) static void NmiSR(void) {
+    __asm volatile ("    b       CrashHandler\n");
 }
 
 //*****************************************************************************
 //
 // This is the code that gets called when the processor receives a fault
-// interrupt.  This simply enters an infinite loop, preserving the system state
-// for examination by a debugger.
+// interrupt.  The state is recorded in a crash record (see crash.cpp) and the
+// part is reset, or halted at a breakpoint when a debugger is attached.
 //
 //*****************************************************************************
-static void FaultISR(void) {
-    //
-    // Enter an infinite loop.
-    //
-    while (1) {
-        ; // trap FAULT
-    }
+__attribute__((naked)) static void FaultISR(void) {
+    __asm volatile ("    b       CrashHandler\n");
 }
 
 //*****************************************************************************
 //
 // This is the code that gets called when the processor receives an unexpected
-// interrupt.  This simply enters an infinite loop, preserving the system state
-// for examination by a debugger.
+// interrupt.  It is handled like a fault, the crash record shows which
+// interrupt had no handler.
 //
 //*****************************************************************************
-static void IntDefaultHandler(void) {
-    //
-    // Go into an infinite loop.
-    //
-    while (1) {
-        ; // trap any handler not defined
-    }
+__attribute__((naked)) static void IntDefaultHandler(void) {
+    __asm volatile ("    b       CrashHandler\n");
+}
+
+//*****************************************************************************
+//
+// Copy the vector table to SRAM and point VTOR at it. VTOR needs the table
+// aligned to its size rounded up to a power of two. Does nothing when the
+// table was already moved, e.g. by IntRegister().
+//
+// The table gets an input section of its own inside .noinit, so that
+// --gc-sections drops it, and its 1 KB alignment, unless vectorTableToRam()
+// is linked in.
+//
+//*****************************************************************************
+#define VECTOR_COUNT    (sizeof(g_pfnVectors) / sizeof(g_pfnVectors[0]))
+
+static void (*ramVectors[VECTOR_COUNT])(void)
+    __attribute__((section(".noinit.ramVectors"), aligned(1024)));
+
+void vectorTableToRam(void) {
+    uint32_t i;
+
+    if (HWREG(NVIC_VTABLE) >= 0x20000000)
+        return;
+
+    for (i = 0; i < VECTOR_COUNT; i++)
+        ramVectors[i] = g_pfnVectors[i];
+    HWREG(NVIC_VTABLE) = (uint32_t)ramVectors;
 }
 
 /* syscall stuff */
@@ -539,6 +692,9 @@ void *__dso_handle = 0;
  */
 typedef char *caddr_t;
 
+uint32_t heap_sbrk_failures;    /* reported by heapStats() */
+char *heap_sbrk_limit;          /* set by heapSetLimit() */
+
 caddr_t _sbrk (int incr)
 {
     double current_sp;
@@ -554,11 +710,13 @@ caddr_t _sbrk (int incr)
 
     // simplistic approach to prevent the heap from corrupting the stack
     // TBD: review for alternatives
-    if ( heap_end + incr < (caddr_t)&current_sp ) {
+    if ( heap_end + incr < (caddr_t)&current_sp &&
+         (heap_sbrk_limit == NULL || heap_end + incr <= heap_sbrk_limit) ) {
         heap_end += incr;
         return (caddr_t) prev_heap_end;
     }
     else {
+        heap_sbrk_failures++;
         return NULL;
     }
 }
@@ -37,6 +37,11 @@
 #include "driverlib/timer.h"
 
 static void (*SysTickCbFuncs[8])(uint32_t ui32TimeMS);
+static void (*CpuFrequencyCbFuncs[8])(uint32_t hz, uint8_t phase);
+static void (*LoopCbFuncs[4])(void);
+
+// In .data, so it is valid once ResetISR has copied it after clockInit()
+static uint32_t cpuHz = F_CPU;
 
 #define SYSTICKHZ               1000UL
 #define SYSTICKMS               (1000UL / SYSTICKHZ)
@@ -48,8 +53,12 @@ static inline void SysTickMode_Run(void);
 static void CPUwfi_safe(void);
 
 static volatile unsigned long milliseconds = 0;
-#define SYSTICK_INT_PRIORITY    0x80
-void timerInit()
+
+//
+// Called from ResetISR before .data and .bss are initialized, so it must not
+// use any global variables.
+//
+void clockInit()
 {
 #ifdef TARGET_IS_BLIZZARD_RB1
     //
@@ -63,14 +72,121 @@ void timerInit()
     //
     MAP_SysCtlClockFreqSet((SYSCTL_XTAL_25MHZ|SYSCTL_OSC_MAIN|SYSCTL_USE_PLL|SYSCTL_CFG_VCO_480), F_CPU);
 #endif
+}
+
+#ifdef TARGET_IS_BLIZZARD_RB1
+//
+// System clocks reachable from the 16MHz crystal, fastest first
+//
+static const struct {
+    uint32_t hz;
+    uint32_t config;
+} cpuClocks[] = {
+    { 80000000, SYSCTL_SYSDIV_2_5 | SYSCTL_USE_PLL },
+    { 66666666, SYSCTL_SYSDIV_3 | SYSCTL_USE_PLL },
+    { 50000000, SYSCTL_SYSDIV_4 | SYSCTL_USE_PLL },
+    { 40000000, SYSCTL_SYSDIV_5 | SYSCTL_USE_PLL },
+    { 20000000, SYSCTL_SYSDIV_10 | SYSCTL_USE_PLL },
+    { 16000000, SYSCTL_SYSDIV_1 | SYSCTL_USE_OSC },
+    {  8000000, SYSCTL_SYSDIV_2 | SYSCTL_USE_OSC },
+    {  4000000, SYSCTL_SYSDIV_4 | SYSCTL_USE_OSC },
+};
+#else
+#define PLL_OUT_HZ  240000000   // 480MHz VCO after the fixed divide by 2
+#endif
+
+uint32_t cpuFrequency(void)
+{
+    return cpuHz;
+}
+
+//
+// Switch the system clock at run time. Registered callbacks are called
+// with CPU_FREQ_PRE before the switch, with interrupts enabled so they can
+// drain transmitters, and with CPU_FREQ_POST after it, with interrupts
+// disabled so nothing runs on the old timing in between. Both get the
+// frequency the clock tree will actually run at. Returns that frequency,
+// the nearest one at or below hz the clock tree can make, or 0 when hz is
+// out of range and nothing was changed. The interrupt mask is restored
+// afterwards; called with interrupts disabled, the PRE callbacks can not
+// rely on interrupts to drain.
+//
+uint32_t setCpuFrequency(uint32_t hz)
+{
+    uint32_t newHz;
+    bool wasDisabled;
+    uint8_t i;
+
+#ifdef TARGET_IS_BLIZZARD_RB1
+    for (i = 0; i < sizeof(cpuClocks) / sizeof(cpuClocks[0]); i++) {
+        if (cpuClocks[i].hz <= hz)
+            break;
+    }
+    if (i == sizeof(cpuClocks) / sizeof(cpuClocks[0]))
+        return 0;
+    newHz = cpuClocks[i].hz;
+#else
+    if (!hz)
+        return 0;
+    if (hz > F_CPU)
+        hz = F_CPU;
+    // SysCtlClockFreqSet() uses the smallest divider of the 240MHz PLL
+    // output that keeps the clock at or below hz
+    newHz = PLL_OUT_HZ / ((PLL_OUT_HZ + hz - 1) / hz);
+#endif
+
+    for (i = 0; i < 8; i++) {
+        if (CpuFrequencyCbFuncs[i])
+            CpuFrequencyCbFuncs[i](newHz, CPU_FREQ_PRE);
+    }
+
+    wasDisabled = MAP_IntMasterDisable();
+#ifdef TARGET_IS_BLIZZARD_RB1
+    for (i = 0; cpuClocks[i].hz != newHz; i++)
+        ;
+    MAP_SysCtlClockSet(cpuClocks[i].config | SYSCTL_XTAL_16MHZ | SYSCTL_OSC_MAIN);
+#else
+    newHz = MAP_SysCtlClockFreqSet((SYSCTL_XTAL_25MHZ|SYSCTL_OSC_MAIN|SYSCTL_USE_PLL|SYSCTL_CFG_VCO_480), hz);
+    if (!newHz)
+        newHz = cpuHz;  // rejected, the clock was not touched
+#endif
+    cpuHz = newHz;
+
+    // Restart the current millisecond at the new rate
+    SysTickMode_Run();
+
+    for (i = 0; i < 8; i++) {
+        if (CpuFrequencyCbFuncs[i])
+            CpuFrequencyCbFuncs[i](newHz, CPU_FREQ_POST);
+    }
+    if (!wasDisabled)
+        MAP_IntMasterEnable();
 
+    return newHz;
+}
+
+void registerCpuFrequencyCb(void (*userFunc)(uint32_t, uint8_t))
+{
+    uint8_t i;
+    for (i=0; i<8; i++) {
+        if (CpuFrequencyCbFuncs[i] == userFunc)
+            break;
+        if (!CpuFrequencyCbFuncs[i]) {
+            CpuFrequencyCbFuncs[i] = userFunc;
+            break;
+        }
+    }
+}
+
+void timerInit()
+{
     //
     //  SysTick is used for delay() and delayMicroseconds()
     //
 
-    MAP_SysTickPeriodSet(F_CPU / SYSTICKHZ);
+    MAP_SysTickPeriodSet(cpuHz / SYSTICKHZ);
     MAP_SysTickEnable();
-    MAP_IntPrioritySet(FAULT_SYSTICK, SYSTICK_INT_PRIORITY);
+    MAP_IntPrioritySet(FAULT_SYSTICK, INT_PRIORITY_SYSTICK);
     MAP_SysTickIntEnable();
     MAP_IntMasterEnable();
 
@@ -80,7 +196,15 @@ void timerInit()
 
 unsigned long micros(void)
 {
-	return (milliseconds * 1000) + ( ((F_CPU / SYSTICKHZ) - MAP_SysTickValueGet()) / (F_CPU/1000000));
+	unsigned long ms, ticks;
+
+	// Both from the same millisecond; a tick still pending can only make
+	// the result lag, never jump ahead
+	do {
+		ms = milliseconds;
+		ticks = MAP_SysTickValueGet();
+	} while (ms != milliseconds);
+	return (ms * 1000) + ( ((cpuHz / SYSTICKHZ) - ticks) / (cpuHz/1000000));
 }
 
 unsigned long millis(void)
@@ -99,11 +223,11 @@ void delayMicroseconds(unsigned int us)
 	// 24 bit timer - mask off undefined bits
 	unsigned long startTime = HWREG(NVIC_ST_CURRENT) & NVIC_ST_CURRENT_M;
 
-	unsigned long ticks = (unsigned long)us * (F_CPU/1000000UL);
+	unsigned long ticks = (unsigned long)us * (cpuHz/1000000UL);
 	volatile unsigned long elapsedTime;
 
 	if (ticks > startTime) {
-		ticks = (ticks + (NVIC_ST_CURRENT_M - (unsigned long)F_CPU / SYSTICKHZ)) & NVIC_ST_CURRENT_M;
+		ticks = (ticks + (NVIC_ST_CURRENT_M - cpuHz / SYSTICKHZ)) & NVIC_ST_CURRENT_M;
 	}
 
 	do {
@@ -111,11 +235,42 @@ void delayMicroseconds(unsigned int us)
 	} while(elapsedTime <= ticks);
 }
 
+//
+// millis() only moves while SysTick can be taken: not in an ISR that
+// blocks it, nor with PRIMASK set or BASEPRI at or above its priority
+//
+static boolean sysTickBlocked(void)
+{
+	uint32_t ipsr, primask, basepri;
+
+	__asm volatile ("mrs %0, ipsr" : "=r" (ipsr));
+	__asm volatile ("mrs %0, primask" : "=r" (primask));
+	__asm volatile ("mrs %0, basepri" : "=r" (basepri));
+	return ipsr || primask || (basepri && basepri <= INT_PRIORITY_SYSTICK);
+}
+
+//
+// Waits against micros(), so the loop callbacks run in between without
+// stretching the delay. Where SysTick is blocked nothing runs in between
+// and the SysTick counter is polled instead.
+//
 void delay(uint32_t millis)
 {
-	unsigned long i;
-	for(i=0; i<millis*2; i++){
-		delayMicroseconds(500);
+	unsigned long i, start;
+
+	if (sysTickBlocked()) {
+		for(i=0; i<millis*2; i++)
+			delayMicroseconds(500);
+		return;
+	}
+
+	start = micros();
+	while (millis) {
+		loopCbRun();
+		while (millis && (long)(micros() - start) >= 1000) {
+			millis--;
+			start += 1000;
+		}
 	}
 }
 
@@ -208,6 +363,21 @@ void suspend(void)
 	HWREG(NVIC_SYS_CTRL) &= ~(NVIC_SYS_CTRL_SLEEPDEEP);
 }
 
+boolean loopIdle = false;
+
+void waitForEvent(void)
+{
+	// With PRIMASK set an interrupt that is already pending ends the WFI
+	// at once, so data received after the check is not slept through
+	unsigned long ulInt = MAP_IntMasterDisable();
+
+	if (!serialEventPending)
+		CPUwfi_safe();
+
+	if (!ulInt)
+		MAP_IntMasterEnable();
+}
+
 void registerSysTickCb(void (*userFunc)(uint32_t))
 {
 	uint8_t i;
@@ -219,7 +389,41 @@ void registerSysTickCb(void (*userFunc)(uint32_t))
 	}
 }
 
-void SysTickIntHandler(void)
+void registerLoopCb(void (*userFunc)(void))
+{
+	uint8_t i;
+	for (i=0; i<4; i++) {
+		if(!LoopCbFuncs[i]) {
+			LoopCbFuncs[i] = userFunc;
+			break;
+		}
+	}
+}
+
+//
+// Callbacks that must not run in an interrupt, e.g. because they write to
+// a HardwareSerial that ISRs use as well. Skipped when called from an
+// interrupt (delay() in an ISR) or from a callback that calls delay().
+//
+void loopCbRun(void)
+{
+	static volatile boolean running = false;
+	uint32_t ipsr;
+	uint8_t i;
+
+	__asm volatile ("mrs %0, ipsr" : "=r" (ipsr));
+	if (ipsr || running)
+		return;
+
+	running = true;
+	for (i=0; i<4; i++) {
+		if (LoopCbFuncs[i])
+			LoopCbFuncs[i]();
+	}
+	running = false;
+}
+
+RAMFUNC void SysTickIntHandler(void)
 {
 	milliseconds++;
 
@@ -247,7 +451,7 @@ static inline void SysTickMode_DeepSleepCoarse(void)
 __attribute__((always_inline))
 static inline void SysTickMode_Run(void)
 {
-	HWREG(NVIC_ST_RELOAD) = F_CPU / SYSTICKHZ - 1;
+	HWREG(NVIC_ST_RELOAD) = cpuHz / SYSTICKHZ - 1;
 	HWREG(NVIC_ST_CURRENT) = 0;
 }
 
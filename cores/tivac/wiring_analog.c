@@ -33,6 +33,7 @@
 #include "inc/hw_memmap.h"
 #include "inc/hw_types.h"
 #include "inc/hw_timer.h"
+#include "inc/hw_gpio.h"
 #include "inc/hw_ints.h"
 #include "driverlib/adc.h"
 #include "driverlib/gpio.h"
@@ -100,6 +101,65 @@ void enableTimerPeriph(uint32_t offset) {
 
 #endif
 
+//
+// PWM outputs to set up again for a new clock after setCpuFrequency()
+//
+#define PWM_RETIME_MAX 16
+
+static struct {
+    uint8_t pin;
+    unsigned int freq;      // 0 for a free slot
+    uint32_t analog_res;
+    uint32_t duty;
+} pwmActive[PWM_RETIME_MAX];
+
+static void pwmCpuFrequencyChanged(uint32_t hz, uint8_t phase) {
+    uint8_t i;
+
+    if (phase != CPU_FREQ_POST)
+        return;
+    for (i = 0; i < PWM_RETIME_MAX; i++) {
+        if (!pwmActive[i].freq)
+            continue;
+        // Skip pins that pinMode() has turned back into GPIOs
+        uint8_t pin = pwmActive[i].pin;
+        uint32_t portBase = (uint32_t) portBASERegister(digitalPinToPort(pin));
+        if (HWREG(portBase + GPIO_O_AFSEL) & digitalPinToBitMask(pin))
+            PWMWrite(pin, pwmActive[i].analog_res, pwmActive[i].duty, pwmActive[i].freq);
+        else
+            pwmActive[i].freq = 0;
+    }
+}
+
+static void pwmRemember(uint8_t pin, uint32_t analog_res, uint32_t duty, unsigned int freq) {
+    uint8_t i, slot = PWM_RETIME_MAX;
+
+    for (i = 0; i < PWM_RETIME_MAX; i++) {
+        if (pwmActive[i].freq && pwmActive[i].pin == pin) {
+            slot = i;
+            break;
+        }
+        if (!pwmActive[i].freq && slot == PWM_RETIME_MAX)
+            slot = i;
+    }
+    if (slot == PWM_RETIME_MAX)
+        return;
+    pwmActive[slot].pin = pin;
+    pwmActive[slot].analog_res = analog_res;
+    pwmActive[slot].duty = duty;
+    pwmActive[slot].freq = freq;
+    registerCpuFrequencyCb(pwmCpuFrequencyChanged);
+}
+
+static void pwmForget(uint8_t pin) {
+    uint8_t i;
+
+    for (i = 0; i < PWM_RETIME_MAX; i++) {
+        if (pwmActive[i].pin == pin)
+            pwmActive[i].freq = 0;
+    }
+}
+
 //
 //empty function due to single reference
 //
@@ -107,6 +167,9 @@ void analogReference(uint16_t mode) {
 }
 
 void PWMWrite(uint8_t pin, uint32_t analog_res, uint32_t duty, unsigned int freq) {
+    if (duty == 0 || duty >= analog_res)
+        pwmForget(pin);
+
     if (duty == 0) {
     	pinMode(pin, OUTPUT);
         digitalWrite(pin, LOW);
@@ -126,11 +189,7 @@ void PWMWrite(uint8_t pin, uint32_t analog_res, uint32_t duty, unsigned int freq
 
         if (port == NOT_A_PORT) return; 	// pin on timer?
 
-#ifdef __TM4C1294NCPDT__
-        uint32_t periodPWM = F_CPU/freq;
-#else
-        uint32_t periodPWM = SysCtlClockGet()/freq;
-#endif
+        uint32_t periodPWM = cpuFrequency()/freq;
 
 
         enableTimerPeriph(offset);
@@ -166,6 +225,7 @@ void PWMWrite(uint8_t pin, uint32_t analog_res, uint32_t duty, unsigned int freq
                 (((analog_res-duty)*periodPWM/analog_res) & 0xFFFF0000) >> 16);
         }
         ROM_TimerEnable(timerBase, timerAB);
+        pwmRemember(pin, analog_res, duty, freq);
     }
 }
 void analogWrite(uint8_t pin, int val) {
@@ -34,6 +34,7 @@
 #include "driverlib/rom.h"
 #include "driverlib/gpio.h"
 #include "driverlib/sysctl.h"
+#include "fast_map.h"
 #define GPIO_LOCK_KEY_DD        0x4C4F434B 
 
 void pinMode(uint8_t pin, uint8_t mode)
@@ -76,7 +77,7 @@ int digitalRead(uint8_t pin)
     uint8_t port = digitalPinToPort(pin);
     uint32_t portBase = (uint32_t) portBASERegister(port);
     if (port == NOT_A_PORT) return LOW;
-    if(ROM_GPIOPinRead(portBase, bit)){
+    if(FAST_GPIOPinRead(portBase, bit)){
     	return HIGH;
     }
     return LOW;
@@ -91,5 +92,5 @@ void digitalWrite(uint8_t pin, uint8_t val)
     
     if (port == NOT_A_PORT) return;
 
-    ROM_GPIOPinWrite(portBase, bit, mask);
+    FAST_GPIOPinWrite(portBase, bit, mask);
 }
@@ -0,0 +1,146 @@
+#!/usr/bin/env python
+#
+#  crash_symbolize.py - Symbolize crash records printed by crashPrint()
+#
+#  Reads the text printed by crashPrint() (see cores/tivac/crash.h) and
+#  prints the fault status decoded and the code addresses resolved to
+#  function, file and line against the sketch ELF file.
+#
+#  usage: crash_symbolize.py sketch.elf [crash.txt]
+#
+#  With no input file the record is read from stdin. Lines come from
+#  arm-none-eabi-addr2line when it is on the PATH (or given with the
+#  ADDR2LINE environment variable), otherwise only function names from the
+#  ELF symbol table are shown.
+#
+#  This library is free software; you can redistribute it and/or
+#  modify it under the terms of the GNU Lesser General Public
+#  License as published by the Free Software Foundation; either
+#  version 2.1 of the License, or (at your option) any later version.
+
+import os
+import re
+import struct
+import subprocess
+import sys
+
+EXCEPTIONS = {2: 'NMI', 3: 'HardFault', 4: 'MemManage', 5: 'BusFault', 6: 'UsageFault'}
+
+CFSR_BITS = [
+    (0, 'IACCVIOL instruction access violation'),
+    (1, 'DACCVIOL data access violation'),
+    (3, 'MUNSTKERR unstacking'),
+    (4, 'MSTKERR stacking (stack overflow?)'),
+    (5, 'MLSPERR FPU lazy state'),
+    (8, 'IBUSERR instruction bus error'),
+    (9, 'PRECISERR precise data bus error'),
+    (10, 'IMPRECISERR imprecise data bus error'),
+    (11, 'UNSTKERR unstacking'),
+    (12, 'STKERR stacking (stack overflow?)'),
+    (13, 'LSPERR FPU lazy state'),
+    (16, 'UNDEFINSTR undefined instruction'),
+    (17, 'INVSTATE invalid state (ARM mode or bad function pointer)'),
+    (18, 'INVPC invalid EXC_RETURN'),
+    (19, 'NOCP no coprocessor'),
+    (24, 'UNALIGNED unaligned access'),
+    (25, 'DIVBYZERO divide by zero'),
+]
+
+HFSR_BITS = [
+    (1, 'VECTTBL vector table read'),
+    (30, 'FORCED escalated from a configurable fault'),
+]
+
+
+def read_symbols(elf_path):
+    with open(elf_path, 'rb') as f:
+        elf = f.read()
+    if elf[:4] != b'\x7fELF' or elf[4:5] != b'\x01':
+        raise SystemExit('%s is not a 32 bit ELF file' % elf_path)
+
+    shoff, = struct.unpack_from('<I', elf, 0x20)
+    shentsize, shnum = struct.unpack_from('<HH', elf, 0x2E)
+    sections = [struct.unpack_from('<IIIIIIIIII', elf, shoff + i * shentsize)
+                for i in range(shnum)]
+
+    symbols = []
+    for sh in sections:
+        if sh[1] != 2:          # SHT_SYMTAB
+            continue
+        strtab = sections[sh[6]]
+        for off in range(sh[4], sh[4] + sh[5], 16):
+            name, value, size, info = struct.unpack_from('<IIIB', elf, off)
+            if info & 0xF != 2 or not size:     # STT_FUNC
+                continue
+            start = strtab[4] + name
+            sname = elf[start:elf.index(b'\0', start)].decode('latin-1')
+            symbols.append((value & ~1, size, sname))
+    return sorted(symbols)
+
+
+def lookup(symbols, addr):
+    for start, size, name in symbols:
+        if start <= addr < start + size:
+            return '%s+0x%x' % (name, addr - start)
+    return '??'
+
+
+def addr2line(elf_path, addrs):
+    tool = os.environ.get('ADDR2LINE', 'arm-none-eabi-addr2line')
+    try:
+        out = subprocess.check_output([tool, '-f', '-C', '-e', elf_path] +
+                                      ['0x%x' % a for a in addrs])
+    except (OSError, subprocess.CalledProcessError):
+        return None
+    lines = out.decode('latin-1').splitlines()
+    return ['%s at %s' % (lines[i], lines[i + 1]) for i in range(0, len(lines) - 1, 2)]
+
+
+def parse(text):
+    fields = {}
+    for key, value in re.findall(r'(\w+)=(0x[0-9a-fA-F]+|\d+)', text):
+        fields[key] = int(value, 0)
+    m = re.search(r'^bt((?: 0x[0-9a-fA-F]+)*)\s*$', text, re.M)
+    backtrace = [int(a, 16) for a in m.group(1).split()] if m else []
+    if 'pc' not in fields:
+        raise SystemExit('no crash record found in input')
+    return fields, backtrace
+
+
+def bits(value, table):
+    return [text for bit, text in table if value & (1 << bit)]
+
+
+def main():
+    if len(sys.argv) < 2:
+        raise SystemExit('usage: crash_symbolize.py sketch.elf [crash.txt]')
+    elf_path = sys.argv[1]
+    text = open(sys.argv[2]).read() if len(sys.argv) > 2 else sys.stdin.read()
+    fields, backtrace = parse(text)
+
+    exc = fields.get('exception', 0)
+    print('exception: %s' % EXCEPTIONS.get(exc, 'unhandled IRQ %d' % (exc - 16) if exc >= 16 else str(exc)))
+    irq = fields.get('irq', 0)
+    print('while in:  %s' % ('thread mode' if irq == 0 else
+                             EXCEPTIONS.get(irq, 'IRQ %d' % (irq - 16))))
+    cfsr = fields.get('cfsr', 0)
+    for text in bits(cfsr, CFSR_BITS) + bits(fields.get('hfsr', 0), HFSR_BITS):
+        print('  %s' % text)
+    if cfsr & (1 << 7):
+        print('  fault address 0x%08x (MMFAR)' % fields['mmfar'])
+    if cfsr & (1 << 15):
+        print('  fault address 0x%08x (BFAR)' % fields['bfar'])
+
+    names = ['pc', 'lr'] + ['bt%d' % i for i in range(len(backtrace))]
+    addrs = [fields['pc'], fields['lr'] & ~1] + [(a & ~1) - 2 for a in backtrace]
+
+    resolved = addr2line(elf_path, addrs)
+    if resolved is None:
+        symbols = read_symbols(elf_path)
+        resolved = [lookup(symbols, a) for a in addrs]
+    for name, addr, where in zip(names, addrs, resolved):
+        print('%-4s 0x%08x %s' % (name, addr, where))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,62 @@
+/*
+  HostTest.h - Checks for the tests that run on the build machine
+  Copyright (c) 2016 Energia.  All right reserved.
+
+  The Test*.cpp files in the extras/host directories of the core and the
+  libraries are programs for the host compiler, not sketches: the build
+  line is at the top of each. They print one line per check and exit
+  non-zero when any of them failed:
+
+    #include "HostTest.h"
+
+    check(fft.begin(8), "ComplexFFT begin(%d)", 8);
+    return checkResult();
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef HostTest_h
+#define HostTest_h
+
+#include <stdarg.h>
+#include <stdio.h>
+
+static int checkFailures;
+
+// Prints PASS or FAIL and the printf style name
+static void check(bool ok, const char *name, ...)
+	__attribute__((format(printf, 2, 3)));
+
+static void check(bool ok, const char *name, ...)
+{
+	va_list args;
+
+	printf("%s ", ok ? "PASS" : "FAIL");
+	va_start(args, name);
+	vprintf(name, args);
+	va_end(args);
+	printf("\n");
+	if (!ok)
+		checkFailures++;
+}
+
+// The exit code for main()
+static int checkResult(void)
+{
+	printf("%d failed\n", checkFailures);
+	return checkFailures != 0;
+}
+
+#endif
@@ -0,0 +1,78 @@
+/*
+  Stream.h - Just enough of Print and Stream to build libraries on the host
+  Copyright (c) 2016 Energia.  All right reserved.
+
+    cd libraries/LogFS
+    g++ -I../../extras/host -Isrc src/LogFS.cpp extras/host/TestLogFS.cpp
+
+  With this directory ahead of the core on the include path, LogFS, SD
+  and their RAM block devices compile with the host compiler, so the file
+  systems can be tested without a board.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef Stream_h
+#define Stream_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+
+class Print {
+public:
+  Print() : write_error(0) {}
+  virtual ~Print() {}
+
+  int getWriteError() { return write_error; }
+  void clearWriteError() { setWriteError(0); }
+
+  virtual size_t write(uint8_t) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size) {
+    size_t n = 0;
+    while (size-- && write(*buffer++))
+      n++;
+    return n;
+  }
+  size_t write(const char *str) {
+    return str ? write((const uint8_t *)str, strlen(str)) : 0;
+  }
+  virtual void flush() {}
+
+  size_t print(const char *str) { return write(str); }
+  size_t print(long n) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%ld", n);
+    return write(buf);
+  }
+  size_t println(const char *str) { return print(str) + write("\r\n"); }
+  size_t println(long n) { return print(n) + write("\r\n"); }
+
+protected:
+  void setWriteError(int err = 1) { write_error = err; }
+
+private:
+  int write_error;
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+};
+
+#endif
@@ -0,0 +1,181 @@
+/*
+  TestLockFree.cpp - Host threaded stress test for LockFree.h
+
+  Threads stand in for interrupt handlers and loop(): they preempt each
+  other at any instruction, which is a harsher test than the single core
+  target.
+
+    g++ -std=gnu++11 -O2 -pthread -Icores/tivac -o TestLockFree \
+        extras/host/TestLockFree.cpp
+    ./TestLockFree
+
+  Add -fsanitize=thread to have ThreadSanitizer check the memory ordering
+  as well.
+*/
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "LockFree.h"
+#include "HostTest.h"
+
+// Wider than a word so a torn copy shows up in the check fields
+struct Item {
+	uint32_t producer;
+	uint32_t seq;
+	uint32_t check;
+};
+
+static uint32_t itemCheck(uint32_t producer, uint32_t seq)
+{
+	return (producer * 0x9E3779B9) ^ ~seq;
+}
+
+static void testSPSC(void)
+{
+	static SPSCQueue<Item, 64> queue;
+	const uint32_t count = 500000;
+	uint32_t expect = 0;
+	bool ordered = true;
+	Item item;
+
+	std::thread producer([&]() {
+		for (uint32_t i = 0; i < count; ) {
+			Item it = { 0, i, itemCheck(0, i) };
+			if (queue.push(it))
+				i++;
+			else
+				std::this_thread::yield();
+		}
+	});
+
+	while (expect < count) {
+		if (!queue.pop(item, 1000))
+			break;
+		if (item.seq != expect || item.check != itemCheck(0, expect))
+			ordered = false;
+		expect++;
+	}
+	producer.join();
+
+	check(expect == count, "SPSCQueue delivers every item");
+	check(ordered, "SPSCQueue keeps order and contents");
+	check(queue.empty(), "SPSCQueue empty at the end");
+}
+
+static void testMPSC(void)
+{
+	static MPSCQueue<Item, 128> queue;
+	const int producers = 4;
+	const uint32_t count = 200000;
+	std::vector<std::thread> threads;
+	uint32_t next[producers] = { 0 };
+	uint32_t total = 0;
+	bool ordered = true;
+	Item item;
+	int p;
+
+	for (p = 0; p < producers; p++) {
+		threads.push_back(std::thread([&, p]() {
+			for (uint32_t i = 0; i < count; ) {
+				Item it = { (uint32_t)p, i, itemCheck(p, i) };
+				if (queue.push(it))
+					i++;
+				else
+					std::this_thread::yield();
+			}
+		}));
+	}
+
+	while (total < producers * count) {
+		if (!queue.pop(item, 1000))
+			break;
+		// Items of one producer arrive in the order it pushed them
+		if (item.producer >= producers || item.seq != next[item.producer] ||
+		    item.check != itemCheck(item.producer, item.seq))
+			ordered = false;
+		else
+			next[item.producer]++;
+		total++;
+	}
+	for (p = 0; p < producers; p++)
+		threads[p].join();
+
+	check(total == producers * count, "MPSCQueue delivers every item");
+	check(ordered, "MPSCQueue keeps per producer order and contents");
+	check(queue.empty(), "MPSCQueue empty at the end");
+}
+
+static void testMPSCFull(void)
+{
+	static MPSCQueue<Item, 4> queue;
+	Item item = { 0, 0, 0 };
+	int i;
+
+	for (i = 0; i < 4; i++)
+		queue.push(item);
+	check(!queue.push(item), "MPSCQueue push fails when full");
+	check(queue.pop(item) && queue.push(item), "MPSCQueue push succeeds after pop");
+	for (i = 0; i < 4; i++)
+		queue.pop(item);
+	check(!queue.pop(item, 10), "MPSCQueue pop times out when empty");
+}
+
+static void testSemaphore(void)
+{
+	static Semaphore sem;
+	const int givers = 4, count = 100000;
+	std::atomic<int> taken(0);
+	std::vector<std::thread> threads;
+	int g;
+
+	std::thread taker([&]() {
+		for (int i = 0; i < givers * count; i++) {
+			if (!sem.take(1000))
+				break;
+			taken++;
+		}
+	});
+	for (g = 0; g < givers; g++) {
+		threads.push_back(std::thread([&]() {
+			for (int i = 0; i < count; i++)
+				sem.give();
+		}));
+	}
+	for (g = 0; g < givers; g++)
+		threads[g].join();
+	taker.join();
+
+	check(taken == givers * count, "Semaphore counts every give");
+	check(sem.value() == 0 && !sem.take(10), "Semaphore empty at the end");
+}
+
+static void testEventFlags(void)
+{
+	static EventFlags flags;
+	std::vector<std::thread> threads;
+	int t;
+
+	for (t = 0; t < 8; t++) {
+		threads.push_back(std::thread([&, t]() {
+			for (int i = 0; i < 100000; i++)
+				flags.set(1u << t);
+		}));
+	}
+	for (t = 0; t < 8; t++)
+		threads[t].join();
+
+	check(flags.waitAll(0xFF, 100) == 0xFF, "EventFlags keeps bits of every setter");
+	check(flags.get() == 0, "EventFlags waitAll() consumes the bits");
+}
+
+int main(void)
+{
+	testSPSC();
+	testMPSC();
+	testMPSCFull();
+	testSemaphore();
+	testEventFlags();
+
+	return checkResult();
+}
@@ -0,0 +1,44 @@
+/*
+  BinaryLogBasic
+
+  Logs a counter, an analog reading and a button interrupt without
+  formatting anything on the LaunchPad. The records drain to Serial in the
+  background. Decode them on the host with:
+
+    python binlog_decode.py BinaryLogBasic.ino.elf /dev/ttyACM0 115200
+
+  binlog_decode.py lives in the extras folder of the BinaryLog library.
+*/
+
+#include <BinaryLog.h>
+
+volatile unsigned long presses = 0;
+
+void buttonPressed()
+{
+  presses++;
+  BLOG("button pressed at %lu ms, count %lu", millis(), presses);
+}
+
+void setup()
+{
+  Serial.begin(115200);
+  BinaryLog.begin(Serial);
+
+  pinMode(PUSH1, INPUT_PULLUP);
+  attachInterrupt(PUSH1, buttonPressed, FALLING);
+
+  BLOG("BinaryLogBasic started, F_CPU %lu", F_CPU);
+}
+
+void loop()
+{
+  static unsigned long count = 0;
+  int value = analogRead(A0);
+
+  BLOG("loop %lu: A0 = %d (%f V)", count++, value, value * 3.3 / 4095);
+  if (BinaryLog.dropped())
+    BLOG("%lu records dropped so far", BinaryLog.dropped());
+
+  delay(500);
+}
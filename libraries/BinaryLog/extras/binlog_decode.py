@@ -0,0 +1,142 @@
+#!/usr/bin/env python
+#
+#  binlog_decode.py - Host side decoder for the BinaryLog library
+#
+#  Reads the format strings from the .binlog_fmt section of the sketch ELF
+#  file and expands the binary records coming from the target.
+#
+#  usage: binlog_decode.py sketch.elf [capture.bin | serial port [baud]]
+#
+#  With no input argument records are read from stdin. Reading from a serial
+#  port needs pyserial.
+#
+#  This library is free software; you can redistribute it and/or
+#  modify it under the terms of the GNU Lesser General Public
+#  License as published by the Free Software Foundation; either
+#  version 2.1 of the License, or (at your option) any later version.
+
+import os
+import re
+import struct
+import sys
+
+SYNC = 0xA5
+SPEC = re.compile(r'%([-+ #0]*\d*(?:\.\d+)?)(hh|h|ll|l|z|j|t)?([diouxXcsfFeEgGp%])')
+
+
+def read_format_strings(elf_path):
+    with open(elf_path, 'rb') as f:
+        elf = f.read()
+    if elf[:4] != b'\x7fELF' or elf[4:5] != b'\x01':
+        raise SystemExit('%s is not a 32 bit ELF file' % elf_path)
+
+    shoff, = struct.unpack_from('<I', elf, 0x20)
+    shentsize, shnum, shstrndx = struct.unpack_from('<HHH', elf, 0x2E)
+
+    def section(i):
+        return struct.unpack_from('<IIIIIIIIII', elf, shoff + i * shentsize)
+
+    names = section(shstrndx)
+    for i in range(shnum):
+        name, _, _, addr, offset, size = section(i)[:6]
+        start = names[4] + name
+        sname = elf[start:elf.index(b'\0', start)].decode()
+        if sname == '.binlog_fmt':
+            return addr, elf[offset:offset + size]
+    raise SystemExit('%s has no .binlog_fmt section, no BLOG() calls?' % elf_path)
+
+
+def format_string(strings, base, fmt_id):
+    start = fmt_id - base
+    if start < 0 or start >= len(strings):
+        return None
+    end = strings.index(b'\0', start)
+    return strings[start:end].decode('latin-1')
+
+
+def expand(fmt, payload):
+    pos = [0]
+
+    def take(n):
+        data = payload[pos[0]:pos[0] + n]
+        if len(data) != n:
+            raise ValueError('short record')
+        pos[0] += n
+        return data
+
+    def convert(m):
+        flags, _, conv = m.groups()
+        if conv == '%':
+            return '%'
+        if conv == 's':
+            n = bytearray(take(1))[0]
+            return ('%' + flags + 's') % take(n).decode('latin-1')
+        raw = take(4)
+        if conv in 'fFeEgG':
+            return ('%' + flags + conv) % struct.unpack('<f', raw)[0]
+        if conv in 'di':
+            return ('%' + flags + 'd') % struct.unpack('<i', raw)[0]
+        if conv == 'c':
+            return ('%' + flags + 'c') % chr(bytearray(raw)[0])
+        if conv == 'p':
+            return '0x%08x' % struct.unpack('<I', raw)[0]
+        return ('%' + flags + conv) % struct.unpack('<I', raw)[0]
+
+    text = SPEC.sub(convert, fmt)
+    if pos[0] != len(payload):
+        raise ValueError('argument size mismatch')
+    return text
+
+
+def decode(stream, strings, base):
+    buf = bytearray()
+    while True:
+        chunk = stream.read(1)
+        if not chunk:
+            return
+        buf += chunk
+        while len(buf) >= 4:
+            if buf[0] != SYNC:
+                del buf[0]
+                continue
+            length = buf[1]
+            if len(buf) < 4 + length:
+                break
+            fmt_id = buf[2] | (buf[3] << 8)
+            fmt = format_string(strings, base, fmt_id)
+            try:
+                if fmt is None:
+                    raise ValueError('unknown format id %d' % fmt_id)
+                line = expand(fmt, bytes(buf[4:4 + length]))
+            except (ValueError, TypeError):
+                # Probably synced on a 0xA5 inside a record, skip one byte
+                del buf[0]
+                continue
+            del buf[:4 + length]
+            yield line
+
+
+def open_input(args):
+    if not args:
+        return getattr(sys.stdin, 'buffer', sys.stdin)
+    path = args[0]
+    if os.path.exists(path) and os.path.isfile(path):
+        return open(path, 'rb')
+    import serial
+    baud = int(args[1]) if len(args) > 1 else 115200
+    return serial.Serial(path, baud)
+
+
+def main():
+    if len(sys.argv) < 2:
+        raise SystemExit('usage: binlog_decode.py sketch.elf [capture.bin | serial port [baud]]')
+    base, strings = read_format_strings(sys.argv[1])
+    stream = open_input(sys.argv[2:])
+
+    for line in decode(stream, strings, base):
+        sys.stdout.write(line + '\n')
+        sys.stdout.flush()
+
+
+if __name__ == '__main__':
+    main()
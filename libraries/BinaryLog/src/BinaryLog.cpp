@@ -0,0 +1,159 @@
+/*
+  BinaryLog.cpp - Deferred binary logging for Energia
+  Copyright (c) 2016 Energia.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "Energia.h"
+#include "BinaryLog.h"
+
+BinaryLogClass::BinaryLogClass(void)
+{
+	head = 0;
+	reserveHead = 0;
+	tail = 0;
+	writers = 0;
+	draining = 0;
+	droppedCount = 0;
+	sink = NULL;
+	background = false;
+}
+
+void BinaryLogClass::begin(Print &out, bool drainInBackground)
+{
+	static bool drainRegistered = false;
+
+	sink = &out;
+	background = drainInBackground;
+
+	if (background && !drainRegistered) {
+		registerLoopCb(backgroundDrain);
+		drainRegistered = true;
+	}
+}
+
+void BinaryLogClass::end(void)
+{
+	poll();
+	background = false;
+	sink = NULL;
+}
+
+//
+// Claim size bytes of the ring. Producers may be nested (loop code
+// interrupted by an ISR that logs as well), so space is claimed with an
+// LDREX/STREX compare and swap on reserveHead instead of masking interrupts.
+//
+uint32_t BinaryLogClass::reserve(uint32_t size)
+{
+	__atomic_add_fetch(&writers, 1, __ATOMIC_ACQUIRE);
+
+	uint32_t start = __atomic_load_n(&reserveHead, __ATOMIC_RELAXED);
+	do {
+		if (start + size - tail > BINLOG_BUFFER_SIZE) {
+			__atomic_add_fetch(&droppedCount, 1, __ATOMIC_RELAXED);
+			commit();
+			return 0xFFFFFFFF;
+		}
+	} while (!__atomic_compare_exchange_n(&reserveHead, &start, start + size,
+			true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+	return start;
+}
+
+//
+// Publish finished records to the consumer. A nested producer always
+// completes before the one it preempted resumes, so only the outermost
+// producer moves head, and everything reserved at that point is complete.
+//
+void BinaryLogClass::commit(void)
+{
+	if (__atomic_sub_fetch(&writers, 1, __ATOMIC_ACQ_REL) != 0)
+		return;
+
+	uint32_t r = __atomic_load_n(&reserveHead, __ATOMIC_ACQUIRE);
+	uint32_t h = __atomic_load_n(&head, __ATOMIC_RELAXED);
+
+	// An ISR may have published a newer head in between; never move back
+	while ((int32_t)(r - h) > 0 &&
+		!__atomic_compare_exchange_n(&head, &h, r, true,
+			__ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+size_t BinaryLogClass::drain(size_t max)
+{
+	size_t total = 0;
+
+	// Single consumer: poll() and the background drain must not interleave
+	if (__atomic_exchange_n(&draining, 1, __ATOMIC_ACQUIRE))
+		return 0;
+
+	Print *out = sink;
+	while (out && total < max) {
+		uint32_t h = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+		uint32_t t = tail;
+		if (h == t)
+			break;
+
+		size_t n = h - t;
+		size_t offset = t & (BINLOG_BUFFER_SIZE - 1);
+		if (n > BINLOG_BUFFER_SIZE - offset)
+			n = BINLOG_BUFFER_SIZE - offset;  // up to the end of the ring
+		if (n > max - total)
+			n = max - total;
+
+		n = out->write(&buffer[offset], n);
+		if (n == 0)
+			break;
+
+		__atomic_store_n(&tail, t + n, __ATOMIC_RELEASE);
+		total += n;
+	}
+
+	__atomic_store_n(&draining, 0, __ATOMIC_RELEASE);
+	return total;
+}
+
+size_t BinaryLogClass::poll(void)
+{
+	return drain((size_t)-1);
+}
+
+size_t BinaryLogClass::pending(void)
+{
+	return head - tail;
+}
+
+void BinaryLogClass::backgroundDrain(void)
+{
+	if (!BinaryLog.background || !BinaryLog.sink)
+		return;
+
+	//
+	// Runs between loop() passes and inside delay(), so never block: only
+	// hand over what the sink can take right now. Sinks that report 0 need
+	// BinaryLog.poll() from loop().
+	//
+	int room = BinaryLog.sink->availableForWrite();
+	if (room <= 0)
+		return;
+	if (room > BINLOG_DRAIN_CHUNK)
+		room = BINLOG_DRAIN_CHUNK;
+
+	BinaryLog.drain(room);
+}
+
+BinaryLogClass BinaryLog;
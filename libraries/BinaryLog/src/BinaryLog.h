@@ -0,0 +1,171 @@
+/*
+  BinaryLog.h - Deferred binary logging for Energia
+  Copyright (c) 2016 Energia.  All right reserved.
+
+  A log call stores only the ID of its format string plus the raw bytes of
+  its arguments in a lock-free ring buffer. The format strings are kept in
+  the non-loaded .binlog_fmt ELF section (see lm4fcpp_*.ld) so they take no
+  flash, and extras/binlog_decode.py expands the records on the host.
+
+  Record layout on the wire:
+    0xA5, payload length, format ID (16 bit, little endian), payload
+
+  Integers, pointers and chars are stored as 4 bytes, float and double as a
+  4 byte float, and strings as a length byte followed by at most 255 chars.
+  64 bit integers do not compile; log them as two 32 bit halves.
+
+  Records drain to the sink in the background from thread context: after
+  each loop() and while delay() waits (see registerLoopCb()). Draining in
+  an interrupt would race with loop() code that writes to the same Serial.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef BinaryLog_h
+#define BinaryLog_h
+
+#include <inttypes.h>
+#include <string.h>
+#include "Print.h"
+
+// Ring buffer size in bytes, must be a power of two.
+#ifndef BINLOG_BUFFER_SIZE
+#define BINLOG_BUFFER_SIZE 512
+#endif
+
+// Maximum number of bytes handed to the sink per background drain.
+#ifndef BINLOG_DRAIN_CHUNK
+#define BINLOG_DRAIN_CHUNK 32
+#endif
+
+#define BINLOG_SYNC 0xA5
+#define BINLOG_HEADER_SIZE 4
+
+#if (BINLOG_BUFFER_SIZE & (BINLOG_BUFFER_SIZE - 1)) != 0
+#error "BINLOG_BUFFER_SIZE must be a power of two"
+#endif
+
+/*
+ * BLOG("adc %d took %u us", value, elapsed);
+ *
+ * Safe to use from interrupt handlers. The format string must be a literal.
+ * Define BINLOG_DISABLE before including this header to compile all log
+ * calls out.
+ */
+#ifdef BINLOG_DISABLE
+#define BLOG(fmt, ...) do { } while (0)
+#else
+#define BLOG(fmt, ...) do { \
+	static const char binlog_fmt_[] \
+		__attribute__((section(".binlog_fmt"), used)) = fmt; \
+	BinaryLog.log((uint16_t)(uintptr_t)binlog_fmt_, ##__VA_ARGS__); \
+} while (0)
+#endif
+
+class BinaryLogClass
+{
+	private:
+		uint8_t buffer[BINLOG_BUFFER_SIZE];
+		volatile uint32_t head;		// end of published records
+		volatile uint32_t reserveHead;	// end of reserved space
+		volatile uint32_t tail;		// next byte to hand to the sink
+		volatile uint32_t writers;	// log calls in progress
+		volatile uint32_t draining;
+		volatile uint32_t droppedCount;
+		Print *sink;
+		bool background;
+
+		uint32_t reserve(uint32_t size);
+		void commit(void);
+		size_t drain(size_t max);
+		static void backgroundDrain(void);
+
+		inline void put8(uint32_t &pos, uint8_t b) {
+			buffer[pos++ & (BINLOG_BUFFER_SIZE - 1)] = b;
+		}
+		inline void put32(uint32_t &pos, uint32_t v) {
+			put8(pos, v); put8(pos, v >> 8); put8(pos, v >> 16); put8(pos, v >> 24);
+		}
+
+		// Encoded size of each argument type
+		static inline uint32_t argSize(void) { return 0; }
+		static inline uint32_t argSize(const char *s) {
+			uint32_t n = s ? strlen(s) : 0;
+			return 1 + (n > 255 ? 255 : n);
+		}
+		static inline uint32_t argSize(char *s) { return argSize((const char *)s); }
+		static inline uint32_t argSize(float) { return 4; }
+		static inline uint32_t argSize(double) { return 4; }
+		template<typename T>
+		static inline uint32_t argSize(T) {
+			static_assert(sizeof(T) <= 4, "BLOG() arguments are at most 32 bits wide");
+			return 4;
+		}
+		template<typename T, typename... Rest>
+		static inline uint32_t argSize(T first, Rest... rest) {
+			return argSize(first) + argSize(rest...);
+		}
+
+		// Serialize each argument into the ring
+		inline void pack(uint32_t &) {}
+		inline void pack(uint32_t &pos, const char *s) {
+			uint32_t n = argSize(s) - 1;
+			put8(pos, n);
+			while (n--) put8(pos, *s++);
+		}
+		inline void pack(uint32_t &pos, char *s) { pack(pos, (const char *)s); }
+		inline void pack(uint32_t &pos, float f) {
+			uint32_t v;
+			memcpy(&v, &f, 4);
+			put32(pos, v);
+		}
+		inline void pack(uint32_t &pos, double d) { pack(pos, (float)d); }
+		template<typename T>
+		inline void pack(uint32_t &pos, T v) { put32(pos, (uint32_t)v); }
+		template<typename T, typename... Rest>
+		inline void pack(uint32_t &pos, T first, Rest... rest) {
+			pack(pos, first);
+			pack(pos, rest...);
+		}
+
+	public:
+		BinaryLogClass(void);
+		void begin(Print &out, bool drainInBackground = true);
+		void end(void);
+		size_t poll(void);
+		size_t pending(void);
+		uint32_t dropped(void) { return droppedCount; }
+
+		template<typename... Args>
+		void log(uint16_t id, Args... args) {
+			uint32_t payload = argSize(args...);
+			if (payload > 255) {
+				__atomic_add_fetch(&droppedCount, 1, __ATOMIC_RELAXED);
+				return;
+			}
+			uint32_t pos = reserve(BINLOG_HEADER_SIZE + payload);
+			if (pos == 0xFFFFFFFF) return;
+			put8(pos, BINLOG_SYNC);
+			put8(pos, payload);
+			put8(pos, id);
+			put8(pos, id >> 8);
+			pack(pos, args...);
+			commit();
+		}
+};
+
+extern BinaryLogClass BinaryLog;
+
+#endif
@@ -0,0 +1,59 @@
+/*
+  SpectrumAnalyzer
+
+  Samples A0 at 4 kHz, removes the DC offset with a biquad high pass,
+  smooths a peak reading with a moving median and prints the strongest
+  frequency from a 256 point real FFT.
+*/
+
+#include <DSP.h>
+
+#define SAMPLES     256
+#define SAMPLE_RATE 4000
+
+// 2nd order Butterworth high pass at 20 Hz for 4 kHz: b0, b1, b2, a1, a2
+static const float highPass[5] = {
+  0.97803048f, -1.95606096f, 0.97803048f, -1.95557824f, 0.95654368f
+};
+static float highPassState[2];
+
+BiquadCascadeF32 dcBlock;
+RealFFT fft;
+MovingMedian<float, 5> peak;
+float samples[SAMPLES];
+float magnitude[SAMPLES / 2];
+
+void setup()
+{
+  Serial.begin(115200);
+  dcBlock.begin(highPass, 1, highPassState);
+  if (!fft.begin(SAMPLES))
+    Serial.println("not enough memory for the FFT");
+}
+
+void loop()
+{
+  unsigned long next = micros();
+  int i, best = 1;
+
+  for (i = 0; i < SAMPLES; i++) {
+    while ((long)(micros() - next) < 0)
+      ;
+    next += 1000000UL / SAMPLE_RATE;
+    samples[i] = analogRead(A0) * (1.0f / 4096.0f);
+  }
+
+  dcBlock.process(samples, samples, SAMPLES);
+  fft.forward(samples);
+
+  // Bins 1 .. n/2-1 are complex pairs after the two real values
+  dspMagnitudeF32(samples + 2, magnitude + 1, SAMPLES / 2 - 1);
+  for (i = 2; i < SAMPLES / 2; i++) {
+    if (magnitude[i] > magnitude[best])
+      best = i;
+  }
+
+  Serial.print("peak ");
+  Serial.print(peak.add((float)best * SAMPLE_RATE / SAMPLES));
+  Serial.println(" Hz");
+}
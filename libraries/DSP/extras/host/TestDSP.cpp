@@ -0,0 +1,259 @@
+/*
+  TestDSP.cpp - Host reference vector tests for the DSP library
+
+  The fixed vectors were computed with a plain double precision DFT and
+  direct convolution in Python; the random ones are checked against the
+  same reference here.
+
+    cd libraries/DSP
+    g++ -std=gnu++11 -Isrc -I../../extras/host -o TestDSP \
+        extras/host/TestDSP.cpp $(find src -name '*.cpp')
+    ./TestDSP
+*/
+
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include "DSP.h"
+#include "HostTest.h"
+
+static double noise(void)
+{
+	return rand() / (double)RAND_MAX - 0.5;
+}
+
+// Reference DFT of n interleaved complex values
+static void dft(const double *in, double *out, int n)
+{
+	int k, m;
+
+	for (k = 0; k < n; k++) {
+		double re = 0, im = 0;
+		for (m = 0; m < n; m++) {
+			double a = -2 * M_PI * k * m / n;
+			re += in[2 * m] * cos(a) - in[2 * m + 1] * sin(a);
+			im += in[2 * m] * sin(a) + in[2 * m + 1] * cos(a);
+		}
+		out[2 * k] = re;
+		out[2 * k + 1] = im;
+	}
+}
+
+static double maxError(const float *a, const float *b, int n)
+{
+	double err = 0;
+	int i;
+
+	for (i = 0; i < n; i++)
+		err = fmax(err, fabs(a[i] - b[i]));
+	return err;
+}
+
+static void testComplexFFTVector(void)
+{
+	float data[16] = { 1, -1, 2, 0, 3, 1, 4, -1, 5, 0, 6, 1, 7, -1, 8, 0 };
+	const float input[16] = { 1, -1, 2, 0, 3, 1, 4, -1, 5, 0, 6, 1, 7, -1, 8, 0 };
+	const float expect[16] = {
+		36.000000f, -1.000000f, -3.414214f, 8.656854f,
+		-2.000000f, 3.000000f, -7.414214f, 0.656854f,
+		-4.000000f, -1.000000f, -0.585786f, -2.656854f,
+		-6.000000f, -5.000000f, -4.585786f, -10.656854f,
+	};
+	ComplexFFT fft;
+	double err;
+
+	check(fft.begin(8), "ComplexFFT begin(8)");
+	fft.forward(data);
+	err = maxError(data, expect, 16);
+	check(err < 1e-4, "ComplexFFT 8 point vector (max error %g)", err);
+	fft.inverse(data);
+	err = maxError(data, input, 16);
+	check(err < 1e-5, "ComplexFFT 8 point inverse (max error %g)", err);
+}
+
+static void testRealFFTVector(void)
+{
+	float data[16];
+	float input[16];
+	const float expect[16] = {
+		-2.000000f, 2.000000f, -2.170447f, 0.013670f,
+		-3.000000f, 0.171573f, -13.068349f, 3.248303f,
+		2.000000f, -2.000000f, -0.002719f, -2.165911f,
+		-3.000000f, -5.828427f, 3.241514f, 2.599456f,
+	};
+	RealFFT fft;
+	double err;
+	int i;
+
+	for (i = 0; i < 16; i++)
+		data[i] = input[i] = i % 5 - 2;
+
+	check(fft.begin(16), "RealFFT begin(16)");
+	fft.forward(data);
+	err = maxError(data, expect, 16);
+	check(err < 1e-4, "RealFFT 16 point vector (max error %g)", err);
+	fft.inverse(data);
+	err = maxError(data, input, 16);
+	check(err < 1e-5, "RealFFT 16 point inverse (max error %g)", err);
+}
+
+static void testComplexFFTRandom(void)
+{
+	int n, i;
+
+	for (n = 4; n <= 4096; n *= 2) {
+		std::vector<float> data(2 * n);
+		std::vector<double> in(2 * n), ref(2 * n);
+		ComplexFFT fft;
+		double err = 0, tol = 2e-6 * n;
+
+		for (i = 0; i < 2 * n; i++)
+			data[i] = in[i] = noise();
+		dft(&in[0], &ref[0], n);
+
+		if (!fft.begin(n)) {
+			check(false, "ComplexFFT %d random", n);
+			continue;
+		}
+		fft.forward(&data[0]);
+		for (i = 0; i < 2 * n; i++)
+			err = fmax(err, fabs(data[i] - ref[i]));
+		check(err < tol, "ComplexFFT %d random (max error %g)", n, err);
+	}
+}
+
+static void testRealFFTRandom(void)
+{
+	int n, i;
+
+	for (n = 8; n <= 4096; n *= 2) {
+		std::vector<float> data(n);
+		std::vector<double> in(2 * n), ref(2 * n);
+		RealFFT fft;
+		double err, tol = 2e-6 * n;
+
+		for (i = 0; i < n; i++) {
+			in[2 * i] = data[i] = noise();
+			in[2 * i + 1] = 0;
+		}
+		dft(&in[0], &ref[0], n);
+
+		if (!fft.begin(n)) {
+			check(false, "RealFFT %d random", n);
+			continue;
+		}
+		fft.forward(&data[0]);
+		err = fmax(fabs(data[0] - ref[0]), fabs(data[1] - ref[n]));
+		for (i = 1; i < n / 2; i++) {
+			err = fmax(err, fabs(data[2 * i] - ref[2 * i]));
+			err = fmax(err, fabs(data[2 * i + 1] - ref[2 * i + 1]));
+		}
+		check(err < tol, "RealFFT %d random (max error %g)", n, err);
+	}
+}
+
+static void testFIRQ15Vector(void)
+{
+	const q15_t taps[8] = { 1200, -3400, 8000, 16000, 8000, -3400, 1200, 300 };
+	const q15_t in[24] = {
+		-23406, -17750, -12093, -6437, -780, 4876, 10532, 16189,
+		21845, -19310, -13653, -7997, -2340, 3316, 8972, 14629,
+		20285, -20870, -15213, -9557, -3900, 1756, 7412, 13069,
+	};
+	const q15_t expect[24] = {
+		-858, 1778, -4316, -14744, -16695, -9122, -5422, -872,
+		3944, 7046, 16719, 10106, -7935, -14547, -4874, -1772,
+		2616, 5717, 15391, 8778, -9263, -15875, -6202, -3100,
+	};
+	q15_t state[8 + 5 - 1];
+	q15_t out[24];
+	FIRFilterQ15 fir;
+	int i, bad = 0;
+
+	// Odd call sizes so blocks straddle the internal block size
+	fir.begin(taps, 8, state, 5);
+	fir.process(in, out, 7);
+	fir.process(in + 7, out + 7, 1);
+	fir.process(in + 8, out + 8, 16);
+	for (i = 0; i < 24; i++)
+		bad += out[i] != expect[i];
+	check(!bad, "FIRFilterQ15 vector");
+
+	fir.reset();
+	fir.process(in, out, 24);
+	for (i = 0, bad = 0; i < 24; i++)
+		bad += out[i] != expect[i];
+	check(!bad, "FIRFilterQ15 vector after reset");
+}
+
+static void testFIRF32Random(void)
+{
+	const int taps = 31, block = 16, n = 200;
+	float h[taps], in[n], out[n], state[taps + block - 1];
+	FIRFilterF32 fir;
+	double err = 0;
+	int i, k;
+
+	for (i = 0; i < taps; i++)
+		h[i] = noise() / 4;
+	for (i = 0; i < n; i++)
+		in[i] = noise();
+
+	fir.begin(h, taps, state, block);
+	fir.process(in, out, 37);
+	for (i = 37; i < n; i++)
+		out[i] = fir.process(in[i]);
+
+	for (i = 0; i < n; i++) {
+		double acc = 0;
+		for (k = 0; k < taps && k <= i; k++)
+			acc += (double)h[k] * in[i - k];
+		err = fmax(err, fabs(acc - out[i]));
+	}
+	check(err < 1e-5, "FIRFilterF32 random (max error %g)", err);
+}
+
+static void testMovingMedianNaN(void)
+{
+	MovingMedian<float, 5> median;
+	float m = 0;
+	int i;
+
+	for (i = 0; i < 20; i++)
+		m = median.add(i % 4 == 0 ? NAN : (float)i);
+	// Window holds 14, 15, 17, 18, 19
+	check(m == 17 && median.size() == 5, "MovingMedian skips NaN");
+}
+
+static void testScaleShiftLimits(void)
+{
+	const q15_t a[3] = { 100, -100, 32767 };
+	const q31_t b[3] = { 100, -100, INT32_MAX };
+	q15_t c[3];
+	q31_t d[3];
+
+	dspScaleQ15(a, 16384, 40, c, 3);
+	check(c[0] == 32767 && c[1] == -32768 && c[2] == 32767, "dspScaleQ15 large shift");
+	dspScaleQ15(a, 16384, -40, c, 3);
+	check(c[0] == 0 && c[1] == -1 && c[2] == 0, "dspScaleQ15 small shift");
+	dspScaleQ31(b, 1 << 30, 100, d, 3);
+	check(d[0] == INT32_MAX && d[1] == INT32_MIN && d[2] == INT32_MAX, "dspScaleQ31 large shift");
+	dspScaleQ31(b, 1 << 30, -100, d, 3);
+	check(d[0] == 0 && d[1] == -1 && d[2] == 0, "dspScaleQ31 small shift");
+}
+
+int main(void)
+{
+	srand(1);
+
+	testComplexFFTVector();
+	testRealFFTVector();
+	testComplexFFTRandom();
+	testRealFFTRandom();
+	testFIRQ15Vector();
+	testFIRF32Random();
+	testMovingMedianNaN();
+	testScaleShiftLimits();
+
+	return checkResult();
+}
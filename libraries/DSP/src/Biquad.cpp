@@ -0,0 +1,114 @@
+/*
+  Biquad.cpp - Cascaded second order IIR sections in q15 and float
+  Copyright (c) 2016 Energia.  All right reserved.
+
+  The q15 sections keep x[n-1], x[n-2] and y[n-1], y[n-2] packed in one
+  word each, so both feedforward and both feedback taps are a single
+  SMLALD. Each stage runs over the whole block before the next one starts,
+  which keeps its coefficients and state in registers.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "Biquad.h"
+
+void BiquadCascadeQ15::begin(const q15_t *coeffs, uint8_t numStages, q15_t *state, uint8_t postShift)
+{
+	this->coeffs = coeffs;
+	this->numStages = numStages;
+	this->state = state;
+	this->postShift = postShift;
+	reset();
+}
+
+void BiquadCascadeQ15::reset(void)
+{
+	memset(state, 0, numStages * 4 * sizeof(q15_t));
+}
+
+void BiquadCascadeQ15::process(const q15_t *in, q15_t *out, size_t n)
+{
+	const int shift = 15 - postShift;
+	const q15_t *c = coeffs;
+	q15_t *st = state;
+	uint8_t stage;
+	size_t i;
+
+	for (stage = 0; stage < numStages; stage++, c += 5, st += 4) {
+		const int32_t b0 = c[0];
+		const uint32_t b12 = dspRead2Q15(c + 1);
+		const uint32_t a12 = dspRead2Q15(c + 3);
+		uint32_t xs = dspRead2Q15(st);          // x[n-1] low, x[n-2] high
+		uint32_t ys = dspRead2Q15(st + 2);      // y[n-1] low, y[n-2] high
+
+		for (i = 0; i < n; i++) {
+			q15_t x = in[i];
+			int64_t acc = (int64_t)b0 * x;
+			q15_t y;
+
+			acc = dspSmlald(b12, xs, acc);
+			acc -= dspSmlald(a12, ys, 0);
+			y = dspSsat((int32_t)(acc >> shift), 16);
+
+			xs = (xs << 16) | (uint16_t)x;
+			ys = (ys << 16) | (uint16_t)y;
+			out[i] = y;
+		}
+		dspWrite2Q15(st, xs);
+		dspWrite2Q15(st + 2, ys);
+
+		// Later stages filter the output in place
+		in = out;
+	}
+}
+
+void BiquadCascadeF32::begin(const float *coeffs, uint8_t numStages, float *state)
+{
+	this->coeffs = coeffs;
+	this->numStages = numStages;
+	this->state = state;
+	reset();
+}
+
+void BiquadCascadeF32::reset(void)
+{
+	memset(state, 0, numStages * 2 * sizeof(float));
+}
+
+void BiquadCascadeF32::process(const float *in, float *out, size_t n)
+{
+	const float *c = coeffs;
+	float *st = state;
+	uint8_t stage;
+	size_t i;
+
+	for (stage = 0; stage < numStages; stage++, c += 5, st += 2) {
+		const float b0 = c[0], b1 = c[1], b2 = c[2], a1 = c[3], a2 = c[4];
+		float d1 = st[0], d2 = st[1];
+
+		for (i = 0; i < n; i++) {
+			float x = in[i];
+			float y = b0 * x + d1;
+
+			d1 = b1 * x - a1 * y + d2;
+			d2 = b2 * x - a2 * y;
+			out[i] = y;
+		}
+		st[0] = d1;
+		st[1] = d2;
+
+		in = out;
+	}
+}
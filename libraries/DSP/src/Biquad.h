@@ -0,0 +1,70 @@
+/*
+  Biquad.h - Cascaded second order IIR sections in q15 and float
+  Copyright (c) 2016 Energia.  All right reserved.
+
+  Each stage implements
+
+            b0 + b1 z^-1 + b2 z^-2
+    H(z) = ------------------------
+            1 + a1 z^-1 + a2 z^-2
+
+  with five coefficients per stage in the order b0, b1, b2, a1, a2. Note
+  the sign of a1 and a2: they are the denominator coefficients as given
+  by most filter design tools, not negated.
+
+  The q15 coefficients are scaled by 2^(15 - postShift) so that values up
+  to +-2^postShift can be represented; a postShift of 1 covers every stable
+  section. The caller owns the coefficient and state arrays, the state
+  holds 4 values per stage for q15 and 2 for float.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef Biquad_h
+#define Biquad_h
+
+#include <stddef.h>
+#include "DSPMath.h"
+
+// Direct form I, state per stage: x[n-1], x[n-2], y[n-1], y[n-2]
+class BiquadCascadeQ15 {
+public:
+	void begin(const q15_t *coeffs, uint8_t numStages, q15_t *state, uint8_t postShift = 1);
+	void reset(void);
+	void process(const q15_t *in, q15_t *out, size_t n);
+	q15_t process(q15_t in) { q15_t out; process(&in, &out, 1); return out; }
+
+private:
+	const q15_t *coeffs;
+	q15_t *state;
+	uint8_t numStages;
+	uint8_t postShift;
+};
+
+// Direct form II transposed, state per stage: d1, d2
+class BiquadCascadeF32 {
+public:
+	void begin(const float *coeffs, uint8_t numStages, float *state);
+	void reset(void);
+	void process(const float *in, float *out, size_t n);
+	float process(float in) { float out; process(&in, &out, 1); return out; }
+
+private:
+	const float *coeffs;
+	float *state;
+	uint8_t numStages;
+};
+
+#endif
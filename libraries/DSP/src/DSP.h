@@ -0,0 +1,38 @@
+/*
+  DSP.h - Signal processing kernels for the Cortex-M4F
+  Copyright (c) 2016 Energia.  All right reserved.
+
+  Includes all parts of the library:
+    DSPMath.h       q15/q31 types, DSP extension intrinsics, fast sqrt/atan2
+    DSPVector.h     add, sub, mul, scale, abs, dot product, conversions
+    FIRFilter.h     block FIR filters, q15 and float
+    Biquad.h        cascaded biquad IIR filters, q15 and float
+    FFT.h           complex and real float FFT
+    MovingFilter.h  moving average and moving median
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef DSP_h
+#define DSP_h
+
+#include "DSPMath.h"
+#include "DSPVector.h"
+#include "FIRFilter.h"
+#include "Biquad.h"
+#include "FFT.h"
+#include "MovingFilter.h"
+
+#endif
@@ -0,0 +1,216 @@
+/*
+  DSPMath.h - Fixed point types, SIMD intrinsics and fast math for the DSP library
+  Copyright (c) 2016 Energia.  All right reserved.
+
+  q15_t holds a fraction in [-1, 1) scaled by 2^15, q31_t one scaled by
+  2^31. The intrinsics map to the Cortex-M4 DSP extension instructions
+  (packed 16 bit multiply-accumulate and saturating arithmetic) and fall
+  back to plain C on compilers without __ARM_FEATURE_DSP, which gives the
+  same results bit for bit.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef DSPMath_h
+#define DSPMath_h
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+typedef int16_t q15_t;
+typedef int32_t q31_t;
+
+#define DSP_INLINE static inline __attribute__((always_inline))
+
+#define DSP_PI 3.14159265358979f
+
+// Two q15 values from memory as one word, the first one in the low half.
+// The address only needs to be 2 byte aligned.
+DSP_INLINE uint32_t dspRead2Q15(const q15_t *p)
+{
+	uint32_t v;
+	memcpy(&v, p, 4);
+	return v;
+}
+
+DSP_INLINE void dspWrite2Q15(q15_t *p, uint32_t v)
+{
+	memcpy(p, &v, 4);
+}
+
+DSP_INLINE uint32_t dspPack2Q15(q15_t lo, q15_t hi)
+{
+	return (uint16_t)lo | ((uint32_t)(uint16_t)hi << 16);
+}
+
+#if defined(__ARM_FEATURE_DSP)
+
+// Saturate to a signed value of the given bit width
+#define dspSsat(x, bits) __extension__ ({ int32_t __r, __x = (x); \
+	__asm ("ssat %0, %1, %2" : "=r" (__r) : "I" (bits), "r" (__x)); __r; })
+
+DSP_INLINE int32_t dspQadd(int32_t a, int32_t b)
+{
+	int32_t r;
+	__asm ("qadd %0, %1, %2" : "=r" (r) : "r" (a), "r" (b));
+	return r;
+}
+
+DSP_INLINE int32_t dspQsub(int32_t a, int32_t b)
+{
+	int32_t r;
+	__asm ("qsub %0, %1, %2" : "=r" (r) : "r" (a), "r" (b));
+	return r;
+}
+
+DSP_INLINE uint32_t dspQadd16(uint32_t a, uint32_t b)
+{
+	uint32_t r;
+	__asm ("qadd16 %0, %1, %2" : "=r" (r) : "r" (a), "r" (b));
+	return r;
+}
+
+DSP_INLINE uint32_t dspQsub16(uint32_t a, uint32_t b)
+{
+	uint32_t r;
+	__asm ("qsub16 %0, %1, %2" : "=r" (r) : "r" (a), "r" (b));
+	return r;
+}
+
+// lo(a) * lo(b) + hi(a) * hi(b)
+DSP_INLINE int32_t dspSmuad(uint32_t a, uint32_t b)
+{
+	int32_t r;
+	__asm ("smuad %0, %1, %2" : "=r" (r) : "r" (a), "r" (b));
+	return r;
+}
+
+// acc + lo(a) * lo(b) + hi(a) * hi(b)
+DSP_INLINE int32_t dspSmlad(uint32_t a, uint32_t b, int32_t acc)
+{
+	int32_t r;
+	__asm ("smlad %0, %1, %2, %3" : "=r" (r) : "r" (a), "r" (b), "r" (acc));
+	return r;
+}
+
+// 64 bit acc + lo(a) * lo(b) + hi(a) * hi(b)
+DSP_INLINE int64_t dspSmlald(uint32_t a, uint32_t b, int64_t acc)
+{
+	__asm ("smlald %Q0, %R0, %1, %2" : "+r" (acc) : "r" (a), "r" (b));
+	return acc;
+}
+
+// 64 bit acc + lo(a) * hi(b) + hi(a) * lo(b)
+DSP_INLINE int64_t dspSmlaldx(uint32_t a, uint32_t b, int64_t acc)
+{
+	__asm ("smlaldx %Q0, %R0, %1, %2" : "+r" (acc) : "r" (a), "r" (b));
+	return acc;
+}
+
+#else
+
+DSP_INLINE int32_t dspSsatC(int32_t x, int bits)
+{
+	int32_t max = (1L << (bits - 1)) - 1;
+	return x > max ? max : (x < -max - 1 ? -max - 1 : x);
+}
+#define dspSsat(x, bits) dspSsatC((x), (bits))
+
+DSP_INLINE int32_t dspQadd(int32_t a, int32_t b)
+{
+	int64_t r = (int64_t)a + b;
+	return r > INT32_MAX ? INT32_MAX : (r < INT32_MIN ? INT32_MIN : (int32_t)r);
+}
+
+DSP_INLINE int32_t dspQsub(int32_t a, int32_t b)
+{
+	int64_t r = (int64_t)a - b;
+	return r > INT32_MAX ? INT32_MAX : (r < INT32_MIN ? INT32_MIN : (int32_t)r);
+}
+
+DSP_INLINE uint32_t dspQadd16(uint32_t a, uint32_t b)
+{
+	return dspPack2Q15(dspSsatC((q15_t)a + (q15_t)b, 16),
+			dspSsatC((q15_t)(a >> 16) + (q15_t)(b >> 16), 16));
+}
+
+DSP_INLINE uint32_t dspQsub16(uint32_t a, uint32_t b)
+{
+	return dspPack2Q15(dspSsatC((q15_t)a - (q15_t)b, 16),
+			dspSsatC((q15_t)(a >> 16) - (q15_t)(b >> 16), 16));
+}
+
+DSP_INLINE int32_t dspSmuad(uint32_t a, uint32_t b)
+{
+	return (int32_t)((q15_t)a * (q15_t)b + (uint32_t)((q15_t)(a >> 16) * (q15_t)(b >> 16)));
+}
+
+DSP_INLINE int32_t dspSmlad(uint32_t a, uint32_t b, int32_t acc)
+{
+	return (int32_t)((uint32_t)acc + (uint32_t)dspSmuad(a, b));
+}
+
+DSP_INLINE int64_t dspSmlald(uint32_t a, uint32_t b, int64_t acc)
+{
+	return acc + (int32_t)(q15_t)a * (q15_t)b + (int32_t)(q15_t)(a >> 16) * (q15_t)(b >> 16);
+}
+
+DSP_INLINE int64_t dspSmlaldx(uint32_t a, uint32_t b, int64_t acc)
+{
+	return acc + (int32_t)(q15_t)a * (q15_t)(b >> 16) + (int32_t)(q15_t)(a >> 16) * (q15_t)b;
+}
+
+#endif
+
+//
+// Fast math
+//
+
+// Single instruction square root on the FPU, no errno handling
+DSP_INLINE float dspSqrtF32(float x)
+{
+#if defined(__ARM_FP) && defined(__arm__)
+	float r;
+	__asm ("vsqrt.f32 %0, %1" : "=t" (r) : "t" (x));
+	return r;
+#else
+	return sqrtf(x);
+#endif
+}
+
+// atan2 with a polynomial, absolute error below 1e-5 rad
+DSP_INLINE float dspAtan2F32(float y, float x)
+{
+	float ax = fabsf(x), ay = fabsf(y);
+	float mx = ax > ay ? ax : ay;
+	float mn = ax > ay ? ay : ax;
+	float a, s, r;
+
+	if (mx == 0.0f)
+		return 0.0f;
+	a = mn / mx;
+	s = a * a;
+	r = ((((-0.0117212f * s + 0.05265332f) * s - 0.11643287f) * s
+		+ 0.19354346f) * s - 0.33262347f) * s + 0.99997726f;
+	r *= a;
+	if (ay > ax)
+		r = DSP_PI / 2 - r;
+	if (x < 0.0f)
+		r = DSP_PI - r;
+	return y < 0.0f ? -r : r;
+}
+
+#endif
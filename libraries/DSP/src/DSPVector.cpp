@@ -0,0 +1,260 @@
+/*
+  DSPVector.cpp - Vector operations on q15, q31 and float arrays
+  Copyright (c) 2016 Energia.  All right reserved.
+
+  The q15 loops work on two samples per word with the packed 16 bit
+  instructions, the float loops are unrolled by four so the FPU pipeline
+  has independent operations to overlap.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "DSPVector.h"
+
+static inline q31_t sat31(int64_t x)
+{
+	return x > INT32_MAX ? INT32_MAX : (x < INT32_MIN ? INT32_MIN : (q31_t)x);
+}
+
+//
+// Add / subtract
+//
+void dspAddQ15(const q15_t *a, const q15_t *b, q15_t *dst, size_t n)
+{
+	for (; n >= 2; n -= 2, a += 2, b += 2, dst += 2)
+		dspWrite2Q15(dst, dspQadd16(dspRead2Q15(a), dspRead2Q15(b)));
+	if (n)
+		*dst = dspSsat(*a + *b, 16);
+}
+
+void dspAddQ31(const q31_t *a, const q31_t *b, q31_t *dst, size_t n)
+{
+	while (n--)
+		*dst++ = dspQadd(*a++, *b++);
+}
+
+void dspAddF32(const float *a, const float *b, float *dst, size_t n)
+{
+	for (; n >= 4; n -= 4, a += 4, b += 4, dst += 4) {
+		float a0 = a[0], a1 = a[1], a2 = a[2], a3 = a[3];
+		dst[0] = a0 + b[0];
+		dst[1] = a1 + b[1];
+		dst[2] = a2 + b[2];
+		dst[3] = a3 + b[3];
+	}
+	while (n--)
+		*dst++ = *a++ + *b++;
+}
+
+void dspSubQ15(const q15_t *a, const q15_t *b, q15_t *dst, size_t n)
+{
+	for (; n >= 2; n -= 2, a += 2, b += 2, dst += 2)
+		dspWrite2Q15(dst, dspQsub16(dspRead2Q15(a), dspRead2Q15(b)));
+	if (n)
+		*dst = dspSsat(*a - *b, 16);
+}
+
+void dspSubQ31(const q31_t *a, const q31_t *b, q31_t *dst, size_t n)
+{
+	while (n--)
+		*dst++ = dspQsub(*a++, *b++);
+}
+
+void dspSubF32(const float *a, const float *b, float *dst, size_t n)
+{
+	for (; n >= 4; n -= 4, a += 4, b += 4, dst += 4) {
+		float a0 = a[0], a1 = a[1], a2 = a[2], a3 = a[3];
+		dst[0] = a0 - b[0];
+		dst[1] = a1 - b[1];
+		dst[2] = a2 - b[2];
+		dst[3] = a3 - b[3];
+	}
+	while (n--)
+		*dst++ = *a++ - *b++;
+}
+
+//
+// Multiply
+//
+void dspMulQ15(const q15_t *a, const q15_t *b, q15_t *dst, size_t n)
+{
+	while (n--)
+		*dst++ = dspSsat(((int32_t)*a++ * *b++) >> 15, 16);
+}
+
+void dspMulQ31(const q31_t *a, const q31_t *b, q31_t *dst, size_t n)
+{
+	while (n--)
+		*dst++ = sat31(((int64_t)*a++ * *b++) >> 31);
+}
+
+void dspMulF32(const float *a, const float *b, float *dst, size_t n)
+{
+	for (; n >= 4; n -= 4, a += 4, b += 4, dst += 4) {
+		float a0 = a[0], a1 = a[1], a2 = a[2], a3 = a[3];
+		dst[0] = a0 * b[0];
+		dst[1] = a1 * b[1];
+		dst[2] = a2 * b[2];
+		dst[3] = a3 * b[3];
+	}
+	while (n--)
+		*dst++ = *a++ * *b++;
+}
+
+//
+// Scale
+//
+void dspScaleQ15(const q15_t *src, q15_t scale, int8_t shift, q15_t *dst, size_t n)
+{
+	int rshift = 15 - shift;
+
+	if (rshift < 0)
+		rshift = 0;
+	else if (rshift > 31)
+		rshift = 31;
+	while (n--)
+		*dst++ = dspSsat(((int32_t)*src++ * scale) >> rshift, 16);
+}
+
+void dspScaleQ31(const q31_t *src, q31_t scale, int8_t shift, q31_t *dst, size_t n)
+{
+	int rshift = 31 - shift;
+
+	if (rshift < 0)
+		rshift = 0;
+	else if (rshift > 63)
+		rshift = 63;
+	while (n--)
+		*dst++ = sat31(((int64_t)*src++ * scale) >> rshift);
+}
+
+void dspScaleF32(const float *src, float scale, float *dst, size_t n)
+{
+	for (; n >= 4; n -= 4, src += 4, dst += 4) {
+		float s0 = src[0], s1 = src[1], s2 = src[2], s3 = src[3];
+		dst[0] = s0 * scale;
+		dst[1] = s1 * scale;
+		dst[2] = s2 * scale;
+		dst[3] = s3 * scale;
+	}
+	while (n--)
+		*dst++ = *src++ * scale;
+}
+
+//
+// Absolute value
+//
+void dspAbsQ15(const q15_t *src, q15_t *dst, size_t n)
+{
+	while (n--) {
+		q15_t v = *src++;
+		*dst++ = v < 0 ? (v == INT16_MIN ? INT16_MAX : -v) : v;
+	}
+}
+
+void dspAbsQ31(const q31_t *src, q31_t *dst, size_t n)
+{
+	while (n--) {
+		q31_t v = *src++;
+		*dst++ = v < 0 ? (v == INT32_MIN ? INT32_MAX : -v) : v;
+	}
+}
+
+void dspAbsF32(const float *src, float *dst, size_t n)
+{
+	while (n--)
+		*dst++ = fabsf(*src++);
+}
+
+//
+// Dot product
+//
+int64_t dspDotQ15(const q15_t *a, const q15_t *b, size_t n)
+{
+	int64_t acc = 0;
+
+	for (; n >= 4; n -= 4, a += 4, b += 4) {
+		acc = dspSmlald(dspRead2Q15(a), dspRead2Q15(b), acc);
+		acc = dspSmlald(dspRead2Q15(a + 2), dspRead2Q15(b + 2), acc);
+	}
+	while (n--)
+		acc += (int32_t)*a++ * *b++;
+	return acc;
+}
+
+int64_t dspDotQ31(const q31_t *a, const q31_t *b, size_t n)
+{
+	int64_t acc = 0;
+
+	while (n--)
+		acc += ((int64_t)*a++ * *b++) >> 14;
+	return acc;
+}
+
+float dspDotF32(const float *a, const float *b, size_t n)
+{
+	float acc0 = 0.0f, acc1 = 0.0f, acc2 = 0.0f, acc3 = 0.0f;
+
+	for (; n >= 4; n -= 4, a += 4, b += 4) {
+		acc0 += a[0] * b[0];
+		acc1 += a[1] * b[1];
+		acc2 += a[2] * b[2];
+		acc3 += a[3] * b[3];
+	}
+	while (n--)
+		acc0 += *a++ * *b++;
+	return (acc0 + acc1) + (acc2 + acc3);
+}
+
+//
+// Conversions
+//
+void dspQ15ToF32(const q15_t *src, float *dst, size_t n)
+{
+	while (n--)
+		*dst++ = *src++ * (1.0f / 32768.0f);
+}
+
+void dspQ31ToF32(const q31_t *src, float *dst, size_t n)
+{
+	while (n--)
+		*dst++ = *src++ * (1.0f / 2147483648.0f);
+}
+
+void dspF32ToQ15(const float *src, q15_t *dst, size_t n)
+{
+	while (n--) {
+		float v = *src++ * 32768.0f;
+		v += v >= 0.0f ? 0.5f : -0.5f;
+		*dst++ = v >= 32767.0f ? INT16_MAX : (v <= -32768.0f ? INT16_MIN : (q15_t)v);
+	}
+}
+
+void dspF32ToQ31(const float *src, q31_t *dst, size_t n)
+{
+	while (n--) {
+		float v = *src++ * 2147483648.0f;
+		*dst++ = v >= 2147483647.0f ? INT32_MAX : (v <= -2147483648.0f ? INT32_MIN : (q31_t)v);
+	}
+}
+
+void dspMagnitudeF32(const float *src, float *dst, size_t n)
+{
+	while (n--) {
+		float re = src[0], im = src[1];
+		*dst++ = dspSqrtF32(re * re + im * im);
+		src += 2;
+	}
+}
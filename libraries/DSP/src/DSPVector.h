@@ -0,0 +1,71 @@
+/*
+  DSPVector.h - Vector operations on q15, q31 and float arrays
+  Copyright (c) 2016 Energia.  All right reserved.
+
+  All functions take the element count n and allow dst to be the same
+  array as a source. Fixed point results saturate instead of wrapping.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef DSPVector_h
+#define DSPVector_h
+
+#include <stddef.h>
+#include "DSPMath.h"
+
+// dst = a + b
+void dspAddQ15(const q15_t *a, const q15_t *b, q15_t *dst, size_t n);
+void dspAddQ31(const q31_t *a, const q31_t *b, q31_t *dst, size_t n);
+void dspAddF32(const float *a, const float *b, float *dst, size_t n);
+
+// dst = a - b
+void dspSubQ15(const q15_t *a, const q15_t *b, q15_t *dst, size_t n);
+void dspSubQ31(const q31_t *a, const q31_t *b, q31_t *dst, size_t n);
+void dspSubF32(const float *a, const float *b, float *dst, size_t n);
+
+// dst = a * b, element by element
+void dspMulQ15(const q15_t *a, const q15_t *b, q15_t *dst, size_t n);
+void dspMulQ31(const q31_t *a, const q31_t *b, q31_t *dst, size_t n);
+void dspMulF32(const float *a, const float *b, float *dst, size_t n);
+
+// dst = src * scale * 2^shift (shift may be negative for the fixed point ones).
+// shift is limited to -16..15 for Q15 and -32..31 for Q31.
+void dspScaleQ15(const q15_t *src, q15_t scale, int8_t shift, q15_t *dst, size_t n);
+void dspScaleQ31(const q31_t *src, q31_t scale, int8_t shift, q31_t *dst, size_t n);
+void dspScaleF32(const float *src, float scale, float *dst, size_t n);
+
+// dst = |src|
+void dspAbsQ15(const q15_t *src, q15_t *dst, size_t n);
+void dspAbsQ31(const q31_t *src, q31_t *dst, size_t n);
+void dspAbsF32(const float *src, float *dst, size_t n);
+
+// Sum of a[i] * b[i]. The q15 result is in 34.30 format, the q31 one in
+// 16.48 format (each product shifted right by 14), no intermediate
+// overflow for any n below 2^16.
+int64_t dspDotQ15(const q15_t *a, const q15_t *b, size_t n);
+int64_t dspDotQ31(const q31_t *a, const q31_t *b, size_t n);
+float dspDotF32(const float *a, const float *b, size_t n);
+
+// Format conversions, float values outside [-1, 1) saturate
+void dspQ15ToF32(const q15_t *src, float *dst, size_t n);
+void dspQ31ToF32(const q31_t *src, float *dst, size_t n);
+void dspF32ToQ15(const float *src, q15_t *dst, size_t n);
+void dspF32ToQ31(const float *src, q31_t *dst, size_t n);
+
+// Magnitude of interleaved complex (re, im) float data, n complex values
+void dspMagnitudeF32(const float *src, float *dst, size_t n);
+
+#endif
@@ -0,0 +1,256 @@
+/*
+  FFT.cpp - Complex and real float FFT
+  Copyright (c) 2016 Energia.  All right reserved.
+
+  Radix-2^2 decimation in frequency: two radix-2 stages are fused into
+  one pass with radix-4 butterflies, so a pass costs three complex
+  multiplies per four points, and the output stays in plain bit reversed
+  order. An odd number of radix-2 stages ends with one twiddle-free
+  radix-2 pass. Twiddles come from a single cosine table, the sine is
+  the same table a quarter period further on.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <stdlib.h>
+#include "FFT.h"
+
+#define FFT_MAX 4096
+
+static bool powerOfTwo(uint16_t n)
+{
+	return n >= 4 && n <= FFT_MAX && !(n & (n - 1));
+}
+
+// cos(2 pi k / n) for k = 0 .. n-1
+static float *makeTable(uint16_t n)
+{
+	float *t = (float *)malloc(n * sizeof(float));
+	uint16_t k;
+
+	if (!t)
+		return NULL;
+	for (k = 0; k < n; k++)
+		t[k] = cosf(2 * DSP_PI * k / n);
+	return t;
+}
+
+static void bitReverse(float *x, uint16_t n)
+{
+	uint16_t i, j = 0, bit;
+
+	for (i = 1; i < n; i++) {
+		for (bit = n >> 1; j & bit; bit >>= 1)
+			j ^= bit;
+		j |= bit;
+		if (i < j) {
+			float re = x[2 * i], im = x[2 * i + 1];
+			x[2 * i] = x[2 * j];
+			x[2 * i + 1] = x[2 * j + 1];
+			x[2 * j] = re;
+			x[2 * j + 1] = im;
+		}
+	}
+}
+
+//
+// Forward transform of n complex values, table holds tableSize cosines
+// with tableSize a multiple of n
+//
+static void cfft(float *x, uint16_t n, const float *table, uint16_t tableSize)
+{
+	const uint16_t mask = tableSize - 1;
+	const uint16_t quarter = tableSize / 4;
+	uint16_t stride = tableSize / n;
+	uint16_t len, q, j, i;
+
+	for (len = n; len >= 4; len >>= 2, stride <<= 2) {
+		q = len / 4;
+		for (j = 0; j < q; j++) {
+			// W^k = cos - j sin, for k = j, 2j, 3j at this stage's stride
+			uint16_t k1 = j * stride, k2 = 2 * k1, k3 = 3 * k1;
+			float c1 = table[k1], s1 = table[(k1 + 3 * quarter) & mask];
+			float c2 = table[k2 & mask], s2 = table[(k2 + 3 * quarter) & mask];
+			float c3 = table[k3 & mask], s3 = table[(k3 + 3 * quarter) & mask];
+
+			for (i = j; i < n; i += len) {
+				float *a = x + 2 * i, *b = a + 2 * q, *c = b + 2 * q, *d = c + 2 * q;
+				float t0r = a[0] + c[0], t0i = a[1] + c[1];
+				float t1r = a[0] - c[0], t1i = a[1] - c[1];
+				float t2r = b[0] + d[0], t2i = b[1] + d[1];
+				float t3r = b[0] - d[0], t3i = b[1] - d[1];
+				float ur = t0r - t2r, ui = t0i - t2i;
+				float vr = t1r + t3i, vi = t1i - t3r;   // t1 - j t3
+				float wr = t1r - t3i, wi = t1i + t3r;   // t1 + j t3
+
+				a[0] = t0r + t2r;
+				a[1] = t0i + t2i;
+				b[0] = ur * c2 + ui * s2;
+				b[1] = ui * c2 - ur * s2;
+				c[0] = vr * c1 + vi * s1;
+				c[1] = vi * c1 - vr * s1;
+				d[0] = wr * c3 + wi * s3;
+				d[1] = wi * c3 - wr * s3;
+			}
+		}
+	}
+
+	if (len == 2) {
+		for (i = 0; i < n; i += 2) {
+			float *a = x + 2 * i;
+			float br = a[2], bi = a[3];
+			a[2] = a[0] - br;
+			a[3] = a[1] - bi;
+			a[0] += br;
+			a[1] += bi;
+		}
+	}
+
+	bitReverse(x, n);
+}
+
+// conj(fft(conj(x))) / n
+static void icfft(float *x, uint16_t n, const float *table, uint16_t tableSize)
+{
+	const float scale = 1.0f / n;
+	uint16_t i;
+
+	for (i = 0; i < n; i++)
+		x[2 * i + 1] = -x[2 * i + 1];
+	cfft(x, n, table, tableSize);
+	for (i = 0; i < n; i++) {
+		x[2 * i] *= scale;
+		x[2 * i + 1] *= -scale;
+	}
+}
+
+//
+// ComplexFFT
+//
+bool ComplexFFT::begin(uint16_t n)
+{
+	end();
+	if (!powerOfTwo(n) || !(cosTable = makeTable(n)))
+		return false;
+	size = n;
+	return true;
+}
+
+void ComplexFFT::end(void)
+{
+	free(cosTable);
+	cosTable = NULL;
+	size = 0;
+}
+
+void ComplexFFT::forward(float *data)
+{
+	if (size)
+		cfft(data, size, cosTable, size);
+}
+
+void ComplexFFT::inverse(float *data)
+{
+	if (size)
+		icfft(data, size, cosTable, size);
+}
+
+//
+// RealFFT: the n reals are treated as n/2 complex values z[m] = x[2m] +
+// j x[2m+1]. With Z = fft(z), the even and odd sample spectra are
+//   E[k] = (Z[k] + conj(Z[n/2-k])) / 2
+//   O[k] = (Z[k] - conj(Z[n/2-k])) / 2j
+// and X[k] = E[k] + W^k O[k], X[n/2-k] = conj(E[k] - W^k O[k]).
+//
+bool RealFFT::begin(uint16_t n)
+{
+	end();
+	if (n < 8 || !powerOfTwo(n) || !(cosTable = makeTable(n)))
+		return false;
+	size = n;
+	return true;
+}
+
+void RealFFT::end(void)
+{
+	free(cosTable);
+	cosTable = NULL;
+	size = 0;
+}
+
+void RealFFT::forward(float *data)
+{
+	const uint16_t half = size / 2, quarter = size / 4;
+	uint16_t k;
+	float z0r, z0i;
+
+	if (!size)
+		return;
+	cfft(data, half, cosTable, size);
+
+	z0r = data[0];
+	z0i = data[1];
+	data[0] = z0r + z0i;
+	data[1] = z0r - z0i;
+
+	for (k = 1; k <= half / 2; k++) {
+		float *zk = data + 2 * k, *zm = data + 2 * (half - k);
+		float c = cosTable[k], s = cosTable[(k + 3 * quarter) & (size - 1)];
+		float er = 0.5f * (zk[0] + zm[0]), ei = 0.5f * (zk[1] - zm[1]);
+		float orr = 0.5f * (zk[1] + zm[1]), oi = -0.5f * (zk[0] - zm[0]);
+		float wr = c * orr + s * oi, wi = c * oi - s * orr;
+
+		zk[0] = er + wr;
+		zk[1] = ei + wi;
+		if (zm != zk) {
+			zm[0] = er - wr;
+			zm[1] = wi - ei;
+		}
+	}
+}
+
+void RealFFT::inverse(float *data)
+{
+	const uint16_t half = size / 2, quarter = size / 4;
+	uint16_t k;
+	float x0, xm;
+
+	if (!size)
+		return;
+
+	x0 = data[0];
+	xm = data[1];
+	data[0] = 0.5f * (x0 + xm);
+	data[1] = 0.5f * (x0 - xm);
+
+	for (k = 1; k <= half / 2; k++) {
+		float *xk = data + 2 * k, *xn = data + 2 * (half - k);
+		float c = cosTable[k], s = cosTable[(k + 3 * quarter) & (size - 1)];
+		float er = 0.5f * (xk[0] + xn[0]), ei = 0.5f * (xk[1] - xn[1]);
+		float dr = 0.5f * (xk[0] - xn[0]), di = 0.5f * (xk[1] + xn[1]);
+		// O = D * conj(W^k) = D * (c + j s)
+		float orr = dr * c - di * s, oi = dr * s + di * c;
+
+		// Z[k] = E + jO, Z[n/2-k] = conj(E) + j conj(O)
+		xk[0] = er - oi;
+		xk[1] = ei + orr;
+		if (xn != xk) {
+			xn[0] = er + oi;
+			xn[1] = orr - ei;
+		}
+	}
+
+	icfft(data, half, cosTable, size);
+}
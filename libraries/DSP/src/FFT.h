@@ -0,0 +1,67 @@
+/*
+  FFT.h - Complex and real float FFT
+  Copyright (c) 2016 Energia.  All right reserved.
+
+  ComplexFFT transforms n interleaved (re, im) values in place, n a power
+  of two from 4 to 4096. RealFFT transforms n real samples in place using
+  a complex FFT of half the length; its spectrum is packed as
+
+    data[0] = X[0].re, data[1] = X[n/2].re,
+    data[2k] = X[k].re, data[2k+1] = X[k].im   for k = 1 .. n/2 - 1
+
+  since X[0] and X[n/2] are real. begin() allocates a cosine table of n
+  floats, end() frees it. The forward transforms are unscaled, the
+  inverse ones divide by n so that inverse(forward(x)) == x.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef FFT_h
+#define FFT_h
+
+#include <stddef.h>
+#include "DSPMath.h"
+
+class ComplexFFT {
+public:
+	ComplexFFT() : cosTable(NULL), size(0) {}
+	~ComplexFFT() { end(); }
+	bool begin(uint16_t n);
+	void end(void);
+	void forward(float *data);
+	void inverse(float *data);
+	uint16_t length(void) { return size; }
+
+private:
+	float *cosTable;
+	uint16_t size;
+};
+
+class RealFFT {
+public:
+	RealFFT() : cosTable(NULL), size(0) {}
+	~RealFFT() { end(); }
+	bool begin(uint16_t n);
+	void end(void);
+	void forward(float *data);
+	void inverse(float *data);
+	uint16_t length(void) { return size; }
+
+private:
+	float *cosTable;
+	uint16_t size;
+};
+
+#endif
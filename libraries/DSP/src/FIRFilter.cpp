@@ -0,0 +1,125 @@
+/*
+  FIRFilter.cpp - Block FIR filters in q15 and float
+  Copyright (c) 2016 Energia.  All right reserved.
+
+  New samples are appended to the history in the state array so every
+  output is a dot product over contiguous memory. The q15 filter reads
+  coefficient and sample pairs as words and multiplies them crosswise with
+  SMLALDX into a 64 bit accumulator, two taps per instruction.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "FIRFilter.h"
+
+void FIRFilterQ15::begin(const q15_t *coeffs, uint16_t numTaps, q15_t *state, uint16_t blockSize)
+{
+	this->coeffs = coeffs;
+	this->numTaps = numTaps;
+	this->state = state;
+	this->blockSize = blockSize;
+	reset();
+}
+
+void FIRFilterQ15::reset(void)
+{
+	memset(state, 0, (numTaps + blockSize - 1) * sizeof(q15_t));
+}
+
+void FIRFilterQ15::process(const q15_t *in, q15_t *out, size_t n)
+{
+	const uint16_t history = numTaps - 1;
+
+	while (n) {
+		size_t m = n < blockSize ? n : blockSize;
+		size_t i;
+
+		memcpy(state + history, in, m * sizeof(q15_t));
+
+		for (i = 0; i < m; i++) {
+			// Newest sample for this output is x = state[history + i]
+			const q15_t *x = state + history + i;
+			const q15_t *h = coeffs;
+			int64_t acc = 0;
+			uint16_t k = numTaps;
+
+			// h[0] * x[0] + h[1] * x[-1] per word pair
+			for (; k >= 4; k -= 4, h += 4, x -= 4) {
+				acc = dspSmlaldx(dspRead2Q15(h), dspRead2Q15(x - 1), acc);
+				acc = dspSmlaldx(dspRead2Q15(h + 2), dspRead2Q15(x - 3), acc);
+			}
+			for (; k >= 2; k -= 2, h += 2, x -= 2)
+				acc = dspSmlaldx(dspRead2Q15(h), dspRead2Q15(x - 1), acc);
+			if (k)
+				acc += (int32_t)*h * *x;
+
+			out[i] = dspSsat((int32_t)(acc >> 15), 16);
+		}
+
+		memmove(state, state + m, history * sizeof(q15_t));
+		in += m;
+		out += m;
+		n -= m;
+	}
+}
+
+void FIRFilterF32::begin(const float *coeffs, uint16_t numTaps, float *state, uint16_t blockSize)
+{
+	this->coeffs = coeffs;
+	this->numTaps = numTaps;
+	this->state = state;
+	this->blockSize = blockSize;
+	reset();
+}
+
+void FIRFilterF32::reset(void)
+{
+	memset(state, 0, (numTaps + blockSize - 1) * sizeof(float));
+}
+
+void FIRFilterF32::process(const float *in, float *out, size_t n)
+{
+	const uint16_t history = numTaps - 1;
+
+	while (n) {
+		size_t m = n < blockSize ? n : blockSize;
+		size_t i;
+
+		memcpy(state + history, in, m * sizeof(float));
+
+		for (i = 0; i < m; i++) {
+			const float *x = state + history + i;
+			const float *h = coeffs;
+			float acc0 = 0.0f, acc1 = 0.0f, acc2 = 0.0f, acc3 = 0.0f;
+			uint16_t k = numTaps;
+
+			for (; k >= 4; k -= 4, h += 4, x -= 4) {
+				acc0 += h[0] * x[0];
+				acc1 += h[1] * x[-1];
+				acc2 += h[2] * x[-2];
+				acc3 += h[3] * x[-3];
+			}
+			while (k--)
+				acc0 += *h++ * *x--;
+
+			out[i] = (acc0 + acc1) + (acc2 + acc3);
+		}
+
+		memmove(state, state + m, history * sizeof(float));
+		in += m;
+		out += m;
+		n -= m;
+	}
+}
@@ -0,0 +1,66 @@
+/*
+  FIRFilter.h - Block FIR filters in q15 and float
+  Copyright (c) 2016 Energia.  All right reserved.
+
+  y[n] = sum of coeffs[k] * x[n - k] for k = 0 .. numTaps - 1
+
+  The caller owns the coefficient and state arrays. The state array holds
+  numTaps + blockSize - 1 samples, process() then handles up to blockSize
+  samples per internal pass and any count per call.
+
+    static const q15_t taps[16] = { ... };
+    static q15_t state[16 + 32 - 1];
+    FIRFilterQ15 fir;
+    fir.begin(taps, 16, state, 32);
+    fir.process(in, out, 32);
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef FIRFilter_h
+#define FIRFilter_h
+
+#include <stddef.h>
+#include "DSPMath.h"
+
+class FIRFilterQ15 {
+public:
+	void begin(const q15_t *coeffs, uint16_t numTaps, q15_t *state, uint16_t blockSize);
+	void reset(void);
+	void process(const q15_t *in, q15_t *out, size_t n);
+	q15_t process(q15_t in) { q15_t out; process(&in, &out, 1); return out; }
+
+private:
+	const q15_t *coeffs;
+	q15_t *state;
+	uint16_t numTaps;
+	uint16_t blockSize;
+};
+
+class FIRFilterF32 {
+public:
+	void begin(const float *coeffs, uint16_t numTaps, float *state, uint16_t blockSize);
+	void reset(void);
+	void process(const float *in, float *out, size_t n);
+	float process(float in) { float out; process(&in, &out, 1); return out; }
+
+private:
+	const float *coeffs;
+	float *state;
+	uint16_t numTaps;
+	uint16_t blockSize;
+};
+
+#endif
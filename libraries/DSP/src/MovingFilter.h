@@ -0,0 +1,145 @@
+/*
+  MovingFilter.h - Moving average and moving median over the last N samples
+  Copyright (c) 2016 Energia.  All right reserved.
+
+    MovingAverage<int16_t, 8> avg;
+    MovingMedian<uint16_t, 5> med;
+    int16_t smooth = avg.add(analogRead(A0));
+    uint16_t clean = med.add(analogRead(A1));
+
+  Until N samples have been added both filters work over the samples seen
+  so far. The average keeps a running sum in a wider type, so an update
+  costs one add and one subtract; float sums are recomputed every N
+  samples so rounding errors do not build up. The median keeps a sorted
+  copy of the window and moves at most N entries per update.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef MovingFilter_h
+#define MovingFilter_h
+
+#include <stdint.h>
+#include <string.h>
+
+// Running sum type for each sample type
+template<typename T> struct DSPAccumulator { typedef int32_t type; };
+template<> struct DSPAccumulator<int32_t> { typedef int64_t type; };
+template<> struct DSPAccumulator<uint32_t> { typedef uint64_t type; };
+template<> struct DSPAccumulator<uint16_t> { typedef uint32_t type; };
+template<> struct DSPAccumulator<uint8_t> { typedef uint32_t type; };
+template<> struct DSPAccumulator<float> { typedef float type; };
+
+template<typename T, uint16_t N>
+class MovingAverage {
+public:
+	MovingAverage() { reset(); }
+
+	void reset(void)
+	{
+		sum = 0;
+		count = 0;
+		head = 0;
+	}
+
+	T add(T sample)
+	{
+		if (count < N)
+			count++;
+		else
+			sum -= window[head];
+		window[head] = sample;
+		sum += sample;
+		if (++head == N) {
+			head = 0;
+			resync((T *)0);
+		}
+		return average();
+	}
+
+	T average(void) const { return count ? (T)(sum / count) : 0; }
+	uint16_t size(void) const { return count; }
+
+private:
+	typedef typename DSPAccumulator<T>::type Acc;
+
+	// Integer sums are exact
+	template<typename U> void resync(U *) {}
+
+	void resync(float *)
+	{
+		uint16_t i;
+		sum = 0;
+		for (i = 0; i < count; i++)
+			sum += window[i];
+	}
+
+	T window[N];
+	Acc sum;
+	uint16_t count;
+	uint16_t head;
+};
+
+template<typename T, uint16_t N>
+class MovingMedian {
+public:
+	MovingMedian() { reset(); }
+
+	void reset(void)
+	{
+		count = 0;
+		head = 0;
+	}
+
+	// NaN samples are ignored, they have no place in the sorted order
+	T add(T sample)
+	{
+		uint16_t i;
+
+		if (sample != sample)
+			return median();
+
+		if (count == N) {
+			// Drop the oldest sample from the sorted copy
+			T old = window[head];
+			for (i = 0; i < count - 1 && sorted[i] != old; i++)
+				;
+			memmove(&sorted[i], &sorted[i + 1], (count - i - 1) * sizeof(T));
+			count--;
+		}
+		window[head] = sample;
+		if (++head == N)
+			head = 0;
+
+		// Insert the new one, searching from the top
+		for (i = count; i > 0 && sorted[i - 1] > sample; i--)
+			sorted[i] = sorted[i - 1];
+		sorted[i] = sample;
+		count++;
+
+		return median();
+	}
+
+	T median(void) const { return count ? sorted[count / 2] : 0; }
+	uint16_t size(void) const { return count; }
+
+private:
+	T window[N];
+	T sorted[N];
+	uint16_t count;
+	uint16_t head;
+};
+
+#endif
@@ -4,8 +4,6 @@
 #include <lwip/inet.h>
 #include <IPAddress.h>
 
-#define ETHERNET_INT_PRIORITY   0xC0
-
 void EthernetClass::begin(uint8_t *mac_address, IPAddress local_ip, IPAddress dns_server, IPAddress gateway, IPAddress subnet)
 {
 	uint32_t ui32User0, ui32User1;
@@ -25,7 +23,7 @@ void EthernetClass::begin(uint8_t *mac_address, IPAddress local_ip, IPAddress dn
 	pui8MACArray[4] = ((ui32User1 >>  8) & 0xff);
 	pui8MACArray[5] = ((ui32User1 >> 16) & 0xff);
 
-	ROM_IntPrioritySet(INT_EMAC0, ETHERNET_INT_PRIORITY);
+	ROM_IntPrioritySet(INT_EMAC0, INT_PRIORITY_ETHERNET);
 
 	if(!subnet) {
 		if((local_ip >> 31) == CLASS_A)
@@ -6,10 +6,10 @@
 
 #include "driverlib/interrupt.h"
 
-/* directives for disabling and enabling interrupts */
-#define INT_PROTECT_INIT(x)    int x = 0
-#define INT_PROTECT(x)         x=IntMasterDisable()
-#define INT_UNPROTECT(x)       do{if(!x)IntMasterEnable();}while(0)
+/* directives for masking the ethernet interrupt */
+#define INT_PROTECT_INIT(x)    uint32_t x = 0
+#define INT_PROTECT(x)         x=criticalEnter(INT_PRIORITY_ETHERNET)
+#define INT_UNPROTECT(x)       criticalExit(x)
 
 /* SYNC_FETCH_AND_NULL: atomic{ tmp=*x; *x=NULL; return tmp; } */
 #define SYNC_FETCH_AND_NULL(x)   (__sync_fetch_and_and(x, NULL))
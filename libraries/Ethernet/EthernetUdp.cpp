@@ -4,37 +4,23 @@
 
 EthernetUDP::EthernetUDP() {
 	_read = 0;
-	front = 0;
-	count = 0;
 	_p = NULL;
 }
 
 void EthernetUDP::do_recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, struct ip_addr* addr, uint16_t port)
 {
 	EthernetUDP *udp = static_cast<EthernetUDP*>(arg);
+	struct packet pkt;
 
-	/* No more space in the receive queue */
-	if(udp->count >= UDP_RX_MAX_PACKETS) {
-		pbuf_free(p);
-		return;
-	}
+	pkt.p = p;
+	/* Record the IP address and port the packet was received from */
+	pkt.remoteIP = IPAddress(addr->addr);
+	pkt.remotePort = port;
+	pkt.destIP = IPAddress(ip_current_dest_addr()->addr);
 
-	/* Increase the number of packets in the queue
-	 * that are waiting for processing */
-	udp->count++;
-	/* Add pacekt to the rear of the queue */
-	udp->packets[udp->rear].p = p;
-	/* Record the IP address and port the pacekt was received from */
-	udp->packets[udp->rear].remoteIP = IPAddress(addr->addr);
-	udp->packets[udp->rear].remotePort = port;
-	udp->packets[udp->rear].destIP = IPAddress(ip_current_dest_addr()->addr);
-
-	/* Advance the rear of the queue */
-	udp->rear++;
-
-	/* Wrap around the end of the array was reached */
-	if(udp->rear == UDP_RX_MAX_PACKETS)
-		udp->rear = 0;
+	/* Add the packet to the queue, drop it if there is no more space */
+	if(!udp->packets.push(pkt))
+		pbuf_free(p);
 }
 
 uint8_t EthernetUDP::begin(uint16_t port)
@@ -164,25 +150,16 @@ int EthernetUDP::parsePacket()
 		_destIP = IPAddress(IPADDR_NONE);
 	}
 
-	/* No more packets in the queue */
-	if(!count) {
+	/* Take the next packet from the front of the queue */
+	struct packet pkt;
+	if(!packets.pop(pkt)) {
 		return 0;
 	}
 
-	/* Take the next packet from the front of the queue */
-	_p = packets[front].p;
-	_remoteIP = packets[front].remoteIP;
-	_remotePort = packets[front].remotePort;
-	_destIP = packets[front].destIP;
-
-	count--;
-
-	/* Advance the front of the queue */
-	front++;
-
-	/* Wrap around if end of queue has been reached */
-	if(front == UDP_RX_MAX_PACKETS)
-		front = 0;
+	_p = pkt.p;
+	_remoteIP = pkt.remoteIP;
+	_remotePort = pkt.remotePort;
+	_destIP = pkt.destIP;
 
 	/* Return the total len of the queue */
 	return _p->tot_len;
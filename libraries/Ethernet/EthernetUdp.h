@@ -6,6 +6,7 @@
 
 #include "Energia.h"
 #include <Udp.h>
+#include <LockFree.h>
 
 struct packet {
 	struct pbuf *p;
@@ -16,10 +17,8 @@ struct packet {
 
 class EthernetUDP : public UDP {
 private:
-	struct packet packets[UDP_RX_MAX_PACKETS];
-	uint8_t front;
-	uint8_t rear;
-	uint8_t count;
+	/* Filled from the ethernet interrupt, drained by parsePacket() */
+	SPSCQueue<struct packet, UDP_RX_MAX_PACKETS> packets;
 
 	struct udp_pcb *_pcb;
 	struct pbuf *_p;
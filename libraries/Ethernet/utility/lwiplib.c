@@ -864,7 +864,7 @@ lwIPTimer(uint32_t ui32TimeMS)
 //! \return None.
 //
 //*****************************************************************************
-void
+RAMFUNC void
 lwIPEthernetIntHandler(void)
 {
 
@@ -53,6 +53,7 @@
 #include "driverlib/interrupt.h"
 #include "driverlib/rom.h"
 #include "driverlib/rom_map.h"
+#include "priority.h"
 
 /**
  * This global is defined in lwiplib.c and contains a count of the number of
@@ -72,35 +73,30 @@ sys_now(void)
 
 /**
  * This function is used to lock access to critical sections when lwipopt.h
- * defines SYS_LIGHTWEIGHT_PROT. It disables interrupts and returns a value
- * indicating the interrupt enable state when the function entered. This
+ * defines SYS_LIGHTWEIGHT_PROT. It masks the ethernet interrupt and any
+ * less urgent one through BASEPRI and returns the previous BASEPRI. This
  * value must be passed back on the matching call to sys_arch_unprotect().
  *
- * @return the interrupt level when the function was entered.
+ * @return the BASEPRI level when the function was entered.
  */
 sys_prot_t
 sys_arch_protect(void)
 {
-  return((sys_prot_t)MAP_IntMasterDisable());
+  return((sys_prot_t)criticalEnter(INT_PRIORITY_ETHERNET));
 }
 
 /**
  * This function is used to unlock access to critical sections when lwipopt.h
- * defines SYS_LIGHTWEIGHT_PROT. It enables interrupts if the value of the lev
- * parameter indicates that they were enabled when the matching call to
- * sys_arch_protect() was made.
+ * defines SYS_LIGHTWEIGHT_PROT. It restores the BASEPRI level saved by the
+ * matching call to sys_arch_protect().
  *
- * @param lev is the interrupt level when the matching protect function was
+ * @param lev is the BASEPRI level when the matching protect function was
  * called
  */
 void
 sys_arch_unprotect(sys_prot_t lev)
 {
-  /* Only turn interrupts back on if they were originally on when the matching
-     sys_arch_protect() call was made. */
-  if(!(lev & 1)) {
-    MAP_IntMasterEnable();
-  }
+  criticalExit(lev);
 }
 #endif /* SYS_LIGHTWEIGHT_PROT */
 
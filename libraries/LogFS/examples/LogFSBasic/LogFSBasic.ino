@@ -0,0 +1,67 @@
+/*
+  LogFSBasic
+
+  Mounts LogFS on a serial NOR flash on SPI with chip select on pin 12,
+  logs a line with a reading of A0 every second and prints the file
+  once it grows past 1 KB, then starts it over.
+
+  Pull the power at any time: after the next reset the log holds every
+  line that was flushed before.
+*/
+
+#include <SPI.h>
+#include <SPIDevice.h>
+#include <LogFS.h>
+#include <SPINorBlockDevice.h>
+
+SPIBus bus(SPI);
+SPIDevice chip(bus, 12, SPISettings(20000000, MSBFIRST, SPI_MODE0));
+SPINorBlockDevice flash(chip);
+LogFS fs;
+
+void setup()
+{
+  Serial.begin(115200);
+  bus.begin();
+  if (!fs.begin(flash)) {
+    Serial.println("mount failed, formatting");
+    if (!fs.format()) {
+      Serial.println("no flash found");
+      while (1)
+        ;
+    }
+  }
+  Serial.print(fs.fileCount());
+  Serial.print(" files, ");
+  Serial.print(fs.freeBlocks());
+  Serial.print(" of ");
+  Serial.print(fs.blockCount());
+  Serial.println(" blocks free");
+}
+
+void loop()
+{
+  static unsigned long last;
+  LogFile f;
+  bool full;
+
+  // Erase ahead and collect garbage while there is nothing else to do
+  fs.idle();
+  if (millis() - last < 1000)
+    return;
+  last = millis();
+
+  f = fs.open("a0.log", LOGFS_WRITE | LOGFS_APPEND);
+  f.print(millis());
+  f.print(' ');
+  f.println(analogRead(A0));
+  f.close();
+
+  f = fs.open("a0.log", LOGFS_READ);
+  full = f.size() > 1024;
+  while (full && f.available())
+    Serial.write(f.read());
+  f.close();
+  if (full)
+    fs.remove("a0.log");
+}
@@ -0,0 +1,291 @@
+/*
+  TestLogFS.cpp - Host test of LogFS on a RAMBlockDevice
+
+  Random operations are checked against a model of the files kept in
+  std::map, with remounts in between; then the power is cut at a random
+  program or erase during an operation, and the remounted file system
+  must hold the files as they were before it, as they would be after it,
+  or for an append a prefix of the new data.
+
+    cd libraries/LogFS
+    g++ -std=gnu++11 -O2 -I../../extras/host -Isrc -o TestLogFS \
+        extras/host/TestLogFS.cpp src/LogFS.cpp
+    ./TestLogFS [seed]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <map>
+#include <string>
+#include "LogFS.h"
+#include "HostTest.h"
+
+typedef std::map<std::string, std::string> Model;
+
+static const uint32_t blockSize = 4096;
+static const uint32_t blockCount = 12;
+static uint8_t image[blockSize * blockCount];
+
+static std::string randomData(int count, char first)
+{
+	std::string data;
+
+	while (count-- > 0)
+		data += (char)(first + rand() % 26);
+	return data;
+}
+
+static std::string randomName(void)
+{
+	char name[8];
+
+	snprintf(name, sizeof(name), "f%d", rand() % 5);
+	return name;
+}
+
+static bool readAll(LogFS &fs, const std::string &name, std::string &data)
+{
+	LogFile f = fs.open(name.c_str());
+	char buf[100];
+	int n;
+
+	data.clear();
+	if (!f)
+		return false;
+	while ((n = f.read(buf, sizeof(buf))) > 0)
+		data.append(buf, n);
+	f.close();
+	return true;
+}
+
+static bool matches(LogFS &fs, const Model &model)
+{
+	std::string data;
+
+	if (fs.fileCount() != model.size())
+		return false;
+	for (Model::const_iterator i = model.begin(); i != model.end(); ++i)
+		if (!readAll(fs, i->first, data) || data != i->second)
+			return false;
+	return true;
+}
+
+static void testBasic(void)
+{
+	RAMBlockDevice dev(image, blockSize, blockCount);
+	LogFS fs;
+	std::string data;
+	LogFile f;
+
+	memset(image, 0xFF, sizeof(image));
+	check(fs.begin(dev), "mount erased device");
+	f = fs.open("a.txt", LOGFS_WRITE);
+	f.print("hello ");
+	f.println("world");
+	f.close();
+	check(readAll(fs, "a.txt", data) && data == "hello world\r\n", "write and read back");
+
+	fs.end();
+	check(fs.begin(dev) && readAll(fs, "a.txt", data) && data == "hello world\r\n",
+	      "file kept across remount");
+
+	f = fs.open("a.txt", LOGFS_WRITE | LOGFS_READ);
+	f.seek(2);
+	f.write((const uint8_t *)"XY", 2);
+	f.close();
+	check(readAll(fs, "a.txt", data) && data == "heXYo world\r\n", "overwrite in the middle");
+
+	check(fs.rename("a.txt", "b.txt") && !fs.exists("a.txt") && fs.exists("b.txt"), "rename");
+	check(fs.remove("b.txt") && fs.fileCount() == 0, "remove");
+	fs.end();
+}
+
+// Appends, overwrites, truncates, renames, removes and remounts, with
+// every file compared to the model after each step
+static void testRandom(void)
+{
+	RAMBlockDevice dev(image, blockSize, blockCount);
+	LogFS fs;
+	Model model;
+	std::string data;
+	int step, remounts = 0;
+	bool ok = true;
+
+	memset(image, 0xFF, sizeof(image));
+	fs.begin(dev);
+	for (step = 0; step < 20000 && ok; step++) {
+		std::string name = randomName();
+		int op = rand() % 10;
+
+		if (op < 6) {
+			std::string add = randomData(rand() % 300, 'a');
+			LogFile f = fs.open(name.c_str(), LOGFS_WRITE | LOGFS_APPEND);
+			size_t n = f.write((const uint8_t *)add.data(), add.size());
+			f.close();
+			model[name] += add.substr(0, n);
+			if (n != add.size() || model[name].size() > 3000) {
+				f = fs.open(name.c_str(), LOGFS_WRITE | LOGFS_TRUNCATE);
+				ok = f;
+				f.close();
+				model[name].clear();
+			}
+		} else if (op == 6) {
+			if (model.count(name)) {
+				ok = fs.remove(name.c_str());
+				model.erase(name);
+			}
+		} else if (op == 7) {
+			std::string to = randomName();
+			if (model.count(name)) {
+				ok = fs.rename(name.c_str(), to.c_str());
+				data = model[name];
+				model.erase(name);
+				model[to] = data;
+			}
+		} else if (op == 8) {
+			fs.end();
+			ok = fs.begin(dev);
+			remounts++;
+		} else if (model.count(name) && model[name].size() > 10) {
+			std::string &m = model[name];
+			std::string add = randomData(rand() % 100, '0');
+			size_t at = rand() % m.size();
+			LogFile f = fs.open(name.c_str(), LOGFS_WRITE | LOGFS_READ);
+			if (f.seek(at) && f.write((const uint8_t *)add.data(), add.size()) == add.size()) {
+				if (at + add.size() > m.size())
+					m.resize(at + add.size());
+				m.replace(at, add.size(), add);
+			}
+			f.close();
+		} else {
+			fs.idle();
+		}
+		ok = ok && matches(fs, model);
+	}
+	if (!ok)
+		printf("  mismatch at step %d\n", step - 1);
+	check(ok, "random operations match the model");
+	check(remounts > 1000, "random operations remounted often");
+	fs.end();
+}
+
+// One operation on a used file system with the power cut after a random
+// number of device operations, then a remount and a check
+static bool powerFailTrial(int trial)
+{
+	Model before, after;
+	std::string name, data;
+	int kind;
+
+	memset(image, 0xFF, sizeof(image));
+	{
+		RAMBlockDevice dev(image, blockSize, blockCount);
+		LogFS fs;
+		int i;
+
+		fs.begin(dev);
+		for (i = 0; i < 60; i++) {
+			std::string n = randomName(), add = randomData(rand() % 400, 'a');
+			size_t total = add.size();
+			for (Model::iterator m = before.begin(); m != before.end(); ++m)
+				total += m->second.size();
+			if (rand() % 6 == 0 && before.count(n)) {
+				fs.remove(n.c_str());
+				before.erase(n);
+			} else if (total > sizeof(image) / 3) {
+				if (!before.empty()) {
+					fs.remove(before.begin()->first.c_str());
+					before.erase(before.begin());
+				}
+			} else {
+				LogFile f = fs.open(n.c_str(), LOGFS_WRITE | LOGFS_APPEND);
+				f.write((const uint8_t *)add.data(), add.size());
+				f.close();
+				before[n] += add;
+			}
+		}
+		fs.end();
+	}
+
+	after = before;
+	name = randomName();
+	{
+		RAMBlockDevice dev(image, blockSize, blockCount);
+		LogFS fs;
+		int i;
+
+		if (!fs.begin(dev)) {
+			printf("  trial %d: mount before the cut failed\n", trial);
+			return false;
+		}
+		dev.failAfter(rand() % 40);
+		kind = rand() % 3;
+		if (kind == 0) {
+			std::string add = randomData(200 + rand() % 3000, 'A');
+			LogFile f = fs.open(name.c_str(), LOGFS_WRITE | LOGFS_APPEND);
+			if (f) {
+				f.write((const uint8_t *)add.data(), add.size());
+				f.close();
+			}
+			after[name] += add;
+		} else if (kind == 1) {
+			fs.remove(name.c_str());
+			after.erase(name);
+		} else {
+			for (i = 0; i < 20; i++)
+				fs.idle();
+		}
+		fs.end();
+	}
+
+	RAMBlockDevice dev(image, blockSize, blockCount);
+	LogFS fs;
+	if (!fs.begin(dev)) {
+		printf("  trial %d: remount after the cut failed (op %d)\n", trial, kind);
+		return false;
+	}
+	if (!matches(fs, before) && !matches(fs, after)) {
+		// A cut append may leave any prefix of the new data
+		Model partial = before;
+		const std::string &old = before[name], &full = after[name];
+		bool exists = readAll(fs, name, data);
+
+		partial.erase(name);
+		if (exists)
+			partial[name] = data;
+		if (kind != 0 || data.size() < old.size() || full.compare(0, data.size(), data) ||
+		    !matches(fs, partial)) {
+			printf("  trial %d: files differ after the cut (op %d, %s)\n",
+			       trial, kind, name.c_str());
+			return false;
+		}
+	}
+
+	LogFile f = fs.open("after", LOGFS_WRITE);
+	if (!f || f.write((const uint8_t *)"hello", 5) != 5) {
+		printf("  trial %d: write after the cut failed\n", trial);
+		return false;
+	}
+	f.close();
+	return readAll(fs, "after", data) && data == "hello";
+}
+
+static void testPowerFail(void)
+{
+	int trial, bad = 0;
+
+	for (trial = 0; trial < 1000; trial++)
+		bad += !powerFailTrial(trial);
+	check(!bad, "power cuts leave the old or the new files");
+}
+
+int main(int argc, char **argv)
+{
+	srand(argc > 1 ? atoi(argv[1]) : 1);
+
+	testBasic();
+	testRandom();
+	testPowerFail();
+
+	return checkResult();
+}
@@ -0,0 +1,119 @@
+/*
+  BlockDevice.h - Storage interface for LogFS
+  Copyright (c) 2016 Energia.  All right reserved.
+
+  NOR flash semantics: erase() sets a whole block to 0xFF and program()
+  can only clear bits, so a byte may be programmed once per erase.
+  Addresses are in bytes; program() and read() may cover any range inside
+  the device, drivers split them at page boundaries themselves.
+
+  RAMBlockDevice keeps the blocks in a caller supplied buffer. It follows
+  the same rules, and failAfter() cuts the power after a number of
+  program/erase operations, the last one half done, so power loss
+  handling can be exercised on the host.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef BlockDevice_h
+#define BlockDevice_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+class BlockDevice {
+public:
+  BlockDevice(uint32_t blockSize = 0, uint32_t blockCount = 0)
+    : eraseSize(blockSize), eraseBlocks(blockCount) {}
+  virtual ~BlockDevice() {}
+
+  virtual bool begin(void) { return true; }
+  virtual bool read(uint32_t address, void *buf, size_t count) = 0;
+  virtual bool program(uint32_t address, const void *buf, size_t count) = 0;
+  // Erase the block starting at address
+  virtual bool erase(uint32_t address) = 0;
+  // Wait until everything programmed is stored
+  virtual bool sync(void) { return true; }
+
+  uint32_t blockSize(void) const { return eraseSize; }
+  uint32_t blockCount(void) const { return eraseBlocks; }
+
+protected:
+  uint32_t eraseSize;
+  uint32_t eraseBlocks;
+};
+
+class RAMBlockDevice : public BlockDevice {
+public:
+  RAMBlockDevice(uint8_t *buf, uint32_t blockSize, uint32_t blockCount)
+    : BlockDevice(blockSize, blockCount), mem(buf), opsLeft(-1) {}
+
+  bool read(uint32_t address, void *buf, size_t count) {
+    if (!valid(address, count))
+      return false;
+    memcpy(buf, mem + address, count);
+    return true;
+  }
+
+  bool program(uint32_t address, const void *buf, size_t count) {
+    const uint8_t *p = (const uint8_t *)buf;
+    bool whole = operation();
+    size_t i;
+
+    if (!valid(address, count) || opsLeft == -2)
+      return false;
+    if (!whole)
+      count /= 2;
+    for (i = 0; i < count; i++)
+      mem[address + i] &= p[i];
+    return whole;
+  }
+
+  bool erase(uint32_t address) {
+    bool whole = operation();
+
+    if (!valid(address, eraseSize) || (address % eraseSize) || opsLeft == -2)
+      return false;
+    memset(mem + address, 0xFF, whole ? eraseSize : eraseSize / 2);
+    return whole;
+  }
+
+  // Power fails half way through the program or erase after the next ops
+  // ones, and nothing is written after that; -1 never fails
+  void failAfter(int32_t ops) { opsLeft = ops; }
+  bool failed(void) const { return opsLeft == -3 || opsLeft == -2; }
+
+private:
+  uint8_t *mem;
+  int32_t opsLeft;    // -1 unlimited, -3 failing now, -2 dead
+
+  bool valid(uint32_t address, size_t count) const {
+    return address <= eraseSize * eraseBlocks && count <= eraseSize * eraseBlocks - address;
+  }
+  // false for the operation that is cut short
+  bool operation(void) {
+    if (opsLeft == -3)
+      opsLeft = -2;
+    if (opsLeft < 0)
+      return true;
+    if (opsLeft-- > 0)
+      return true;
+    opsLeft = -3;
+    return false;
+  }
+};
+
+#endif
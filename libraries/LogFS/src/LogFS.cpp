@@ -0,0 +1,1079 @@
+/*
+  LogFS.cpp - Log-structured file system for NOR flash
+  Copyright (c) 2016 Energia.  All right reserved.
+
+  Block header, 16 bytes:  magic, erase count, sequence, CRC32 of those.
+  An erased block that has not been used yet carries the magic and its
+  erase count with sequence and CRC still 0xFFFFFFFF, so they can be
+  programmed later when the block becomes the head.
+
+  Record, 4 byte aligned:  type, 0, payload length (16 bit), file ID,
+  offset, payload, CRC32 of everything before it. A type of 0xFF is
+  erased flash and ends the block.
+
+  Why the log stays consistent across collection: blocks are collected
+  oldest first, so by the time the block holding a truncate or delete
+  record is collected, every older record of that file is gone and the
+  record can simply be dropped. An ID is not reused while any record of
+  it is left in the log. Live data and
+  create records are copied to the head before the block is erased; a
+  power failure in between only leaves duplicates, which replay to the
+  same state. Copied data can land after a create record has moved
+  forward, so replay also accepts data for a file it has not seen yet
+  and drops such files if their create record never shows up.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "LogFS.h"
+
+#define BLOCK_MAGIC         0x53464C4EUL    // "NLFS"
+#define BLOCK_HEADER        16
+#define RECORD_HEADER       12
+#define RECORD_CRC          4
+#define RECORD_MIN          32      // smallest data record worth splitting off
+#define BLOCK_MAX           32768
+#define RESERVE             2       // blocks kept free for collection
+
+#define REC_CREATE          1
+#define REC_DATA            2
+#define REC_TRUNCATE        3
+#define REC_DELETE          4
+#define REC_ERASED          0xFF
+
+#define STATE_UNKNOWN       0
+#define STATE_ERASED        1
+#define STATE_USED          2
+
+#define NONE                0xFFFF
+
+struct BlockHeader {
+    uint32_t magic;
+    uint32_t erases;
+    uint32_t seq;
+    uint32_t crc;
+};
+
+struct RecordHeader {
+    uint8_t type;
+    uint8_t reserved;
+    uint16_t length;
+    uint32_t id;
+    uint32_t offset;
+};
+
+static uint32_t align4(uint32_t n)
+{
+    return (n + 3) & ~3UL;
+}
+
+// CRC32 (IEEE), a nibble at a time; start with 0xFFFFFFFF, invert at the end
+static uint32_t crc32(uint32_t crc, const void *data, size_t count)
+{
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+        0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+        0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+    const uint8_t *p = (const uint8_t *)data;
+
+    while (count--) {
+        crc ^= *p++;
+        crc = (crc >> 4) ^ table[crc & 15];
+        crc = (crc >> 4) ^ table[crc & 15];
+    }
+    return crc;
+}
+
+LogFS::LogFS(void)
+{
+    dev = NULL;
+    files = NULL;
+    extents = NULL;
+    blocks = 0;
+    used = 0;
+}
+
+bool LogFS::begin(BlockDevice &device, uint16_t fileSlots, uint16_t extentSlots)
+{
+    end();
+    dev = &device;
+    blockSize = dev->blockSize();
+    blocks = dev->blockCount() > NONE - 1 ? NONE - 1 : dev->blockCount();
+    if (!dev->begin() || blockSize < 256 || blockSize > BLOCK_MAX || blocks <= RESERVE + 1)
+        return false;
+
+    maxFiles = fileSlots;
+    maxExtents = extentSlots;
+    files = (Entry *)malloc(maxFiles * sizeof(Entry));
+    extents = (Extent *)malloc(maxExtents * sizeof(Extent));
+    if (!files || !extents || !mount()) {
+        end();
+        return false;
+    }
+    return true;
+}
+
+void LogFS::end(void)
+{
+    uint8_t i;
+
+    if (files) {
+        for (i = 0; i < LOGFS_MAX_OPEN; i++) {
+            if (handles[i].used)
+                flushHandle(&handles[i]);
+        }
+        dev->sync();
+    }
+    free(files);
+    free(extents);
+    files = NULL;
+    extents = NULL;
+    blocks = 0;
+    used = 0;
+}
+
+bool LogFS::format(void)
+{
+    uint32_t erases, blockSeq;
+    uint16_t b;
+
+    if (!files)
+        return false;
+    for (b = 0; b < blocks; b++) {
+        if (blockState(b, &erases, &blockSeq) != STATE_ERASED && !prepare(b, erases + 1))
+            return false;
+    }
+    return mount();
+}
+
+//
+// Device access. Reads up to LOGFS_CACHE_SIZE go through the cache, which
+// makes walking record headers cheap; larger ones go straight through.
+//
+bool LogFS::devRead(uint32_t address, void *buf, size_t count)
+{
+    uint32_t deviceSize = blockSize * blocks;
+
+    if (count > LOGFS_CACHE_SIZE)
+        return dev->read(address, buf, count);
+
+    if (address < cacheAddr || address + count > cacheAddr + cacheLen) {
+        if (address >= deviceSize || count > deviceSize - address)
+            return false;
+        cacheLen = deviceSize - address < LOGFS_CACHE_SIZE ? deviceSize - address : LOGFS_CACHE_SIZE;
+        if (!dev->read(address, cache, cacheLen)) {
+            cacheLen = 0;
+            return false;
+        }
+        cacheAddr = address;
+    }
+    memcpy(buf, cache + (address - cacheAddr), count);
+    return true;
+}
+
+bool LogFS::devProgram(uint32_t address, const void *buf, size_t count)
+{
+    if (address < cacheAddr + cacheLen && address + count > cacheAddr)
+        cacheLen = 0;
+    return dev->program(address, buf, count);
+}
+
+bool LogFS::devErase(uint16_t block)
+{
+    uint32_t address = block * blockSize;
+
+    if (address < cacheAddr + cacheLen && address + blockSize > cacheAddr)
+        cacheLen = 0;
+    return dev->erase(address);
+}
+
+//
+// Blocks
+//
+uint8_t LogFS::blockState(uint16_t block, uint32_t *erases, uint32_t *blockSeq)
+{
+    BlockHeader h;
+
+    *erases = 0;
+    if (!devRead(block * blockSize, &h, sizeof(h)) || h.magic != BLOCK_MAGIC)
+        return STATE_UNKNOWN;
+    if (h.erases == 0xFFFFFFFF)
+        return STATE_UNKNOWN;
+    *erases = h.erases;
+    if (h.seq == 0xFFFFFFFF && h.crc == 0xFFFFFFFF)
+        return STATE_ERASED;
+    if (h.crc != ~crc32(0xFFFFFFFF, &h, 12))
+        return STATE_UNKNOWN;
+    *blockSeq = h.seq;
+    return STATE_USED;
+}
+
+// Erase a block and leave it ready for use with its new erase count
+bool LogFS::prepare(uint16_t block, uint32_t erases)
+{
+    BlockHeader h;
+
+    h.magic = BLOCK_MAGIC;
+    h.erases = erases;
+    return devErase(block) && devProgram(block * blockSize, &h, 8);
+}
+
+// Start the next block of the ring as the new head
+bool LogFS::allocate(void)
+{
+    uint16_t next = used ? (head + 1) % blocks : head;
+    uint32_t erases, blockSeq;
+    BlockHeader h;
+
+    if (used == blocks)
+        return false;
+    if (blockState(next, &erases, &blockSeq) != STATE_ERASED) {
+        if (!prepare(next, ++erases))
+            return false;
+    }
+    h.seq = seq + 1;
+    h.magic = BLOCK_MAGIC;
+    h.erases = erases;
+    h.crc = ~crc32(0xFFFFFFFF, &h, 12);
+    if (!devProgram(next * blockSize + 8, &h.seq, 8))
+        return false;
+
+    if (!used)
+        tail = next;
+    head = next;
+    used++;
+    seq++;
+    headPos = BLOCK_HEADER;
+    aheadReady = false;
+    return true;
+}
+
+//
+// Make room for a record of need bytes at the head. Outside collection
+// the last RESERVE free blocks are left for collection to copy into.
+//
+bool LogFS::room(uint32_t need)
+{
+    uint16_t attempts;
+
+    if (used && headPos + need <= blockSize)
+        return true;
+    if (!collecting) {
+        for (attempts = used; blocks - used <= RESERVE && attempts; attempts--) {
+            if (!reclaim())
+                return false;
+        }
+        if (blocks - used <= RESERVE)
+            return false;
+    }
+    return allocate();
+}
+
+//
+// Copy what is still live in the oldest block to the head and erase it
+//
+bool LogFS::reclaim(void)
+{
+    uint16_t b = tail;
+    uint32_t erases, blockSeq, pos, off;
+    uint16_t i;
+    int32_t n;
+    bool ok = true;
+
+    if (used <= 1)
+        return false;
+    collecting = true;
+
+    for (i = 0; i < maxFiles && ok; i++) {
+        Entry &f = files[i];
+        if (f.used && f.named && f.createBlock == b) {
+            ok = append(REC_CREATE, f.id, 0, (const uint8_t *)f.name, NULL, 0, strlen(f.name), &pos) >= 0;
+            f.createBlock = head;
+        }
+    }
+
+    for (i = 0; i < maxExtents && ok; i++) {
+        if (extents[i].file == NONE || extents[i].block != b)
+            continue;
+        Extent e = extents[i];
+        extents[i].file = NONE;
+        for (off = 0; off < e.length && ok; off += n) {
+            n = append(REC_DATA, files[e.file].id, e.fileOffset + off, NULL, &e, off, e.length - off, &pos);
+            ok = n > 0 && addData(e.file, e.fileOffset + off, n, head, pos, headPos);
+        }
+        if (!ok)
+            extents[i] = e;
+    }
+
+    collecting = false;
+    if (!ok)
+        return false;
+
+    blockState(b, &erases, &blockSeq);
+    if (!prepare(b, erases + 1))
+        return false;
+    tail = (b + 1) % blocks;
+    used--;
+    return true;
+}
+
+//
+// Append one record at the head. Data records are cut to what fits in the
+// head block; the payload comes from data, or from the extent src when
+// collection copies it. Returns the payload length written, or -1.
+//
+int32_t LogFS::append(uint8_t type, uint32_t id, uint32_t offset, const uint8_t *data,
+                      const Extent *src, uint32_t srcOffset, uint32_t count, uint32_t *pos)
+{
+    uint32_t min = type == REC_DATA && count > RECORD_MIN ? RECORD_MIN : count;
+    uint32_t space, address, crc, done, chunk;
+    uint8_t copy[32];
+    RecordHeader r;
+
+    if (!room(align4(RECORD_HEADER + min + RECORD_CRC)))
+        return -1;
+
+    space = blockSize - headPos - RECORD_HEADER - RECORD_CRC;
+    if (count > space)
+        count = space;
+    if (count > 0xFFFF)
+        count = 0xFFFF;
+
+    r.type = type;
+    r.reserved = 0;
+    r.length = count;
+    r.id = id;
+    r.offset = offset;
+    address = head * blockSize + headPos;
+    *pos = headPos;
+    // Whatever happens below, this space is used up
+    headPos = align4(headPos + RECORD_HEADER + count + RECORD_CRC);
+
+    crc = crc32(0xFFFFFFFF, &r, sizeof(r));
+    if (!devProgram(address, &r, sizeof(r)))
+        return -1;
+    address += sizeof(r);
+
+    if (data) {
+        crc = crc32(crc, data, count);
+        if (count && !devProgram(address, data, count))
+            return -1;
+        address += count;
+    } else {
+        for (done = 0; done < count; done += chunk) {
+            chunk = count - done < sizeof(copy) ? count - done : sizeof(copy);
+            if (!readExtent(*src, srcOffset + done, copy, chunk))
+                return -1;
+            crc = crc32(crc, copy, chunk);
+            if (!devProgram(address, copy, chunk))
+                return -1;
+            address += chunk;
+        }
+    }
+
+    crc = ~crc;
+    if (!devProgram(address, &crc, sizeof(crc)))
+        return -1;
+    return count;
+}
+
+//
+// Mounting
+//
+bool LogFS::mount(void)
+{
+    uint32_t erases, blockSeq, minSeq = 0xFFFFFFFF, maxSeq = 0, lastSeq, end, n;
+    uint16_t b, i;
+    uint8_t buf[32];
+    bool any = false;
+
+    memset(handles, 0, sizeof(handles));
+    for (i = 0; i < maxFiles; i++)
+        files[i].used = 0;
+    for (i = 0; i < maxExtents; i++)
+        extents[i].file = NONE;
+    cacheLen = 0;
+    cacheAddr = 0;
+    collecting = false;
+    aheadReady = false;
+    nextId = 1;
+    seq = 0;
+    used = 0;
+    head = 0;
+    tail = 0;
+    headPos = blockSize;
+
+    for (b = 0; b < blocks; b++) {
+        if (blockState(b, &erases, &blockSeq) != STATE_USED)
+            continue;
+        if (blockSeq < minSeq) {
+            minSeq = blockSeq;
+            tail = b;
+        }
+        if (blockSeq >= maxSeq) {
+            maxSeq = blockSeq;
+            head = b;
+        }
+        any = true;
+    }
+    if (!any)
+        return true;
+
+    // The used blocks run from tail to head round the ring in sequence
+    // order; blocks in between that lost their header count as used
+    // until they are collected
+    used = (head + blocks - tail) % blocks + 1;
+    seq = maxSeq;
+    lastSeq = 0;
+    for (b = tail;; b = (b + 1) % blocks) {
+        if (blockState(b, &erases, &blockSeq) == STATE_USED) {
+            if (blockSeq < lastSeq || (b != tail && blockSeq == lastSeq))
+                return false;
+            lastSeq = blockSeq;
+            if (!replay(b, &end))
+                return false;
+            if (b == head)
+                headPos = end;
+        }
+        if (b == head)
+            break;
+    }
+
+    // A torn write after the last record leaves programmed bytes there
+    for (end = headPos; end < blockSize; end += n) {
+        n = blockSize - end < sizeof(buf) ? blockSize - end : sizeof(buf);
+        if (!dev->read(head * blockSize + end, buf, n))
+            return false;
+        for (i = 0; i < n && buf[i] == 0xFF; i++)
+            ;
+        if (i < n) {
+            headPos = blockSize;
+            break;
+        }
+    }
+
+    // Data whose create record never showed up belongs to deleted files
+    for (i = 0; i < maxFiles; i++) {
+        if (files[i].used && !files[i].named)
+            dropEntry(i);
+    }
+    return true;
+}
+
+// Apply the records of one block to the index, *end is where the log stops
+bool LogFS::replay(uint16_t block, uint32_t *end)
+{
+    uint32_t pos = BLOCK_HEADER, base = block * blockSize, crc, stored, done, chunk, next;
+    uint8_t buf[32];
+    RecordHeader r;
+    int f;
+
+    while (pos + RECORD_HEADER + RECORD_CRC <= blockSize) {
+        if (!devRead(base + pos, &r, sizeof(r)) || r.type == REC_ERASED)
+            break;
+        next = align4(pos + RECORD_HEADER + r.length + RECORD_CRC);
+        if (pos + RECORD_HEADER + r.length + RECORD_CRC > blockSize)
+            break;
+
+        crc = crc32(0xFFFFFFFF, &r, sizeof(r));
+        for (done = 0; done < r.length; done += chunk) {
+            chunk = r.length - done < sizeof(buf) ? r.length - done : sizeof(buf);
+            if (!devRead(base + pos + RECORD_HEADER + done, buf, chunk))
+                return false;
+            crc = crc32(crc, buf, chunk);
+        }
+        if (!devRead(base + pos + RECORD_HEADER + r.length, &stored, sizeof(stored)) || stored != ~crc)
+            break;
+
+        if (r.id >= nextId)
+            nextId = r.id + 1;
+        f = findId(r.id);
+
+        switch (r.type) {
+        case REC_CREATE:
+            if (r.length == 0 || r.length > LOGFS_NAME_MAX)
+                break;
+            if (f < 0 && (f = newEntry(r.id)) < 0)
+                return false;
+            devRead(base + pos + RECORD_HEADER, files[f].name, r.length);
+            files[f].name[r.length] = 0;
+            files[f].named = 1;
+            files[f].createBlock = block;
+            break;
+        case REC_DATA:
+            if (f < 0 && (f = newEntry(r.id)) < 0)
+                return false;
+            if (r.length && !addData(f, r.offset, r.length, block, pos, next))
+                return false;
+            break;
+        case REC_TRUNCATE:
+            if (f >= 0 && r.offset < files[f].size) {
+                trim(f, r.offset, 0xFFFFFFFF);
+                files[f].size = r.offset;
+            }
+            break;
+        case REC_DELETE:
+            if (f >= 0)
+                dropEntry(f);
+            break;
+        }
+        pos = next;
+    }
+    *end = pos;
+    return true;
+}
+
+//
+// Index
+//
+int LogFS::findFile(const char *name)
+{
+    uint16_t i;
+
+    for (i = 0; i < maxFiles; i++) {
+        if (files[i].used && files[i].named && !strcmp(files[i].name, name))
+            return i;
+    }
+    return -1;
+}
+
+int LogFS::findId(uint32_t id)
+{
+    uint16_t i;
+
+    for (i = 0; i < maxFiles; i++) {
+        if (files[i].used && files[i].id == id)
+            return i;
+    }
+    return -1;
+}
+
+int LogFS::newEntry(uint32_t id)
+{
+    uint16_t i;
+
+    for (i = 0; i < maxFiles; i++) {
+        if (!files[i].used) {
+            files[i].id = id;
+            files[i].size = 0;
+            files[i].createBlock = NONE;
+            files[i].used = 1;
+            files[i].named = 0;
+            files[i].name[0] = 0;
+            return i;
+        }
+    }
+    return -1;
+}
+
+void LogFS::dropEntry(uint16_t file)
+{
+    uint16_t i;
+
+    for (i = 0; i < maxExtents; i++) {
+        if (extents[i].file == file)
+            extents[i].file = NONE;
+    }
+    files[file].used = 0;
+}
+
+uint16_t LogFS::freeExtents(void)
+{
+    uint16_t i, n = 0;
+
+    for (i = 0; i < maxExtents; i++) {
+        if (extents[i].file == NONE)
+            n++;
+    }
+    return n;
+}
+
+// Drop [from, to) of a file from its extents, splitting one if needed
+bool LogFS::trim(uint16_t file, uint32_t from, uint32_t to)
+{
+    uint16_t i, j;
+
+    for (i = 0; i < maxExtents; i++) {
+        Extent &e = extents[i];
+        uint32_t start = e.fileOffset, stop = e.fileOffset + e.length;
+
+        if (e.file != file || stop <= from || start >= to)
+            continue;
+        if (from <= start && stop <= to) {
+            e.file = NONE;
+        } else if (start < from && stop > to) {
+            for (j = 0; j < maxExtents && extents[j].file != NONE; j++)
+                ;
+            if (j == maxExtents)
+                return false;
+            extents[j] = e;
+            extents[j].skip += to - start;
+            extents[j].fileOffset = to;
+            extents[j].length = stop - to;
+            e.length = from - start;
+            e.open = 0;
+        } else if (start < from) {
+            e.length = from - start;
+            e.open = 0;
+        } else {
+            e.skip += to - start;
+            e.fileOffset = to;
+            e.length = stop - to;
+        }
+    }
+    return true;
+}
+
+// Record that a data record at pos..end of block holds [offset, offset + count)
+bool LogFS::addData(uint16_t file, uint32_t offset, uint32_t count,
+                    uint16_t block, uint32_t pos, uint32_t end)
+{
+    uint16_t i, slot = NONE;
+
+    if (!trim(file, offset, offset + count))
+        return false;
+    if (offset + count > files[file].size)
+        files[file].size = offset + count;
+
+    for (i = 0; i < maxExtents; i++) {
+        Extent &e = extents[i];
+        if (e.file == NONE) {
+            if (slot == NONE)
+                slot = i;
+        } else if (e.file == file && e.block == block && e.runEnd == pos && e.open &&
+                   e.fileOffset + e.length == offset) {
+            e.length += count;
+            e.runEnd = end;
+            return true;
+        }
+    }
+    if (slot == NONE)
+        return false;
+
+    Extent &e = extents[slot];
+    e.fileOffset = offset;
+    e.length = count;
+    e.file = file;
+    e.block = block;
+    e.run = pos;
+    e.runEnd = end;
+    e.skip = 0;
+    e.open = 1;
+    return true;
+}
+
+bool LogFS::readExtent(const Extent &e, uint32_t offset, void *buf, uint32_t count)
+{
+    uint8_t *out = (uint8_t *)buf;
+    uint32_t base = e.block * blockSize, pos = e.run, data = e.skip + offset, n;
+    RecordHeader r;
+
+    while (count && pos < e.runEnd) {
+        if (!devRead(base + pos, &r, sizeof(r)))
+            return false;
+        if (data >= r.length) {
+            data -= r.length;
+        } else {
+            n = r.length - data < count ? r.length - data : count;
+            if (!devRead(base + pos + RECORD_HEADER + data, out, n))
+                return false;
+            out += n;
+            count -= n;
+            data = 0;
+        }
+        pos = align4(pos + RECORD_HEADER + r.length + RECORD_CRC);
+    }
+    return count == 0;
+}
+
+bool LogFS::writeData(uint16_t file, uint32_t offset, const uint8_t *buf, uint32_t count)
+{
+    uint32_t pos;
+    int32_t n;
+
+    while (count) {
+        // A split and a new extent at most
+        if (freeExtents() < 2)
+            return false;
+        n = append(REC_DATA, files[file].id, offset, buf, NULL, 0, count, &pos);
+        if (n <= 0 || !addData(file, offset, n, head, pos, headPos))
+            return false;
+        offset += n;
+        buf += n;
+        count -= n;
+    }
+    return true;
+}
+
+//
+// Files
+//
+LogFile LogFS::open(const char *name, uint8_t mode)
+{
+    size_t len = name ? strlen(name) : 0;
+    uint32_t pos;
+    uint8_t h;
+    int f;
+
+    if (!files || !len || len > LOGFS_NAME_MAX)
+        return LogFile();
+    for (h = 0; h < LOGFS_MAX_OPEN && handles[h].used; h++)
+        ;
+    if (h == LOGFS_MAX_OPEN)
+        return LogFile();
+
+    f = findFile(name);
+    if (f < 0) {
+        if (!(mode & LOGFS_WRITE) || (f = newEntry(nextId)) < 0)
+            return LogFile();
+        if (append(REC_CREATE, nextId, 0, (const uint8_t *)name, NULL, 0, len, &pos) < 0) {
+            files[f].used = 0;
+            return LogFile();
+        }
+        nextId++;
+        strcpy(files[f].name, name);
+        files[f].named = 1;
+        files[f].createBlock = head;
+    } else if ((mode & LOGFS_TRUNCATE) && (mode & LOGFS_WRITE) && files[f].size) {
+        if (append(REC_TRUNCATE, files[f].id, 0, NULL, NULL, 0, 0, &pos) < 0)
+            return LogFile();
+        trim(f, 0, 0xFFFFFFFF);
+        files[f].size = 0;
+    }
+
+    Handle &hd = handles[h];
+    hd.id = files[f].id;
+    hd.file = f;
+    hd.mode = mode;
+    hd.pos = (mode & LOGFS_APPEND) ? files[f].size : 0;
+    hd.bufLen = 0;
+    hd.used = 1;
+    return LogFile(this, h);
+}
+
+bool LogFS::exists(const char *name)
+{
+    return files && name && findFile(name) >= 0;
+}
+
+bool LogFS::remove(const char *name)
+{
+    uint32_t pos;
+    uint8_t h;
+    int f;
+
+    if (!files || !name || (f = findFile(name)) < 0)
+        return false;
+    if (append(REC_DELETE, files[f].id, 0, NULL, NULL, 0, 0, &pos) < 0)
+        return false;
+    for (h = 0; h < LOGFS_MAX_OPEN; h++) {
+        if (handles[h].used && handles[h].id == files[f].id)
+            handles[h].used = 0;
+    }
+    dropEntry(f);
+    return true;
+}
+
+bool LogFS::rename(const char *from, const char *to)
+{
+    size_t len = to ? strlen(to) : 0;
+    uint32_t pos;
+    int f;
+
+    if (!files || !from || !len || len > LOGFS_NAME_MAX || (f = findFile(from)) < 0)
+        return false;
+    if (!strcmp(from, to))
+        return true;
+    if (findFile(to) >= 0 && !remove(to))
+        return false;
+    if (append(REC_CREATE, files[f].id, 0, (const uint8_t *)to, NULL, 0, len, &pos) < 0)
+        return false;
+    strcpy(files[f].name, to);
+    files[f].createBlock = head;
+    return true;
+}
+
+uint16_t LogFS::fileCount(void)
+{
+    uint16_t i, n = 0;
+
+    for (i = 0; files && i < maxFiles; i++) {
+        if (files[i].used && files[i].named)
+            n++;
+    }
+    return n;
+}
+
+bool LogFS::fileInfo(uint16_t index, char *name, uint32_t *size)
+{
+    uint16_t i;
+    uint8_t h;
+
+    for (i = 0; files && i < maxFiles; i++) {
+        if (!files[i].used || !files[i].named || index--)
+            continue;
+        if (name)
+            strcpy(name, files[i].name);
+        if (size) {
+            *size = files[i].size;
+            for (h = 0; h < LOGFS_MAX_OPEN; h++) {
+                if (handles[h].used && handles[h].file == i && handleSize(&handles[h]) > *size)
+                    *size = handleSize(&handles[h]);
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+void LogFS::idle(void)
+{
+    uint32_t erases, blockSeq;
+    uint16_t next;
+
+    if (!files)
+        return;
+    if (blocks - used <= RESERVE + 1 && used > 1)
+        reclaim();
+    if (!aheadReady && used && used < blocks) {
+        next = (head + 1) % blocks;
+        if (blockState(next, &erases, &blockSeq) == STATE_ERASED || prepare(next, erases + 1))
+            aheadReady = true;
+    }
+}
+
+//
+// Handles
+//
+LogFS::Handle *LogFS::handleFor(uint8_t h)
+{
+    Handle *hd;
+
+    if (!files || h >= LOGFS_MAX_OPEN || !handles[h].used)
+        return NULL;
+    hd = &handles[h];
+    if (!files[hd->file].used || files[hd->file].id != hd->id) {
+        hd->used = 0;
+        return NULL;
+    }
+    return hd;
+}
+
+bool LogFS::flushHandle(Handle *h)
+{
+    bool ok;
+
+    if (!h->bufLen)
+        return true;
+    ok = writeData(h->file, h->bufOffset, h->buf, h->bufLen);
+    h->bufLen = 0;
+    return ok;
+}
+
+uint32_t LogFS::handleSize(Handle *h)
+{
+    uint32_t size = files[h->file].size;
+
+    if (h->bufLen && h->bufOffset + h->bufLen > size)
+        size = h->bufOffset + h->bufLen;
+    return size;
+}
+
+int LogFS::readHandle(Handle *h, void *buf, size_t count)
+{
+    uint8_t *out = (uint8_t *)buf;
+    uint32_t size, n, done = 0;
+    uint16_t i;
+
+    if (!(h->mode & LOGFS_READ) || !flushHandle(h))
+        return -1;
+    size = files[h->file].size;
+    if (h->pos >= size)
+        return 0;
+    if (count > size - h->pos)
+        count = size - h->pos;
+
+    while (done < count) {
+        for (i = 0; i < maxExtents; i++) {
+            Extent &e = extents[i];
+            if (e.file == h->file && e.fileOffset <= h->pos && h->pos < e.fileOffset + e.length)
+                break;
+        }
+        if (i == maxExtents)
+            break;
+        Extent &e = extents[i];
+        n = e.fileOffset + e.length - h->pos;
+        if (n > count - done)
+            n = count - done;
+        if (!readExtent(e, h->pos - e.fileOffset, out + done, n))
+            break;
+        done += n;
+        h->pos += n;
+    }
+    return done;
+}
+
+size_t LogFS::writeHandle(Handle *h, const uint8_t *buf, size_t count)
+{
+    size_t done = 0, n;
+    uint32_t start;
+
+    if (!(h->mode & LOGFS_WRITE))
+        return 0;
+    if (h->mode & LOGFS_APPEND)
+        h->pos = handleSize(h);
+    if (h->bufLen && h->pos != h->bufOffset + h->bufLen && !flushHandle(h))
+        return 0;
+    start = h->pos;
+
+    while (done < count) {
+        if (!h->bufLen)
+            h->bufOffset = h->pos;
+        n = LOGFS_FILE_BUFFER - h->bufLen;
+        if (n > count - done)
+            n = count - done;
+        memcpy(h->buf + h->bufLen, buf + done, n);
+        h->bufLen += n;
+        h->pos += n;
+        done += n;
+        if (h->bufLen == LOGFS_FILE_BUFFER && !flushHandle(h)) {
+            // The whole buffer is lost, including what came before this call
+            h->pos = h->bufOffset;
+            return h->pos > start ? h->pos - start : 0;
+        }
+    }
+    return done;
+}
+
+//
+// LogFile
+//
+size_t LogFile::write(uint8_t b)
+{
+    return write(&b, 1);
+}
+
+size_t LogFile::write(const uint8_t *buf, size_t count)
+{
+    LogFS::Handle *h = fs ? fs->handleFor(handle) : NULL;
+    size_t n;
+
+    if (!h)
+        return 0;
+    n = fs->writeHandle(h, buf, count);
+    if (n < count)
+        setWriteError();
+    return n;
+}
+
+int LogFile::available(void)
+{
+    LogFS::Handle *h = fs ? fs->handleFor(handle) : NULL;
+    uint32_t size;
+
+    if (!h || !(h->mode & LOGFS_READ))
+        return 0;
+    size = fs->handleSize(h);
+    return h->pos < size ? size - h->pos : 0;
+}
+
+int LogFile::read(void)
+{
+    uint8_t b;
+
+    return read(&b, 1) == 1 ? b : -1;
+}
+
+int LogFile::read(void *buf, size_t count)
+{
+    LogFS::Handle *h = fs ? fs->handleFor(handle) : NULL;
+
+    return h ? fs->readHandle(h, buf, count) : -1;
+}
+
+int LogFile::peek(void)
+{
+    LogFS::Handle *h = fs ? fs->handleFor(handle) : NULL;
+    int c;
+
+    if (!h)
+        return -1;
+    c = read();
+    if (c >= 0)
+        h->pos--;
+    return c;
+}
+
+void LogFile::flush(void)
+{
+    LogFS::Handle *h = fs ? fs->handleFor(handle) : NULL;
+
+    if (h) {
+        if (!fs->flushHandle(h))
+            setWriteError();
+        fs->dev->sync();
+    }
+}
+
+bool LogFile::seek(uint32_t pos)
+{
+    LogFS::Handle *h = fs ? fs->handleFor(handle) : NULL;
+
+    if (!h || pos > fs->handleSize(h))
+        return false;
+    h->pos = pos;
+    return true;
+}
+
+uint32_t LogFile::position(void)
+{
+    LogFS::Handle *h = fs ? fs->handleFor(handle) : NULL;
+
+    return h ? h->pos : 0;
+}
+
+uint32_t LogFile::size(void)
+{
+    LogFS::Handle *h = fs ? fs->handleFor(handle) : NULL;
+
+    return h ? fs->handleSize(h) : 0;
+}
+
+const char *LogFile::name(void)
+{
+    LogFS::Handle *h = fs ? fs->handleFor(handle) : NULL;
+
+    return h ? fs->files[h->file].name : "";
+}
+
+void LogFile::close(void)
+{
+    LogFS::Handle *h = fs ? fs->handleFor(handle) : NULL;
+
+    if (h) {
+        flush();
+        h->used = 0;
+    }
+    fs = NULL;
+}
+
+LogFile::operator bool(void)
+{
+    return fs && fs->handleFor(handle);
+}
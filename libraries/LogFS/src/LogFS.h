@@ -0,0 +1,223 @@
+/*
+  LogFS.h - Log-structured file system for NOR flash
+  Copyright (c) 2016 Energia.  All right reserved.
+
+    RAMBlockDevice / SPINorBlockDevice flash(...);
+    LogFS fs;
+    fs.begin(flash);
+    LogFile f = fs.open("log.txt", LOGFS_WRITE | LOGFS_APPEND);
+    f.println(analogRead(A0));
+    f.close();
+
+  The device is a ring of erase blocks written as one log. Each block
+  starts with a header holding its sequence number and erase count, then
+  records: file created or renamed, data written at an offset, file
+  truncated, file deleted. Every record ends with a CRC32, so a record
+  cut short by a power failure is recognised and ignored, and everything
+  before it stays valid. Nothing is ever overwritten in place.
+
+  begin() replays the log in sequence order and keeps in RAM, per file,
+  the list of extents: runs of consecutive data records in one block.
+  Appending to a file in the block that holds its last run just extends
+  that run, so a file written sequentially needs about one extent per
+  block. Garbage collection takes the oldest block, appends the data in
+  it that is still live to the head of the log, and erases it right away
+  so the block is ready when the head comes round (erase-ahead). Since
+  the log only moves forwards round the ring, every block is erased
+  equally often. Two blocks are kept free so collection always has room.
+
+  Writes go through a small per file buffer, and reads through a cache
+  of LOGFS_CACHE_SIZE bytes for record headers; larger reads go straight
+  to the device, which can use DMA for them.
+
+  The names are flat, up to LOGFS_NAME_MAX characters. Blocks may be at
+  most 32 KB. Built outside Energia with extras/host on the include path,
+  the file system runs on a RAMBlockDevice on the host.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef LogFS_h
+#define LogFS_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include "Stream.h"
+#include "BlockDevice.h"
+
+#ifndef LOGFS_NAME_MAX
+#define LOGFS_NAME_MAX      31
+#endif
+#ifndef LOGFS_MAX_OPEN
+#define LOGFS_MAX_OPEN      4
+#endif
+#ifndef LOGFS_FILE_BUFFER
+#define LOGFS_FILE_BUFFER   64
+#endif
+#ifndef LOGFS_CACHE_SIZE
+#define LOGFS_CACHE_SIZE    64
+#endif
+
+// open() modes, combined with |
+#define LOGFS_READ          0x01
+#define LOGFS_WRITE         0x02    // creates the file if missing
+#define LOGFS_TRUNCATE      0x04
+#define LOGFS_APPEND        0x08    // every write goes to the end
+
+class LogFS;
+
+class LogFile : public Stream {
+public:
+  LogFile(void) : fs(NULL), handle(0) {}
+
+  size_t write(uint8_t b);
+  size_t write(const uint8_t *buf, size_t count);
+  using Print::write;
+  int available(void);
+  int read(void);
+  int read(void *buf, size_t count);
+  int peek(void);
+  void flush(void);
+
+  bool seek(uint32_t pos);
+  uint32_t position(void);
+  uint32_t size(void);
+  const char *name(void);
+  void close(void);
+  operator bool(void);
+
+private:
+  LogFile(LogFS *owner, uint8_t h) : fs(owner), handle(h) {}
+  LogFS *fs;
+  uint8_t handle;
+  friend class LogFS;
+};
+
+class LogFS {
+public:
+  LogFS(void);
+  ~LogFS() { end(); }
+
+  // Mounts what is on dev; an empty or erased device is an empty file
+  // system. False if the log is inconsistent or does not fit in RAM.
+  bool begin(BlockDevice &dev, uint16_t maxFiles = 16, uint16_t maxExtents = 128);
+  void end(void);
+  bool format(void);
+
+  LogFile open(const char *name, uint8_t mode = LOGFS_READ);
+  bool exists(const char *name);
+  bool remove(const char *name);
+  // Replaces to if it exists
+  bool rename(const char *from, const char *to);
+
+  uint16_t fileCount(void);
+  // name needs LOGFS_NAME_MAX + 1 bytes
+  bool fileInfo(uint16_t index, char *name, uint32_t *size);
+
+  uint32_t blockCount(void) const { return blocks; }
+  uint32_t freeBlocks(void) const { return blocks - used; }
+
+  // Erase the next block ahead and collect garbage early, for loop()
+  void idle(void);
+
+private:
+  struct Entry {
+    uint32_t id;
+    uint32_t size;
+    uint16_t createBlock;     // block of the current create record
+    uint8_t used;
+    uint8_t named;
+    char name[LOGFS_NAME_MAX + 1];
+  };
+  // File bytes [fileOffset, fileOffset + length) are the payloads of the
+  // records from run up to runEnd in block, less the first skip bytes
+  struct Extent {
+    uint32_t fileOffset;
+    uint32_t length;
+    uint16_t file;
+    uint16_t block;
+    uint16_t run;
+    uint16_t runEnd;
+    uint16_t skip;
+    uint16_t open;            // ends with the run, so it may grow
+  };
+  struct Handle {
+    uint32_t id;
+    uint32_t pos;
+    uint32_t bufOffset;
+    uint16_t file;
+    uint16_t bufLen;
+    uint8_t mode;
+    uint8_t used;
+    uint8_t buf[LOGFS_FILE_BUFFER];
+  };
+
+  BlockDevice *dev;
+  Entry *files;
+  Extent *extents;
+  uint16_t maxFiles;
+  uint16_t maxExtents;
+  Handle handles[LOGFS_MAX_OPEN];
+
+  uint32_t blockSize;
+  uint16_t blocks;
+  uint16_t head;
+  uint16_t tail;
+  uint16_t used;
+  uint32_t headPos;
+  uint32_t seq;
+  uint32_t nextId;
+  bool collecting;
+  bool aheadReady;
+
+  uint32_t cacheAddr;
+  uint16_t cacheLen;
+  uint8_t cache[LOGFS_CACHE_SIZE];
+
+  bool mount(void);
+  bool replay(uint16_t block, uint32_t *end);
+  uint8_t blockState(uint16_t block, uint32_t *erases, uint32_t *blockSeq);
+  bool prepare(uint16_t block, uint32_t erases);
+  bool allocate(void);
+  bool reclaim(void);
+  bool room(uint32_t need);
+  int32_t append(uint8_t type, uint32_t id, uint32_t offset, const uint8_t *data,
+                 const Extent *src, uint32_t srcOffset, uint32_t count, uint32_t *pos);
+
+  bool devRead(uint32_t address, void *buf, size_t count);
+  bool devProgram(uint32_t address, const void *buf, size_t count);
+  bool devErase(uint16_t block);
+
+  int findFile(const char *name);
+  int findId(uint32_t id);
+  int newEntry(uint32_t id);
+  void dropEntry(uint16_t file);
+  uint16_t freeExtents(void);
+  bool trim(uint16_t file, uint32_t from, uint32_t to);
+  bool addData(uint16_t file, uint32_t offset, uint32_t count,
+               uint16_t block, uint32_t pos, uint32_t end);
+  bool readExtent(const Extent &e, uint32_t offset, void *buf, uint32_t count);
+  bool writeData(uint16_t file, uint32_t offset, const uint8_t *buf, uint32_t count);
+
+  Handle *handleFor(uint8_t h);
+  bool flushHandle(Handle *h);
+  uint32_t handleSize(Handle *h);
+  int readHandle(Handle *h, void *buf, size_t count);
+  size_t writeHandle(Handle *h, const uint8_t *buf, size_t count);
+
+  friend class LogFile;
+};
+
+#endif
@@ -0,0 +1,164 @@
+/*
+  SPINorBlockDevice.cpp - Serial NOR flash as a LogFS block device
+  Copyright (c) 2016 Energia.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifdef ENERGIA
+
+#include "SPINorBlockDevice.h"
+
+#define CMD_WRITE_ENABLE    0x06
+#define CMD_READ_STATUS     0x05
+#define CMD_FAST_READ       0x0B
+#define CMD_PAGE_PROGRAM    0x02
+#define CMD_SECTOR_ERASE    0x20
+#define CMD_JEDEC_ID        0x9F
+#define CMD_RELEASE_PD      0xAB
+
+#define STATUS_BUSY         0x01
+#define SECTOR_SIZE         4096
+#define PAGE_SIZE           256
+#define READ_CHUNK          4096    // four chain tasks plus the command
+
+SPINorBlockDevice::SPINorBlockDevice(SPIDevice &device, uint32_t firstBlock, uint32_t blocks)
+    : BlockDevice(SECTOR_SIZE, blocks), dev(device), offset(firstBlock * SECTOR_SIZE), id(0), busy(false)
+{
+}
+
+bool SPINorBlockDevice::begin(void)
+{
+    uint8_t cmd[4] = { CMD_JEDEC_ID, 0xFF, 0xFF, 0xFF };
+    uint8_t reply[4];
+    uint32_t capacity, available;
+
+    dev.begin();
+    reply[0] = CMD_RELEASE_PD;
+    if (!dev.transfer(reply, NULL, 1))
+        return false;
+    delayMicroseconds(50);
+
+    if (!dev.transfer(cmd, reply, sizeof(reply)))
+        return false;
+    id = ((uint32_t) reply[1] << 16) | (reply[2] << 8) | reply[3];
+    if (reply[1] == 0x00 || reply[1] == 0xFF || reply[3] < 16)
+        return false;
+
+    // Beyond 16 MB the part would need 4 byte addresses
+    capacity = 1UL << (reply[3] > 24 ? 24 : reply[3]);
+    if (offset >= capacity)
+        return false;
+    available = (capacity - offset) / SECTOR_SIZE;
+    if (!eraseBlocks || eraseBlocks > available)
+        eraseBlocks = available;
+    return true;
+}
+
+void SPINorBlockDevice::command(uint8_t cmd, uint32_t address)
+{
+    address += offset;
+    header[0] = cmd;
+    header[1] = address >> 16;
+    header[2] = address >> 8;
+    header[3] = address;
+    header[4] = 0xFF;       // dummy byte of fast read
+}
+
+bool SPINorBlockDevice::writeEnable(void)
+{
+    uint8_t cmd = CMD_WRITE_ENABLE;
+
+    return dev.transfer(&cmd, NULL, 1);
+}
+
+bool SPINorBlockDevice::waitReady(uint32_t timeoutMs)
+{
+    uint8_t cmd[2] = { CMD_READ_STATUS, 0xFF };
+    uint8_t status[2];
+    uint32_t start = millis();
+
+    while (busy) {
+        if (!dev.transfer(cmd, status, sizeof(status)))
+            return false;
+        if (!(status[1] & STATUS_BUSY))
+            busy = false;
+        else if (millis() - start > timeoutMs)
+            return false;
+    }
+    return true;
+}
+
+bool SPINorBlockDevice::read(uint32_t address, void *buf, size_t count)
+{
+    uint8_t *p = (uint8_t *) buf;
+    size_t chunk;
+    SPIChain chain;
+
+    if (!valid(address, count) || !waitReady())
+        return false;
+
+    for (; count; count -= chunk, address += chunk, p += chunk) {
+        chunk = count > READ_CHUNK ? READ_CHUNK : count;
+        command(CMD_FAST_READ, address);
+        chain.clear();
+        if (!chain.add(header, NULL, 5) || !chain.add(NULL, p, chunk) ||
+            !dev.transfer(chain))
+            return false;
+    }
+    return true;
+}
+
+bool SPINorBlockDevice::program(uint32_t address, const void *buf, size_t count)
+{
+    const uint8_t *p = (const uint8_t *) buf;
+    size_t chunk;
+    SPIChain chain;
+
+    if (!valid(address, count))
+        return false;
+
+    // A page program wraps round at the end of its page
+    for (; count; count -= chunk, address += chunk, p += chunk) {
+        chunk = PAGE_SIZE - (address + offset) % PAGE_SIZE;
+        if (chunk > count)
+            chunk = count;
+        if (!waitReady() || !writeEnable())
+            return false;
+        command(CMD_PAGE_PROGRAM, address);
+        chain.clear();
+        if (!chain.add(header, NULL, 4) || !chain.add(p, NULL, chunk) ||
+            !dev.transfer(chain))
+            return false;
+        busy = true;
+    }
+    return true;
+}
+
+bool SPINorBlockDevice::erase(uint32_t address)
+{
+    if (!valid(address, SECTOR_SIZE) || address % SECTOR_SIZE || !waitReady())
+        return false;
+
+    if (!writeEnable())
+        return false;
+    command(CMD_SECTOR_ERASE, address);
+    if (!dev.transfer(header, NULL, 4))
+        return false;
+    busy = true;
+    return true;
+}
+
+#endif
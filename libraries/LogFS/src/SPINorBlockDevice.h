@@ -0,0 +1,64 @@
+/*
+  SPINorBlockDevice.h - Serial NOR flash as a LogFS block device
+  Copyright (c) 2016 Energia.  All right reserved.
+
+    SPIBus bus(SPI);
+    SPIDevice chip(bus, 12, SPISettings(20000000, MSBFIRST, SPI_MODE0));
+    SPINorBlockDevice flash(chip);
+
+  Any 25 series flash with 4 KB sector erase (0x20): W25Q, MX25L, AT25SF,
+  S25FL1 and the like. The size comes from the JEDEC ID, up to 16 MB with
+  3 byte addresses. Reads and page programs go out as one SPIChain each,
+  command and data back to back under one chip select, so the data moves
+  by uDMA and the bus stays free for other devices in between.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef SPINorBlockDevice_h
+#define SPINorBlockDevice_h
+
+#include <SPIDevice.h>
+#include "BlockDevice.h"
+
+class SPINorBlockDevice : public BlockDevice {
+public:
+  // blocks 0 uses the whole chip; firstBlock skips space used otherwise
+  SPINorBlockDevice(SPIDevice &device, uint32_t firstBlock = 0, uint32_t blocks = 0);
+
+  bool begin(void);
+  bool read(uint32_t address, void *buf, size_t count);
+  bool program(uint32_t address, const void *buf, size_t count);
+  bool erase(uint32_t address);
+  bool sync(void) { return waitReady(); }
+
+  uint32_t jedecId(void) const { return id; }
+
+private:
+  SPIDevice &dev;
+  uint32_t offset;
+  uint32_t id;
+  bool busy;
+  uint8_t header[5];
+
+  void command(uint8_t cmd, uint32_t address);
+  bool writeEnable(void);
+  bool waitReady(uint32_t timeoutMs = 500);
+  bool valid(uint32_t address, size_t count) const {
+    return address <= eraseSize * eraseBlocks && count <= eraseSize * eraseBlocks - address;
+  }
+};
+
+#endif
@@ -0,0 +1,61 @@
+/*
+  QSPIFlashInfo
+
+  Reads the ID of the serial flash on the DK-TM4C129X (Macronix
+  MX66L51235F on SSI3, port Q), then times a 4 KB read on one, two and
+  four data lines.
+
+  The flash has to be on the module's hardware FSS pin, PQ1 here, and
+  its IO2/IO3 pins wired to SSI3XDAT2/SSI3XDAT3 for quad reads.
+*/
+
+#include <SPI.h>
+#include <QSPIFlash.h>
+
+SPIClass flashSPI(5);
+QSPIFlash flash(flashSPI);
+uint8_t buf[4096];
+
+void timeRead(uint8_t lines)
+{
+  unsigned long start;
+
+  flash.begin(40000000, lines);
+  start = micros();
+  flash.read(0, buf, sizeof(buf));
+  Serial.print(flash.lines());
+  Serial.print(" line read: ");
+  Serial.print(micros() - start);
+  Serial.println(" us");
+}
+
+void setup()
+{
+  uint8_t id[3];
+
+  Serial.begin(115200);
+  delay(1000);
+
+  if (!flash.begin()) {
+    Serial.println("no flash found");
+    return;
+  }
+  flash.readId(id);
+  Serial.print("JEDEC ID ");
+  Serial.print(id[0], HEX);
+  Serial.print(" ");
+  Serial.print(id[1], HEX);
+  Serial.print(" ");
+  Serial.println(id[2], HEX);
+  Serial.print("size ");
+  Serial.print(flash.size() >> 20);
+  Serial.println(" MB");
+
+  timeRead(1);
+  timeRead(2);
+  timeRead(4);
+}
+
+void loop()
+{
+}
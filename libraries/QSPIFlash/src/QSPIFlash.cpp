@@ -0,0 +1,245 @@
+/*
+  QSPIFlash.cpp - Serial NOR flash over the TM4C129 Bi-/Quad-SSI
+  Copyright (c) 2016 Energia.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "QSPIFlash.h"
+
+#define CMD_WRITE_STATUS    0x01
+#define CMD_PAGE_PROGRAM    0x02
+#define CMD_READ_STATUS     0x05
+#define CMD_WRITE_ENABLE    0x06
+#define CMD_FAST_READ       0x0B
+#define CMD_SECTOR_ERASE    0x20
+#define CMD_WRITE_STATUS2   0x31
+#define CMD_READ_STATUS2    0x35
+#define CMD_DUAL_READ       0x3B
+#define CMD_QUAD_READ       0x6B
+#define CMD_JEDEC_ID        0x9F
+#define CMD_ENTER_4B        0xB7
+#define CMD_CHIP_ERASE      0xC7
+#define CMD_BLOCK_ERASE     0xD8
+
+#define STATUS_BUSY         0x01
+#define STATUS_WEL          0x02
+
+#define MFR_MACRONIX        0xC2
+
+// Worst case program and erase times of common 3 V parts, with margin
+#define PROGRAM_TIMEOUT     10
+#define SECTOR_TIMEOUT      1000
+#define BLOCK_TIMEOUT       4000
+#define CHIP_TIMEOUT        600000UL
+
+QSPIFlash::QSPIFlash(SPIClass &port) : spi(port) {
+    capacity = 0;
+    dataLines = 1;
+    addressBytes = 3;
+    manufacturer = 0;
+}
+
+bool QSPIFlash::begin(uint32_t clock, uint8_t maxLines) {
+    uint8_t id[3];
+
+    capacity = 0;
+    dataLines = 1;
+    addressBytes = 3;
+    // Single line until the ID says what the part is
+    spi.beginAdvanced(false);
+    spi.applySettings(SPISettings(clock, MSBFIRST, SPI_MODE0));
+
+    readId(id);
+    if (id[0] == 0x00 || id[0] == 0xFF)
+        return false;
+    manufacturer = id[0];
+
+    // log2 of the size in bytes, except above 256 Mbit on some vendors
+    // where 0x20 means 512 Mbit
+    if (id[2] >= 0x20 && id[2] <= 0x22)
+        capacity = 1UL << (id[2] - 6);
+    else if (id[2] >= 0x10 && id[2] < 0x20)
+        capacity = 1UL << id[2];
+
+    if (capacity > 0x1000000UL) {
+        command(CMD_ENTER_4B, NULL, NULL, 0);
+        addressBytes = 4;
+    }
+
+    if (maxLines >= 4 && spi.beginAdvanced(true) && quadEnable())
+        dataLines = 4;
+    else if (maxLines >= 2)
+        dataLines = 2;
+    return true;
+}
+
+void QSPIFlash::end(void) {
+    spi.endAdvanced();
+}
+
+//
+// One command frame: the opcode, then count bytes out of tx or into rx,
+// all on a single line
+//
+void QSPIFlash::command(uint8_t cmd, const uint8_t *tx, uint8_t *rx, size_t count) {
+    spi.advWrite(&cmd, 1, 1, count == 0);
+    if (!count)
+        return;
+    if (rx)
+        spi.advRead(rx, count, 1, true);
+    else
+        spi.advWrite(tx, count, 1, true);
+}
+
+// Opcode, address and an optional dummy byte, leaving FSS low for the data
+void QSPIFlash::header(uint8_t cmd, uint32_t address, bool dummy, bool last) {
+    uint8_t buf[6];
+    uint8_t n = 0, i;
+
+    buf[n++] = cmd;
+    for (i = addressBytes; i > 0; i--)
+        buf[n++] = address >> (8 * (i - 1));
+    if (dummy)
+        buf[n++] = 0xFF;
+    spi.advWrite(buf, n, 1, last);
+}
+
+void QSPIFlash::readId(uint8_t id[3]) {
+    command(CMD_JEDEC_ID, NULL, id, 3);
+}
+
+uint8_t QSPIFlash::status(uint8_t cmd) {
+    uint8_t value;
+
+    command(cmd, NULL, &value, 1);
+    return value;
+}
+
+bool QSPIFlash::busy(void) {
+    return status(CMD_READ_STATUS) & STATUS_BUSY;
+}
+
+bool QSPIFlash::waitReady(uint32_t timeoutMs) {
+    uint32_t start = millis();
+
+    while (busy()) {
+        if (millis() - start > timeoutMs)
+            return false;
+    }
+    return true;
+}
+
+bool QSPIFlash::writeEnable(void) {
+    command(CMD_WRITE_ENABLE, NULL, NULL, 0);
+    return status(CMD_READ_STATUS) & STATUS_WEL;
+}
+
+//
+// Macronix keeps QE in bit 6 of status register 1; Winbond, GigaDevice
+// and most others in bit 1 of status register 2, written either on its
+// own or, on older parts, together with register 1. Non-volatile, so
+// this normally writes only once per part.
+//
+bool QSPIFlash::quadEnable(void) {
+    uint8_t sr[2];
+
+    if (manufacturer == MFR_MACRONIX) {
+        sr[0] = status(CMD_READ_STATUS);
+        if (sr[0] & 0x40)
+            return true;
+        sr[0] |= 0x40;
+        if (!writeEnable())
+            return false;
+        command(CMD_WRITE_STATUS, sr, NULL, 1);
+        waitReady(SECTOR_TIMEOUT);
+        return status(CMD_READ_STATUS) & 0x40;
+    }
+
+    sr[1] = status(CMD_READ_STATUS2);
+    if (sr[1] & 0x02)
+        return true;
+    sr[1] |= 0x02;
+    if (writeEnable()) {
+        command(CMD_WRITE_STATUS2, &sr[1], NULL, 1);
+        waitReady(SECTOR_TIMEOUT);
+    }
+    if (!(status(CMD_READ_STATUS2) & 0x02) && writeEnable()) {
+        sr[0] = status(CMD_READ_STATUS);
+        command(CMD_WRITE_STATUS, sr, NULL, 2);
+        waitReady(SECTOR_TIMEOUT);
+    }
+    return status(CMD_READ_STATUS2) & 0x02;
+}
+
+bool QSPIFlash::read(uint32_t address, void *buf, size_t count) {
+    uint8_t cmd = dataLines == 4 ? CMD_QUAD_READ :
+                  dataLines == 2 ? CMD_DUAL_READ : CMD_FAST_READ;
+
+    if (!capacity || address + count > capacity)
+        return false;
+    if (!count)
+        return true;
+    header(cmd, address, true, false);
+    spi.advRead(buf, count, dataLines, true);
+    return true;
+}
+
+bool QSPIFlash::write(uint32_t address, const void *buf, size_t count) {
+    const uint8_t *p = (const uint8_t *) buf;
+    size_t chunk;
+
+    if (!capacity || address + count > capacity)
+        return false;
+
+    while (count) {
+        // A page program wraps within its page, so stop at the boundary
+        chunk = QSPIFLASH_PAGE_SIZE - (address & (QSPIFLASH_PAGE_SIZE - 1));
+        if (chunk > count)
+            chunk = count;
+        if (!writeEnable())
+            return false;
+        header(CMD_PAGE_PROGRAM, address, false, false);
+        spi.advWrite(p, chunk, 1, true);
+        if (!waitReady(PROGRAM_TIMEOUT))
+            return false;
+        address += chunk;
+        p += chunk;
+        count -= chunk;
+    }
+    return true;
+}
+
+bool QSPIFlash::erase(uint8_t cmd, uint32_t address, uint32_t timeoutMs) {
+    if (!capacity || address >= capacity || !writeEnable())
+        return false;
+    header(cmd, address, false, true);
+    return waitReady(timeoutMs);
+}
+
+bool QSPIFlash::eraseSector(uint32_t address) {
+    return erase(CMD_SECTOR_ERASE, address, SECTOR_TIMEOUT);
+}
+
+bool QSPIFlash::eraseBlock(uint32_t address) {
+    return erase(CMD_BLOCK_ERASE, address, BLOCK_TIMEOUT);
+}
+
+bool QSPIFlash::eraseChip(void) {
+    if (!capacity || !writeEnable())
+        return false;
+    command(CMD_CHIP_ERASE, NULL, NULL, 0);
+    return waitReady(CHIP_TIMEOUT);
+}
@@ -0,0 +1,86 @@
+/*
+  QSPIFlash.h - Serial NOR flash over the TM4C129 Bi-/Quad-SSI
+  Copyright (c) 2016 Energia.  All right reserved.
+
+    SPIClass flashSPI(5);             // SSI3 on port Q of the DK-TM4C129X
+    QSPIFlash flash(flashSPI);
+    flash.begin(40000000);
+    flash.read(0x10000, buf, sizeof(buf));
+
+  The flash sits on the hardware FSS pin of the module, which stays low
+  for a whole command through frame hold. Reads use Fast Read Quad
+  Output (0x6B) or Fast Read Dual Output (0x3B): command, address and
+  dummy byte on one line and the data on four or two, so reads move up
+  to four times as much data per clock as plain SPI. begin() sets the
+  quad enable bit where the part needs one, and falls back to dual
+  when it cannot or the module has no XDAT2/XDAT3 pins. Page programming
+  is limited by the flash's program time rather than the bus, so writes
+  use the single line 0x02. Parts above 16 MB are switched to 4 byte
+  addresses.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef QSPIFlash_h
+#define QSPIFlash_h
+
+#include <SPI.h>
+
+#if !defined(__TM4C129XNCZAD__) && !defined(__TM4C1294NCPDT__)
+#error "QSPIFlash needs the advanced SSI of the TM4C129"
+#endif
+
+#define QSPIFLASH_PAGE_SIZE     256
+#define QSPIFLASH_SECTOR_SIZE   4096
+#define QSPIFLASH_BLOCK_SIZE    65536
+
+class QSPIFlash {
+public:
+  QSPIFlash(SPIClass &spi);
+
+  // false if nothing answers the JEDEC ID command; maxLines 1, 2 or 4
+  bool begin(uint32_t clock = 40000000, uint8_t maxLines = 4);
+  void end(void);
+
+  void readId(uint8_t id[3]);
+  uint32_t size(void) const { return capacity; }
+  uint8_t lines(void) const { return dataLines; }
+
+  bool read(uint32_t address, void *buf, size_t count);
+  // Clears bits only, erase first; may cross page boundaries
+  bool write(uint32_t address, const void *buf, size_t count);
+  bool eraseSector(uint32_t address);   // 4 KB
+  bool eraseBlock(uint32_t address);    // 64 KB
+  bool eraseChip(void);
+
+  bool busy(void);
+  bool waitReady(uint32_t timeoutMs);
+
+private:
+  SPIClass &spi;
+  uint32_t capacity;
+  uint8_t dataLines;
+  uint8_t addressBytes;
+  uint8_t manufacturer;
+
+  void command(uint8_t cmd, const uint8_t *tx, uint8_t *rx, size_t count);
+  void header(uint8_t cmd, uint32_t address, bool dummy, bool last);
+  uint8_t status(uint8_t cmd);
+  bool writeEnable(void);
+  bool quadEnable(void);
+  bool erase(uint8_t cmd, uint32_t address, uint32_t timeoutMs);
+};
+
+#endif
@@ -0,0 +1,72 @@
+/*
+  Datalogger
+
+  Logs A0, A1 and A2 at 1 kHz to DATALOG.CSV on an SD card with chip
+  select on pin 8, then prints how long the writes took.
+
+  The file gets 1 MB of contiguous clusters up front, so the lines go
+  to the card as one multi-block write; flush() every second puts the
+  size into the directory, so a power cut loses at most a second.
+*/
+
+#include <SPI.h>
+#include <SPIDevice.h>
+#include <SD.h>
+
+#define SD_CS       8
+#define SAMPLES     10000
+
+SPIBus bus(SPI);
+SPIDevice card(bus, SD_CS, SPISettings(25000000, MSBFIRST, SPI_MODE0));
+File logFile;
+unsigned long busy;
+
+void setup()
+{
+  Serial.begin(115200);
+  if (!SD.begin(card)) {
+    Serial.println("no card");
+    while (1)
+      ;
+  }
+  Serial.print("FAT");
+  Serial.print(SD.fatType());
+  Serial.print(", ");
+  Serial.print(SD.clusterSize());
+  Serial.println(" byte clusters");
+
+  logFile = SD.open("DATALOG.CSV", FILE_WRITE | SD_TRUNCATE);
+  if (!logFile || !logFile.preAllocate(1000000))
+    Serial.println("could not create DATALOG.CSV");
+}
+
+void loop()
+{
+  static unsigned long next = micros();
+  static unsigned int count;
+  unsigned long start;
+
+  if (!logFile || (long)(micros() - next) < 0)
+    return;
+  next += 1000;
+
+  start = micros();
+  logFile.print(millis());
+  logFile.print(',');
+  logFile.print(analogRead(A0));
+  logFile.print(',');
+  logFile.print(analogRead(A1));
+  logFile.print(',');
+  logFile.println(analogRead(A2));
+  if (++count % 1000 == 0)
+    logFile.flush();
+  busy += micros() - start;
+
+  if (count == SAMPLES) {
+    Serial.print(logFile.size());
+    Serial.print(" bytes, ");
+    Serial.print(busy / SAMPLES);
+    Serial.println(" us per line");
+    logFile.close();
+  }
+}
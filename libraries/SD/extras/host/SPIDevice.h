@@ -0,0 +1,29 @@
+/*
+  SPIDevice.h - Stand-in for the SPI library when building SD on the host
+  Copyright (c) 2016 Energia.  All right reserved.
+
+  SdCard.h only passes these around; the host test supplies an SdCard
+  that keeps the blocks in RAM instead of talking to a card.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef SPIDevice_h
+#define SPIDevice_h
+
+class SPIClass {};
+class SPIDevice {};
+
+#endif
@@ -0,0 +1,491 @@
+/*
+  TestSD.cpp - Host test of the FAT16 and FAT32 layer on RAM images
+
+  The card is replaced by a RAM image formatted here; random writes,
+  appends, overwrites, truncates, pre-allocations, removes and remounts
+  are checked against a model of the files kept in std::map. After
+  unmounting, the image is walked by a checker written separately from
+  SD.cpp: FAT copies, cluster chains, cross links, lost clusters, FSInfo
+  and every file's contents.
+
+    cd libraries/SD
+    g++ -std=gnu++11 -O2 -Iextras/host -I../../extras/host -Isrc \
+        -o TestSD extras/host/TestSD.cpp src/SD.cpp
+    ./TestSD [seed]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "SD.h"
+#include "HostTest.h"
+
+typedef std::map<std::string, std::string> Model;
+
+//
+// The card: blocks in RAM
+//
+static std::vector<uint8_t> image;
+static uint32_t multiWrites;
+
+SdCard::SdCard(void)
+{
+	dev = NULL;
+	spi = NULL;
+	cardType = SD_CARD_NONE;
+	error = SD_ERROR_NONE;
+	state = 0;
+	blocks = 0;
+}
+
+bool SdCard::begin(SPIDevice &device)
+{
+	dev = &device;
+	cardType = image.empty() ? SD_CARD_NONE : SD_CARD_SDHC;
+	blocks = image.size() / SD_BLOCK_SIZE;
+	return cardType != SD_CARD_NONE;
+}
+
+bool SdCard::readBlocks(uint32_t lba, uint8_t *buf, uint32_t count)
+{
+	if (lba >= blocks || count > blocks - lba) {
+		error = SD_ERROR_RANGE;
+		return false;
+	}
+	memcpy(buf, &image[(size_t)lba * SD_BLOCK_SIZE], (size_t)count * SD_BLOCK_SIZE);
+	return true;
+}
+
+bool SdCard::writeBlocks(uint32_t lba, const uint8_t *buf, uint32_t count)
+{
+	if (lba >= blocks || count > blocks - lba) {
+		error = SD_ERROR_RANGE;
+		return false;
+	}
+	memcpy(&image[(size_t)lba * SD_BLOCK_SIZE], buf, (size_t)count * SD_BLOCK_SIZE);
+	multiWrites += count > 1;
+	return true;
+}
+
+bool SdCard::sync(void)
+{
+	return cardType != SD_CARD_NONE;
+}
+
+//
+// Formatting and checking, independent of SD.cpp
+//
+static uint16_t le16(const uint8_t *p)
+{
+	return p[0] | p[1] << 8;
+}
+
+static uint32_t le32(const uint8_t *p)
+{
+	return le16(p) | (uint32_t)le16(p + 2) << 16;
+}
+
+static void put16(uint8_t *p, uint16_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+	put16(p, v);
+	put16(p + 2, v >> 16);
+}
+
+// Superfloppy layout, no partition table, like a freshly formatted card
+static void format(uint32_t sectors, bool fat32, uint8_t sectorsPerCluster)
+{
+	const uint32_t reserved = fat32 ? 32 : 1, fats = 2, rootEntries = fat32 ? 0 : 512;
+	const uint32_t rootSectors = rootEntries * 32 / 512;
+	uint32_t fatSectors = 1, clusters, i;
+	uint8_t *bs;
+
+	for (;;) {
+		clusters = (sectors - reserved - fats * fatSectors - rootSectors) / sectorsPerCluster;
+		if (((clusters + 2) * (fat32 ? 4 : 2) + 511) / 512 <= fatSectors)
+			break;
+		fatSectors++;
+	}
+
+	image.assign((size_t)sectors * 512, 0);
+	bs = &image[0];
+	memcpy(bs, "\xEB\x58\x90MSWIN4.1", 11);
+	put16(bs + 11, 512);
+	bs[13] = sectorsPerCluster;
+	put16(bs + 14, reserved);
+	bs[16] = fats;
+	put16(bs + 17, rootEntries);
+	put16(bs + 19, sectors < 65536 ? sectors : 0);
+	bs[21] = 0xF8;
+	put16(bs + 22, fat32 ? 0 : fatSectors);
+	put16(bs + 24, 63);
+	put16(bs + 26, 255);
+	put32(bs + 32, sectors < 65536 ? 0 : sectors);
+	if (fat32) {
+		put32(bs + 36, fatSectors);
+		put32(bs + 44, 2);              // root directory cluster
+		put16(bs + 48, 1);              // FSInfo sector
+		put16(bs + 50, 6);
+		bs[66] = 0x29;
+		memcpy(bs + 82, "FAT32   ", 8);
+
+		uint8_t *info = bs + 512;
+		put32(info, 0x41615252);
+		put32(info + 484, 0x61417272);
+		put32(info + 488, 0xFFFFFFFF);  // free count unknown
+		put32(info + 492, 3);
+		info[510] = 0x55;
+		info[511] = 0xAA;
+	} else {
+		bs[38] = 0x29;
+		memcpy(bs + 54, "FAT16   ", 8);
+	}
+	bs[510] = 0x55;
+	bs[511] = 0xAA;
+
+	for (i = 0; i < fats; i++) {
+		uint8_t *fat = bs + (reserved + i * fatSectors) * 512;
+		if (fat32) {
+			put32(fat, 0x0FFFFFF8);
+			put32(fat + 4, 0x0FFFFFFF);
+			put32(fat + 8, 0x0FFFFFFF);     // root directory
+		} else {
+			put16(fat, 0xFFF8);
+			put16(fat + 2, 0xFFFF);
+		}
+	}
+}
+
+struct Volume {
+	const uint8_t *base;
+	bool fat32;
+	uint32_t clusterBytes;
+	uint32_t fatStart;
+	uint32_t fatBytes;
+	uint32_t fats;
+	uint32_t rootStart;
+	uint32_t rootBytes;
+	uint32_t dataStart;
+	uint32_t clusters;
+	std::vector<std::string> owner;
+	Model files;
+	int errors;
+};
+
+static void problem(Volume &v, const std::string &what)
+{
+	printf("  %s\n", what.c_str());
+	v.errors++;
+}
+
+static uint32_t fatEntry(const Volume &v, uint32_t cluster)
+{
+	const uint8_t *fat = v.base + v.fatStart;
+
+	return v.fat32 ? le32(fat + cluster * 4) & 0x0FFFFFFF : le16(fat + cluster * 2);
+}
+
+// The contents of the chain from first, which is claimed for owner
+static bool readChain(Volume &v, uint32_t first, const std::string &owner, std::string &data)
+{
+	const uint32_t end = v.fat32 ? 0x0FFFFFF8 : 0xFFF8;
+	uint32_t c;
+
+	data.clear();
+	for (c = first; c < end; c = fatEntry(v, c)) {
+		if (c < 2 || c >= v.clusters + 2) {
+			problem(v, owner + ": chain runs into cluster " + std::to_string(c));
+			return false;
+		}
+		if (!v.owner[c].empty()) {
+			problem(v, owner + ": cluster " + std::to_string(c) + " also in " + v.owner[c]);
+			return false;
+		}
+		v.owner[c] = owner;
+		data.append((const char *)v.base + v.dataStart + (size_t)(c - 2) * v.clusterBytes,
+		            v.clusterBytes);
+	}
+	return true;
+}
+
+static void walk(Volume &v, const std::string &dir, const std::string &path)
+{
+	size_t i;
+
+	for (i = 0; i + 32 <= dir.size(); i += 32) {
+		const uint8_t *e = (const uint8_t *)dir.data() + i;
+		std::string name((const char *)e, 8), ext((const char *)e + 8, 3), data;
+		uint32_t first = le16(e + 26) | (v.fat32 ? (uint32_t)le16(e + 20) << 16 : 0);
+		uint32_t size = le32(e + 28);
+
+		if (e[0] == 0)
+			return;
+		if (e[0] == 0xE5 || e[11] == 0x0F || (e[11] & 0x08) || e[0] == '.')
+			continue;
+		name.erase(name.find_last_not_of(' ') + 1);
+		ext.erase(ext.find_last_not_of(' ') + 1);
+		if (!ext.empty())
+			name += "." + ext;
+		name = path + name;
+
+		if (e[11] & 0x10) {
+			if (!first)
+				problem(v, name + ": directory without clusters");
+			else if (readChain(v, first, name, data))
+				walk(v, data, name + "/");
+		} else if (first || size) {
+			if (!readChain(v, first, name, data))
+				continue;
+			// close() gives back what preAllocate() did not use
+			if (data.size() != (size + v.clusterBytes - 1) / v.clusterBytes * v.clusterBytes)
+				problem(v, name + ": " + std::to_string(data.size() / v.clusterBytes) +
+				        " clusters for " + std::to_string(size) + " bytes");
+			data.resize(size < data.size() ? size : data.size());
+			v.files[name] = data;
+		} else {
+			v.files[name] = "";
+		}
+	}
+}
+
+static bool checkVolume(Volume &v)
+{
+	const uint8_t *bs = &image[0];
+	uint32_t fatSectors = le16(bs + 22) ? le16(bs + 22) : le32(bs + 36);
+	uint32_t sectors = le16(bs + 19) ? le16(bs + 19) : le32(bs + 32);
+	uint32_t bytes = le16(bs + 11), allocated = 0, reachable = 0, c, i;
+	std::string root;
+
+	v.base = bs;
+	v.clusterBytes = bs[13] * bytes;
+	v.fatStart = le16(bs + 14) * bytes;
+	v.fats = bs[16];
+	v.fatBytes = fatSectors * bytes;
+	v.rootStart = v.fatStart + v.fats * v.fatBytes;
+	v.rootBytes = le16(bs + 17) * 32;
+	v.dataStart = v.rootStart + (v.rootBytes + bytes - 1) / bytes * bytes;
+	v.clusters = (sectors * bytes - v.dataStart) / v.clusterBytes;
+	v.fat32 = v.clusters >= 65525;
+	v.owner.assign(v.clusters + 2, std::string());
+	v.files.clear();
+	v.errors = 0;
+
+	for (i = 1; i < v.fats; i++)
+		if (memcmp(bs + v.fatStart, bs + v.fatStart + i * v.fatBytes, v.fatBytes))
+			problem(v, "FAT copy " + std::to_string(i) + " differs");
+
+	if (v.fat32) {
+		if (readChain(v, le32(bs + 44), "/", root))
+			walk(v, root, "");
+	} else {
+		walk(v, std::string((const char *)bs + v.rootStart, v.rootBytes), "");
+	}
+
+	for (c = 2; c < v.clusters + 2; c++) {
+		allocated += fatEntry(v, c) != 0;
+		reachable += !v.owner[c].empty();
+	}
+	if (allocated != reachable)
+		problem(v, std::to_string(allocated - reachable) + " lost clusters");
+	if (v.fat32) {
+		uint32_t free = le32(bs + le16(bs + 48) * bytes + 488);
+		if (free != 0xFFFFFFFF && free != v.clusters - allocated)
+			problem(v, "FSInfo free count " + std::to_string(free) + ", " +
+			        std::to_string(v.clusters - allocated) + " free");
+	}
+	return !v.errors;
+}
+
+//
+// The tests
+//
+static SPIDevice device;
+
+static std::string randomData(int count)
+{
+	std::string data;
+
+	while (count-- > 0)
+		data += (char)('a' + rand() % 26);
+	return data;
+}
+
+static bool readAll(const std::string &name, std::string &data)
+{
+	File f = SD.open(name.c_str());
+	char buf[700];
+	int n;
+
+	data.clear();
+	if (!f)
+		return false;
+	while ((n = f.read(buf, 1 + rand() % sizeof(buf))) > 0)
+		data.append(buf, n);
+	f.close();
+	return true;
+}
+
+static bool matches(const Model &model)
+{
+	std::string data;
+
+	for (Model::const_iterator i = model.begin(); i != model.end(); ++i) {
+		if (!readAll(i->first, data) || data != i->second) {
+			printf("  %s differs: %zu bytes, %zu expected\n", i->first.c_str(),
+			       data.size(), i->second.size());
+			return false;
+		}
+	}
+	return true;
+}
+
+// One random step on model; false when the file system disagrees
+static bool randomStep(Model &model)
+{
+	static const char *const dirs[] = { "", "LOGS/", "LOGS/SUB/" };
+	char path[32];
+	std::string data, none;
+	File f;
+
+	snprintf(path, sizeof(path), "%sF%d.TXT", dirs[rand() % 3], rand() % 8);
+	std::string name = path;
+	Model::iterator it = model.find(name);
+	bool exists = it != model.end();
+	std::string &m = exists ? it->second : none;
+
+	switch (rand() % 12) {
+	case 0: case 1: case 2: case 3: case 4: {
+		std::string add = randomData(rand() % (rand() % 4 ? 300 : 5000));
+		size_t done = 0;
+
+		f = SD.open(path, FILE_WRITE);
+		if (!f)
+			return false;
+		if (rand() % 5 == 0)
+			f.preAllocate(f.size() + add.size() + rand() % 20000);
+		while (done < add.size()) {
+			size_t n = 1 + rand() % 1500;
+			if (n > add.size() - done)
+				n = add.size() - done;
+			if (f.write((const uint8_t *)add.data() + done, n) != n)
+				return false;
+			done += n;
+			if (rand() % 10 == 0)
+				f.flush();
+		}
+		f.close();
+		model[name] += add;
+		return true;
+	}
+	case 5:
+		if (!exists)
+			return !SD.exists(path);
+		model.erase(name);
+		return SD.remove(path) && !SD.exists(path);
+	case 6:
+		if (!exists || m.size() <= 20)
+			return true;
+		{
+			uint32_t at = rand() % (m.size() - 10);
+			f = SD.open(path, SD_READ | SD_WRITE);
+			if (!f || !f.seek(at) || f.write((const uint8_t *)"0123456789", 10) != 10)
+				return false;
+			f.close();
+			m.replace(at, 10, "0123456789");
+		}
+		return true;
+	case 7:
+		if (!exists)
+			return true;
+		{
+			uint32_t length = rand() % (m.size() + 1);
+			f = SD.open(path, SD_READ | SD_WRITE);
+			if (!f || !f.truncate(length))
+				return false;
+			f.close();
+			m.resize(length);
+		}
+		return true;
+	case 8:
+		SD.end();
+		return SD.begin(device) && matches(model);
+	case 9:
+		if (!exists)
+			return true;
+		{
+			uint32_t at = rand() % (m.size() + 1);
+			f = SD.open(path);
+			if (!f || !f.seek(at))
+				return false;
+			data.resize(m.size() - at);
+			if (data.size() && f.read(&data[0], data.size()) != (int)data.size())
+				return false;
+			f.close();
+			return data == m.substr(at);
+		}
+	default: {
+		size_t total = 0;
+		for (Model::iterator i = model.begin(); i != model.end(); ++i)
+			total += i->second.size();
+		if (total > 200000) {
+			name = model.begin()->first;
+			model.erase(model.begin());
+			return SD.remove(name.c_str());
+		}
+		return true;
+	}
+	}
+}
+
+static void testVolume(bool fat32)
+{
+	const char *type = fat32 ? "FAT32" : "FAT16";
+	Model model;
+	Volume volume;
+	int step, listed = 0, expect = 0;
+	bool ok = true;
+
+	format(fat32 ? 140000 : 40000, fat32, 1);
+	multiWrites = 0;
+
+	check(SD.begin(device) && SD.fatType() == (fat32 ? 32 : 16), "%s mount", type);
+	check(SD.mkdir("/LOGS/SUB") && SD.exists("LOGS") && SD.exists("LOGS/SUB"), "%s mkdir with parents", type);
+
+	for (step = 0; step < 3000 && ok; step++)
+		ok = randomStep(model);
+	if (!ok)
+		printf("  failed at step %d\n", step - 1);
+	check(ok && matches(model), "%s random operations match the model", type);
+
+	File dir = SD.open("/LOGS/SUB");
+	for (File f = dir.openNextFile(); f; f = dir.openNextFile()) {
+		listed++;
+		f.close();
+	}
+	dir.close();
+	for (Model::iterator i = model.begin(); i != model.end(); ++i)
+		expect += i->first.compare(0, 9, "LOGS/SUB/") == 0;
+	check(listed == expect, "%s directory listing", type);
+	check(multiWrites > 0, "%s whole sectors go out as multi-block writes", type);
+	SD.end();
+
+	check(checkVolume(volume), "%s image passes the checker", type);
+	check(volume.files == model, "%s checker finds the model's files", type);
+}
+
+int main(int argc, char **argv)
+{
+	srand(argc > 1 ? atoi(argv[1]) : 1);
+
+	testVolume(false);
+	testVolume(true);
+
+	return checkResult();
+}
@@ -0,0 +1,1106 @@
+/*
+  SD.cpp - FAT16 and FAT32 file system on SD cards
+  Copyright (c) 2016 Energia.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <string.h>
+#include "SD.h"
+
+#define ATTR_READ_ONLY      0x01
+#define ATTR_VOLUME         0x08
+#define ATTR_DIRECTORY      0x10
+#define ATTR_ARCHIVE        0x20
+#define ATTR_LONG_NAME      0x0F
+
+// Directory entry fields
+#define DIR_ENTRY           32
+#define DIR_ATTR            11
+#define DIR_CREATE_TIME     14
+#define DIR_CREATE_DATE     16
+#define DIR_ACCESS_DATE     18
+#define DIR_CLUSTER_HIGH    20
+#define DIR_WRITE_TIME      22
+#define DIR_WRITE_DATE      24
+#define DIR_CLUSTER_LOW     26
+#define DIR_SIZE            28
+#define DIR_DELETED         0xE5
+
+// FAT values, FAT16 ones are widened to these
+#define FAT_FREE            0
+#define FAT_END             0x0FFFFFF8
+#define FAT_EOC             0x0FFFFFFF
+
+#define FSINFO_LEAD         0x41615252
+#define FSINFO_STRUCT       0x61417272
+
+// cacheGet()
+#define CACHE_READ          0
+#define CACHE_WRITE         1       // will be changed
+#define CACHE_ZERO          2       // will be overwritten, need not be read
+
+// resolve()
+#define RESOLVE_FIND        0
+#define RESOLVE_FILE        1       // create the file if missing
+#define RESOLVE_DIRS        2       // create missing directories
+
+#define NONE                0xFFFFFFFF
+
+SDClass SD;
+
+static uint16_t get16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static void put16(uint8_t *p, uint16_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void put32(uint8_t *p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static bool bootSector(const uint8_t *p) {
+    return get16(p + 11) == SD_BLOCK_SIZE && p[13] && !(p[13] & (p[13] - 1)) &&
+           get16(p + 14) && p[16] >= 1 && p[16] <= 2 && p[510] == 0x55 && p[511] == 0xAA;
+}
+
+// One path component as a space padded 8.3 name; moves *path past it
+static bool makeName(const char **path, uint8_t *name) {
+    const char *s = *path;
+    uint8_t i = 0, limit = 8, c;
+
+    memset(name, ' ', 11);
+    if (s[0] == '.' && (s[1] == '/' || !s[1])) {
+        name[0] = '.';
+        s++;
+    } else if (s[0] == '.' && s[1] == '.' && (s[2] == '/' || !s[2])) {
+        name[0] = name[1] = '.';
+        s += 2;
+    } else {
+        for (; *s && *s != '/'; s++) {
+            c = *s;
+            if (c == '.') {
+                if (!i || limit == 11)
+                    return false;
+                i = 8;
+                limit = 11;
+                continue;
+            }
+            if (c <= ' ' || c >= 0x7F || strchr("\"*+,:;<=>?[\\]|", c) || i == limit)
+                return false;
+            name[i++] = (c >= 'a' && c <= 'z') ? c - 'a' + 'A' : c;
+        }
+        if (!i)
+            return false;
+    }
+    while (*s == '/')
+        s++;
+    *path = s;
+    return true;
+}
+
+static void showName(const uint8_t *entry, char *name) {
+    uint8_t i;
+
+    for (i = 0; i < 8 && entry[i] != ' '; i++)
+        *name++ = entry[i];
+    if (entry[8] != ' ') {
+        *name++ = '.';
+        for (i = 8; i < 11 && entry[i] != ' '; i++)
+            *name++ = entry[i];
+    }
+    *name = 0;
+}
+
+SDClass::SDClass(void) {
+    mounted = false;
+    clusters = 0;
+    clusterBytes = 0;
+    fatStart = 0;
+    fatSize = 0;
+    nextHandleId = 0;
+    dateTime = NULL;
+    memset(handles, 0, sizeof(handles));
+}
+
+bool SDClass::begin(SPIDevice &device) {
+    end();
+    if (!sdCard.begin(device))
+        return false;
+    mounted = mount();
+    return mounted;
+}
+
+void SDClass::end(void) {
+    uint8_t i;
+
+    if (!mounted)
+        return;
+    for (i = 0; i < SD_MAX_OPEN; i++) {
+        if (handles[i].used)
+            closeHandle(&handles[i]);
+    }
+    sync();
+    mounted = false;
+}
+
+bool SDClass::mount(void) {
+    uint32_t start = 0, total;
+    uint16_t info;
+    uint8_t *p, i, type;
+
+    for (i = 0; i < SD_CACHE_SECTORS; i++)
+        cache[i].valid = 0;
+    cacheAge = 0;
+    fsInfoDirty = false;
+    fatStart = 0;
+    fatSize = 0;
+
+    if (!(p = cacheGet(0, CACHE_READ)))
+        return false;
+    if (!bootSector(p)) {
+        // Partitioned: the first FAT16 or FAT32 partition
+        if (p[510] != 0x55 || p[511] != 0xAA)
+            return false;
+        for (i = 0; i < 4; i++) {
+            type = p[0x1BE + i * 16 + 4];
+            if (type == 0x04 || type == 0x06 || type == 0x0B || type == 0x0C || type == 0x0E)
+                break;
+        }
+        if (i == 4)
+            return false;
+        start = get32(p + 0x1BE + i * 16 + 8);
+        if (!(p = cacheGet(start, CACHE_READ)) || !bootSector(p))
+            return false;
+    }
+
+    numFats = p[16];
+    clusterBytes = (uint32_t) p[13] * SD_BLOCK_SIZE;
+    for (clusterShift = 9; (1UL << clusterShift) < clusterBytes; clusterShift++)
+        ;
+    rootEntries = get16(p + 17);
+    total = get16(p + 19) ? get16(p + 19) : get32(p + 32);
+    fatSize = get16(p + 22) ? get16(p + 22) : get32(p + 36);
+    fatStart = start + get16(p + 14);
+    rootStart = fatStart + numFats * fatSize;
+    dataStart = rootStart + (rootEntries * DIR_ENTRY + SD_BLOCK_SIZE - 1) / SD_BLOCK_SIZE;
+    if (total <= dataStart - start)
+        return false;
+
+    // The FAT type follows from the cluster count alone
+    clusters = (total - (dataStart - start)) >> (clusterShift - 9);
+    if (clusters < 4085)
+        return false;
+    fat32 = clusters >= 65525;
+    if (fatSize * (SD_BLOCK_SIZE / (fat32 ? 4 : 2)) < clusters + 2)
+        return false;
+    rootCluster = fat32 ? get32(p + 44) : 0;
+    info = fat32 ? get16(p + 48) : 0;
+    fsInfo = (info && info != 0xFFFF) ? start + info : 0;
+
+    // Allocation carries on where the last one stopped
+    nextFree = 2;
+    if (fsInfo) {
+        if ((p = cacheGet(fsInfo, CACHE_READ)) && get32(p) == FSINFO_LEAD && get32(p + 484) == FSINFO_STRUCT)
+            nextFree = get32(p + 492);
+        else
+            fsInfo = 0;
+    }
+    if (nextFree < 2 || nextFree >= clusters + 2)
+        nextFree = 2;
+    return true;
+}
+
+//
+// Sector cache, least recently used goes first
+//
+uint8_t *SDClass::cacheGet(uint32_t lba, uint8_t how) {
+    Cache *c = NULL;
+    uint8_t i;
+
+    for (i = 0; i < SD_CACHE_SECTORS; i++) {
+        if (cache[i].valid && cache[i].lba == lba) {
+            c = &cache[i];
+            break;
+        }
+    }
+    if (!c) {
+        // FAT sectors stay while there is anything else to let go of, or
+        // every cluster boundary would read the FAT again and interrupt a
+        // multi-block write
+        for (i = 0; i < SD_CACHE_SECTORS; i++) {
+            Cache *e = &cache[i];
+            if (!e->valid) {
+                c = e;
+                break;
+            }
+            if (!c || (isFat(c->lba) && !isFat(e->lba)) ||
+                (isFat(c->lba) == isFat(e->lba) && e->age < c->age))
+                c = e;
+        }
+        if (!cacheWriteBack(c))
+            return NULL;
+        c->valid = 0;
+        if (how == CACHE_ZERO)
+            memset(c->data, 0, SD_BLOCK_SIZE);
+        else if (!sdCard.readBlock(lba, c->data))
+            return NULL;
+        c->lba = lba;
+        c->valid = 1;
+    }
+    c->age = ++cacheAge;
+    if (how != CACHE_READ)
+        c->dirty = 1;
+    return c->data;
+}
+
+bool SDClass::cacheWriteBack(Cache *c) {
+    uint8_t i;
+
+    if (!c->valid || !c->dirty)
+        return true;
+    if (!sdCard.writeBlock(c->lba, c->data))
+        return false;
+    // Every copy of the FAT
+    if (isFat(c->lba)) {
+        for (i = 1; i < numFats; i++) {
+            if (!sdCard.writeBlock(c->lba + i * fatSize, c->data))
+                return false;
+        }
+    }
+    c->dirty = 0;
+    return true;
+}
+
+bool SDClass::cacheFlush(void) {
+    uint8_t i;
+
+    for (i = 0; i < SD_CACHE_SECTORS; i++) {
+        if (!cacheWriteBack(&cache[i]))
+            return false;
+    }
+    return true;
+}
+
+// Before sectors are read directly write them back, before they are
+// written directly drop them
+bool SDClass::cacheRange(uint32_t lba, uint32_t count, bool drop) {
+    uint8_t i;
+
+    for (i = 0; i < SD_CACHE_SECTORS; i++) {
+        Cache &c = cache[i];
+        if (!c.valid || c.lba < lba || c.lba >= lba + count)
+            continue;
+        if (drop)
+            c.valid = c.dirty = 0;
+        else if (!cacheWriteBack(&c))
+            return false;
+    }
+    return true;
+}
+
+//
+// FAT
+//
+bool SDClass::fatGet(uint32_t cluster, uint32_t *value) {
+    uint8_t *p;
+
+    if (cluster < 2 || cluster >= clusters + 2)
+        return false;
+    if (fat32) {
+        if (!(p = cacheGet(fatStart + (cluster >> 7), CACHE_READ)))
+            return false;
+        *value = get32(p + ((cluster & 127) << 2)) & 0x0FFFFFFF;
+    } else {
+        if (!(p = cacheGet(fatStart + (cluster >> 8), CACHE_READ)))
+            return false;
+        *value = get16(p + ((cluster & 255) << 1));
+        if (*value >= 0xFFF7)
+            *value |= 0x0FFF0000;
+    }
+    return true;
+}
+
+bool SDClass::fatSet(uint32_t cluster, uint32_t value) {
+    uint8_t *p;
+
+    if (cluster < 2 || cluster >= clusters + 2)
+        return false;
+    if (fat32) {
+        if (!(p = cacheGet(fatStart + (cluster >> 7), CACHE_WRITE)))
+            return false;
+        p += (cluster & 127) << 2;
+        // The top four bits are reserved
+        put32(p, (get32(p) & 0xF0000000) | (value & 0x0FFFFFFF));
+    } else {
+        if (!(p = cacheGet(fatStart + (cluster >> 8), CACHE_WRITE)))
+            return false;
+        put16(p + ((cluster & 255) << 1), value);
+    }
+    return true;
+}
+
+//
+// Take count free clusters in a row, right after prev if possible, link
+// them up and append them to prev. Returns the first or 0.
+//
+uint32_t SDClass::allocate(uint32_t prev, uint32_t count) {
+    uint32_t c, n, value, first = 0, run = 0;
+
+    c = (prev && prev + 1 < clusters + 2) ? prev + 1 : nextFree;
+    for (n = 0; run < count && n < clusters + count; n++, c++) {
+        // A run cannot wrap round the end of the FAT
+        if (c >= clusters + 2) {
+            c = 2;
+            run = 0;
+        }
+        if (!fatGet(c, &value))
+            return 0;
+        if (value != FAT_FREE) {
+            run = 0;
+            continue;
+        }
+        if (!run)
+            first = c;
+        run++;
+    }
+    if (run < count)
+        return 0;
+
+    for (c = first; c < first + count - 1; c++) {
+        if (!fatSet(c, c + 1))
+            return 0;
+    }
+    if (!fatSet(first + count - 1, FAT_EOC) || (prev && !fatSet(prev, first)))
+        return 0;
+    nextFree = first + count < clusters + 2 ? first + count : 2;
+    fsInfoDirty = true;
+    return first;
+}
+
+bool SDClass::freeChain(uint32_t cluster) {
+    uint32_t next;
+
+    while (cluster >= 2 && cluster < clusters + 2) {
+        if (!fatGet(cluster, &next) || !fatSet(cluster, FAT_FREE))
+            return false;
+        cluster = next;
+    }
+    fsInfoDirty = true;
+    return true;
+}
+
+// Keep the clusters needed for length bytes and free the rest
+bool SDClass::trimChain(Handle *h, uint32_t length) {
+    uint32_t keep = (length + clusterBytes - 1) >> clusterShift, rest;
+
+    if (!h->firstCluster)
+        return true;
+    if (!keep) {
+        rest = h->firstCluster;
+        h->firstCluster = 0;
+        h->dirty = 1;
+    } else {
+        if (!seekCluster(h, keep - 1, false) || !fatGet(h->cluster, &rest))
+            return false;
+        if (rest >= FAT_END)
+            return true;
+        if (!fatSet(h->cluster, FAT_EOC))
+            return false;
+    }
+    h->cluster = 0;
+    return freeChain(rest);
+}
+
+bool SDClass::zeroCluster(uint32_t cluster) {
+    uint32_t lba = clusterSector(cluster), sectors = clusterBytes >> 9, i;
+    uint8_t *p;
+
+    if (!cacheRange(lba, sectors, true) || !(p = cacheGet(lba, CACHE_ZERO)))
+        return false;
+    memset(p, 0, SD_BLOCK_SIZE);
+    for (i = 1; i < sectors; i++) {
+        if (!sdCard.writeBlock(lba + i, p))
+            return false;
+    }
+    return true;
+}
+
+//
+// Position in a file or directory
+//
+bool SDClass::seekCluster(Handle *h, uint32_t index, bool extend) {
+    uint32_t next;
+
+    if (!h->firstCluster) {
+        if (!extend)
+            return false;
+        if (!(h->firstCluster = allocate(0, 1)))
+            return false;
+        h->dirty = 1;
+        h->cluster = 0;
+    }
+    if (!h->cluster || index < h->clusterIndex) {
+        h->cluster = h->firstCluster;
+        h->clusterIndex = 0;
+    }
+    while (h->clusterIndex < index) {
+        if (!fatGet(h->cluster, &next))
+            return false;
+        if (next >= FAT_END) {
+            if (!extend || !(next = allocate(h->cluster, 1)))
+                return false;
+        } else if (next < 2 || next >= clusters + 2) {
+            return false;
+        }
+        h->cluster = next;
+        h->clusterIndex++;
+    }
+    return true;
+}
+
+// The sector holding pos, 0 past the end
+uint32_t SDClass::sectorFor(Handle *h, uint32_t pos, bool extend) {
+    // The FAT16 root directory is a fixed area before the clusters
+    if (h->root && !fat32)
+        return pos < rootEntries * DIR_ENTRY ? rootStart + (pos >> 9) : 0;
+    if (!seekCluster(h, pos >> clusterShift, extend))
+        return 0;
+    return clusterSector(h->cluster) + ((pos & (clusterBytes - 1)) >> 9);
+}
+
+// Sectors from lba on, in h's current cluster and the ones after it,
+// that follow each other on the card, up to max
+uint32_t SDClass::contiguous(Handle *h, uint32_t lba, uint32_t max) {
+    uint32_t c = h->cluster, n, next;
+
+    n = clusterSector(c) + (clusterBytes >> 9) - lba;
+    while (n < max && fatGet(c, &next) && next == c + 1) {
+        c = next;
+        n += clusterBytes >> 9;
+    }
+    return n < max ? n : max;
+}
+
+//
+// Directories
+//
+void SDClass::openDir(Handle *h, uint32_t cluster) {
+    memset(h, 0, sizeof(*h));
+    // ".." entries in a subdirectory of the root say 0
+    if (!cluster && fat32)
+        cluster = rootCluster;
+    h->firstCluster = cluster;
+    h->attr = ATTR_DIRECTORY;
+    h->root = cluster == rootCluster;
+    if (h->root)
+        strcpy(h->name, "/");
+}
+
+bool SDClass::loadEntry(Handle *dir, uint32_t pos, uint32_t lfnPos, Handle *h) {
+    uint32_t lba = sectorFor(dir, pos, false);
+    uint8_t *p;
+
+    if (!lba || !(p = cacheGet(lba, CACHE_READ)))
+        return false;
+    p += pos & (SD_BLOCK_SIZE - 1);
+
+    memset(h, 0, sizeof(*h));
+    h->firstCluster = get16(p + DIR_CLUSTER_LOW);
+    if (fat32)
+        h->firstCluster |= (uint32_t) get16(p + DIR_CLUSTER_HIGH) << 16;
+    h->size = get32(p + DIR_SIZE);
+    h->attr = p[DIR_ATTR];
+    h->parentCluster = dir->firstCluster;
+    h->dirPos = pos;
+    h->lfnPos = lfnPos;
+    h->dirSector = lba;
+    h->dirOffset = pos & (SD_BLOCK_SIZE - 1);
+    showName(p, h->name);
+    if (h->attr & ATTR_DIRECTORY) {
+        h->size = 0;
+        // ".." up to the root
+        if (!h->firstCluster)
+            h->firstCluster = rootCluster;
+        h->root = h->firstCluster == rootCluster;
+    }
+    return true;
+}
+
+// *freePos is the first free entry, or the end of the directory
+bool SDClass::findEntry(Handle *dir, const uint8_t *name, Handle *h, uint32_t *freePos) {
+    uint32_t pos, lba, lfnPos = NONE;
+    uint8_t *p;
+
+    *freePos = NONE;
+    for (pos = 0; (lba = sectorFor(dir, pos, false)); pos += DIR_ENTRY) {
+        if (!(p = cacheGet(lba, CACHE_READ)))
+            return false;
+        p += pos & (SD_BLOCK_SIZE - 1);
+        if (!p[0])
+            break;
+        if (p[0] == DIR_DELETED) {
+            if (*freePos == NONE)
+                *freePos = pos;
+            lfnPos = NONE;
+            continue;
+        }
+        // Long names go in front of their entry
+        if (p[DIR_ATTR] == ATTR_LONG_NAME) {
+            if (lfnPos == NONE)
+                lfnPos = pos;
+            continue;
+        }
+        if (!(p[DIR_ATTR] & ATTR_VOLUME) && !memcmp(p, name, 11))
+            return loadEntry(dir, pos, lfnPos == NONE ? pos : lfnPos, h);
+        lfnPos = NONE;
+    }
+    if (*freePos == NONE)
+        *freePos = pos;
+    return false;
+}
+
+bool SDClass::createEntry(Handle *dir, const uint8_t *name, uint8_t attr, uint32_t freePos, Handle *h) {
+    uint32_t lba, cluster = 0, parent;
+    uint8_t *p;
+
+    // Past the end the directory grows by a cleared cluster; the FAT16
+    // root cannot grow
+    if (!(lba = sectorFor(dir, freePos, false))) {
+        if (!(lba = sectorFor(dir, freePos, true)) || !zeroCluster(dir->cluster))
+            return false;
+    }
+
+    if (attr & ATTR_DIRECTORY) {
+        if (!(cluster = allocate(0, 1)) || !zeroCluster(cluster) ||
+            !(p = cacheGet(clusterSector(cluster), CACHE_WRITE)))
+            return false;
+        parent = dir->root ? 0 : dir->firstCluster;
+        memset(p, ' ', 11);
+        p[0] = '.';
+        p[DIR_ATTR] = ATTR_DIRECTORY;
+        stamp(p, true);
+        put16(p + DIR_CLUSTER_LOW, cluster);
+        put16(p + DIR_CLUSTER_HIGH, cluster >> 16);
+        p += DIR_ENTRY;
+        memset(p, ' ', 11);
+        p[0] = p[1] = '.';
+        p[DIR_ATTR] = ATTR_DIRECTORY;
+        stamp(p, true);
+        put16(p + DIR_CLUSTER_LOW, parent);
+        put16(p + DIR_CLUSTER_HIGH, parent >> 16);
+    }
+
+    if (!(p = cacheGet(lba, CACHE_WRITE)))
+        return false;
+    p += freePos & (SD_BLOCK_SIZE - 1);
+    memset(p, 0, DIR_ENTRY);
+    memcpy(p, name, 11);
+    p[DIR_ATTR] = attr;
+    stamp(p, true);
+    put16(p + DIR_CLUSTER_LOW, cluster);
+    put16(p + DIR_CLUSTER_HIGH, cluster >> 16);
+    return loadEntry(dir, freePos, freePos, h);
+}
+
+// Marks the entry and its long name deleted
+bool SDClass::deleteEntry(Handle *h) {
+    uint32_t pos, lba;
+    uint8_t *p;
+    Handle dir;
+
+    openDir(&dir, h->parentCluster);
+    for (pos = h->lfnPos; pos <= h->dirPos; pos += DIR_ENTRY) {
+        if (!(lba = sectorFor(&dir, pos, false)) || !(p = cacheGet(lba, CACHE_WRITE)))
+            return false;
+        p[pos & (SD_BLOCK_SIZE - 1)] = DIR_DELETED;
+    }
+    return true;
+}
+
+bool SDClass::resolve(const char *path, Handle *h, uint8_t create) {
+    uint8_t name[11];
+    uint32_t freePos;
+    Handle dir;
+    bool last;
+
+    if (!mounted || !path)
+        return false;
+    openDir(h, 0);
+    while (*path == '/')
+        path++;
+    while (*path) {
+        if (!(h->attr & ATTR_DIRECTORY) || !makeName(&path, name))
+            return false;
+        last = !*path;
+        dir = *h;
+        if (findEntry(&dir, name, h, &freePos))
+            continue;
+        if (create == RESOLVE_FIND || name[0] == '.' || (!last && create != RESOLVE_DIRS))
+            return false;
+        if (!createEntry(&dir, name, create == RESOLVE_DIRS ? ATTR_DIRECTORY : ATTR_ARCHIVE, freePos, h))
+            return false;
+    }
+    return true;
+}
+
+// The next file or directory after dir->pos
+bool SDClass::nextEntry(Handle *dir, Handle *h) {
+    uint32_t lba, lfnPos = NONE;
+    uint8_t *p;
+    bool ok;
+
+    for (; (lba = sectorFor(dir, dir->pos, false)); dir->pos += DIR_ENTRY) {
+        if (!(p = cacheGet(lba, CACHE_READ)))
+            return false;
+        p += dir->pos & (SD_BLOCK_SIZE - 1);
+        if (!p[0])
+            return false;
+        if (p[DIR_ATTR] == ATTR_LONG_NAME && p[0] != DIR_DELETED) {
+            if (lfnPos == NONE)
+                lfnPos = dir->pos;
+            continue;
+        }
+        if (p[0] == DIR_DELETED || p[0] == '.' || (p[DIR_ATTR] & ATTR_VOLUME)) {
+            lfnPos = NONE;
+            continue;
+        }
+        ok = loadEntry(dir, dir->pos, lfnPos == NONE ? dir->pos : lfnPos, h);
+        dir->pos += DIR_ENTRY;
+        return ok;
+    }
+    return false;
+}
+
+void SDClass::stamp(uint8_t *entry, bool created) {
+    uint16_t date = (36 << 9) | (1 << 5) | 1, time = 0;
+
+    if (dateTime)
+        dateTime(&date, &time);
+    if (created) {
+        entry[13] = 0;
+        put16(entry + DIR_CREATE_TIME, time);
+        put16(entry + DIR_CREATE_DATE, date);
+    }
+    put16(entry + DIR_ACCESS_DATE, date);
+    put16(entry + DIR_WRITE_TIME, time);
+    put16(entry + DIR_WRITE_DATE, date);
+}
+
+//
+// Paths
+//
+File SDClass::open(const char *path, uint8_t mode) {
+    Handle h;
+    uint8_t i;
+
+    for (i = 0; i < SD_MAX_OPEN && handles[i].used; i++)
+        ;
+    if (i == SD_MAX_OPEN)
+        return File();
+    if (!resolve(path, &h, (mode & SD_WRITE) && (mode & SD_CREATE) ? RESOLVE_FILE : RESOLVE_FIND))
+        return File();
+    return openHandle(h, mode);
+}
+
+bool SDClass::exists(const char *path) {
+    Handle h;
+
+    return resolve(path, &h, RESOLVE_FIND);
+}
+
+bool SDClass::mkdir(const char *path) {
+    Handle h;
+
+    return resolve(path, &h, RESOLVE_DIRS) && (h.attr & ATTR_DIRECTORY) && sync();
+}
+
+bool SDClass::remove(const char *path) {
+    Handle h;
+
+    if (!resolve(path, &h, RESOLVE_FIND) || (h.attr & (ATTR_DIRECTORY | ATTR_READ_ONLY)) || isOpen(&h, SD_MAX_OPEN))
+        return false;
+    return freeChain(h.firstCluster) && deleteEntry(&h) && sync();
+}
+
+bool SDClass::rmdir(const char *path) {
+    Handle h, dir, entry;
+
+    if (!resolve(path, &h, RESOLVE_FIND) || !(h.attr & ATTR_DIRECTORY) || h.root || isOpen(&h, SD_MAX_OPEN))
+        return false;
+    dir = h;
+    if (nextEntry(&dir, &entry))
+        return false;
+    return freeChain(h.firstCluster) && deleteEntry(&h) && sync();
+}
+
+bool SDClass::sync(void) {
+    uint8_t i, *p;
+    bool ok = true;
+
+    if (!mounted)
+        return false;
+    for (i = 0; i < SD_MAX_OPEN; i++) {
+        if (handles[i].used)
+            ok = flushHandle(&handles[i]) && ok;
+    }
+    // The free count is left for the next check to work out
+    if (fsInfoDirty && fsInfo && (p = cacheGet(fsInfo, CACHE_WRITE))) {
+        put32(p + 488, 0xFFFFFFFF);
+        put32(p + 492, nextFree);
+        fsInfoDirty = false;
+    }
+    return cacheFlush() && sdCard.sync() && ok;
+}
+
+//
+// Open files
+//
+File SDClass::openHandle(Handle &h, uint8_t mode) {
+    uint8_t i;
+
+    if ((mode & SD_WRITE) && (h.attr & (ATTR_DIRECTORY | ATTR_READ_ONLY)))
+        return File();
+    // Two handles on one file would each keep their own size
+    for (i = 0; i < SD_MAX_OPEN; i++) {
+        if (isOpen(&h, i) && ((handles[i].mode | mode) & SD_WRITE))
+            return File();
+    }
+    for (i = 0; i < SD_MAX_OPEN && handles[i].used; i++)
+        ;
+    if (i == SD_MAX_OPEN)
+        return File();
+
+    Handle &o = handles[i];
+    o = h;
+    o.mode = mode;
+    o.used = 1;
+    if (!++nextHandleId)
+        nextHandleId++;
+    o.id = nextHandleId;
+    if ((mode & SD_TRUNCATE) && (mode & SD_WRITE) && !truncate(&o, 0)) {
+        o.used = 0;
+        return File();
+    }
+    if (mode & SD_APPEND)
+        o.pos = o.size;
+    return File(this, i, o.id);
+}
+
+// Whether handles[index], or any handle for SD_MAX_OPEN, has h's entry
+bool SDClass::isOpen(Handle *h, uint8_t index) {
+    uint8_t i;
+
+    for (i = 0; i < SD_MAX_OPEN; i++) {
+        Handle &o = handles[i];
+        if ((index == SD_MAX_OPEN || index == i) && o.used && !o.root && !h->root &&
+            o.dirSector == h->dirSector && o.dirOffset == h->dirOffset)
+            return true;
+    }
+    return false;
+}
+
+SDClass::Handle *SDClass::handleFor(uint8_t h, uint32_t id) {
+    if (!mounted || h >= SD_MAX_OPEN || !handles[h].used || handles[h].id != id)
+        return NULL;
+    return &handles[h];
+}
+
+// Size, first cluster and time stamps into the directory entry
+bool SDClass::flushHandle(Handle *h) {
+    uint8_t *p;
+
+    if (!h->dirty || h->root)
+        return true;
+    if (!(p = cacheGet(h->dirSector, CACHE_WRITE)))
+        return false;
+    p += h->dirOffset;
+    put16(p + DIR_CLUSTER_LOW, h->firstCluster);
+    put16(p + DIR_CLUSTER_HIGH, fat32 ? h->firstCluster >> 16 : 0);
+    if (!(h->attr & ATTR_DIRECTORY))
+        put32(p + DIR_SIZE, h->size);
+    if (h->mode & SD_WRITE) {
+        stamp(p, false);
+        p[DIR_ATTR] |= ATTR_ARCHIVE;
+    }
+    h->dirty = 0;
+    return true;
+}
+
+int SDClass::readHandle(Handle *h, void *buf, size_t count) {
+    uint8_t *out = (uint8_t *) buf, *p;
+    uint32_t lba, off, n;
+    size_t done = 0;
+
+    if (!(h->mode & SD_READ) || (h->attr & ATTR_DIRECTORY))
+        return -1;
+    if (h->pos >= h->size)
+        return 0;
+    if (count > h->size - h->pos)
+        count = h->size - h->pos;
+
+    while (done < count) {
+        off = h->pos & (SD_BLOCK_SIZE - 1);
+        if (!(lba = sectorFor(h, h->pos, false)))
+            break;
+        if (!off && count - done >= SD_BLOCK_SIZE) {
+            // Whole sectors straight from the card
+            n = contiguous(h, lba, (count - done) >> 9);
+            if (!cacheRange(lba, n, false) || !sdCard.readBlocks(lba, out + done, n))
+                break;
+            n <<= 9;
+        } else {
+            if (!(p = cacheGet(lba, CACHE_READ)))
+                break;
+            n = SD_BLOCK_SIZE - off;
+            if (n > count - done)
+                n = count - done;
+            memcpy(out + done, p + off, n);
+        }
+        done += n;
+        h->pos += n;
+    }
+    return done ? (int) done : -1;
+}
+
+size_t SDClass::writeHandle(Handle *h, const uint8_t *buf, size_t count) {
+    uint32_t lba, off, n;
+    size_t done = 0;
+    uint8_t *p;
+
+    if (!(h->mode & SD_WRITE))
+        return 0;
+
+    while (done < count) {
+        off = h->pos & (SD_BLOCK_SIZE - 1);
+        if (!(lba = sectorFor(h, h->pos, true)))
+            break;
+        if (!off && count - done >= SD_BLOCK_SIZE) {
+            // Whole sectors straight to the card, in one transfer as far as
+            // the clusters follow each other
+            n = contiguous(h, lba, (count - done) >> 9);
+            if (!cacheRange(lba, n, true) || !sdCard.writeBlocks(lba, buf + done, n))
+                break;
+            n <<= 9;
+        } else {
+            // Nothing to keep in a sector that starts at the end
+            if (!(p = cacheGet(lba, !off && h->pos >= h->size ? CACHE_ZERO : CACHE_WRITE)))
+                break;
+            n = SD_BLOCK_SIZE - off;
+            if (n > count - done)
+                n = count - done;
+            memcpy(p + off, buf + done, n);
+            // Out as soon as it is full, so the card sees the file in order
+            if (off + n == SD_BLOCK_SIZE && !cacheRange(lba, 1, false))
+                break;
+        }
+        done += n;
+        h->pos += n;
+        if (h->pos > h->size)
+            h->size = h->pos;
+        h->dirty = 1;
+    }
+    return done;
+}
+
+bool SDClass::preAllocate(Handle *h, uint32_t length) {
+    uint32_t need = (length + clusterBytes - 1) >> clusterShift, have = 0, last = 0, c, next;
+
+    if (!(h->mode & SD_WRITE) || (h->attr & ATTR_DIRECTORY))
+        return false;
+    for (c = h->firstCluster; c && have <= clusters; c = next) {
+        have++;
+        last = c;
+        if (!fatGet(c, &next))
+            return false;
+        if (next >= FAT_END)
+            break;
+    }
+    if (have >= need)
+        return true;
+    if (!(c = allocate(last, need - have)))
+        return false;
+    if (!h->firstCluster) {
+        h->firstCluster = c;
+        h->cluster = 0;
+        h->dirty = 1;
+    }
+    h->preallocated = 1;
+    return true;
+}
+
+bool SDClass::truncate(Handle *h, uint32_t length) {
+    if (!(h->mode & SD_WRITE) || (h->attr & ATTR_DIRECTORY) || length > h->size)
+        return false;
+    if (!trimChain(h, length))
+        return false;
+    h->size = length;
+    if (h->pos > length)
+        h->pos = length;
+    h->preallocated = 0;
+    h->dirty = 1;
+    return true;
+}
+
+void SDClass::closeHandle(Handle *h) {
+    // Give back what preAllocate() took and was not used
+    if (h->preallocated)
+        trimChain(h, h->size);
+    flushHandle(h);
+    h->used = 0;
+}
+
+//
+// File
+//
+size_t File::write(uint8_t b) {
+    return write(&b, 1);
+}
+
+size_t File::write(const uint8_t *buf, size_t count) {
+    SDClass::Handle *h = sd ? sd->handleFor(handle, id) : NULL;
+    size_t n;
+
+    if (!h)
+        return 0;
+    n = sd->writeHandle(h, buf, count);
+    if (n < count)
+        setWriteError();
+    return n;
+}
+
+int File::available(void) {
+    SDClass::Handle *h = sd ? sd->handleFor(handle, id) : NULL;
+    uint32_t n;
+
+    if (!h || !(h->mode & SD_READ) || h->pos >= h->size)
+        return 0;
+    n = h->size - h->pos;
+    return n > 0x7FFFFFFF ? 0x7FFFFFFF : n;
+}
+
+int File::read(void) {
+    uint8_t b;
+
+    return read(&b, 1) == 1 ? b : -1;
+}
+
+int File::read(void *buf, size_t count) {
+    SDClass::Handle *h = sd ? sd->handleFor(handle, id) : NULL;
+
+    return h ? sd->readHandle(h, buf, count) : -1;
+}
+
+int File::peek(void) {
+    SDClass::Handle *h = sd ? sd->handleFor(handle, id) : NULL;
+    int c;
+
+    if (!h)
+        return -1;
+    c = read();
+    if (c >= 0)
+        h->pos--;
+    return c;
+}
+
+void File::flush(void) {
+    if (sd && sd->handleFor(handle, id) && !sd->sync())
+        setWriteError();
+}
+
+bool File::seek(uint32_t pos) {
+    SDClass::Handle *h = sd ? sd->handleFor(handle, id) : NULL;
+
+    if (!h || (h->attr & ATTR_DIRECTORY) || pos > h->size)
+        return false;
+    h->pos = pos;
+    return true;
+}
+
+uint32_t File::position(void) {
+    SDClass::Handle *h = sd ? sd->handleFor(handle, id) : NULL;
+
+    return h ? h->pos : 0;
+}
+
+uint32_t File::size(void) {
+    SDClass::Handle *h = sd ? sd->handleFor(handle, id) : NULL;
+
+    return h ? h->size : 0;
+}
+
+bool File::truncate(uint32_t length) {
+    SDClass::Handle *h = sd ? sd->handleFor(handle, id) : NULL;
+
+    return h && sd->truncate(h, length);
+}
+
+bool File::preAllocate(uint32_t length) {
+    SDClass::Handle *h = sd ? sd->handleFor(handle, id) : NULL;
+
+    return h && sd->preAllocate(h, length);
+}
+
+const char *File::name(void) {
+    SDClass::Handle *h = sd ? sd->handleFor(handle, id) : NULL;
+
+    return h ? h->name : "";
+}
+
+bool File::isDirectory(void) {
+    SDClass::Handle *h = sd ? sd->handleFor(handle, id) : NULL;
+
+    return h && (h->attr & ATTR_DIRECTORY);
+}
+
+File File::openNextFile(uint8_t mode) {
+    SDClass::Handle *h = sd ? sd->handleFor(handle, id) : NULL;
+    SDClass::Handle entry;
+
+    if (!h || !(h->attr & ATTR_DIRECTORY) || !sd->nextEntry(h, &entry))
+        return File();
+    return sd->openHandle(entry, mode);
+}
+
+void File::rewindDirectory(void) {
+    SDClass::Handle *h = sd ? sd->handleFor(handle, id) : NULL;
+
+    if (h && (h->attr & ATTR_DIRECTORY))
+        h->pos = 0;
+}
+
+void File::close(void) {
+    SDClass::Handle *h = sd ? sd->handleFor(handle, id) : NULL;
+
+    if (h) {
+        sd->closeHandle(h);
+        sd->sync();
+    }
+    sd = NULL;
+}
+
+File::operator bool(void) {
+    return sd && sd->handleFor(handle, id);
+}
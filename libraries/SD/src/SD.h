@@ -0,0 +1,232 @@
+/*
+  SD.h - FAT16 and FAT32 file system on SD cards
+  Copyright (c) 2016 Energia.  All right reserved.
+
+    SPIBus bus(SPI);
+    SPIDevice card(bus, 8, SPISettings(25000000, MSBFIRST, SPI_MODE0));
+
+    SD.begin(card);
+    File log = SD.open("/LOGS/DATA.CSV", FILE_WRITE);
+    log.preAllocate(1000000);
+    log.println(analogRead(A0));
+    log.close();
+
+  Names are 8.3, without long file names; directories are separated by
+  '/'. Long name entries written by other systems are skipped, and
+  removed together with their file.
+
+  Sectors go through a write-back cache of SD_CACHE_SECTORS. Reads and
+  writes of whole sectors bypass it and go to the card directly, across
+  as many consecutive clusters as the chain allows, as one multi-block
+  transfer. A sector filled by small writes is written out as soon as
+  it is full, so a file written in small pieces still reaches the card
+  as one sequential stream. New clusters are taken right after the
+  previous one where possible; preAllocate() reserves a contiguous run
+  up front, so logging never has to search the FAT, and whatever is left
+  of it is given back at close().
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef SD_h
+#define SD_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include "Stream.h"
+#include "SdCard.h"
+
+#ifndef SD_MAX_OPEN
+#define SD_MAX_OPEN         4
+#endif
+#ifndef SD_CACHE_SECTORS
+#define SD_CACHE_SECTORS    3
+#endif
+
+// open() modes, combined with |
+#define SD_READ             0x01
+#define SD_WRITE            0x02
+#define SD_CREATE           0x04    // create the file if missing
+#define SD_APPEND           0x08    // start at the end
+#define SD_TRUNCATE         0x10
+
+#define FILE_READ           SD_READ
+#define FILE_WRITE          (SD_READ | SD_WRITE | SD_CREATE | SD_APPEND)
+
+class SDClass;
+
+class File : public Stream {
+public:
+  File(void) : sd(NULL), handle(0), id(0) {}
+
+  size_t write(uint8_t b);
+  size_t write(const uint8_t *buf, size_t count);
+  using Print::write;
+  int available(void);
+  int read(void);
+  int read(void *buf, size_t count);
+  int peek(void);
+  // Writes back everything cached and updates the directory entry
+  void flush(void);
+
+  bool seek(uint32_t pos);
+  uint32_t position(void);
+  uint32_t size(void);
+  bool truncate(uint32_t length);
+  // Reserve contiguous clusters for length bytes in all
+  bool preAllocate(uint32_t length);
+
+  const char *name(void);
+  bool isDirectory(void);
+  File openNextFile(uint8_t mode = FILE_READ);
+  void rewindDirectory(void);
+  void close(void);
+  operator bool(void);
+
+private:
+  File(SDClass *owner, uint8_t h, uint32_t i) : sd(owner), handle(h), id(i) {}
+  SDClass *sd;
+  uint8_t handle;
+  uint32_t id;
+  friend class SDClass;
+};
+
+class SDClass {
+public:
+  SDClass(void);
+
+  // The card shares the device's bus with the other devices on it
+  bool begin(SPIDevice &device);
+  void end(void);
+
+  File open(const char *path, uint8_t mode = FILE_READ);
+  bool exists(const char *path);
+  // Creates missing parent directories as well
+  bool mkdir(const char *path);
+  bool remove(const char *path);
+  // Only empty directories
+  bool rmdir(const char *path);
+
+  // Writes back all files and the cache
+  bool sync(void);
+
+  uint8_t fatType(void) const { return mounted ? (fat32 ? 32 : 16) : 0; }
+  uint32_t clusterCount(void) const { return clusters; }
+  uint32_t clusterSize(void) const { return clusterBytes; }
+  SdCard &card(void) { return sdCard; }
+
+  // Time stamps for new and written files, FAT encoded; without one
+  // files are dated 1 January 2016
+  void dateTimeCallback(void (*callback)(uint16_t *date, uint16_t *time)) {
+    dateTime = callback;
+  }
+
+private:
+  struct Handle {
+    uint32_t id;
+    uint32_t firstCluster;
+    uint32_t size;
+    uint32_t pos;
+    uint32_t cluster;         // cluster holding pos, 0 if not looked up
+    uint32_t clusterIndex;    // its place in the chain
+    uint32_t parentCluster;   // directory holding the entry
+    uint32_t dirPos;          // the entry's offset in it
+    uint32_t lfnPos;          // first long name entry before it
+    uint32_t dirSector;
+    uint16_t dirOffset;
+    uint8_t mode;
+    uint8_t attr;
+    uint8_t used;
+    uint8_t dirty;            // directory entry needs updating
+    uint8_t preallocated;
+    uint8_t root;
+    char name[13];
+  };
+  struct Cache {
+    uint32_t lba;
+    uint32_t age;
+    uint8_t valid;
+    uint8_t dirty;
+    uint8_t data[SD_BLOCK_SIZE];
+  };
+
+  SdCard sdCard;
+  bool mounted;
+  bool fat32;
+  bool fsInfoDirty;
+  uint8_t numFats;
+  uint8_t clusterShift;
+  uint32_t clusterBytes;
+  uint32_t clusters;
+  uint32_t fatStart;
+  uint32_t fatSize;
+  uint32_t rootStart;
+  uint32_t rootEntries;
+  uint32_t rootCluster;
+  uint32_t dataStart;
+  uint32_t fsInfo;
+  uint32_t nextFree;
+  uint32_t nextHandleId;
+  uint32_t cacheAge;
+  void (*dateTime)(uint16_t *date, uint16_t *time);
+  Handle handles[SD_MAX_OPEN];
+  Cache cache[SD_CACHE_SECTORS];
+
+  bool mount(void);
+  uint8_t *cacheGet(uint32_t lba, uint8_t how);
+  bool cacheWriteBack(Cache *c);
+  bool cacheFlush(void);
+  bool cacheRange(uint32_t lba, uint32_t count, bool drop);
+  bool isFat(uint32_t lba) const { return lba >= fatStart && lba < fatStart + fatSize; }
+
+  bool fatGet(uint32_t cluster, uint32_t *value);
+  bool fatSet(uint32_t cluster, uint32_t value);
+  uint32_t allocate(uint32_t prev, uint32_t count);
+  bool freeChain(uint32_t cluster);
+  bool trimChain(Handle *h, uint32_t length);
+  uint32_t clusterSector(uint32_t cluster) const {
+    return dataStart + ((cluster - 2) << (clusterShift - 9));
+  }
+  bool zeroCluster(uint32_t cluster);
+
+  bool seekCluster(Handle *h, uint32_t index, bool extend);
+  uint32_t sectorFor(Handle *h, uint32_t pos, bool extend);
+  uint32_t contiguous(Handle *h, uint32_t lba, uint32_t max);
+
+  void openDir(Handle *h, uint32_t cluster);
+  bool findEntry(Handle *dir, const uint8_t *name, Handle *h, uint32_t *freePos);
+  bool loadEntry(Handle *dir, uint32_t pos, uint32_t lfnPos, Handle *h);
+  bool createEntry(Handle *dir, const uint8_t *name, uint8_t attr, uint32_t freePos, Handle *h);
+  bool deleteEntry(Handle *h);
+  bool resolve(const char *path, Handle *h, uint8_t create);
+  bool nextEntry(Handle *dir, Handle *h);
+  void stamp(uint8_t *entry, bool created);
+
+  File openHandle(Handle &h, uint8_t mode);
+  Handle *handleFor(uint8_t h, uint32_t id);
+  bool isOpen(Handle *h, uint8_t index);
+  bool flushHandle(Handle *h);
+  int readHandle(Handle *h, void *buf, size_t count);
+  size_t writeHandle(Handle *h, const uint8_t *buf, size_t count);
+  bool preAllocate(Handle *h, uint32_t length);
+  bool truncate(Handle *h, uint32_t length);
+  void closeHandle(Handle *h);
+
+  friend class File;
+};
+
+extern SDClass SD;
+
+#endif
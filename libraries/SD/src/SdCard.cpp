@@ -0,0 +1,321 @@
+/*
+  SdCard.cpp - SD and SDHC cards in SPI mode
+  Copyright (c) 2016 Energia.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "SdCard.h"
+
+#define CMD0                0       // GO_IDLE_STATE
+#define CMD8                8       // SEND_IF_COND
+#define CMD9                9       // SEND_CSD
+#define CMD12               12      // STOP_TRANSMISSION
+#define CMD16               16      // SET_BLOCKLEN
+#define CMD18               18      // READ_MULTIPLE_BLOCK
+#define CMD25               25      // WRITE_MULTIPLE_BLOCK
+#define CMD55               55      // APP_CMD
+#define CMD58               58      // READ_OCR
+#define ACMD41              41      // SD_SEND_OP_COND
+
+#define R1_READY            0x00
+#define R1_IDLE             0x01
+#define R1_ILLEGAL          0x04
+
+#define TOKEN_DATA          0xFE    // read data and CMD17/24 writes
+#define TOKEN_WRITE_MULTI   0xFC
+#define TOKEN_STOP          0xFD
+#define DATA_ACCEPTED       0x05
+
+#define STATE_IDLE          0
+#define STATE_READING       1
+#define STATE_WRITING       2
+
+#define INIT_TIMEOUT        2000
+#define READ_TIMEOUT        300
+#define WRITE_TIMEOUT       600     // SDHC allows 500 ms per block
+
+SdCard::SdCard(void) {
+    dev = NULL;
+    spi = NULL;
+    cardType = SD_CARD_NONE;
+    error = SD_ERROR_NONE;
+    state = STATE_IDLE;
+    blocks = 0;
+}
+
+bool SdCard::begin(SPIDevice &device) {
+    uint32_t hz = device.getSettings()._clock;
+    bool ok;
+
+    dev = &device;
+    spi = &device.port();
+    cardType = SD_CARD_NONE;
+    state = STATE_IDLE;
+    blocks = 0;
+    device.begin();
+
+    device.setSettings(SPISettings(400000, MSBFIRST, SPI_MODE0));
+    ok = init();
+    device.setSettings(SPISettings(hz, MSBFIRST, SPI_MODE0));
+    return ok;
+}
+
+bool SdCard::init(void) {
+    uint32_t start, arg;
+    uint8_t reply[4], csd[16], i;
+
+    // 74 clocks or more with chip select high put the card in SPI mode
+    dev->beginTransaction();
+    dev->deselect();
+    for (i = 0; i < 10; i++)
+        spi->transfer(0xFF);
+    dev->endTransaction();
+
+    select();
+    start = millis();
+    while (command(CMD0, 0) != R1_IDLE) {
+        if (millis() - start > INIT_TIMEOUT)
+            return fail(SD_ERROR_CMD0);
+    }
+
+    if (command(CMD8, 0x1AA) & R1_ILLEGAL) {
+        cardType = SD_CARD_SD1;
+    } else {
+        spi->read(reply, 4);
+        if (reply[3] != 0xAA)
+            return fail(SD_ERROR_CMD8);
+        cardType = SD_CARD_SD2;
+    }
+
+    // Version 2 cards are asked whether they are high capacity
+    arg = cardType == SD_CARD_SD2 ? 0x40000000 : 0;
+    while (appCommand(ACMD41, arg) != R1_READY) {
+        if (millis() - start > INIT_TIMEOUT)
+            return fail(SD_ERROR_ACMD41);
+    }
+
+    if (cardType == SD_CARD_SD2) {
+        if (command(CMD58, 0) != R1_READY)
+            return fail(SD_ERROR_CMD58);
+        spi->read(reply, 4);
+        if (reply[0] & 0x40)
+            cardType = SD_CARD_SDHC;
+    }
+    if (cardType != SD_CARD_SDHC && command(CMD16, SD_BLOCK_SIZE) != R1_READY)
+        return fail(SD_ERROR_CMD16);
+
+    if (command(CMD9, 0) != R1_READY || !readData(csd, sizeof(csd)))
+        return fail(SD_ERROR_CSD);
+    if ((csd[0] >> 6) == 1) {
+        // CSD version 2: (C_SIZE + 1) * 512 KB
+        blocks = ((((uint32_t) csd[7] & 0x3F) << 16) | (csd[8] << 8) | csd[9]) + 1;
+        blocks <<= 10;
+    } else {
+        uint32_t size = ((csd[6] & 0x03) << 10) | (csd[7] << 2) | (csd[8] >> 6);
+        uint8_t mult = ((csd[9] & 0x03) << 1) | (csd[10] >> 7);
+        uint8_t readBits = csd[5] & 0x0F;
+        blocks = (size + 1) << (mult + 2 + readBits - 9);
+    }
+    deselect();
+
+    error = SD_ERROR_NONE;
+    return true;
+}
+
+void SdCard::select(void) {
+    dev->beginTransaction();
+}
+
+void SdCard::deselect(void) {
+    dev->deselect();
+    // The card lets go of MISO on the next clock
+    spi->transfer(0xFF);
+    dev->endTransaction();
+}
+
+bool SdCard::fail(uint8_t code) {
+    error = code;
+    deselect();
+    return false;
+}
+
+uint8_t SdCard::command(uint8_t cmd, uint32_t arg) {
+    uint8_t frame[6], r, i;
+
+    // CMD0 may come while the card still sends, CMD12 ends a read
+    if (cmd != CMD0 && cmd != CMD12)
+        waitReady(READ_TIMEOUT);
+
+    frame[0] = 0x40 | cmd;
+    frame[1] = arg >> 24;
+    frame[2] = arg >> 16;
+    frame[3] = arg >> 8;
+    frame[4] = arg;
+    // Only CMD0 and CMD8 are checked before CRCs are switched off
+    frame[5] = cmd == CMD0 ? 0x95 : cmd == CMD8 ? 0x87 : 0x01;
+    spi->write(frame, sizeof(frame));
+    if (cmd == CMD12)
+        spi->transfer(0xFF);
+
+    for (i = 0, r = 0xFF; i < 10 && (r & 0x80); i++)
+        r = spi->transfer(0xFF);
+    return r;
+}
+
+uint8_t SdCard::appCommand(uint8_t cmd, uint32_t arg) {
+    command(CMD55, 0);
+    return command(cmd, arg);
+}
+
+bool SdCard::waitReady(uint32_t timeoutMs) {
+    uint32_t start = millis();
+
+    while (spi->transfer(0xFF) != 0xFF) {
+        if (millis() - start > timeoutMs)
+            return false;
+    }
+    return true;
+}
+
+void SdCard::transferBlock(const uint8_t *tx, uint8_t *rx) {
+    if (spi->transferAsync(tx, rx, SD_BLOCK_SIZE, NULL, 0xFF))
+        spi->waitDone();
+    else
+        spi->transfer(tx, rx, SD_BLOCK_SIZE);
+}
+
+bool SdCard::readData(uint8_t *buf, size_t count) {
+    uint32_t start = millis();
+    uint8_t token, crc[2];
+
+    while ((token = spi->transfer(0xFF)) == 0xFF) {
+        if (millis() - start > READ_TIMEOUT)
+            return false;
+    }
+    if (token != TOKEN_DATA)
+        return false;
+    if (count == SD_BLOCK_SIZE)
+        transferBlock(NULL, buf);
+    else
+        spi->read(buf, count);
+    spi->read(crc, sizeof(crc));
+    return true;
+}
+
+bool SdCard::writeData(uint8_t token, const uint8_t *buf) {
+    uint8_t crc[2] = { 0xFF, 0xFF };
+
+    spi->transfer(token);
+    transferBlock(buf, NULL);
+    spi->write(crc, sizeof(crc));
+    return (spi->transfer(0xFF) & 0x1F) == DATA_ACCEPTED;
+}
+
+bool SdCard::readBlocks(uint32_t lba, uint8_t *buf, uint32_t count) {
+    if (!count)
+        return true;
+    if (lba >= blocks || count > blocks - lba) {
+        error = SD_ERROR_RANGE;
+        return false;
+    }
+
+    if (state == STATE_READING && lba == next) {
+        select();
+    } else {
+        if (!sync())
+            return false;
+        select();
+        if (command(CMD18, address(lba)) != R1_READY)
+            return fail(SD_ERROR_READ);
+        state = STATE_READING;
+    }
+
+    for (; count; count--, lba++, buf += SD_BLOCK_SIZE) {
+        if (!readData(buf, SD_BLOCK_SIZE)) {
+            deselect();
+            stop();
+            error = SD_ERROR_READ;
+            return false;
+        }
+    }
+    next = lba;
+    deselect();
+    return true;
+}
+
+bool SdCard::writeBlocks(uint32_t lba, const uint8_t *buf, uint32_t count) {
+    if (!count)
+        return true;
+    if (lba >= blocks || count > blocks - lba) {
+        error = SD_ERROR_RANGE;
+        return false;
+    }
+
+    if (state == STATE_WRITING && lba == next) {
+        select();
+    } else {
+        if (!sync())
+            return false;
+        select();
+        if (command(CMD25, address(lba)) != R1_READY)
+            return fail(SD_ERROR_WRITE);
+        state = STATE_WRITING;
+    }
+
+    for (; count; count--, lba++, buf += SD_BLOCK_SIZE) {
+        // Busy until the previous block is programmed
+        if (!waitReady(WRITE_TIMEOUT) || !writeData(TOKEN_WRITE_MULTI, buf)) {
+            deselect();
+            stop();
+            error = SD_ERROR_WRITE;
+            return false;
+        }
+    }
+    next = lba;
+    deselect();
+    return true;
+}
+
+bool SdCard::stop(void) {
+    bool ok;
+
+    select();
+    if (state == STATE_READING) {
+        command(CMD12, 0);
+        ok = waitReady(WRITE_TIMEOUT);
+    } else {
+        ok = waitReady(WRITE_TIMEOUT);
+        spi->transfer(TOKEN_STOP);
+        // Busy starts one byte after the stop token
+        spi->transfer(0xFF);
+        ok = waitReady(WRITE_TIMEOUT) && ok;
+    }
+    state = STATE_IDLE;
+    deselect();
+    return ok;
+}
+
+bool SdCard::sync(void) {
+    if (!spi || cardType == SD_CARD_NONE)
+        return false;
+    if (state == STATE_IDLE)
+        return true;
+    if (!stop()) {
+        error = SD_ERROR_STOP;
+        return false;
+    }
+    return true;
+}
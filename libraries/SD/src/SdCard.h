@@ -0,0 +1,104 @@
+/*
+  SdCard.h - SD and SDHC cards in SPI mode
+  Copyright (c) 2016 Energia.  All right reserved.
+
+    SPIBus bus(SPI);
+    SPIDevice sd(bus, 8, SPISettings(25000000, MSBFIRST, SPI_MODE0));
+    SdCard card;
+    card.begin(sd);
+    card.readBlocks(lba, buf, 4);
+
+  Blocks move by uDMA, 512 bytes per transfer. Consecutive calls on
+  consecutive blocks run as one open multi-block transfer (CMD18 or
+  CMD25), so a file written or read sector by sector costs one command
+  for the whole run instead of one per block; anything else, or sync(),
+  ends it first. Each command holds the bus through the device from
+  select to deselect, and lets go between blocks, so transactions queued
+  for other devices on the bus run in between.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef SdCard_h
+#define SdCard_h
+
+#include <SPIDevice.h>
+
+#define SD_BLOCK_SIZE       512
+
+// type()
+#define SD_CARD_NONE        0
+#define SD_CARD_SD1         1       // version 1, byte addressed
+#define SD_CARD_SD2         2       // version 2 standard capacity
+#define SD_CARD_SDHC        3       // SDHC or SDXC, block addressed
+
+// errorCode()
+#define SD_ERROR_NONE       0
+#define SD_ERROR_CMD0       1       // no card, or it does not answer
+#define SD_ERROR_CMD8       2
+#define SD_ERROR_ACMD41     3       // initialisation timed out
+#define SD_ERROR_CMD58      4
+#define SD_ERROR_CMD16      5
+#define SD_ERROR_CSD        6
+#define SD_ERROR_READ       7
+#define SD_ERROR_WRITE      8
+#define SD_ERROR_STOP       9
+#define SD_ERROR_RANGE      10
+
+class SdCard {
+public:
+  SdCard(void);
+
+  // The clock is 400 kHz while the card initialises, then the one in the
+  // device's settings, in SPI_MODE0
+  bool begin(SPIDevice &device);
+
+  uint8_t type(void) const { return cardType; }
+  uint32_t blockCount(void) const { return blocks; }
+  uint8_t errorCode(void) const { return error; }
+
+  bool readBlock(uint32_t lba, uint8_t *buf) { return readBlocks(lba, buf, 1); }
+  bool readBlocks(uint32_t lba, uint8_t *buf, uint32_t count);
+  bool writeBlock(uint32_t lba, const uint8_t *buf) { return writeBlocks(lba, buf, 1); }
+  bool writeBlocks(uint32_t lba, const uint8_t *buf, uint32_t count);
+
+  // Ends an open multi-block transfer and waits until the card has
+  // programmed everything written
+  bool sync(void);
+
+private:
+  SPIDevice *dev;
+  SPIClass *spi;
+  uint8_t cardType;
+  uint8_t error;
+  uint8_t state;          // multi-block transfer in progress
+  uint32_t next;          // the block it continues with
+  uint32_t blocks;
+
+  bool init(void);
+  void select(void);
+  void deselect(void);
+  bool fail(uint8_t code);
+  uint8_t command(uint8_t cmd, uint32_t arg);
+  uint8_t appCommand(uint8_t cmd, uint32_t arg);
+  bool waitReady(uint32_t timeoutMs);
+  bool readData(uint8_t *buf, size_t count);
+  bool writeData(uint8_t token, const uint8_t *buf);
+  void transferBlock(const uint8_t *tx, uint8_t *rx);
+  bool stop(void);
+  uint32_t address(uint32_t lba) const { return cardType == SD_CARD_SDHC ? lba : lba << 9; }
+};
+
+#endif
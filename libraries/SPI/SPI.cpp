@@ -19,6 +19,12 @@
 #include "driverlib/pin_map.h"
 #include "SPI.h"
 #include "part.h"
+#include "fast_map.h"
+#include "inc/hw_ints.h"
+#include "inc/hw_udma.h"
+#include "driverlib/rom_map.h"
+#include "driverlib/udma.h"
+#include "LockFree.h"
 
 #define SSIBASE g_ulSSIBase[SSIModule]
 #define NOT_ACTIVE 0xA
@@ -104,6 +110,31 @@ static const unsigned long g_ulSSIConfig[][4] = {
 #endif
 ,};
 
+#if defined(__TM4C129XNCZAD__) || defined(__TM4C1294NCPDT__)
+//*****************************************************************************
+//
+// The XDAT2/XDAT3 pins for Quad-SSI: pin configurations, port and pins.
+// SSI3 on PF has no XDAT3 on the 128 pin part.
+//
+//*****************************************************************************
+static const unsigned long g_ulSSIQuadConfig[][4] = {
+#if defined(__TM4C129XNCZAD__)
+    {GPIO_PA6_SSI0XDAT2, GPIO_PA7_SSI0XDAT3, GPIO_PORTA_BASE, GPIO_PIN_6 | GPIO_PIN_7},
+    {GPIO_PD4_SSI1XDAT2, GPIO_PD5_SSI1XDAT3, GPIO_PORTD_BASE, GPIO_PIN_4 | GPIO_PIN_5},
+    {GPIO_PD7_SSI2XDAT2, GPIO_PD6_SSI2XDAT3, GPIO_PORTD_BASE, GPIO_PIN_7 | GPIO_PIN_6},
+    {GPIO_PF4_SSI3XDAT2, GPIO_PF5_SSI3XDAT3, GPIO_PORTF_BASE, GPIO_PIN_4 | GPIO_PIN_5},
+    {GPIO_PG3_SSI2XDAT2, GPIO_PG2_SSI2XDAT3, GPIO_PORTG_BASE, GPIO_PIN_3 | GPIO_PIN_2},
+    {GPIO_PP0_SSI3XDAT2, GPIO_PP1_SSI3XDAT3, GPIO_PORTP_BASE, GPIO_PIN_0 | GPIO_PIN_1}
+#elif defined(__TM4C1294NCPDT__)
+    {GPIO_PA6_SSI0XDAT2, GPIO_PA7_SSI0XDAT3, GPIO_PORTA_BASE, GPIO_PIN_6 | GPIO_PIN_7},
+    {GPIO_PD4_SSI1XDAT2, GPIO_PD5_SSI1XDAT3, GPIO_PORTD_BASE, GPIO_PIN_4 | GPIO_PIN_5},
+    {GPIO_PD7_SSI2XDAT2, GPIO_PD6_SSI2XDAT3, GPIO_PORTD_BASE, GPIO_PIN_7 | GPIO_PIN_6},
+    {0, 0, 0, 0},
+    {GPIO_PP0_SSI3XDAT2, GPIO_PP1_SSI3XDAT3, GPIO_PORTP_BASE, GPIO_PIN_0 | GPIO_PIN_1}
+#endif
+};
+#endif
+
 //*****************************************************************************
 //
 // The list of SSI gpio port bases.
@@ -146,19 +177,60 @@ static const unsigned long g_ulSSIPins[] = {
 #endif
 };
 
-uint8_t SPIClass::initialized = 0;
-uint8_t SPIClass::interruptMode = 0;
-uint8_t SPIClass::interruptMask[] = {};
-uint8_t SPIClass::interruptSave[] = {};
+//*****************************************************************************
+//
+// The list of SSI interrupts and uDMA RX/TX channel assignments.
+//
+//*****************************************************************************
+static const unsigned long g_ulSSIInt[] = {
+#if defined(TARGET_IS_BLIZZARD_RB1)
+    INT_SSI0, INT_SSI1, INT_SSI2, INT_SSI3
+#elif defined(__TM4C129XNCZAD__)
+    INT_SSI0, INT_SSI1, INT_SSI2, INT_SSI3, INT_SSI2, INT_SSI3
+#elif defined(__TM4C1294NCPDT__)
+    INT_SSI0, INT_SSI1, INT_SSI2, INT_SSI3, INT_SSI3
+#endif
+};
+
+static const unsigned long g_ulSSIDMA[][2] = {
+    {UDMA_CH10_SSI0RX, UDMA_CH11_SSI0TX},
+    {UDMA_CH24_SSI1RX, UDMA_CH25_SSI1TX},
+    {UDMA_CH12_SSI2RX, UDMA_CH13_SSI2TX},
+    {UDMA_CH14_SSI3RX, UDMA_CH15_SSI3TX},
+#if defined(__TM4C129XNCZAD__)
+    {UDMA_CH12_SSI2RX, UDMA_CH13_SSI2TX},
+    {UDMA_CH14_SSI3RX, UDMA_CH15_SSI3TX}
+#elif defined(__TM4C1294NCPDT__)
+    {UDMA_CH14_SSI3RX, UDMA_CH15_SSI3TX}
+#endif
+};
+
+#define DMA_RX_CHANNEL (g_ulSSIDMA[SSIModule][0] & 0xFF)
+#define DMA_TX_CHANNEL (g_ulSSIDMA[SSIModule][1] & 0xFF)
+
+// SPIClass that began on each SSI, for the interrupt handlers and clock
+// changes
+static SPIClass *ssiOwner[4];
+#define SSI_NUMBER(base) (((base) >> 12) & 3)
 
 SPIClass::SPIClass(void) {
-	SSIModule = NOT_ACTIVE;
-	SSIBitOrder = MSBFIRST;
+	init(NOT_ACTIVE);
 }
 
 SPIClass::SPIClass(uint8_t module) {
+	init(module);
+}
+
+void SPIClass::init(uint8_t module) {
 	SSIModule = module;
 	SSIBitOrder = MSBFIRST;
+	SSIBitRate = 0;
+	dmaBusy = 0;
+	slaveRx = NULL;
+	initialized = 0;
+	interruptMode = 0;
+	memset(interruptMask, 0, sizeof(interruptMask));
+	memset(interruptSave, 0, sizeof(interruptSave));
 }
 
 void SPIClass::beginTransaction(SPISettings settings) {
@@ -176,24 +248,37 @@ void SPIClass::beginTransaction(SPISettings settings) {
             noInterrupts();
         }
     }
-    setBitOrder(settings._SSIBitOrder);
-    setDataMode(settings._SSIMode);
-    setClockDivider(settings._divider);
+    applySettings(settings);
+}
+
+void SPIClass::applySettings(const SPISettings &settings) {
+    SSIBitOrder = settings._SSIBitOrder;
+    SSIBitRate = settings._clock;
+    if (cpuFrequency() != F_CPU) {
+        // Slowed down by setCpuFrequency(), the precomputed values are off
+        setDataMode(settings._SSIMode);
+        setBitRate(settings._clock);
+        return;
+    }
+    HWREG(SSIBASE + SSI_O_CPSR) = settings._cpsr;
+    HWREG(SSIBASE + SSI_O_CR0) = settings._cr0;
 }
 
 void SPIClass::endTransaction(void) {
     if (interruptMode > 0) {
-        noInterrupts();
         if (interruptMode == 1) {
             uint8_t i;
+            uint32_t saved = criticalEnter(INT_PRIORITY_GPIO);
             for(i = 1; i < NUM_PORTS; i++) {
                 if(interruptSave[i]) {
                     // disable the registered interrupts
                     GPIOIntEnable((uint32_t) portBASERegister(i), interruptSave[i]);
                 }
             }
-            interrupts();
+            criticalExit(saved);
         } else {
+            // The interrupt may be any vector at any priority, so this
+            // still has to be global
             interrupts();
         }
     }
@@ -240,11 +325,10 @@ void SPIClass::begin() {
         */
         ROM_SSIClockSourceSet(SSIBASE, SSI_CLOCK_SYSTEM);
 
-    #if defined(TARGET_IS_BLIZZARD_RB1)
-        SSIConfigSetExpClk(SSIBASE, SysCtlClockGet(), SSI_FRF_MOTO_MODE_0, SSI_MODE_MASTER, 4000000, 8);
-    #else
-        SSIConfigSetExpClk(SSIBASE, F_CPU, SSI_FRF_MOTO_MODE_0, SSI_MODE_MASTER, 4000000, 8);
-    #endif
+        SSIConfigSetExpClk(SSIBASE, cpuFrequency(), SSI_FRF_MOTO_MODE_0, SSI_MODE_MASTER, 4000000, 8);
+        SSIBitRate = 4000000;
+        ssiOwner[SSI_NUMBER(SSIBASE)] = this;
+        registerCpuFrequencyCb(cpuFrequencyChanged);
 
         ROM_SSIEnable(SSIBASE);
 
@@ -257,14 +341,19 @@ void SPIClass::begin() {
 void SPIClass::end() {
     if (initialized)
         initialized--;
-    if (!initialized) {
+    if (!initialized && SSIModule != NOT_ACTIVE) {
+        endSlave();
+        waitDone();
     	ROM_SSIDisable(SSIBASE);
+        if (ssiOwner[SSI_NUMBER(SSIBASE)] == this)
+            ssiOwner[SSI_NUMBER(SSIBASE)] = NULL;
         interruptMode = 0;
+        memset(interruptMask, 0, sizeof(interruptMask));
     }
 }
 
 void SPIClass::usingInterrupt(uint8_t interruptNumber) {
-    noInterrupts();
+    uint32_t saved = criticalEnter(INT_PRIORITY_CORE);
     // handle interruptMode
     uint8_t bit = digitalPinToBitMask(interruptNumber);
 	uint8_t port = digitalPinToPort(interruptNumber);
@@ -279,7 +368,7 @@ void SPIClass::usingInterrupt(uint8_t interruptNumber) {
 
     interruptMask[port] |= bit;
 
-    interrupts();
+    criticalExit(saved);
 }
 
 void SPIClass::notUsingInterrupt(uint8_t interruptNumber) {
@@ -290,7 +379,7 @@ void SPIClass::notUsingInterrupt(uint8_t interruptNumber) {
     uint8_t haveInterrupts = false;
     uint8_t i;
 
-    noInterrupts();
+    uint32_t saved = criticalEnter(INT_PRIORITY_CORE);
     // handle interruptMode
 
     uint8_t bit = digitalPinToBitMask(interruptNumber);
@@ -307,7 +396,7 @@ void SPIClass::notUsingInterrupt(uint8_t interruptNumber) {
     if (!haveInterrupts)
         interruptMode = 0;
 
-    interrupts();
+    criticalExit(saved);
 }
 
 void SPIClass::setBitOrder(uint8_t ssPin, uint8_t bitOrder) {
@@ -324,33 +413,42 @@ void SPIClass::setDataMode(uint8_t mode) {
 }
 
 void SPIClass::setClockDivider(uint8_t divider){
+    setBitRate(16000000 / divider);
+}
 
-    uint32_t ui32MaxBitRate;
-    uint32_t ui32BitRate;
+void SPIClass::setBitRate(uint32_t ui32BitRate){
+
+    uint32_t hz = cpuFrequency();
     uint32_t ui32RegVal;
-    uint32_t ui32PreDiv;
-    uint32_t ui32SCR;
-
-    ui32BitRate = 16000000 / divider;
-    //
-    // Set the clock predivider.
-    //
-    ui32MaxBitRate = F_CPU / ui32BitRate;
-    ui32PreDiv = 0;
-    do
-    {
-        ui32PreDiv += 2;
-        ui32SCR = (ui32MaxBitRate / ui32PreDiv) - 1; 
-    }
-    while(ui32SCR > 255);
-    HWREG(SSIBASE + SSI_O_CPSR) = ui32PreDiv;
+
+    SSIBitRate = ui32BitRate;
+    HWREG(SSIBASE + SSI_O_CPSR) = SPISettings::prescaler(hz, ui32BitRate);
 
     ui32RegVal = HWREG(SSIBASE + SSI_O_CR0);
     ui32RegVal &= ~(SSI_CR0_SCR_M);
-    ui32RegVal |= (ui32SCR << SSI_CR0_SCR_S) & (SSI_CR0_SCR_M);
+    ui32RegVal |= SPISettings::control(hz, ui32BitRate, 0) & SSI_CR0_SCR_M;
     HWREG(SSIBASE + SSI_O_CR0) = ui32RegVal;
 }
 
+//
+// Reload the dividers of the modules in use after setCpuFrequency()
+//
+void SPIClass::cpuFrequencyChanged(uint32_t hz, uint8_t phase) {
+    uint8_t i;
+
+    for (i = 0; i < 4; i++) {
+        SPIClass *spi = ssiOwner[i];
+        if (!spi)
+            continue;
+        if (phase != CPU_FREQ_POST)
+            spi->waitDone();    // let DMA finish at the old rate
+        else if (spi->slaveRx)
+            continue;           // clocked by the master, CPSR/SCR unused
+        else if (spi->SSIBitRate)
+            spi->setBitRate(spi->SSIBitRate);
+    }
+}
+
 uint8_t SPIClass::transfer(uint8_t data) {
 	uint32_t rxtxData;
 
@@ -359,11 +457,11 @@ uint8_t SPIClass::transfer(uint8_t data) {
 		asm("rbit %0, %1" : "=r" (rxtxData) : "r" (rxtxData));	// reverse order of 32 bits 
 		asm("rev %0, %1" : "=r" (rxtxData) : "r" (rxtxData));	// reverse order of bytes to get original bits into lowest byte 
 	}
-	ROM_SSIDataPut(SSIBASE, (uint8_t) rxtxData);
+	FAST_SSIDataPut(SSIBASE, (uint8_t) rxtxData);
 
-	while(ROM_SSIBusy(SSIBASE));
+	while(FAST_SSIBusy(SSIBASE));
 
-	ROM_SSIDataGet(SSIBASE, &rxtxData);
+	FAST_SSIDataGet(SSIBASE, &rxtxData);
 	if(SSIBitOrder == LSBFIRST) {
 		asm("rbit %0, %1" : "=r" (rxtxData) : "r" (rxtxData));	// reverse order of 32 bits 
 		asm("rev %0, %1" : "=r" (rxtxData) : "r" (rxtxData));	// reverse order of bytes to get original bits into lowest byte 
@@ -388,11 +486,11 @@ uint16_t SPIClass::transfer16(uint16_t data) {
 		asm("rbit %0, %1" : "=r" (rxtxData) : "r" (rxtxData));	// reverse order of 32 bits 
 		asm("rev %0, %1" : "=r" (rxtxData) : "r" (rxtxData));	// reverse order of bytes to get original bits into lowest byte 
 	}
-	ROM_SSIDataPut(SSIBASE, (uint16_t) rxtxData);
+	FAST_SSIDataPut(SSIBASE, (uint16_t) rxtxData);
 
-	while(ROM_SSIBusy(SSIBASE));
+	while(FAST_SSIBusy(SSIBASE));
 
-	ROM_SSIDataGet(SSIBASE, &rxtxData);
+	FAST_SSIDataGet(SSIBASE, &rxtxData);
 	if(SSIBitOrder == LSBFIRST) {
 		asm("rbit %0, %1" : "=r" (rxtxData) : "r" (rxtxData));	// reverse order of 32 bits 
 		asm("rev %0, %1" : "=r" (rxtxData) : "r" (rxtxData));	// reverse order of bytes to get original bits into lowest byte 
@@ -408,28 +506,458 @@ uint16_t SPIClass::transfer16(uint16_t data) {
 	return (uint16_t) rxtxData;
 }
 
-void SPIClass::transfer(void *buf, size_t count) { 
-    uint32_t ui32RegVal;
-    uint32_t txData;
-    uint8_t *_buf = (uint8_t *) buf;
+// Bit reversed byte, for LSBFIRST
+static inline uint32_t reverse8(uint32_t data) {
+	asm("rbit %0, %1" : "=r" (data) : "r" (data));
+	return data >> 24;
+}
+
+//
+// Pipelined 8 bit transfer. Up to 8 frames are kept in flight, the depth
+// of the RX FIFO, so the TX FIFO never runs dry while data is left and RX
+// can never overrun; SCK runs back to back. tx == NULL sends fill,
+// rx == NULL discards what comes back. tx and rx may be the same buffer
+// since each byte is sent before its reply is stored.
+//
+void SPIClass::transferBuffer(const uint8_t *tx, uint8_t *rx, size_t count, uint8_t fill) {
+    const uint32_t base = SSIBASE;
+    const bool lsb = (SSIBitOrder == LSBFIRST);
+    const uint32_t fillData = lsb ? reverse8(fill) : fill;
+    size_t sent = 0, received = 0;
+    uint32_t data;
+
+    waitDone();
+
+    // Drop anything left over in the RX FIFO
+    while (HWREG(base + SSI_O_SR) & SSI_SR_RNE)
+        data = HWREG(base + SSI_O_DR);
+
+    while (received < count) {
+        while (sent < count && sent - received < 8) {
+            data = tx ? (lsb ? reverse8(tx[sent]) : tx[sent]) : fillData;
+            HWREG(base + SSI_O_DR) = data;
+            sent++;
+        }
+        while (HWREG(base + SSI_O_SR) & SSI_SR_RNE) {
+            data = HWREG(base + SSI_O_DR);
+            if (rx)
+                rx[received] = lsb ? reverse8(data) : data;
+            received++;
+        }
+    }
+}
+
+void SPIClass::transfer(void *buf, size_t count) {
+    transferBuffer((const uint8_t *) buf, (uint8_t *) buf, count, 0xFF);
+}
+
+void SPIClass::transfer(const void *txBuf, void *rxBuf, size_t count) {
+    transferBuffer((const uint8_t *) txBuf, (uint8_t *) rxBuf, count, 0xFF);
+}
+
+void SPIClass::write(const void *buf, size_t count) {
+    transferBuffer((const uint8_t *) buf, NULL, count, 0xFF);
+}
+
+void SPIClass::read(void *buf, size_t count, uint8_t fill) {
+    transferBuffer(NULL, (uint8_t *) buf, count, fill);
+}
+
+//
+// uDMA transfers. Both channels always run: with no rx buffer the RX
+// channel empties the FIFO into a dummy byte, so completion of the RX
+// channel means the last frame is off the wire. Transfers longer than
+// DMA_MAX_TRANSFER are restarted from the interrupt in chunks; a chain
+// runs as peripheral scatter-gather without the CPU.
+//
+bool SPIChain::add(const void *tx, void *rx, size_t n) {
+    const uint8_t *t = (const uint8_t *) tx;
+    uint8_t *r = (uint8_t *) rx;
+    size_t tasks = (n + DMA_MAX_TRANSFER - 1) / DMA_MAX_TRANSFER;
+    size_t chunk;
+
+    if (!n || count + tasks > SPI_CHAIN_MAX)
+        return false;
+
+    // The SSI data register is filled in by transferAsync()
+    for (; n; n -= chunk, count++) {
+        chunk = n > DMA_MAX_TRANSFER ? DMA_MAX_TRANSFER : n;
+        dmaTaskSet(&txTasks[count],
+                   UDMA_SIZE_8 | (t ? UDMA_SRC_INC_8 : UDMA_SRC_INC_NONE) | UDMA_DST_INC_NONE | UDMA_ARB_4,
+                   UDMA_MODE_PER_SCATTER_GATHER, t ? (void *) t : &fillByte, NULL, chunk);
+        dmaTaskSet(&rxTasks[count],
+                   UDMA_SIZE_8 | UDMA_SRC_INC_NONE | (r ? UDMA_DST_INC_8 : UDMA_DST_INC_NONE) | UDMA_ARB_4,
+                   UDMA_MODE_PER_SCATTER_GATHER, NULL, r ? r : &sink, chunk);
+        if (t)
+            t += chunk;
+        if (r)
+            r += chunk;
+    }
+    return true;
+}
+
+void SPIClass::dmaChannels(void) {
+    dmaBegin();
+    MAP_uDMAChannelAssign(g_ulSSIDMA[SSIModule][0]);
+    MAP_uDMAChannelAssign(g_ulSSIDMA[SSIModule][1]);
+    MAP_uDMAChannelAttributeDisable(DMA_RX_CHANNEL, UDMA_ATTR_ALL);
+    MAP_uDMAChannelAttributeDisable(DMA_TX_CHANNEL, UDMA_ATTR_ALL);
+    // RX must keep up or the FIFO overruns
+    MAP_uDMAChannelAttributeEnable(DMA_RX_CHANNEL, UDMA_ATTR_HIGH_PRIORITY);
+}
+
+bool SPIClass::dmaSetup(SPICallback callback) {
+    const uint32_t base = SSIBASE;
+    uint32_t data;
+
+    if (dmaBusy || slaveRx)
+        return false;
+    dmaBusy = 1;
+    dmaCallback = callback;
+
+    dmaChannels();
+
+    while (HWREG(base + SSI_O_SR) & SSI_SR_RNE)
+        data = HWREG(base + SSI_O_DR);
+    (void) data;
+
+    ssiOwner[SSI_NUMBER(base)] = this;
+#if !defined(TARGET_IS_BLIZZARD_RB1)
+    // Snowflake signals uDMA completion through the SSI interrupt mask
+    HWREG(base + SSI_O_ICR) = SSI_ICR_DMARXIC | SSI_ICR_DMATXIC;
+    HWREG(base + SSI_O_IM) |= SSI_IM_DMARXIM;
+#endif
+    ROM_IntPrioritySet(g_ulSSIInt[SSIModule], INT_PRIORITY_SSI);
+    ROM_IntEnable(g_ulSSIInt[SSIModule]);
+    return true;
+}
+
+void SPIClass::dmaStart(void) {
+    const uint32_t base = SSIBASE;
+    uint32_t n = dmaLeft > DMA_MAX_TRANSFER ? DMA_MAX_TRANSFER : dmaLeft;
+
+    MAP_uDMAChannelControlSet(DMA_RX_CHANNEL | UDMA_PRI_SELECT,
+                              UDMA_SIZE_8 | UDMA_SRC_INC_NONE |
+                              (dmaRx ? UDMA_DST_INC_8 : UDMA_DST_INC_NONE) | UDMA_ARB_4);
+    MAP_uDMAChannelTransferSet(DMA_RX_CHANNEL | UDMA_PRI_SELECT, UDMA_MODE_BASIC,
+                               (void *)(base + SSI_O_DR), dmaRx ? dmaRx : &dmaSink, n);
+    MAP_uDMAChannelControlSet(DMA_TX_CHANNEL | UDMA_PRI_SELECT,
+                              UDMA_SIZE_8 | (dmaTx ? UDMA_SRC_INC_8 : UDMA_SRC_INC_NONE) |
+                              UDMA_DST_INC_NONE | UDMA_ARB_4);
+    MAP_uDMAChannelTransferSet(DMA_TX_CHANNEL | UDMA_PRI_SELECT, UDMA_MODE_BASIC,
+                               (void *)(dmaTx ? dmaTx : &dmaFill), (void *)(base + SSI_O_DR), n);
+    if (dmaTx)
+        dmaTx += n;
+    if (dmaRx)
+        dmaRx += n;
+    dmaLeft -= n;
+
+    MAP_uDMAChannelEnable(DMA_RX_CHANNEL);
+    MAP_uDMAChannelEnable(DMA_TX_CHANNEL);
+    HWREG(base + SSI_O_DMACTL) = SSI_DMACTL_TXDMAE | SSI_DMACTL_RXDMAE;
+}
+
+bool SPIClass::transferAsync(const void *txBuf, void *rxBuf, size_t count,
+                             SPICallback callback, uint8_t fill) {
+    if (!count || !dmaSetup(callback))
+        return false;
+    dmaTx = (const uint8_t *) txBuf;
+    dmaRx = (uint8_t *) rxBuf;
+    dmaFill = fill;
+    dmaLeft = count;
+    dmaStart();
+    return true;
+}
+
+bool SPIClass::transferAsync(SPIChain &chain, SPICallback callback) {
+    const uint32_t base = SSIBASE;
+    uint8_t i, last = chain.count - 1;
+
+    if (!chain.count || !dmaSetup(callback))
+        return false;
+    dmaLeft = 0;
+
+    // Point the tasks at this SSI and let the last one end the transfer
+    for (i = 0; i < chain.count; i++) {
+        uint32_t mode = (i == last) ? UDMA_MODE_BASIC : (UDMA_MODE_PER_SCATTER_GATHER | UDMA_MODE_ALT_SELECT);
+        chain.txTasks[i].pvDstEndAddr = (void *)(base + SSI_O_DR);
+        chain.rxTasks[i].pvSrcEndAddr = (void *)(base + SSI_O_DR);
+        chain.txTasks[i].ui32Control = (chain.txTasks[i].ui32Control & ~UDMA_CHCTL_XFERMODE_M) | mode;
+        chain.rxTasks[i].ui32Control = (chain.rxTasks[i].ui32Control & ~UDMA_CHCTL_XFERMODE_M) | mode;
+    }
+
+    MAP_uDMAChannelScatterGatherSet(DMA_RX_CHANNEL, chain.count, chain.rxTasks, 1);
+    MAP_uDMAChannelScatterGatherSet(DMA_TX_CHANNEL, chain.count, chain.txTasks, 1);
+    MAP_uDMAChannelEnable(DMA_RX_CHANNEL);
+    MAP_uDMAChannelEnable(DMA_TX_CHANNEL);
+    HWREG(base + SSI_O_DMACTL) = SSI_DMACTL_TXDMAE | SSI_DMACTL_RXDMAE;
+    return true;
+}
+
+void SPIClass::waitDone(void) {
+    lockfree::waitUntil([this]() { return !dmaBusy; }, 0xFFFFFFFF);
+}
+
+void SPIClass::dmaIntHandler(void) {
+    const uint32_t base = SSIBASE;
+
+    HWREG(UDMA_CHIS) = (1 << DMA_RX_CHANNEL) | (1 << DMA_TX_CHANNEL);
+#if !defined(TARGET_IS_BLIZZARD_RB1)
+    HWREG(base + SSI_O_ICR) = SSI_ICR_DMARXIC | SSI_ICR_DMATXIC;
+#endif
+    if (!dmaBusy || MAP_uDMAChannelIsEnabled(DMA_RX_CHANNEL))
+        return;
+
+    if (dmaLeft) {
+        dmaStart();
+        return;
+    }
+
+    HWREG(base + SSI_O_DMACTL) = 0;
+    dmaBusy = 0;
+    if (dmaCallback)
+        dmaCallback();
+}
+
+static void ssiIntHandler(uint8_t ssi) {
+    if (ssiOwner[ssi])
+        ssiOwner[ssi]->dmaIntHandler();
+}
+
+extern "C" void SSIIntHandler(void) { ssiIntHandler(0); }
+extern "C" void SSIIntHandler1(void) { ssiIntHandler(1); }
+extern "C" void SSIIntHandler2(void) { ssiIntHandler(2); }
+extern "C" void SSIIntHandler3(void) { ssiIntHandler(3); }
+
+//
+// Slave mode. The RX channel fills the receive buffer and the TX channel
+// feeds the reply, followed by fill bytes for the rest of the frame, so
+// there is no per-byte interrupt. The SSI has no interrupt for FSS going
+// high, so the end of a frame is a GPIO edge on fssPin: the FSS pin
+// itself or any pin wired to it. At that point whatever DMA has not
+// moved yet is drained from the FIFO, the callback gets the frame and
+// both channels are rearmed. Bytes still in the TX FIFO cannot be
+// flushed any other way, so then the SSI is reset.
+//
+static void slaveFrameEnd(uint8_t ssi) {
+    if (ssiOwner[ssi])
+        ssiOwner[ssi]->slaveIntHandler();
+}
+
+static void slaveFrameEnd0(void) { slaveFrameEnd(0); }
+static void slaveFrameEnd1(void) { slaveFrameEnd(1); }
+static void slaveFrameEnd2(void) { slaveFrameEnd(2); }
+static void slaveFrameEnd3(void) { slaveFrameEnd(3); }
+
+static void (* const slaveFrameEnds[4])(void) = {
+    slaveFrameEnd0, slaveFrameEnd1, slaveFrameEnd2, slaveFrameEnd3
+};
+
+bool SPIClass::beginSlave(uint8_t mode, uint8_t fssPin, void *rxBuf, size_t rxSize,
+                          SPISlaveCallback callback) {
+    // With SPH clear the SSI wants FSS pulsed between bytes, which masters
+    // holding chip select for a whole transfer do not do
+    if (!(mode & SPI_MODE1) || !rxBuf || !rxSize)
+        return false;
+
+    if (!initialized)
+        begin();
+    waitDone();
+    endSlave();
+
+    slaveMode = mode;
+    slaveFss = fssPin;
+    slaveSize = rxSize > DMA_MAX_TRANSFER ? DMA_MAX_TRANSFER : rxSize;
+    slaveCallback = callback;
+    slaveTx = NULL;
+    slaveTxSize = 0;
+    slaveFill = 0;
+    slaveRx = (uint8_t *) rxBuf;
+    ssiOwner[SSI_NUMBER(SSIBASE)] = this;
+
+    dmaChannels();
+    slaveArm(false);
+    attachInterrupt(fssPin, slaveFrameEnds[SSI_NUMBER(SSIBASE)], RISING);
+    return true;
+}
+
+void SPIClass::endSlave(void) {
+    if (!slaveRx)
+        return;
+    detachInterrupt(slaveFss);
+    MAP_uDMAChannelDisable(DMA_RX_CHANNEL);
+    MAP_uDMAChannelDisable(DMA_TX_CHANNEL);
+    HWREG(SSIBASE + SSI_O_DMACTL) = 0;
+    ROM_SSIDisable(SSIBASE);
+    slaveRx = NULL;
+
+    // Back to the master setup of begin(), which is not run again while
+    // initialized; the next beginTransaction() applies its own settings
+    unsigned long discard;
+    SSIConfigSetExpClk(SSIBASE, cpuFrequency(), SSI_FRF_MOTO_MODE_0, SSI_MODE_MASTER,
+                       SSIBitRate ? SSIBitRate : 4000000, 8);
+    ROM_SSIEnable(SSIBASE);
+    while (ROM_SSIDataGetNonBlocking(SSIBASE, &discard));
+}
+
+void SPIClass::setReply(const void *txBuf, size_t count, uint8_t fill) {
+    uint32_t saved = criticalEnter(INT_PRIORITY_GPIO);
+    slaveTx = (const uint8_t *) txBuf;
+    slaveTxSize = txBuf ? count : 0;
+    slaveFill = fill;
+    criticalExit(saved);
+}
+
+void SPIClass::slaveArm(bool reset) {
+    const uint32_t base = SSIBASE;
+    size_t reply = slaveTxSize < slaveSize ? slaveTxSize : slaveSize;
+
+    if (reset) {
+        MAP_SysCtlPeripheralReset(g_ulSSIPeriph[SSIModule]);
+        ROM_SSIClockSourceSet(base, SSI_CLOCK_SYSTEM);
+    }
+    ROM_SSIDisable(base);
+    SSIConfigSetExpClk(base, cpuFrequency(), slaveMode >> 6, SSI_MODE_SLAVE,
+                       cpuFrequency() / 12, 8);
+
+    MAP_uDMAChannelControlSet(DMA_RX_CHANNEL | UDMA_PRI_SELECT,
+                              UDMA_SIZE_8 | UDMA_SRC_INC_NONE | UDMA_DST_INC_8 | UDMA_ARB_4);
+    MAP_uDMAChannelTransferSet(DMA_RX_CHANNEL | UDMA_PRI_SELECT, UDMA_MODE_BASIC,
+                               (void *)(base + SSI_O_DR), slaveRx, slaveSize);
+
+    if (reply == slaveSize || !reply) {
+        MAP_uDMAChannelControlSet(DMA_TX_CHANNEL | UDMA_PRI_SELECT,
+                                  UDMA_SIZE_8 | (reply ? UDMA_SRC_INC_8 : UDMA_SRC_INC_NONE) |
+                                  UDMA_DST_INC_NONE | UDMA_ARB_4);
+        MAP_uDMAChannelTransferSet(DMA_TX_CHANNEL | UDMA_PRI_SELECT, UDMA_MODE_BASIC,
+                                   reply ? (void *) slaveTx : &slaveFill,
+                                   (void *)(base + SSI_O_DR), slaveSize);
+    } else {
+        // The reply, then fill bytes up to the size of the RX buffer
+        dmaTaskSet(&slaveTasks[0], UDMA_SIZE_8 | UDMA_SRC_INC_8 | UDMA_DST_INC_NONE | UDMA_ARB_4,
+                   UDMA_MODE_PER_SCATTER_GATHER, (void *) slaveTx, (void *)(base + SSI_O_DR), reply);
+        dmaTaskSet(&slaveTasks[1], UDMA_SIZE_8 | UDMA_SRC_INC_NONE | UDMA_DST_INC_NONE | UDMA_ARB_4,
+                   UDMA_MODE_BASIC, &slaveFill, (void *)(base + SSI_O_DR), slaveSize - reply);
+        MAP_uDMAChannelScatterGatherSet(DMA_TX_CHANNEL, 2, slaveTasks, 1);
+    }
+
+    MAP_uDMAChannelEnable(DMA_RX_CHANNEL);
+    MAP_uDMAChannelEnable(DMA_TX_CHANNEL);
+    HWREG(base + SSI_O_DMACTL) = SSI_DMACTL_TXDMAE | SSI_DMACTL_RXDMAE;
+    ROM_SSIEnable(base);
+}
+
+void SPIClass::slaveIntHandler(void) {
+    const uint32_t base = SSIBASE;
+    size_t got;
+
+    if (!slaveRx)
+        return;
+
+    MAP_uDMAChannelDisable(DMA_RX_CHANNEL);
+    MAP_uDMAChannelDisable(DMA_TX_CHANNEL);
+    HWREG(base + SSI_O_DMACTL) = 0;
+
+    got = slaveSize - uDMAChannelSizeGet(DMA_RX_CHANNEL | UDMA_PRI_SELECT);
+    while (HWREG(base + SSI_O_SR) & SSI_SR_RNE) {
+        uint32_t data = HWREG(base + SSI_O_DR);
+        if (got < slaveSize)
+            slaveRx[got++] = data;
+    }
+
+    if (slaveCallback)
+        slaveCallback(slaveRx, got);
+    slaveArm(!(HWREG(base + SSI_O_SR) & SSI_SR_TFE));
+}
+
+#if defined(__TM4C129XNCZAD__) || defined(__TM4C1294NCPDT__)
+//
+// Advanced SSI. With frame hold on, FSS stays low across any number of
+// frames and mode changes until a byte is written with EOM set, so a
+// command, its address and its data can each use their own width. The
+// mode may only change once the shift register is idle.
+//
+static void advModeSet(uint32_t base, uint32_t mode) {
+    while (HWREG(base + SSI_O_SR) & SSI_SR_BSY)
+        ;
+    MAP_SSIAdvModeSet(base, mode);
+}
+
+bool SPIClass::beginAdvanced(bool quad) {
+    const uint32_t base = SSIBASE;
+
+    if (!initialized)
+        begin();
+    if (quad) {
+        if (!g_ulSSIQuadConfig[SSIModule][0])
+            return false;
+        ROM_GPIOPinConfigure(g_ulSSIQuadConfig[SSIModule][0]);
+        ROM_GPIOPinConfigure(g_ulSSIQuadConfig[SSIModule][1]);
+        ROM_GPIOPinTypeSSI(g_ulSSIQuadConfig[SSIModule][2], g_ulSSIQuadConfig[SSIModule][3]);
+    }
+    waitDone();
+    advModeSet(base, SSI_ADV_MODE_WRITE);
+    MAP_SSIAdvFrameHoldEnable(base);
+    return true;
+}
+
+void SPIClass::endAdvanced(void) {
+    const uint32_t base = SSIBASE;
+
+    advModeSet(base, SSI_ADV_MODE_LEGACY);
+    MAP_SSIAdvFrameHoldDisable(base);
+}
+
+void SPIClass::advWrite(const void *buf, size_t count, uint8_t lines, bool last) {
+    const uint32_t base = SSIBASE;
+    const uint8_t *tx = (const uint8_t *) buf;
     size_t i;
-    
-    if(count == 1) {
-        transfer(_buf[0]);
+
+    advModeSet(base, lines == 4 ? SSI_ADV_MODE_QUAD_WRITE :
+                     lines == 2 ? SSI_ADV_MODE_BI_WRITE : SSI_ADV_MODE_WRITE);
+    for (i = 0; i < count; i++) {
+        while (!(HWREG(base + SSI_O_SR) & SSI_SR_TNF))
+            ;
+        if (last && i == count - 1)
+            HWREG(base + SSI_O_CR1) |= SSI_CR1_EOM;
+        HWREG(base + SSI_O_DR) = tx[i];
     }
+}
 
-    // Transfer 16 bytes at the time
-    for(i = 0; i < count; i = i+ 2) {
-        if(count - i == 1) {
-            transfer(_buf[i]);
-            break;
+void SPIClass::advRead(void *buf, size_t count, uint8_t lines, bool last) {
+    const uint32_t base = SSIBASE;
+    uint8_t *rx = (uint8_t *) buf;
+    size_t sent = 0, received = 0;
+    uint32_t data;
+
+    advModeSet(base, lines == 4 ? SSI_ADV_MODE_QUAD_READ :
+                     lines == 2 ? SSI_ADV_MODE_BI_READ : SSI_ADV_MODE_READ_WRITE);
+    while (HWREG(base + SSI_O_SR) & SSI_SR_RNE)
+        data = HWREG(base + SSI_O_DR);
+
+    // Each dummy write clocks in one byte, keep the FIFO full as in
+    // transferBuffer()
+    while (received < count) {
+        while (sent < count && sent - received < 8) {
+            if (last && sent == count - 1)
+                HWREG(base + SSI_O_CR1) |= SSI_CR1_EOM;
+            HWREG(base + SSI_O_DR) = 0xFF;
+            sent++;
+        }
+        while (HWREG(base + SSI_O_SR) & SSI_SR_RNE) {
+            data = HWREG(base + SSI_O_DR);
+            rx[received++] = data;
         }
-        txData = ((uint8_t)_buf[i]) << 8 | ((uint8_t)_buf[i + 1]);
-        transfer16(txData);
     }
 }
+#endif
 
 void SPIClass::setModule(uint8_t module) {
+	if (initialized && module != SSIModule) {
+		// Release the old module completely before moving
+		initialized = 1;
+		end();
+	}
 	SSIModule = module;
 	begin();
 }
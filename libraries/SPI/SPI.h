@@ -13,6 +13,7 @@
 
 #include <stdio.h>
 #include <Energia.h>
+#include <dma.h>
 
 #define SPI_CLOCK_DIV2 2
 #define SPI_CLOCK_DIV4 4
@@ -40,28 +41,72 @@
 #define MSBFIRST 1
 #define LSBFIRST 0
 
+//
+// Register values for one device, worked out once for F_CPU. With constant
+// arguments the compiler folds them, and beginTransaction() only has to
+// store CPSR and CR0. The fastest rate not above clock is used.
+//
 class SPISettings {
 public:
+  constexpr SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode)
+    : _SSIBitOrder(bitOrder), _SSIMode(dataMode), _clock(clock),
+      _cpsr(prescaler(F_CPU, clock)),
+      _cr0(control(F_CPU, clock, dataMode)) {}
+  constexpr SPISettings()
+    : SPISettings(4000000, MSBFIRST, SPI_MODE0) {}
+
   uint8_t _SSIBitOrder;
   uint8_t _SSIMode;
-  uint8_t _divider;
-  SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode) {
-      init_AlwaysInline(clock, bitOrder, dataMode);
+  uint32_t _clock;
+  uint8_t _cpsr;    // SSI_O_CPSR, even 2..254
+  uint16_t _cr0;    // SSI_O_CR0: SCR, SPH/SPO, Freescale frames, 8 bits
+
+  // SSI clock is hz / (CPSR * (1 + SCR))
+  static constexpr uint32_t divisor(uint32_t hz, uint32_t clock) {
+    return clock ? (hz + clock - 1) / clock : 0xFFFFFFFF;
   }
-  SPISettings() {
-    init_AlwaysInline(4000000, MSBFIRST, SPI_MODE0);
+  static constexpr uint8_t prescaler(uint32_t hz, uint32_t clock) {
+    return divisor(hz, clock) <= 512 ? 2 :
+           divisor(hz, clock) > 254 * 256 ? 254 :
+           (divisor(hz, clock) + 511) / 512 * 2;
   }
-private:
+  static constexpr uint16_t control(uint32_t hz, uint32_t clock, uint8_t dataMode) {
+    return (uint16_t)(((divisor(hz, clock) + prescaler(hz, clock) - 1) / prescaler(hz, clock) > 256 ? 255 :
+                       (divisor(hz, clock) + prescaler(hz, clock) - 1) / prescaler(hz, clock) - 1) << 8) |
+           (dataMode & 0xC0) | 0x07;
+  }
+};
 
-  void init_AlwaysInline(uint32_t clock, uint8_t bitOrder, uint8_t dataMode)
-    __attribute__((__always_inline__)) {
+// Called from the SSI interrupt when an asynchronous transfer is done
+typedef void (*SPICallback)(void);
 
-    // Pack into the SPISettings class
-    _SSIBitOrder = bitOrder;
-    _SSIMode     = dataMode ;
-    _divider     =  20000000/clock;
-  }
-  friend class SPIClass;  
+// Called from the FSS interrupt with the bytes of one slave frame
+typedef void (*SPISlaveCallback)(uint8_t *rx, size_t count);
+
+// uDMA tasks per SPIChain, each covers up to DMA_MAX_TRANSFER bytes
+#ifndef SPI_CHAIN_MAX
+#define SPI_CHAIN_MAX 8
+#endif
+
+//
+// A list of buffers sent as one scatter-gather DMA transfer, e.g. a
+// command header followed by a data block. Must stay in scope until the
+// transfer is done.
+//
+class SPIChain {
+public:
+  SPIChain(uint8_t fill = 0xFF) : count(0), fillByte(fill) {}
+  // tx NULL sends the fill byte, rx NULL discards; false when out of tasks
+  bool add(const void *tx, void *rx, size_t n);
+  void clear(void) { count = 0; }
+  uint8_t size(void) const { return count; }
+private:
+  tDMAControlTable txTasks[SPI_CHAIN_MAX];
+  tDMAControlTable rxTasks[SPI_CHAIN_MAX];
+  uint8_t count;
+  uint8_t fillByte;
+  uint8_t sink;
+  friend class SPIClass;
 };
 
 class SPIClass {
@@ -69,11 +114,38 @@ class SPIClass {
 private:
 	uint8_t SSIModule;
 	uint8_t SSIBitOrder;
-  static uint8_t inTransactionFlag;
-  static uint8_t initialized;
-  static uint8_t interruptMode; // 0=none, 1=mask, 2=global
-  static uint8_t interruptMask[NUM_PORTS]; // which interrupts to mask
-  static uint8_t interruptSave[NUM_PORTS]; // temp storage, to restore state
+	uint32_t SSIBitRate;
+  // Per instance, so each SSI module is set up and torn down on its own
+  uint8_t initialized;
+  uint8_t interruptMode; // 0=none, 1=mask, 2=global
+  uint8_t interruptMask[NUM_PORTS]; // which interrupts to mask
+  uint8_t interruptSave[NUM_PORTS]; // temp storage, to restore state
+  void init(uint8_t module);
+  void setBitRate(uint32_t);
+  void transferBuffer(const uint8_t *tx, uint8_t *rx, size_t count, uint8_t fill);
+  static void cpuFrequencyChanged(uint32_t hz, uint8_t phase);
+  // uDMA transfer state, shared with the SSI interrupt
+  volatile uint8_t dmaBusy;
+  uint8_t dmaFill;
+  uint8_t dmaSink;
+  const uint8_t *dmaTx;
+  uint8_t *dmaRx;
+  size_t dmaLeft;
+  SPICallback dmaCallback;
+  bool dmaSetup(SPICallback callback);
+  void dmaStart(void);
+  void dmaChannels(void);
+  // Slave mode state, slaveRx is NULL when not a slave
+  uint8_t *slaveRx;
+  size_t slaveSize;
+  const uint8_t *slaveTx;
+  size_t slaveTxSize;
+  uint8_t slaveFill;
+  uint8_t slaveMode;
+  uint8_t slaveFss;
+  SPISlaveCallback slaveCallback;
+  tDMAControlTable slaveTasks[2];
+  void slaveArm(bool reset);
 public:
 
   SPIClass(void);
@@ -84,6 +156,9 @@ public:
   void notUsingInterrupt(uint8_t interruptNumber);
   void endTransaction(void);
   void beginTransaction(SPISettings settings);
+  // Clock, mode and bit order of beginTransaction() without the interrupt
+  // masking
+  void applySettings(const SPISettings &settings);
   void setBitOrder(uint8_t);
   void setBitOrder(uint8_t, uint8_t);
 
@@ -93,9 +168,48 @@ public:
 
   uint8_t transfer(uint8_t);
   uint16_t transfer16(uint16_t data);
-  void transfer(void *buf, size_t count);
+  // Buffer transfers, 8 bit frames sent back to back
+  void transfer(void *buf, size_t count);             // replies overwrite buf
+  void transfer(const void *txBuf, void *rxBuf, size_t count);
+  void write(const void *buf, size_t count);          // replies discarded
+  void read(void *buf, size_t count, uint8_t fill = 0xFF);
+
+  // uDMA transfers, MSB first only. Return at once and call callback from
+  // the SSI interrupt when done; false if a transfer is still running.
+  // tx NULL sends fill, rx NULL discards what comes back.
+  bool transferAsync(const void *txBuf, void *rxBuf, size_t count,
+                     SPICallback callback = NULL, uint8_t fill = 0xFF);
+  bool transferAsync(SPIChain &chain, SPICallback callback = NULL);
+  bool isBusy(void) { return dmaBusy; }
+  void waitDone(void);
+  void dmaIntHandler(void);
+
+  // Slave mode: each frame, from FSS low to FSS high, is received by DMA
+  // into rxBuf (at most DMA_MAX_TRANSFER bytes) while the reply set with
+  // setReply() is sent, then fill. callback runs from the rising edge on
+  // fssPin, the FSS pin or a pin wired to it, and rxBuf is rearmed when it
+  // returns. Only SPI_MODE1 and SPI_MODE3; SPI clock at most F_CPU / 12.
+  bool beginSlave(uint8_t mode, uint8_t fssPin, void *rxBuf, size_t rxSize,
+                  SPISlaveCallback callback);
+  void endSlave(void);
+  // Used from the next frame on; txBuf must stay valid
+  void setReply(const void *txBuf, size_t count, uint8_t fill = 0);
+  void slaveIntHandler(void);
+
+#if defined(__TM4C129XNCZAD__) || defined(__TM4C1294NCPDT__)
+  // Bi-/Quad-SSI on the TM4C129, MSB first. beginAdvanced() holds FSS low
+  // from the first advWrite()/advRead() until one is called with last set;
+  // quad also takes over the XDAT2/XDAT3 pins and fails on modules
+  // without them. lines is 1, 2 or 4.
+  bool beginAdvanced(bool quad);
+  void endAdvanced(void);
+  void advWrite(const void *buf, size_t count, uint8_t lines, bool last);
+  void advRead(void *buf, size_t count, uint8_t lines, bool last);
+#endif
 
   //Stellarpad-specific functions
+  // Switches this instance to another module. Modules that share an SSI
+  // (4 and 5 on the TM4C129) must not be in use by two instances at once.
   void setModule(uint8_t);
 
 };
@@ -0,0 +1,271 @@
+/*
+  SPIDevice.cpp - Shared SPI bus with per device settings and chip select
+  Copyright (c) 2016 Energia.  All right reserved.
+
+  The queue is a singly linked list of caller owned transactions, sorted
+  by priority on insert. It is touched from loop() and from the SSI
+  interrupt that finishes a transfer, so it is only changed with
+  INT_PRIORITY_SSI masked. current is claimed under the same mask, which
+  makes whoever claims it the only one driving the bus.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "wiring_private.h"
+#include "inc/hw_gpio.h"
+#include "LockFree.h"
+#include "SPIDevice.h"
+
+#define SPI_BUS_MAX 4
+
+//
+// SPIClass completion callbacks take no argument, so each bus gets its
+// own trampoline
+//
+static SPIBus *buses[SPI_BUS_MAX];
+
+void spiBusDone(uint8_t slot) {
+    buses[slot]->dmaDone();
+}
+
+static void spiBusDone0(void) { spiBusDone(0); }
+static void spiBusDone1(void) { spiBusDone(1); }
+static void spiBusDone2(void) { spiBusDone(2); }
+static void spiBusDone3(void) { spiBusDone(3); }
+
+static const SPICallback busDone[SPI_BUS_MAX] = {
+    spiBusDone0, spiBusDone1, spiBusDone2, spiBusDone3
+};
+
+// Registered with registerLoopCb(), picks up deferred CPU transfers
+static void spiBusPoll(void) {
+    uint8_t i;
+
+    for (i = 0; i < SPI_BUS_MAX && buses[i]; i++)
+        buses[i]->poll();
+}
+
+static inline bool inInterrupt(void) {
+    uint32_t ipsr;
+
+    __asm volatile ("mrs %0, ipsr" : "=r" (ipsr));
+    return ipsr != 0;
+}
+
+SPIBus::SPIBus(SPIClass &port) : spi(port), held() {
+    queue = NULL;
+    current = NULL;
+    slot = SPI_BUS_MAX;
+}
+
+void SPIBus::begin(void) {
+    uint8_t i;
+
+    if (slot < SPI_BUS_MAX)
+        return;
+    for (i = 0; i < SPI_BUS_MAX; i++) {
+        if (!buses[i]) {
+            buses[i] = this;
+            slot = i;
+            break;
+        }
+    }
+    if (slot == 0)
+        registerLoopCb(spiBusPoll);
+    spi.begin();
+}
+
+bool SPIBus::submit(SPITransaction &t) {
+    SPITransaction *volatile *p;
+    uint32_t saved;
+
+    if (t.pending)
+        return false;
+    t.pending = true;
+
+    saved = criticalEnter(INT_PRIORITY_SSI);
+    for (p = &queue; *p && (*p)->priority >= t.priority; p = &(*p)->next)
+        ;
+    t.next = *p;
+    *p = &t;
+    criticalExit(saved);
+
+    startNext();
+    return true;
+}
+
+//
+// Chains only exist as DMA tasks, so they go MSB first regardless; a bus
+// without a DMA slot can only run plain transfers.
+//
+bool SPIBus::needsCpu(const SPITransaction *t) const {
+    return slot >= SPI_BUS_MAX ||
+           (!t->chain && t->device->settings._SSIBitOrder != MSBFIRST);
+}
+
+//
+// Claim the bus for the head of the queue and start it. DMA transfers end
+// in dmaDone(); the ones clocked here finish inline and the loop moves on.
+// From the SSI interrupt only DMA transfers are started, a CPU clocked one
+// at the head stays queued for thread context.
+//
+void SPIBus::startNext(void) {
+    SPITransaction *t;
+    SPIDevice *dev;
+    uint32_t saved;
+    bool isr = inInterrupt();
+
+    for (;;) {
+        saved = criticalEnter(INT_PRIORITY_SSI);
+        t = current ? NULL : queue;
+        if (t && isr && needsCpu(t))
+            t = NULL;
+        if (t) {
+            queue = t->next;
+            current = t;
+        }
+        criticalExit(saved);
+        if (!t)
+            return;
+
+        dev = t->device;
+        spi.applySettings(dev->settings);
+        dev->select();
+        t->status = SPI_TRANSACTION_OK;
+
+        if (spi.isBusy()) {
+            // Someone runs DMA on the port outside the bus, any bytes
+            // clocked now would mix with theirs
+            t->status = SPI_TRANSACTION_BUSY;
+        } else if (!needsCpu(t)) {
+            if (t->chain ? spi.transferAsync(*t->chain, busDone[slot])
+                         : spi.transferAsync(t->tx, t->rx, t->count, busDone[slot]))
+                return;
+            // Empty, or the port is a slave
+            if (t->chain ? t->chain->size() : t->count)
+                t->status = SPI_TRANSACTION_FAILED;
+        } else if (t->chain) {
+            t->status = SPI_TRANSACTION_FAILED;
+        } else {
+            spi.transfer(t->tx, t->rx, t->count);
+        }
+        complete(t);
+    }
+}
+
+//
+// Claim the bus once it is idle, as startNext() would for a transaction,
+// and keep it until release(). Deferred CPU transfers are run meanwhile.
+//
+void SPIBus::acquire(SPIDevice &dev) {
+    uint32_t saved;
+    bool claimed;
+
+    for (;;) {
+        lockfree::waitUntil([this]() { return !current && !queue; }, 1);
+        saved = criticalEnter(INT_PRIORITY_SSI);
+        claimed = !current && !queue;
+        if (claimed)
+            current = &held;
+        criticalExit(saved);
+        if (claimed)
+            break;
+        poll();
+    }
+
+    held.device = &dev;
+    spi.applySettings(dev.settings);
+    dev.select();
+}
+
+void SPIBus::release(void) {
+    held.device->deselect();
+    current = NULL;
+    startNext();
+}
+
+void SPIBus::complete(SPITransaction *t) {
+    t->device->deselect();
+    current = NULL;
+    t->pending = false;
+    if (t->callback)
+        t->callback(t);
+}
+
+void SPIBus::dmaDone(void) {
+    complete(current);
+    startNext();
+}
+
+//
+// SPIDevice
+//
+uint32_t SPIDevice::csDummy;
+
+SPIDevice::SPIDevice(SPIBus &spiBus, uint8_t pin, const SPISettings &spiSettings)
+    : bus(spiBus), settings(spiSettings), csPin(pin), csData(&csDummy) {
+}
+
+void SPIDevice::begin(void) {
+    uint8_t port = digitalPinToPort(csPin);
+
+    pinMode(csPin, OUTPUT);
+    if (port != NOT_A_PORT)
+        csData = (volatile uint32_t *)((uint32_t) portBASERegister(port) + GPIO_O_DATA +
+                                       (digitalPinToBitMask(csPin) << 2));
+    deselect();
+    bus.begin();
+}
+
+bool SPIDevice::submit(SPITransaction &t, SPITransactionCallback callback, uint8_t priority) {
+    t.device = this;
+    t.callback = callback;
+    t.priority = priority;
+    return bus.submit(t);
+}
+
+//
+// Wait in thread context for t, starting whatever the SSI interrupt left
+// for it in between; the transfer waited for may be one of those. From an
+// interrupt at or above the SSI or SysTick priority t would never finish,
+// so the blocking transfers refuse to start there.
+//
+bool SPIDevice::wait(SPITransaction &t) {
+    while (!lockfree::waitUntil([&]() { return !t.pending; }, 1))
+        bus.poll();
+    return t.status == SPI_TRANSACTION_OK;
+}
+
+bool SPIDevice::transfer(const void *txBuf, void *rxBuf, size_t count) {
+    SPITransaction t = {};
+
+    t.tx = txBuf;
+    t.rx = rxBuf;
+    t.count = count;
+    if (!count)
+        return true;
+    if (inInterrupt() || !submit(t))
+        return false;
+    return wait(t);
+}
+
+bool SPIDevice::transfer(SPIChain &chain) {
+    SPITransaction t = {};
+
+    t.chain = &chain;
+    if (inInterrupt() || !submit(t))
+        return false;
+    return wait(t);
+}
@@ -0,0 +1,151 @@
+/*
+  SPIDevice.h - Shared SPI bus with per device settings and chip select
+  Copyright (c) 2016 Energia.  All right reserved.
+
+    SPIBus bus(SPI2);
+    SPIDevice radio(bus, 18, SPISettings(8000000, MSBFIRST, SPI_MODE0));
+    SPIDevice flash(bus, 12, SPISettings(20000000, MSBFIRST, SPI_MODE3));
+
+    radio.transfer(cmd, reply, 4);          // blocking
+    flash.submit(readPage);                 // queued, callback when done
+
+  Every transaction carries its device, so the bus applies that device's
+  clock, mode and bit order and drives its chip select around it. Queued
+  transactions run back to back by uDMA from the SSI interrupt, highest
+  priority first and in submit order within a priority. LSBFIRST devices
+  are clocked by the CPU, since the DMA path is MSB first only; chains
+  always go by DMA and so always MSB first. CPU clocked transfers block,
+  so when one comes up in the SSI interrupt it is left queued until
+  thread context picks it up: submit(), a blocking transfer, or the
+  loop() / delay() hook the bus registers. Interrupt handlers use submit()
+  and a callback; the blocking calls are for thread context only.
+
+  Protocols that poll for a reply under one chip select, such as SD
+  cards, cannot put a whole exchange into one transaction. Between
+  beginTransaction() and endTransaction() the device holds the bus with
+  chip select low and talks to port() directly; queued transactions wait
+  until it lets go.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef SPIDevice_h
+#define SPIDevice_h
+
+#include "SPI.h"
+
+class SPIDevice;
+struct SPITransaction;
+
+// Called once the transaction is done, from the SSI interrupt or, for CPU
+// clocked ones, from thread context
+typedef void (*SPITransactionCallback)(SPITransaction *t);
+
+// SPITransaction::status once pending is false
+#define SPI_TRANSACTION_OK      0
+#define SPI_TRANSACTION_BUSY    1   // the port's DMA was in use outside the bus
+#define SPI_TRANSACTION_FAILED  2   // DMA refused it, or a chain without a DMA slot
+
+//
+// One chip select cycle. Either tx/rx/count or a chain; tx NULL sends
+// 0xFF, rx NULL discards. Owned by the caller and must stay in scope
+// until pending is false.
+//
+struct SPITransaction {
+  SPIDevice *device;
+  const void *tx;
+  void *rx;
+  size_t count;
+  SPIChain *chain;
+  uint8_t priority;                   // higher runs first
+  SPITransactionCallback callback;
+  void *user;
+  volatile bool pending;
+  uint8_t status;                     // SPI_TRANSACTION_xxx
+  SPITransaction *next;
+};
+
+class SPIBus {
+public:
+  SPIBus(SPIClass &spi);
+  void begin(void);
+
+  // false if t is already queued
+  bool submit(SPITransaction &t);
+  bool isBusy(void) const { return current || queue; }
+  SPIClass &port(void) { return spi; }
+  // Start what the SSI interrupt left for thread context
+  void poll(void) { startNext(); }
+
+private:
+  SPIClass &spi;
+  SPITransaction *volatile queue;
+  SPITransaction *volatile current;
+  SPITransaction held;                // current while a device holds the bus
+  uint8_t slot;
+
+  void acquire(SPIDevice &dev);
+  void release(void);
+  bool needsCpu(const SPITransaction *t) const;
+  void startNext(void);
+  void complete(SPITransaction *t);
+  void dmaDone(void);
+  friend void spiBusDone(uint8_t slot);
+  friend class SPIDevice;
+};
+
+class SPIDevice {
+public:
+  SPIDevice(SPIBus &bus, uint8_t csPin, const SPISettings &settings);
+  void begin(void);
+
+  // Blocking, waits behind anything already queued on the bus; thread
+  // context only. false when called from an interrupt, which would wait
+  // forever, or when the transfer could not be run, see SPI_TRANSACTION_xxx
+  bool transfer(const void *txBuf, void *rxBuf, size_t count);
+  bool transfer(SPIChain &chain);
+  void write(const void *buf, size_t count) { transfer(buf, NULL, count); }
+  void read(void *buf, size_t count) { transfer(NULL, buf, count); }
+
+  // Queue t for this device and return at once
+  bool submit(SPITransaction &t, SPITransactionCallback callback = NULL,
+              uint8_t priority = 0);
+
+  // Hold the bus, waiting behind anything queued, and select the device;
+  // thread context only, from an interrupt it never returns. Transfers in
+  // between go straight to port().
+  void beginTransaction(void) { bus.acquire(*this); }
+  void endTransaction(void) { bus.release(); }
+  SPIClass &port(void) { return bus.port(); }
+
+  // Used from the next transaction on
+  void setSettings(const SPISettings &spiSettings) { settings = spiSettings; }
+  const SPISettings &getSettings(void) const { return settings; }
+
+  void select(void) { *csData = 0; }
+  void deselect(void) { *csData = 0xFF; }
+
+private:
+  SPIBus &bus;
+  SPISettings settings;
+  uint8_t csPin;
+  // GPIODATA alias that writes only the chip select bit
+  volatile uint32_t *csData;
+  static uint32_t csDummy;
+  bool wait(SPITransaction &t);
+  friend class SPIBus;
+};
+
+#endif
@@ -0,0 +1,60 @@
+/*
+  Shared Bus
+
+  Two devices with different clocks and modes on the BoosterPack SPI.
+  The bus switches settings and chip selects per transaction; the sensor
+  read is queued and finishes in the background while loop() carries on.
+
+  The circuit:
+  * Sensor CS on pin 12, SPI mode 0 at 1 MHz
+  * Flash CS on pin 13, SPI mode 3 at 20 MHz
+*/
+
+#include <SPI.h>
+#include <SPIDevice.h>
+
+SPIBus bus(SPI);
+SPIDevice sensor(bus, 12, SPISettings(1000000, MSBFIRST, SPI_MODE0));
+SPIDevice flash(bus, 13, SPISettings(20000000, MSBFIRST, SPI_MODE3));
+
+uint8_t sensorCmd[3] = { 0x80, 0x00, 0x00 };
+uint8_t sensorData[3];
+SPITransaction sensorRead;
+volatile bool sensorReady;
+
+void sensorDone(SPITransaction *t)
+{
+  sensorReady = true;
+}
+
+void setup()
+{
+  Serial.begin(115200);
+  sensor.begin();
+  flash.begin();
+
+  sensorRead.tx = sensorCmd;
+  sensorRead.rx = sensorData;
+  sensorRead.count = sizeof(sensorCmd);
+}
+
+void loop()
+{
+  uint8_t jedec[4] = { 0x9F };
+
+  sensor.submit(sensorRead, sensorDone, 1);
+
+  // Waits for the sensor read if it is still on the bus
+  flash.transfer(jedec, jedec, sizeof(jedec));
+  Serial.print("flash id ");
+  Serial.print(jedec[1], HEX);
+  Serial.print(jedec[2], HEX);
+  Serial.println(jedec[3], HEX);
+
+  while (!sensorReady)
+    ;
+  sensorReady = false;
+  Serial.print("sensor ");
+  Serial.println((sensorData[1] << 8) | sensorData[2]);
+  delay(1000);
+}
@@ -35,13 +35,16 @@ static void calculatePeriodRemainder(void)
 	remainderPulseWidth = REFRESH_INTERVAL - servoPeriodSum;
 }
 
-static void initServo(void) {
+// The ISR reloads the timer from ticksPerMicrosecond on every pulse
+static void servoCpuFrequencyChanged(uint32_t hz, uint8_t phase)
+{
+	if (phase == CPU_FREQ_POST)
+		ticksPerMicrosecond = hz / 1000000;
+}
 
-	/* Work around for clock not yet up in the constructor */
-#ifdef TARGET_IS_BLIZZARD_RB1
-	ROM_SysCtlClockSet(SYSCTL_SYSDIV_2_5|SYSCTL_USE_PLL|SYSCTL_XTAL_16MHZ|SYSCTL_OSC_MAIN);
-#endif
+static void initServo(void) {
 
+	// The system clock is set up by ResetISR before constructors run
 	// Initialize global variables
 	ticksPerMicrosecond = 0;
 	servoAssignedMask = 0;
@@ -68,12 +71,14 @@ static void initServo(void) {
 	ROM_TimerConfigure(SERVO_TIMER, SERVO_TIME_CFG);
 
 	// Calculate the number of timer counts/microsecond
-	ticksPerMicrosecond = F_CPU / 1000000;
+	ticksPerMicrosecond = cpuFrequency() / 1000000;
+	registerCpuFrequencyCb(servoCpuFrequencyChanged);
 
 	// Initially load the timer with 20ms interval time
 	ROM_TimerLoadSet(SERVO_TIMER, SERVO_TIMER_A, ticksPerMicrosecond * REFRESH_INTERVAL);
 
 	// Setup the interrupt for the TIMER1A timeout.
+	ROM_IntPrioritySet(SERVO_TIMER_INTERRUPT, INT_PRIORITY_SERVO);
 	ROM_IntEnable(SERVO_TIMER_INTERRUPT);
 	ROM_TimerIntEnable(SERVO_TIMER, SERVO_TIMER_TRIGGER);
 
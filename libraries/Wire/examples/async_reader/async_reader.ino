@@ -0,0 +1,69 @@
+// Wire Asynchronous Reader
+
+// Demonstrates requestFromAsync(): every 10 ms 16 bytes are read from
+// register 0 of the I2C device at address 0x68 while loop() keeps
+// counting. The interrupt moves the bytes and calls sensorDone() at the
+// end, so the CPU is free for the 1.5 ms the transfer takes at 100 kHz.
+
+// This example code is in the public domain.
+
+
+#include <Wire.h>
+
+#define DEVICE   0x68
+#define LENGTH   16
+
+volatile bool ready;
+volatile uint8_t result;
+unsigned long next;
+unsigned long spins;
+
+void sensorDone(uint8_t status, uint8_t count)
+{
+  result = status;
+  ready = true;
+}
+
+void registerSent(uint8_t status, uint8_t count)
+{
+  // Repeated START, then read; called from the I2C interrupt
+  if (status == WIRE_SUCCESS)
+    Wire.requestFromAsync(DEVICE, LENGTH, sensorDone);
+  else
+    sensorDone(status, 0);
+}
+
+void setup()
+{
+  Wire.begin();
+  Wire.setWireTimeout(5000);   // give up on a byte after 5 ms
+  Serial.begin(115200);
+}
+
+void loop()
+{
+  spins++;                     // work done while the bus is busy
+
+  if (ready) {
+    ready = false;
+    if (result == WIRE_SUCCESS) {
+      while (Wire.available()) {
+        Serial.print(Wire.read(), HEX);
+        Serial.print(' ');
+      }
+    } else {
+      Serial.print("error ");
+      Serial.print(result);
+    }
+    Serial.print(" spins ");
+    Serial.println(spins);
+    spins = 0;
+  }
+
+  if ((long)(millis() - next) >= 0 && !Wire.isBusy()) {
+    next = millis() + 10;
+    Wire.beginTransmission(DEVICE);
+    Wire.write(0);
+    Wire.transmitAsync(registerSent, false);
+  }
+}
@@ -47,6 +47,7 @@
 #include "driverlib/pin_map.h"
 #include "driverlib/sysctl.h"
 #include "driverlib/i2c.h"
+#include "priority.h"
 #include "Wire.h"
 
 #define TX_BUFFER_EMPTY    (txReadIndex == txWriteIndex)
@@ -61,6 +62,11 @@
 #define ACK_BIT 	0x8
 #define HS_PREAMBLE 0x07
 
+// masterPhase
+#define PHASE_HS    0   // high speed master code on the bus
+#define PHASE_DATA  1
+#define PHASE_STOP  2   // STOP after an error, masterStatus holds it
+
 
 #define NOT_ACTIVE  0xA
 
@@ -221,61 +227,154 @@ static const unsigned long g_uli2cSCLPins[4] =
 
 TwoWire::TwoWire()
 {
+	wireTimeout = WIRE_TIMEOUT_US;
 }
 
 TwoWire::TwoWire(unsigned long module)
 {
 	i2cModule = module;
+	wireTimeout = WIRE_TIMEOUT_US;
 }
 
 // Private Methods //////////////////////////////////////////////////////////////
 
-uint8_t getError(uint8_t thrownError) {
-  if(thrownError == I2C_MASTER_ERR_ADDR_ACK) return(2);
-  else if(thrownError == I2C_MASTER_ERR_DATA_ACK) return(3);
-  else if(thrownError != 0) return (4);
-  else return(0);
+static uint8_t getError(uint8_t thrownError) {
+  if(thrownError == I2C_MASTER_ERR_ADDR_ACK) return(WIRE_NACK_ADDR);
+  else if(thrownError == I2C_MASTER_ERR_DATA_ACK) return(WIRE_NACK_DATA);
+  else if(thrownError != 0) return (WIRE_ERROR);
+  else return(WIRE_SUCCESS);
+}
+
+/*
+ * Every byte is one MCS command; the master interrupt fires when it is
+ * done and the handler issues the next. The first command carries START,
+ * the last one STOP, received bytes are ACKed except the last.
+ */
+void TwoWire::masterCommand(void) {
+	unsigned long cmd = RUN_BIT;
+
+	if (masterCount == 0)
+		cmd |= START_BIT;
+	if (masterLeft > 1)
+		cmd |= (masterOp == MASTER_RX) ? ACK_BIT : 0;
+	else if (masterStop)
+		cmd |= STOP_BIT;
+
+	if (masterOp == MASTER_TX) {
+		ROM_I2CMasterDataPut(MASTER_BASE, txBuffer[txReadIndex]);
+		txReadIndex = (txReadIndex + 1) % BUFFER_LENGTH;
+	}
+	HWREG(MASTER_BASE + I2C_O_MCS) = cmd;
 }
 
-uint8_t TwoWire::getRxData(unsigned long cmd) {
+bool TwoWire::masterStart(uint8_t op, uint8_t address, uint8_t quantity,
+		TwoWireCallback callback, uint8_t sendStop) {
 
-	if (currentState == IDLE)
-	    while(ROM_I2CMasterBusBusy(MASTER_BASE));
+	if (isBusy())
+		return false;
+
+	masterCallback = callback;
+	masterStatus = WIRE_SUCCESS;
+	masterCount = 0;
+	masterLeft = quantity;
+	masterStop = sendStop;
+	if (op == MASTER_TX)
+		txEnd = (txReadIndex + quantity) % BUFFER_LENGTH;
+	if (!quantity) {
+		if (callback)
+			callback(WIRE_SUCCESS, 0);
+		return true;
+	}
+
+	masterTime = micros();
+	masterOp = op;
+	masterAddress = address;
+	if (highSpeed == I2C_MTPR_HS && currentState == IDLE) {
+		// The master code goes first, the interrupt then sends the address
+		masterPhase = PHASE_HS;
+		ROM_I2CMasterSlaveAddrSet(MASTER_BASE, HS_PREAMBLE, true);
+		ROM_I2CMasterControl(MASTER_BASE, I2C_MASTER_CMD_HS_MASTER_CODE_SEND);
+	} else {
+		masterPhase = PHASE_DATA;
+		ROM_I2CMasterSlaveAddrSet(MASTER_BASE, address, op == MASTER_RX);
+		masterCommand();
+	}
+	return true;
+}
+
+void TwoWire::masterFinish(uint8_t status) {
+	masterStatus = status;
+	// Drop what an error left unsent, keep bytes queued for the next one
+	if (masterOp == MASTER_TX)
+		txReadIndex = txEnd;
+	// Without STOP the bus stays ours and the next transfer repeats START
+	currentState = (masterStop || status != WIRE_SUCCESS) ? IDLE : masterOp;
+	masterOp = IDLE;
+	if (masterCallback)
+		masterCallback(status, masterCount);
+}
+
+void TwoWire::masterIntHandler(void) {
+	HWREG(MASTER_BASE + I2C_O_MICR) = I2C_MICR_IC;
+	if (masterOp == IDLE)
+		return;
+	masterTime = micros();
+
+	if (masterPhase == PHASE_STOP) {
+		masterFinish(masterStatus);
+		return;
+	}
+	if (masterPhase == PHASE_HS) {
+		masterPhase = PHASE_DATA;
+		ROM_I2CMasterSlaveAddrSet(MASTER_BASE, masterAddress, masterOp == MASTER_RX);
+		masterCommand();
+		return;
+	}
 
-	HWREG(MASTER_BASE + I2C_O_MCS) = cmd;
-	/*
-	 * Work-around of I2C MasterBUSY Status bit does not get set Immediately
-	 * See ERRATA I2C#08 in http://www.ti.com/lit/er/spmz850g/spmz850g.pdf
-	 */
-	
-    while(!(HWREG(MASTER_BASE + I2C_O_MRIS) & I2C_MRIS_RIS));
-    HWREG(MASTER_BASE + I2C_O_MICR) |= I2C_MICR_IC;
 	uint8_t error = ROM_I2CMasterErr(MASTER_BASE);
 	if (error != I2C_MASTER_ERR_NONE) {
-        ROM_I2CMasterControl(MASTER_BASE, I2C_MASTER_CMD_BURST_RECEIVE_ERROR_STOP);
+		masterStatus = getError(error);
+		if (error & I2C_MASTER_ERR_ARB_LOST) {
+			// The bus belongs to the other master, no STOP from us
+			masterFinish(masterStatus);
+		} else if (masterLeft == 1 && masterStop) {
+			// The failed command carried STOP, the bus is already
+			// released and no further interrupt is coming
+			masterFinish(masterStatus);
+		} else {
+			masterPhase = PHASE_STOP;
+			ROM_I2CMasterControl(MASTER_BASE, masterOp == MASTER_RX ?
+					I2C_MASTER_CMD_BURST_RECEIVE_ERROR_STOP :
+					I2C_MASTER_CMD_BURST_SEND_ERROR_STOP);
+		}
+		return;
 	}
-	else {
+
+	if (masterOp == MASTER_RX) {
 		rxBuffer[rxWriteIndex] = ROM_I2CMasterDataGet(MASTER_BASE);
 		rxWriteIndex = (rxWriteIndex + 1) % BUFFER_LENGTH;
 	}
-	return error;
-
+	masterCount++;
+	if (--masterLeft)
+		masterCommand();
+	else
+		masterFinish(WIRE_SUCCESS);
 }
 
-uint8_t TwoWire::sendTxData(unsigned long cmd, uint8_t data) {
-    ROM_I2CMasterDataPut(MASTER_BASE, data);
+/*
+ * A byte took longer than wireTimeout, most likely a slave holding SCL
+ * low. Reset the controller and release the bus, keeping the bit rate.
+ */
+void TwoWire::masterAbort(void) {
+	uint32_t tpr = HWREG(MASTER_BASE + I2C_O_MTPR);
+	uint32_t pc = HWREG(MASTER_BASE + I2C_O_PC);
 
-    HWREG(MASTER_BASE + I2C_O_MCS) = cmd;
-	/*
-	 * Work-around of I2C MasterBUSY Status bit does not get set Immediately
-	 * See ERRATA I2C#08 in http://www.ti.com/lit/er/spmz850g/spmz850g.pdf
-	 */
-    while(!(HWREG(MASTER_BASE + I2C_O_MRIS) & I2C_MRIS_RIS));
-    HWREG(MASTER_BASE + I2C_O_MICR) |= I2C_MICR_IC;
-    uint8_t error = ROM_I2CMasterErr(MASTER_BASE);
-    if (error != I2C_MASTER_ERR_NONE)
-		  ROM_I2CMasterControl(MASTER_BASE, I2C_MASTER_CMD_BURST_SEND_ERROR_STOP);
-    return(getError(error));
+	forceStop();
+	HWREG(MASTER_BASE + I2C_O_PC) = pc;
+	HWREG(MASTER_BASE + I2C_O_MTPR) = tpr;
+	ROM_I2CMasterIntEnable(MASTER_BASE);
+	timeoutFlag = true;
+	masterFinish(WIRE_TIMEOUT);
 }
 
 void TwoWire::forceStop(void) {
@@ -298,7 +397,7 @@ void TwoWire::forceStop(void) {
      */
     ROM_SysCtlPeripheralReset(g_uli2cPeriph[i2cModule]);
     while(!ROM_SysCtlPeripheralReady(g_uli2cPeriph[i2cModule]));
-    ROM_I2CMasterInitExpClk(MASTER_BASE, F_CPU, false);
+    ROM_I2CMasterInitExpClk(MASTER_BASE, cpuFrequency(), false);
 }
 
 // Public Methods //////////////////////////////////////////////////////////////
@@ -322,7 +421,7 @@ void TwoWire::begin(void)
   ROM_GPIOPinConfigure(g_uli2cConfig[i2cModule][1]);
   ROM_GPIOPinTypeI2C(g_uli2cBase[i2cModule], g_uli2cSDAPins[i2cModule]);
   ROM_GPIOPinTypeI2CSCL(g_uli2cBase[i2cModule], g_uli2cSCLPins[i2cModule]);
-  ROM_I2CMasterInitExpClk(MASTER_BASE, F_CPU, false);//max bus speed=400kHz for gyroscope
+  ROM_I2CMasterInitExpClk(MASTER_BASE, cpuFrequency(), false);//max bus speed=400kHz for gyroscope
 
   // Force a stop condition
   if(!ROM_GPIOPinRead(g_uli2cBase[i2cModule], g_uli2cSCLPins[i2cModule]))
@@ -337,7 +436,7 @@ void TwoWire::begin(void)
   	  do{
   		  for(unsigned long i = 0; i < 10 ; i++) {
   		      // 100Hz=desired frequency, delay iteration=3 cycles
-  			  ROM_SysCtlDelay(F_CPU/100000/3);
+  			  ROM_SysCtlDelay(cpuFrequency()/100000/3);
   			  mask = (i%2) ? g_uli2cSCLPins[i2cModule] : 0;
   			  ROM_GPIOPinWrite(g_uli2cBase[i2cModule], g_uli2cSCLPins[i2cModule], mask);
   		  }
@@ -350,6 +449,17 @@ void TwoWire::begin(void)
 
   }
 
+  // Master transfers are driven by the interrupt
+  currentState = IDLE;
+  masterOp = IDLE;
+  HWREG(MASTER_BASE + I2C_O_MICR) = I2C_MICR_IC;
+  ROM_I2CMasterIntEnable(MASTER_BASE);
+  ROM_IntPrioritySet(g_uli2cInt[i2cModule], INT_PRIORITY_I2C);
+  ROM_IntEnable(g_uli2cInt[i2cModule]);
+
+  busClock = 100000;
+  highSpeed = 0;
+  registerCpuFrequencyCb(cpuFrequencyChanged);
 }
 
 /*
@@ -370,6 +480,7 @@ void TwoWire::begin(uint8_t address)
   slaveAddress = address;
 
   // Enable slave interrupts
+  ROM_IntPrioritySet(g_uli2cInt[i2cModule], INT_PRIORITY_I2C);
   ROM_IntEnable(g_uli2cInt[i2cModule]);
   I2CSlaveIntEnableEx(SLAVE_BASE, I2C_SLAVE_INT_DATA | I2C_SLAVE_INT_STOP);
   HWREG(SLAVE_BASE + I2C_O_SICR) =
@@ -389,60 +500,37 @@ void TwoWire::begin(int address)
   begin((uint8_t)address);
 }
 
-uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity, uint8_t sendStop)
+bool TwoWire::requestFromAsync(uint8_t address, uint8_t quantity,
+		TwoWireCallback callback, uint8_t sendStop)
 {
-  uint8_t error = 0;
-  uint8_t oldWriteIndex = rxWriteIndex;
-  uint8_t spaceAvailable = (rxWriteIndex >= rxReadIndex) ?
-		 BUFFER_LENGTH - (rxWriteIndex - rxReadIndex) : (rxReadIndex - rxWriteIndex);
+  // The ring holds BUFFER_LENGTH - 1 bytes
+  uint8_t spaceAvailable = BUFFER_LENGTH - 1 - available();
 
   if (quantity > spaceAvailable)
 	  quantity = spaceAvailable;
-  if (!quantity) return 0;
 
-  /*
-   * Select which slave we are requesting data from
-   * true indicates we are reading from the slave.
-   */
-  ROM_I2CMasterSlaveAddrSet(MASTER_BASE, address, true);
-
-  unsigned long cmd = 0;
-
-  if((quantity > 1) || !sendStop)
-	  cmd = RUN_BIT | START_BIT | ACK_BIT;
-  else cmd = RUN_BIT | START_BIT | (sendStop << 2);
-
-  error = getRxData(cmd);
-  if(error) return 0;
-
-  currentState = MASTER_RX;
-
-  for (int i = 1; i < quantity; i++) {
-	  /*
-	   * Since NACK is being sent on last byte, a consecutive burst read will
-	   * need to send a start condition.
-	   */
-	  if(i == (quantity - 1))
-		cmd = RUN_BIT;
-	  else
-		cmd = RUN_BIT | ACK_BIT;
-
-	  error = getRxData(cmd);
-	  if(error) return i;
-  }
+  return masterStart(MASTER_RX, address, quantity, callback, sendStop);
+}
 
-  if(sendStop) {
-	  HWREG(MASTER_BASE + I2C_O_MCS) = STOP_BIT;
-      while(!(HWREG(MASTER_BASE + I2C_O_MRIS) & I2C_MRIS_RIS));
-      HWREG(MASTER_BASE + I2C_O_MICR) |= I2C_MICR_IC;
-	  currentState = IDLE;
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity, uint8_t sendStop)
+{
+  uint32_t start = micros();
+
+  waitDone();
+  // Another master may still own the bus
+  if (currentState == IDLE) {
+	  while (ROM_I2CMasterBusBusy(MASTER_BASE)) {
+		  if (wireTimeout && micros() - start > wireTimeout) {
+			  timeoutFlag = true;
+			  return 0;
+		  }
+	  }
   }
 
-  uint8_t bytesWritten = (rxWriteIndex >= oldWriteIndex) ?
-		 (rxWriteIndex - oldWriteIndex) : (oldWriteIndex - rxWriteIndex);
-
-  return(bytesWritten);
-
+  if (!requestFromAsync(address, quantity, NULL, sendStop))
+	  return 0;
+  waitDone();
+  return masterCount;
 }
 
 uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity)
@@ -470,51 +558,24 @@ void TwoWire::beginTransmission(int address)
   beginTransmission((uint8_t)address);
 }
 
-uint8_t TwoWire::endTransmission(uint8_t sendStop)
+bool TwoWire::transmitAsync(TwoWireCallback callback, uint8_t sendStop)
 {
-  uint8_t error = I2C_MASTER_ERR_NONE;
-
-  if(highSpeed == I2C_MTPR_HS) {
-      I2CMasterSlaveAddrSet(MASTER_BASE, HS_PREAMBLE, true);
-      I2CMasterControl(MASTER_BASE, I2C_MASTER_CMD_HS_MASTER_CODE_SEND);
-      /*
-       * Work-around of I2C MasterBUSY Status bit does not get set Immediately
-       * See ERRATA I2C#08 in http://www.ti.com/lit/er/spmz850g/spmz850g.pdf
-       */
-      while(!(HWREG(MASTER_BASE + I2C_O_MRIS) & I2C_MRIS_RIS));
-      HWREG(MASTER_BASE + I2C_O_MICR) |= I2C_MICR_IC;
-  }
-
-  if(TX_BUFFER_EMPTY) return 0;
-
-  I2CMasterSlaveAddrSet(MASTER_BASE, txAddress, false);
-
-  unsigned long cmd = RUN_BIT | START_BIT;
-
-  error = sendTxData(cmd,txBuffer[txReadIndex]);
-  txReadIndex = (txReadIndex + 1) % BUFFER_LENGTH;
-  if(error) return error;
-  while(!TX_BUFFER_EMPTY) {
-	  error = sendTxData(RUN_BIT,txBuffer[txReadIndex]);
-  	  txReadIndex = (txReadIndex + 1) % BUFFER_LENGTH;
-	  if(error) return getError(error);
-  }
-
-  if(sendStop) {
-	  HWREG(MASTER_BASE + I2C_O_MCS) = STOP_BIT;
-
-	  while(!(HWREG(MASTER_BASE + I2C_O_MRIS) & I2C_MRIS_RIS));
-	          HWREG(MASTER_BASE + I2C_O_MICR) |= I2C_MICR_IC;
-	  currentState = IDLE;
-  }
-  else {
-	  currentState = MASTER_TX;
-  }
+  uint8_t quantity = (txWriteIndex >= txReadIndex) ?
+		  (txWriteIndex - txReadIndex) : BUFFER_LENGTH - (txReadIndex - txWriteIndex);
 
+  if (!masterStart(MASTER_TX, txAddress, quantity, callback, sendStop))
+	  return false;
   // Indicate that we are done transmitting.
   transmitting = 0;
-  return error;
+  return true;
+}
 
+uint8_t TwoWire::endTransmission(uint8_t sendStop)
+{
+  waitDone();
+  if (!transmitAsync(NULL, sendStop))
+	  return WIRE_ERROR;
+  return waitDone();
 }
 
 /*
@@ -575,7 +636,7 @@ int TwoWire::read(void)
   int value = -1;
   
   // Get each successive byte on each call
-  if(!RX_BUFFER_FULL){
+  if(!RX_BUFFER_EMPTY){
     value = rxBuffer[rxReadIndex];
     rxReadIndex = (rxReadIndex + 1) % BUFFER_LENGTH;
   }
@@ -614,8 +675,6 @@ void TwoWire::onRequest( void (*function)(void) )
 void TwoWire::setClock(uint32_t clock)
 {
     uint32_t ui32SCLFreq = clock;
-    uint32_t ui32TPR;
-    uint32_t mul = 10;
 
     /*
      * Check for valid input. If no valid input set to 10 kHz.
@@ -626,19 +685,78 @@ void TwoWire::setClock(uint32_t clock)
 
 		if(hs_enabled && clock == 3400000) {
 			highSpeed = I2C_MTPR_HS;
-			mul =  3;
 			HWREG(MASTER_BASE + I2C_O_PC) |= I2C_PC_HS;
 		}
 	} else {
 	    ui32SCLFreq = 100000;
 	}
 
-	ui32TPR = ((F_CPU + (2 * mul * ui32SCLFreq) - 1) /
-	  	  (2 * mul * ui32SCLFreq)) - 1;
+	busClock = ui32SCLFreq;
+	setBitRate(cpuFrequency());
+}
+
+void TwoWire::setBitRate(uint32_t hz)
+{
+	uint32_t mul = (highSpeed == I2C_MTPR_HS) ? 3 : 10;
+	uint32_t ui32TPR = ((hz + (2 * mul * busClock) - 1) /
+			(2 * mul * busClock)) - 1;
+
 	HWREG(MASTER_BASE + I2C_O_MTPR) = ui32TPR | highSpeed;
 }
 
+//
+// Keep the SCL rate across setCpuFrequency(). A running transfer finishes
+// at the old rate first, then the timer period is reloaded for the new
+// clock.
+//
+void TwoWire::retime(uint32_t hz, uint8_t phase)
+{
+	if (phase == CPU_FREQ_PRE) {
+		while (isBusy())
+			;
+		return;
+	}
+	setBitRate(hz);
+}
+
+bool TwoWire::isBusy(void)
+{
+  if (masterOp == IDLE)
+	  return false;
+
+  uint32_t saved = criticalEnter(INT_PRIORITY_I2C);
+  if (masterOp != IDLE && wireTimeout && micros() - masterTime > wireTimeout)
+	  masterAbort();
+  criticalExit(saved);
+  return masterOp != IDLE;
+}
+
+uint8_t TwoWire::waitDone(void)
+{
+  while (isBusy()) {
+	  /*
+	   * Run the state machine here when the I2C interrupt cannot be
+	   * taken, e.g. when called from an ISR of the same or higher priority
+	   */
+	  uint32_t saved = criticalEnter(INT_PRIORITY_I2C);
+	  if (HWREG(MASTER_BASE + I2C_O_MMIS) & I2C_MMIS_MIS)
+		  masterIntHandler();
+	  criticalExit(saved);
+  }
+  return masterStatus;
+}
+
+void TwoWire::setWireTimeout(uint32_t timeoutUs)
+{
+  wireTimeout = timeoutUs;
+}
+
 void TwoWire::I2CIntHandler(void) {
+	if (HWREG(MASTER_BASE + I2C_O_MMIS) & I2C_MMIS_MIS) {
+		masterIntHandler();
+		return;
+	}
+
 	// Clear data interrupt
 	HWREG(SLAVE_BASE + I2C_O_SICR) = I2C_SICR_DATAIC;
 	uint8_t startDetected = 0;
@@ -670,7 +788,8 @@ void TwoWire::I2CIntHandler(void) {
 
 		    if(startDetected) {
 		        uint8_t oldWriteIndex = txWriteIndex;
-		        user_onRequest();
+		        if (user_onRequest)
+		            user_onRequest();
 
 		        // Send data if onRequest() wrote data that has yet to be sent
 		    	if(oldWriteIndex != txWriteIndex) {
@@ -696,18 +815,13 @@ void TwoWire::I2CIntHandler(void) {
 
 	if(stopDetected && currentState == SLAVE_RX) {
 		int avail = available();
-		user_onReceive(avail);
+		if (user_onReceive)
+			user_onReceive(avail);
 		currentState = IDLE;
 	}
 
 }
 
-void
-I2CIntHandler(void)
-{
-    Wire.I2CIntHandler();
-}
-
 void TwoWire::setModule(unsigned long _i2cModule)
 {
     i2cModule = _i2cModule;
@@ -749,3 +863,27 @@ void I2CIntHandler3(void)
     Wire3.I2CIntHandler();
 }
 #endif
+
+void TwoWire::cpuFrequencyChanged(uint32_t hz, uint8_t phase)
+{
+    TwoWire *const ports[] = {
+#if WIRE_INTERFACES_COUNT > 0
+        &Wire0,
+#endif
+#if WIRE_INTERFACES_COUNT > 1
+        &Wire1,
+#endif
+#if WIRE_INTERFACES_COUNT > 2
+        &Wire2,
+#endif
+#if WIRE_INTERFACES_COUNT > 3
+        &Wire3,
+#endif
+    };
+    unsigned i;
+
+    for (i = 0; i < sizeof(ports) / sizeof(ports[0]); i++) {
+        if (ports[i]->busClock)
+            ports[i]->retime(hz, phase);
+    }
+}
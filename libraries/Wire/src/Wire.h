@@ -12,6 +12,16 @@
 #define MASTER_RX 2
 #define SLAVE_RX 3
 
+// endTransmission() and completion status
+#define WIRE_SUCCESS      0
+#define WIRE_NACK_ADDR    2
+#define WIRE_NACK_DATA    3
+#define WIRE_ERROR        4     // arbitration lost or bus error
+#define WIRE_TIMEOUT      5
+
+// Default setWireTimeout(), longest wait for one byte in microseconds
+#define WIRE_TIMEOUT_US   25000
+
 #if defined(ENERGIA_EK_TM4C1294XL)
 #define BOOST_PACK_WIRE 0
 #define Wire Wire0
@@ -22,6 +32,13 @@
 #error "LauncPad not supported"
 #endif
 
+// Called when an asynchronous transfer is done, with its status and the
+// number of bytes sent or received. That is normally the I2C interrupt;
+// isBusy() and waitDone() call it from the caller's context, with the I2C
+// interrupt masked, when they time the transfer out (WIRE_TIMEOUT) or
+// finish it for an ISR that blocks the I2C interrupt
+typedef void (*TwoWireCallback)(uint8_t status, uint8_t count);
+
 class TwoWire : public Stream
 {
 
@@ -41,14 +58,36 @@ class TwoWire : public Stream
 		uint8_t transmitting;
 		uint8_t currentState;
 		uint32_t highSpeed;
+		uint32_t busClock;              // SCL rate, 0 until begin() as master
 		void (*user_onRequest)(void);
 		void (*user_onReceive)(int);
 		void onRequestService(void);
 		void onReceiveService(uint8_t*, int);
-		
-		uint8_t getRxData(unsigned long cmd);
-		uint8_t sendTxData(unsigned long cmd, uint8_t data);
+
+		// Master transfer run by the interrupt
+		volatile uint8_t masterOp;      // IDLE, MASTER_TX or MASTER_RX while busy
+		volatile uint8_t masterPhase;
+		volatile uint8_t masterStatus;
+		uint8_t masterLeft;             // bytes still to send or receive
+		uint8_t masterCount;            // bytes sent or received
+		uint8_t masterStop;
+		uint8_t masterAddress;
+		uint8_t txEnd;                  // txWriteIndex when the transmit started
+		TwoWireCallback masterCallback;
+		volatile uint32_t masterTime;   // micros() of the last progress
+		uint32_t wireTimeout;
+		volatile bool timeoutFlag;
+
+		bool masterStart(uint8_t op, uint8_t address, uint8_t quantity,
+				TwoWireCallback callback, uint8_t sendStop);
+		void masterCommand(void);
+		void masterFinish(uint8_t status);
+		void masterIntHandler(void);
+		void masterAbort(void);
 		void forceStop(void);
+		void setBitRate(uint32_t hz);
+		void retime(uint32_t hz, uint8_t phase);
+		static void cpuFrequencyChanged(uint32_t hz, uint8_t phase);
 
     public:
 		TwoWire(void);
@@ -74,6 +113,23 @@ class TwoWire : public Stream
 		void onRequest( void (*)(void) );
 		void setClock(uint32_t);
 
+		// Non-blocking master transfers. requestFromAsync() receives into
+		// the buffer read() takes from, transmitAsync() sends what was
+		// written since beginTransmission(). Both return false while an
+		// earlier transfer still runs.
+		bool requestFromAsync(uint8_t address, uint8_t quantity,
+				TwoWireCallback callback = NULL, uint8_t sendStop = true);
+		bool transmitAsync(TwoWireCallback callback = NULL, uint8_t sendStop = true);
+		bool isBusy(void);
+		// Status of the last transfer once it is done
+		uint8_t waitDone(void);
+
+		// Abort a transfer and reset the bus when a byte takes longer than
+		// timeoutUs, 0 waits forever
+		void setWireTimeout(uint32_t timeoutUs = WIRE_TIMEOUT_US);
+		bool getWireTimeoutFlag(void) { return timeoutFlag; }
+		void clearWireTimeoutFlag(void) { timeoutFlag = false; }
+
 		inline size_t write(unsigned long n) { return write((uint8_t)n); }
 		inline size_t write(long n) { return write((uint8_t)n); }
 		inline size_t write(unsigned int n) { return write((uint8_t)n); }